@@ -0,0 +1,527 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/Commandlets/PGNGenerateNarrativesCommandlet.h"
+
+#include "Async/ParallelFor.h"
+#include "Dom/JsonObject.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Policies/CondensedJsonPrintPolicy.h"
+#include "ProceduralNarrative/DataAssets/PGNCharacterDataAsset.h"
+#include "ProceduralNarrative/DataAssets/PGNEventDataAsset.h"
+#include "ProceduralNarrative/DataAssets/PGNMoodGraphDataAsset.h"
+#include "ProceduralNarrative/Generation/PGNNarrativePrefetcher.h"
+#include "ProceduralNarrative/Generation/PGNScratchMemory.h"
+#include "ProceduralNarrative/History/PGNCharacterTimeline.h"
+#include "ProceduralNarrative/Population/PGNVirtualPopulation.h"
+#include "ProceduralNarrative/World/PGNWorldData.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+// Turns a list of enum value names, such as ["MOOD_Joyful"], into the values.
+template <typename EnumType>
+static bool ParseEnumArrayField(const TSharedPtr<FJsonObject>& JsonObject, const TCHAR* NameOfField,
+	TArray<EnumType>& Out_AllValues, FString& Out_Error)
+{
+	const TArray<TSharedPtr<FJsonValue>>* AllJsonValues = nullptr;
+
+	if (!JsonObject.IsValid() || !JsonObject->TryGetArrayField(NameOfField, AllJsonValues))
+	{
+		return true;
+	}
+
+	for (const TSharedPtr<FJsonValue>& ThisJsonValue : *AllJsonValues)
+	{
+		const FString ThisName = ThisJsonValue->AsString();
+		const int64 Value = StaticEnum<EnumType>()->GetValueByNameString(ThisName);
+
+		if (Value == INDEX_NONE)
+		{
+			Out_Error = FString::Printf(TEXT("'%s' is not a valid value for %s."), *ThisName, NameOfField);
+			return false;
+		}
+
+		Out_AllValues.Add(static_cast<EnumType>(Value));
+	}
+
+	return true;
+}
+
+// The name of every value of an enum, indexed by the value, so that worker threads never have to go through UEnum.
+template <typename EnumType>
+static TArray<FString> CreateEnumNameTable()
+{
+	const UEnum* Enum = StaticEnum<EnumType>();
+
+	TArray<FString> AllNames;
+	AllNames.SetNum(256);
+
+	for (int32 Index_Enum = 0; Index_Enum < Enum->NumEnums(); Index_Enum++)
+	{
+		const int64 Value = Enum->GetValueByIndex(Index_Enum);
+
+		if (AllNames.IsValidIndex(static_cast<int32>(Value)))
+		{
+			AllNames[static_cast<int32>(Value)] = Enum->GetNameStringByIndex(Index_Enum);
+		}
+	}
+
+	return AllNames;
+}
+
+// Each chain scores the same few hundred candidates over and over, so a small cache goes a long way.
+static constexpr int32 NUMBER_OF_EVALUATIONS_TO_CACHE_PER_CHAIN = 16384;
+
+/*
+ * Fills in the casting candidates and the relationship oracle of a chain, from the neighbours of the anchor. Virtual
+ * characters only know the people who live near them, so, as in APGNOverseer::GatherCastingCandidates, these are the
+ * only people who can make a cast that knows each other.
+ */
+static void GatherCastingCandidatesOfChain(const FPGNVirtualPopulation& VirtualPopulation, int32 IndexOfAnchor,
+	int32 NumberOfCastingCandidates, FPGNNarrativeGenerationSnapshot& Out_Snapshot)
+{
+	const int32 NumberOfCandidates = FMath::Min(NumberOfCastingCandidates, VirtualPopulation.Num());
+	const int32 IndexOfFirstCandidate = FMath::Clamp(IndexOfAnchor - NumberOfCandidates / 2, 0,
+		VirtualPopulation.Num() - NumberOfCandidates);
+
+	Out_Snapshot.AllCastingCandidates.Reset(NumberOfCandidates);
+
+	FPGNCharacter ThisCharacter;
+
+	for (int32 Index_Character = IndexOfFirstCandidate; Index_Character < IndexOfFirstCandidate + NumberOfCandidates; Index_Character++)
+	{
+		if (VirtualPopulation.MaterializeCharacter(Index_Character, ThisCharacter))
+		{
+			FPGNCastingCandidate& NewCandidate = Out_Snapshot.AllCastingCandidates.AddDefaulted_GetRef();
+			NewCandidate.IndexOfCharacter = Index_Character;
+			NewCandidate.bIsMale = ThisCharacter.bIsMale;
+			NewCandidate.Template = ThisCharacter.MyCharacterTemplate;
+			NewCandidate.StateFlags = FPGNCharacterTimeline::GetInitialFlagsOfCharacter(ThisCharacter);
+		}
+	}
+
+	// The oracle only has to know the candidates, and they can only be related to someone within the neighbourhood.
+	const TSharedRef<FPGNRelationshipOracle, ESPMode::ThreadSafe> RelationshipOracle =
+		MakeShared<FPGNRelationshipOracle, ESPMode::ThreadSafe>();
+	RelationshipOracle->Reset(VirtualPopulation.Num());
+
+	const int32 IndexOfLastCandidate = IndexOfFirstCandidate + NumberOfCandidates - 1;
+
+	for (int32 IndexOfCharacterA = IndexOfFirstCandidate; IndexOfCharacterA <= IndexOfLastCandidate; IndexOfCharacterA++)
+	{
+		const int32 IndexOfLastNeighbour = FMath::Min(IndexOfCharacterA + FPGNVirtualPopulation::NEIGHBOURHOOD_RADIUS,
+			IndexOfLastCandidate);
+
+		for (int32 IndexOfCharacterB = IndexOfCharacterA + 1; IndexOfCharacterB <= IndexOfLastNeighbour; IndexOfCharacterB++)
+		{
+			FPGNRelationship Relationship;
+
+			if (!VirtualPopulation.FindRelationship(IndexOfCharacterA, IndexOfCharacterB, Relationship))
+			{
+				continue;
+			}
+
+			if (Relationship.bHasSocialRelationship)
+			{
+				RelationshipOracle->SetSocialRelationship(IndexOfCharacterA, IndexOfCharacterB,
+					Relationship.SocialRelationship, Relationship.DistanceBetweenCharacters);
+			}
+
+			if (Relationship.bAreSpouses)
+			{
+				RelationshipOracle->SetAreSpouses(IndexOfCharacterA, IndexOfCharacterB, true);
+			}
+		}
+	}
+
+	Out_Snapshot.RelationshipOracle = RelationshipOracle;
+}
+
+UPGNGenerateNarrativesCommandlet::UPGNGenerateNarrativesCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+	ShowErrorCount = true;
+}
+
+int32 UPGNGenerateNarrativesCommandlet::Main(const FString& Params)
+{
+	FString RequestFilename;
+
+	if (!FParse::Value(*Params, TEXT("Request="), RequestFilename))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Usage: -run=PGNGenerateNarratives -Request=<Request.json> [-Output=<Narratives.jsonl>] [-Seed=<Seed>] [-Count=<NumberOfNarratives>]"));
+		return 1;
+	}
+
+	FPGNNarrativeBatchRequest Request;
+	FString Error;
+
+	if (!ReadBatchRequest(RequestFilename, Request, Error))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not read the batch request %s: %s"), *RequestFilename, *Error);
+		return 1;
+	}
+
+	// The command line wins over the request file, so that one request can be sharded across several build agents.
+	FParse::Value(*Params, TEXT("Output="), Request.OutputFilename);
+	FParse::Value(*Params, TEXT("Seed="), Request.Seed);
+	FParse::Value(*Params, TEXT("Count="), Request.NumberOfNarratives);
+
+	if (Request.OutputFilename.IsEmpty())
+	{
+		Request.OutputFilename = FPaths::ChangeExtension(RequestFilename, TEXT("jsonl"));
+	}
+
+	return RunBatchRequest(Request) ? 0 : 1;
+}
+
+bool UPGNGenerateNarrativesCommandlet::ReadBatchRequest(const FString& Filename, FPGNNarrativeBatchRequest& Out_Request,
+	FString& Out_Error)
+{
+	FString JsonString;
+
+	if (!FFileHelper::LoadFileToString(JsonString, *Filename))
+	{
+		Out_Error = TEXT("The file could not be read.");
+		return false;
+	}
+
+	TSharedPtr<FJsonObject> RootObject;
+	const TSharedRef<TJsonReader<>> JsonReader = TJsonReaderFactory<>::Create(JsonString);
+
+	if (!FJsonSerializer::Deserialize(JsonReader, RootObject) || !RootObject.IsValid())
+	{
+		Out_Error = TEXT("The file is not a JSON object.");
+		return false;
+	}
+
+	Out_Request = FPGNNarrativeBatchRequest();
+
+	RootObject->TryGetNumberField(TEXT("Seed"), Out_Request.Seed);
+	RootObject->TryGetStringField(TEXT("EventLibraryFile"), Out_Request.EventLibraryFilename);
+	RootObject->TryGetStringField(TEXT("EventDataAsset"), Out_Request.EventDataAssetPath);
+	RootObject->TryGetStringField(TEXT("MoodGraphDataAsset"), Out_Request.MoodGraphDataAssetPath);
+	RootObject->TryGetStringField(TEXT("CharacterDataAsset"), Out_Request.CharacterDataAssetPath);
+	RootObject->TryGetNumberField(TEXT("CandidateNarratives"), Out_Request.NumberOfCandidateNarratives);
+	RootObject->TryGetNumberField(TEXT("EventsBeforeConclusion"), Out_Request.NumberOfEventsBeforeConclusion);
+	RootObject->TryGetNumberField(TEXT("Count"), Out_Request.NumberOfNarratives);
+	RootObject->TryGetNumberField(TEXT("NumberOfChains"), Out_Request.NumberOfChains);
+	RootObject->TryGetNumberField(TEXT("NarrativesPerBatch"), Out_Request.NumberOfNarrativesPerBatch);
+	RootObject->TryGetStringField(TEXT("Output"), Out_Request.OutputFilename);
+
+	// A relative event library path is relative to the request, so a request and its data can be moved together.
+	if (!Out_Request.EventLibraryFilename.IsEmpty() && FPaths::IsRelative(Out_Request.EventLibraryFilename))
+	{
+		Out_Request.EventLibraryFilename = FPaths::Combine(FPaths::GetPath(Filename), Out_Request.EventLibraryFilename);
+	}
+
+	const TSharedPtr<FJsonObject>* PopulationObject = nullptr;
+
+	if (RootObject->TryGetObjectField(TEXT("Population"), PopulationObject))
+	{
+		double AverageNumberOfSocialPartners = Out_Request.AverageNumberOfSocialPartners;
+
+		(*PopulationObject)->TryGetNumberField(TEXT("NumberOfCharacters"), Out_Request.NumberOfCharacters);
+		(*PopulationObject)->TryGetNumberField(TEXT("AverageNumberOfSocialPartners"), AverageNumberOfSocialPartners);
+		(*PopulationObject)->TryGetNumberField(TEXT("NumberOfCastingCandidates"), Out_Request.NumberOfCastingCandidates);
+
+		Out_Request.AverageNumberOfSocialPartners = static_cast<float>(AverageNumberOfSocialPartners);
+	}
+
+	const TSharedPtr<FJsonObject>* ConstraintsObject = nullptr;
+
+	if (RootObject->TryGetObjectField(TEXT("Constraints"), ConstraintsObject))
+	{
+		if (!ParseEnumArrayField(*ConstraintsObject, TEXT("ConclusionMoods"), Out_Request.AllAllowedConclusionMoods, Out_Error)
+			|| !ParseEnumArrayField(*ConstraintsObject, TEXT("ConclusionActions"), Out_Request.AllAllowedConclusionActions, Out_Error))
+		{
+			return false;
+		}
+
+		(*ConstraintsObject)->TryGetNumberField(TEXT("MaximumAttemptsPerNarrative"), Out_Request.MaximumAttemptsPerNarrative);
+	}
+
+	if (Out_Request.NumberOfNarratives <= 0)
+	{
+		Out_Error = TEXT("Count must be greater than zero.");
+		return false;
+	}
+
+	if (Out_Request.EventLibraryFilename.IsEmpty() && Out_Request.EventDataAssetPath.IsEmpty())
+	{
+		Out_Error = TEXT("There is no EventLibraryFile or EventDataAsset.");
+		return false;
+	}
+
+	if (Out_Request.CharacterDataAssetPath.IsEmpty())
+	{
+		Out_Error = TEXT("There is no CharacterDataAsset to cast the narratives from.");
+		return false;
+	}
+
+	Out_Request.NumberOfChains = FMath::Clamp(Out_Request.NumberOfChains, 1, Out_Request.NumberOfNarratives);
+	Out_Request.NumberOfCharacters = FMath::Max(Out_Request.NumberOfCharacters, 1);
+	Out_Request.AverageNumberOfSocialPartners = FMath::Max(Out_Request.AverageNumberOfSocialPartners, 0.f);
+	Out_Request.NumberOfCastingCandidates = FMath::Max(Out_Request.NumberOfCastingCandidates, 1);
+	Out_Request.NumberOfCandidateNarratives = FMath::Max(Out_Request.NumberOfCandidateNarratives, 1);
+	Out_Request.NumberOfEventsBeforeConclusion = FMath::Max(Out_Request.NumberOfEventsBeforeConclusion, 0);
+	Out_Request.NumberOfNarrativesPerBatch = FMath::Max(Out_Request.NumberOfNarrativesPerBatch, 1);
+	Out_Request.MaximumAttemptsPerNarrative = FMath::Max(Out_Request.MaximumAttemptsPerNarrative, 1);
+
+	return true;
+}
+
+bool UPGNGenerateNarrativesCommandlet::RunBatchRequest(const FPGNNarrativeBatchRequest& Request)
+{
+	const UPGNEventDataAsset* EventDataAsset = nullptr;
+
+	if (Request.EventLibraryFilename.IsEmpty())
+	{
+		EventDataAsset = LoadObject<UPGNEventDataAsset>(nullptr, *Request.EventDataAssetPath);
+
+		if (EventDataAsset == nullptr)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Could not load the Event Data Asset %s."), *Request.EventDataAssetPath);
+			return false;
+		}
+	}
+
+	const UPGNMoodGraphDataAsset* MoodGraphDataAsset = Request.MoodGraphDataAssetPath.IsEmpty() ? nullptr
+		: LoadObject<UPGNMoodGraphDataAsset>(nullptr, *Request.MoodGraphDataAssetPath);
+	const UPGNCharacterDataAsset* CharacterDataAsset = LoadObject<UPGNCharacterDataAsset>(nullptr,
+		*Request.CharacterDataAssetPath);
+
+	if (CharacterDataAsset == nullptr)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not load the Character Data Asset %s."), *Request.CharacterDataAssetPath);
+		return false;
+	}
+
+	const FPGNWorldDataPtr WorldData = FPGNWorldDataCache::Get().FindOrCreate(EventDataAsset,
+		Request.EventLibraryFilename, MoodGraphDataAsset, CharacterDataAsset);
+
+	if (!WorldData.IsValid() || WorldData->AllConclusionEvents.Num() == 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("There are no conclusion events to generate narratives from."));
+		return false;
+	}
+
+	const FPGNEventLibrary& EventLibrary = *WorldData->EventLibrary;
+
+	// Characters are only ever materialised from their hashes, which never touches the cache, so the chains can share it.
+	FPGNVirtualPopulation VirtualPopulation;
+
+	if (!VirtualPopulation.Initialize(CharacterDataAsset, WorldData->GenerationAliasTable, WorldData->TemplateAllocationOrder,
+		Request.Seed, Request.NumberOfCharacters, Request.AverageNumberOfSocialPartners, 1))
+	{
+		return false;
+	}
+
+	TUniquePtr<IFileHandle> OutputFile(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*Request.OutputFilename));
+
+	if (!OutputFile.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not open %s for writing."), *Request.OutputFilename);
+		return false;
+	}
+
+	const TArray<FString> AllMoodNames = CreateEnumNameTable<EPGNMood>();
+	const TArray<FString> AllActionNames = CreateEnumNameTable<EPGNEventAction>();
+
+	// We will give every chain its own session, seeded from the request seed and the chain, and split the narratives
+	// between them as evenly as we can.
+	const int32 NumberOfChains = Request.NumberOfChains;
+
+	TArray<FPGNNarrativeGenerationSnapshot> AllChainSnapshots;
+	TArray<TUniquePtr<FPGNNarrativeEvaluator>> AllChainEvaluators;
+	TArray<FRandomStream> AllChainRandomStreams;
+	TArray<int32> AllNumberOfNarrativesLeftInChain;
+	TArray<int32> AllNumberOfNarrativesWrittenByChain;
+	TArray<int32> AllNumberOfSkippedNarrativesInChain;
+	AllChainSnapshots.SetNum(NumberOfChains);
+	AllChainEvaluators.SetNum(NumberOfChains);
+	AllChainRandomStreams.SetNum(NumberOfChains);
+	AllNumberOfNarrativesLeftInChain.SetNum(NumberOfChains);
+	AllNumberOfNarrativesWrittenByChain.SetNumZeroed(NumberOfChains);
+	AllNumberOfSkippedNarrativesInChain.SetNumZeroed(NumberOfChains);
+
+	for (int32 Index_Chain = 0; Index_Chain < NumberOfChains; Index_Chain++)
+	{
+		FPGNNarrativeGenerationSnapshot& ThisSnapshot = AllChainSnapshots[Index_Chain];
+		ThisSnapshot.EventLibrary = WorldData->EventLibrary;
+		ThisSnapshot.WorldData = WorldData;
+		ThisSnapshot.AllConclusionEventUsage.SetNum(WorldData->AllConclusionEvents.Num());
+		ThisSnapshot.MoodDistanceTable = WorldData->MoodDistanceTable;
+		ThisSnapshot.RandomSeed = static_cast<int32>(HashCombine(GetTypeHash(Request.Seed), GetTypeHash(Index_Chain)));
+
+		ThisSnapshot.NumberOfCandidateNarratives = Request.NumberOfCandidateNarratives;
+		ThisSnapshot.NumberOfEventsBeforeConclusion = Request.NumberOfEventsBeforeConclusion;
+		ThisSnapshot.DesiredFinalDramaticTension = EventDataAsset != nullptr ? EventDataAsset->DesiredFinalDramaticTension : 0.f;
+		ThisSnapshot.NumberOfEvaluationsToCache = NUMBER_OF_EVALUATIONS_TO_CACHE_PER_CHAIN;
+
+		FRandomStream& ThisRandomStream = AllChainRandomStreams[Index_Chain];
+		ThisRandomStream.Initialize(ThisSnapshot.RandomSeed);
+
+		GatherCastingCandidatesOfChain(VirtualPopulation, ThisRandomStream.RandRange(0, VirtualPopulation.Num() - 1),
+			Request.NumberOfCastingCandidates, ThisSnapshot);
+
+		// Built the same way as the prefetcher's, with the lambda keeping the chain's oracle alive.
+		const TSharedPtr<const FPGNRelationshipOracle, ESPMode::ThreadSafe> RelationshipOracle = ThisSnapshot.RelationshipOracle;
+
+		AllChainEvaluators[Index_Chain] = MakeUnique<FPGNNarrativeEvaluator>(ThisSnapshot.EventLibrary,
+			ThisSnapshot.MoodDistanceTable, ThisSnapshot.DesiredFinalDramaticTension,
+			[RelationshipOracle](int32 IndexOfCharacterA, int32 IndexOfCharacterB, FPGNRelationship& Out_Relationship)
+			{
+				return RelationshipOracle->FindRelationship(IndexOfCharacterA, IndexOfCharacterB, Out_Relationship);
+			}, ThisSnapshot.NumberOfEvaluationsToCache);
+
+		AllNumberOfNarrativesLeftInChain[Index_Chain] = Request.NumberOfNarratives / NumberOfChains
+			+ (Index_Chain < Request.NumberOfNarratives % NumberOfChains ? 1 : 0);
+	}
+
+	// Each chain writes one round of lines into its own buffer, so the workers never share anything they change.
+	TArray<TArray<uint8>> AllChainOutputBuffers;
+	AllChainOutputBuffers.SetNum(NumberOfChains);
+
+	int32 NumberOfNarrativesWritten = 0;
+	bool bHasNarrativesLeft = true;
+
+	while (bHasNarrativesLeft)
+	{
+		ParallelFor(NumberOfChains, [&](int32 Index_Chain)
+		{
+			FPGNNarrativeGenerationSnapshot& ThisSnapshot = AllChainSnapshots[Index_Chain];
+			FRandomStream& ThisRandomStream = AllChainRandomStreams[Index_Chain];
+			FPGNNarrativeEvaluator& ThisEvaluator = *AllChainEvaluators[Index_Chain];
+			TArray<uint8>& ThisOutputBuffer = AllChainOutputBuffers[Index_Chain];
+			ThisOutputBuffer.Reset();
+
+			const int32 NumberOfNarrativesInThisBatch = FMath::Min(AllNumberOfNarrativesLeftInChain[Index_Chain],
+				Request.NumberOfNarrativesPerBatch);
+
+			for (int32 Index_Narrative = 0; Index_Narrative < NumberOfNarrativesInThisBatch; Index_Narrative++)
+			{
+				AllNumberOfNarrativesLeftInChain[Index_Chain]--;
+
+				FPGNGenerationScratchScope ScratchScope;
+
+				// A narrative that breaks the constraints stays in the chain's history, which is what moves the next
+				// attempt on to a different conclusion. One that could not be built at all is a failed attempt.
+				FPGNGeneratedNarrative ThisNarrative;
+				TArray<FPGNCastMember> ThisCast;
+				bool bMeetsConstraints = false;
+
+				for (int32 Index_Attempt = 0; Index_Attempt < Request.MaximumAttemptsPerNarrative && !bMeetsConstraints; Index_Attempt++)
+				{
+					ThisNarrative = FPGNGeneratedNarrative();
+
+					if (!FPGNNarrativePrefetcher::BuildNarrativeFromSnapshot(ThisSnapshot, ThisRandomStream, ThisEvaluator,
+						ThisNarrative, ThisCast))
+					{
+						continue;
+					}
+
+					const FPGNPackedEvent& ThisConclusionEvent = EventLibrary.GetEvent(ThisNarrative.ConclusionEventId);
+
+					bMeetsConstraints = (Request.AllAllowedConclusionMoods.Num() == 0
+							|| Request.AllAllowedConclusionMoods.Contains(ThisConclusionEvent.GetMood()))
+						&& (Request.AllAllowedConclusionActions.Num() == 0
+							|| Request.AllAllowedConclusionActions.Contains(ThisConclusionEvent.GetAction()));
+				}
+
+				if (!bMeetsConstraints)
+				{
+					AllNumberOfSkippedNarrativesInChain[Index_Chain]++;
+					continue;
+				}
+
+				const FPGNPackedEvent& ThisConclusionEvent = EventLibrary.GetEvent(ThisNarrative.ConclusionEventId);
+
+				FString ThisLine;
+				const TSharedRef<TJsonWriter<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>> JsonWriter =
+					TJsonWriterFactory<TCHAR, TCondensedJsonPrintPolicy<TCHAR>>::Create(&ThisLine);
+
+				JsonWriter->WriteObjectStart();
+				JsonWriter->WriteValue(TEXT("Chain"), Index_Chain);
+				JsonWriter->WriteValue(TEXT("Index"), AllNumberOfNarrativesWrittenByChain[Index_Chain]);
+				JsonWriter->WriteValue(TEXT("ConclusionEventId"), ThisNarrative.ConclusionEventId);
+
+				if (EventLibrary.HasEventNames())
+				{
+					JsonWriter->WriteValue(TEXT("ConclusionEventName"), EventLibrary.GetEventName(ThisNarrative.ConclusionEventId));
+				}
+
+				JsonWriter->WriteValue(TEXT("Mood"), AllMoodNames[static_cast<uint8>(ThisConclusionEvent.GetMood())]);
+				JsonWriter->WriteValue(TEXT("Action"), AllActionNames[static_cast<uint8>(ThisConclusionEvent.GetAction())]);
+				JsonWriter->WriteArrayStart(TEXT("EventIds"));
+
+				for (const int ThisEventId : ThisNarrative.AllEventIds)
+				{
+					JsonWriter->WriteValue(ThisEventId);
+				}
+
+				JsonWriter->WriteArrayEnd();
+				JsonWriter->WriteObjectEnd();
+				JsonWriter->Close();
+
+				ThisLine.AppendChar(TEXT('\n'));
+
+				const FTCHARToUTF8 ThisLineInUTF8(*ThisLine);
+				ThisOutputBuffer.Append(reinterpret_cast<const uint8*>(ThisLineInUTF8.Get()), ThisLineInUTF8.Length());
+
+				AllNumberOfNarrativesWrittenByChain[Index_Chain]++;
+			}
+		});
+
+		// Then write the round out in chain order, so the file does not depend on which worker finished first.
+		bHasNarrativesLeft = false;
+
+		for (int32 Index_Chain = 0; Index_Chain < NumberOfChains; Index_Chain++)
+		{
+			const TArray<uint8>& ThisOutputBuffer = AllChainOutputBuffers[Index_Chain];
+
+			if (ThisOutputBuffer.Num() > 0 && !OutputFile->Write(ThisOutputBuffer.GetData(), ThisOutputBuffer.Num()))
+			{
+				UE_LOG(LogTemp, Error, TEXT("Could not write to %s."), *Request.OutputFilename);
+				return false;
+			}
+
+			bHasNarrativesLeft |= AllNumberOfNarrativesLeftInChain[Index_Chain] > 0;
+		}
+
+		OutputFile->Flush();
+
+		NumberOfNarrativesWritten = 0;
+
+		for (const int32 ThisNumberOfNarrativesWritten : AllNumberOfNarrativesWrittenByChain)
+		{
+			NumberOfNarrativesWritten += ThisNumberOfNarrativesWritten;
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("Generated %d of %d narratives."), NumberOfNarrativesWritten,
+			Request.NumberOfNarratives);
+	}
+
+	int32 NumberOfSkippedNarratives = 0;
+
+	for (const int32 ThisNumberOfSkippedNarratives : AllNumberOfSkippedNarrativesInChain)
+	{
+		NumberOfSkippedNarratives += ThisNumberOfSkippedNarratives;
+	}
+
+	if (NumberOfSkippedNarratives > 0)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%d narratives could not be built to meet the constraints within %d attempts and were skipped."),
+			NumberOfSkippedNarratives, Request.MaximumAttemptsPerNarrative);
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Wrote %d narratives to %s."), NumberOfNarrativesWritten, *Request.OutputFilename);
+
+	return true;
+}
@@ -0,0 +1,93 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "ProceduralNarrative/PGNUtilities.h"
+#include "PGNGenerateNarrativesCommandlet.generated.h"
+
+// Everything a batch run is asked to do, read from the request file.
+struct FPGNNarrativeBatchRequest
+{
+	int32 Seed = 0;
+
+	// Either an event library file or an Event Data Asset; the file wins if both are given.
+	FString EventLibraryFilename;
+	FString EventDataAssetPath;
+	FString MoodGraphDataAssetPath;
+	FString CharacterDataAssetPath;
+
+	int32 NumberOfNarratives = 0;
+
+	// How many independent histories the narratives are spread across. This, and not the number of cores, decides
+	// what gets generated, so the same request gives the same file on every machine.
+	int32 NumberOfChains = 16;
+
+	// How many narratives each chain writes per round. Only one round's worth of output is ever held in memory.
+	int32 NumberOfNarrativesPerBatch = 256;
+
+	// The town the narratives are cast from, a virtual population made from the Character Data Asset and the seed.
+	int32 NumberOfCharacters = 100000;
+	float AverageNumberOfSocialPartners = 8.f;
+
+	// Each chain casts from this many neighbours of someone at random, as an overseer with a virtual population does.
+	int32 NumberOfCastingCandidates = 256;
+
+	int32 NumberOfCandidateNarratives = 1;
+	int32 NumberOfEventsBeforeConclusion = 3;
+
+	// Constraints. An empty list allows anything.
+	TArray<EPGNMood> AllAllowedConclusionMoods;
+	TArray<EPGNEventAction> AllAllowedConclusionActions;
+
+	// How many narratives a chain may build for each one it writes before it gives up on the constraints.
+	int32 MaximumAttemptsPerNarrative = 16;
+
+	FString OutputFilename;
+};
+
+/**
+ * Generates narratives headlessly and streams them to a JSON Lines file, one narrative per line.
+ *
+ *	UE4Editor-Cmd <Project>.uproject -run=PGNGenerateNarratives -Request=<Request.json> [-Output=<Narratives.jsonl>]
+ *		[-Seed=<Seed>] [-Count=<NumberOfNarratives>] -unattended -nullrhi -nopause
+ *
+ * The request file is a JSON object:
+ *
+ *	{
+ *		"Seed": 1234,
+ *		"EventLibraryFile": "Data/Events.pgnevents",			(or "EventDataAsset": "/Game/Path/To/EventDataAsset")
+ *		"MoodGraphDataAsset": "/Game/Path/To/MoodGraphDataAsset",
+ *		"CharacterDataAsset": "/Game/Path/To/CharacterDataAsset",
+ *		"Population": { "NumberOfCharacters": 100000, "AverageNumberOfSocialPartners": 8, "NumberOfCastingCandidates": 256 },
+ *		"CandidateNarratives": 1,
+ *		"EventsBeforeConclusion": 3,
+ *		"Count": 100000,
+ *		"NumberOfChains": 16,
+ *		"NarrativesPerBatch": 256,
+ *		"Output": "Saved/Narratives.jsonl",
+ *		"Constraints": { "ConclusionMoods": ["MOOD_Joyful"], "ConclusionActions": [], "MaximumAttemptsPerNarrative": 16 }
+ *	}
+ *
+ * Every chain is its own session with its own history, random stream and cast, so the chains are generated in
+ * parallel across all cores, and their output is written in chain order once each round is done. The Character Data
+ * Asset is required, since nothing can be cast without a town.
+ */
+UCLASS()
+class PROCEDURALNARRATIVE_API UPGNGenerateNarrativesCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+
+	UPGNGenerateNarrativesCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+	static bool ReadBatchRequest(const FString& Filename, FPGNNarrativeBatchRequest& Out_Request, FString& Out_Error);
+
+	// Returns false if the request could not be run at all. Narratives that could not be built, or could not meet the
+	// constraints, are skipped and counted, but do not fail the run.
+	static bool RunBatchRequest(const FPGNNarrativeBatchRequest& Request);
+};
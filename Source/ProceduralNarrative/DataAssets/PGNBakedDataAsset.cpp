@@ -0,0 +1,86 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PGNBakedDataAsset.h"
+
+#include "ProceduralNarrative/PGNCustomVersion.h"
+
+void UPGNBakedDataAsset::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	Ar.UsingCustomVersion(FPGNCustomVersion::GUID);
+
+	if (ShouldSerializeBakedData(Ar))
+	{
+		Ar << BakedSourceHash;
+	}
+}
+
+void UPGNBakedDataAsset::PostLoad()
+{
+	Super::PostLoad();
+
+#if WITH_EDITOR
+	// Assets saved before we baked anything (or edited outside of the details panel) get fixed up here, so that
+	// cooking always picks up data that matches the authored data.
+	if (!HasValidBakedData())
+	{
+		BakeDerivedData();
+	}
+#endif
+}
+
+#if WITH_EDITOR
+void UPGNBakedDataAsset::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	// We bake first, since running overseers reload from the baked data as soon as they hear about the change.
+	BakeDerivedData();
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+}
+
+#if ENGINE_MAJOR_VERSION >= 5
+void UPGNBakedDataAsset::PreSave(FObjectPreSaveContext ObjectSaveContext)
+{
+	Super::PreSave(ObjectSaveContext);
+#else
+void UPGNBakedDataAsset::PreSave(const ITargetPlatform* TargetPlatform)
+{
+	Super::PreSave(TargetPlatform);
+#endif
+	BakeDerivedData();
+}
+#endif
+
+bool UPGNBakedDataAsset::HasValidBakedData() const
+{
+	if (BakedSourceHash == 0 || !HasBakedDataOfExpectedSize())
+	{
+		return false;
+	}
+
+#if WITH_EDITOR
+	// In the editor the authored data can change underneath us. Cooked data is baked on save, so it is trusted.
+	return BakedSourceHash == CalculateSourceHash();
+#else
+	return true;
+#endif
+}
+
+bool UPGNBakedDataAsset::ShouldSerializeBakedData(const FArchive& Ar)
+{
+	return Ar.CustomVer(FPGNCustomVersion::GUID) >= FPGNCustomVersion::AddedBakedDerivedData;
+}
+
+uint32 UPGNBakedDataAsset::BeginSourceHash()
+{
+	// The version is part of the hash, so that changing how we bake invalidates everything baked before.
+	const int32 BakeVersion = FPGNCustomVersion::LatestVersion;
+	return FCrc::MemCrc32(&BakeVersion, sizeof(BakeVersion));
+}
+
+uint32 UPGNBakedDataAsset::FinishSourceHash(uint32 SourceHash)
+{
+	// Zero is reserved for "never baked".
+	return SourceHash == 0 ? 1 : SourceHash;
+}
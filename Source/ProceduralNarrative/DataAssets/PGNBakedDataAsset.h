@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "Runtime/Launch/Resources/Version.h"
+#if ENGINE_MAJOR_VERSION >= 5
+#include "UObject/ObjectSaveContext.h"
+#endif
+#include "PGNBakedDataAsset.generated.h"
+
+/**
+ * A data asset that bakes derived data from its authored data, and saves it alongside.
+ *
+ * The baked data is stamped with a hash of whatever it was baked from. Subclasses say how to bake, how to hash and
+ * what the baked data should look like; this keeps it baked and decides whether it can be trusted.
+ */
+UCLASS(Abstract)
+class PROCEDURALNARRATIVE_API UPGNBakedDataAsset : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+
+	// Subclasses serialize their baked data after calling this, if ShouldSerializeBakedData says so.
+	virtual void Serialize(FArchive& Ar) override;
+	virtual void PostLoad() override;
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#if ENGINE_MAJOR_VERSION >= 5
+	virtual void PreSave(FObjectPreSaveContext ObjectSaveContext) override;
+#else
+	virtual void PreSave(const ITargetPlatform* TargetPlatform) override;
+#endif
+#endif
+
+	// Rebuilds the baked data from the authored data, and stamps it with CalculateSourceHash.
+	virtual void BakeDerivedData() PURE_VIRTUAL(UPGNBakedDataAsset::BakeDerivedData, );
+
+	// Never zero. Only covers what the baked data depends on.
+	virtual uint32 CalculateSourceHash() const PURE_VIRTUAL(UPGNBakedDataAsset::CalculateSourceHash, return 0;);
+
+	uint32 GetBakedSourceHash() const { return BakedSourceHash; }
+
+	// If this is false, the overseer will build the tables itself at startup.
+	bool HasValidBakedData() const;
+
+protected:
+
+	// Whether the archive holds baked data at all. Assets saved before we baked anything do not.
+	static bool ShouldSerializeBakedData(const FArchive& Ar);
+
+	// Subclasses start their CalculateSourceHash with the first, fold their fields into it, and end with the second.
+	static uint32 BeginSourceHash();
+	static uint32 FinishSourceHash(uint32 SourceHash);
+
+	// A cheap check that the baked data is the shape the authored data says it should be.
+	virtual bool HasBakedDataOfExpectedSize() const PURE_VIRTUAL(UPGNBakedDataAsset::HasBakedDataOfExpectedSize, return false;);
+
+	uint32 BakedSourceHash = 0;
+};
@@ -3,3 +3,144 @@
 
 #include "PGNCharacterDataAsset.h"
 
+void UPGNCharacterDataAsset::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	if (ShouldSerializeBakedData(Ar))
+	{
+		Ar << BakedGenerationAliasTable;
+		Ar << BakedTemplateAllocationOrder;
+	}
+}
+
+void UPGNCharacterDataAsset::BakeDerivedData()
+{
+	CreateGenerationAliasTable(AllDemographicParameters, BakedGenerationAliasTable);
+	CreateTemplateAllocationOrder(AllCharacterTemplates, BakedTemplateAllocationOrder);
+	BakedSourceHash = CalculateSourceHash();
+}
+
+void UPGNCharacterDataAsset::CreateGenerationAliasTable(
+	const TArray<FPGNCharacterDemographicParameters>& AllDemographics, FPGNAliasTable& Out_AliasTable)
+{
+	TArray<float> AllPopulationShares;
+	AllPopulationShares.Reserve(AllDemographics.Num());
+
+	for (const FPGNCharacterDemographicParameters& ThisDemographic : AllDemographics)
+	{
+		AllPopulationShares.Add(ThisDemographic.PopulationShare);
+	}
+
+	Out_AliasTable.Build(AllPopulationShares);
+}
+
+void UPGNCharacterDataAsset::CreateTemplateAllocationOrder(const TArray<FPGNCharacterTemplate>& AllTemplates,
+	TArray<int>& Out_AllocationOrder)
+{
+	Out_AllocationOrder.Reset(AllTemplates.Num());
+
+	for (int Index_Template = 0; Index_Template < AllTemplates.Num(); Index_Template++)
+	{
+		Out_AllocationOrder.Add(Index_Template);
+	}
+
+	// Ties are broken by index so that the order is the same every time we bake.
+	Out_AllocationOrder.Sort([&AllTemplates](const int A, const int B)
+	{
+		if (AllTemplates[A].NumberOfTimesTemplateUsed != AllTemplates[B].NumberOfTimesTemplateUsed)
+		{
+			return AllTemplates[A].NumberOfTimesTemplateUsed < AllTemplates[B].NumberOfTimesTemplateUsed;
+		}
+
+		return A < B;
+	});
+}
+
+EPGNCharacterRomanticRelationship UPGNCharacterDataAsset::DetermineRomanticRelationshipFromPercentage(
+	float GeneratedChance) const
+{
+	GeneratedChance = FMath::Clamp(GeneratedChance, 0.f, 1.f);
+	if (GeneratedChance <= PercentageOfCharactersWhoAreMarried)
+	{
+		return EPGNCharacterRomanticRelationship::MARRIED;
+	}
+
+	float CurrentIntervalLocation = PercentageOfCharactersWhoAreMarried;
+
+	if (GeneratedChance <= PercentageOfCharactersWhoAreDivorced + CurrentIntervalLocation)
+	{
+		return EPGNCharacterRomanticRelationship::DIVORCED;
+	}
+
+	CurrentIntervalLocation += PercentageOfCharactersWhoAreDivorced;
+
+	if (GeneratedChance <= PercentageOfCharactersWhoAreWidowed + CurrentIntervalLocation)
+	{
+		return EPGNCharacterRomanticRelationship::WIDOWED;
+	}
+
+	return EPGNCharacterRomanticRelationship::SINGLE;
+}
+
+EPGNCharacterSocialRelationship UPGNCharacterDataAsset::DetermineSocialRelationshipFromPercentage(
+	float GeneratedChance) const
+{
+	float CurrentStartOfInterval = 0.f;
+	float CurrentEndOfInterval = CurrentStartOfInterval + PercentageOfCharactersWhoAreNeighbors;
+
+	if (GeneratedChance >= CurrentStartOfInterval && GeneratedChance <= CurrentEndOfInterval)
+	{
+		return EPGNCharacterSocialRelationship::NEIGHBORS;
+	}
+
+	CurrentStartOfInterval = CurrentEndOfInterval;
+	CurrentEndOfInterval += PercentageOfCharactersWhoAreFamily;
+
+	if (GeneratedChance >= CurrentStartOfInterval && GeneratedChance <= CurrentEndOfInterval)
+	{
+		return EPGNCharacterSocialRelationship::FAMILY;
+	}
+
+	CurrentStartOfInterval = CurrentEndOfInterval;
+	CurrentEndOfInterval += PercentageOfCharactersWhoAreCoworkers;
+
+	if (GeneratedChance >= CurrentStartOfInterval && GeneratedChance <= CurrentEndOfInterval)
+	{
+		return EPGNCharacterSocialRelationship::COWORKERS;
+	}
+
+	CurrentStartOfInterval = CurrentEndOfInterval;
+	CurrentEndOfInterval += PercentageOfCharactersWhoAreFriends;
+
+	if (GeneratedChance >= CurrentStartOfInterval && GeneratedChance <= CurrentEndOfInterval)
+	{
+		return EPGNCharacterSocialRelationship::FRIENDS;
+	}
+
+	return EPGNCharacterSocialRelationship::ENEMIES;
+}
+
+uint32 UPGNCharacterDataAsset::CalculateSourceHash() const
+{
+	uint32 SourceHash = BeginSourceHash();
+
+	// Only what the baked tables depend on goes into the hash, so renaming characters does not invalidate anything.
+	for (const FPGNCharacterDemographicParameters& ThisDemographic : AllDemographicParameters)
+	{
+		SourceHash = FCrc::MemCrc32(&ThisDemographic.PopulationShare, sizeof(ThisDemographic.PopulationShare), SourceHash);
+	}
+
+	for (const FPGNCharacterTemplate& ThisTemplate : AllCharacterTemplates)
+	{
+		SourceHash = FCrc::MemCrc32(&ThisTemplate.NumberOfTimesTemplateUsed, sizeof(ThisTemplate.NumberOfTimesTemplateUsed),
+			SourceHash);
+	}
+
+	return FinishSourceHash(SourceHash);
+}
+
+bool UPGNCharacterDataAsset::HasBakedDataOfExpectedSize() const
+{
+	return BakedTemplateAllocationOrder.Num() == AllCharacterTemplates.Num();
+}
@@ -3,15 +3,16 @@
 #pragma once
 
 #include "CoreMinimal.h"
-#include "Engine/DataAsset.h"
+#include "ProceduralNarrative/DataAssets/PGNBakedDataAsset.h"
 #include "ProceduralNarrative/PGNUtilities.h"
+#include "ProceduralNarrative/Generation/PGNAliasTable.h"
 #include "PGNCharacterDataAsset.generated.h"
 
 /**
  * 
  */
 UCLASS()
-class PROCEDURALNARRATIVE_API UPGNCharacterDataAsset : public UDataAsset
+class PROCEDURALNARRATIVE_API UPGNCharacterDataAsset : public UPGNBakedDataAsset
 {
 	GENERATED_BODY()
 
@@ -71,4 +72,37 @@ public:
 	int MaximumDistanceBetweenCharactersInSingleEdge = 10;
 	
 #pragma endregion SocialRelationships
+
+	// Both of these map a number in [0, 1] onto the percentages above, in the order they are declared.
+	EPGNCharacterRomanticRelationship DetermineRomanticRelationshipFromPercentage(float GeneratedChance) const;
+	EPGNCharacterSocialRelationship DetermineSocialRelationshipFromPercentage(float GeneratedChance) const;
+
+#pragma region Baked Data
+
+	virtual void Serialize(FArchive& Ar) override;
+
+	virtual void BakeDerivedData() override;
+	virtual uint32 CalculateSourceHash() const override;
+
+	// Picks an index into AllDemographicParameters in proportion to each generation's population share.
+	const FPGNAliasTable& GetBakedGenerationAliasTable() const { return BakedGenerationAliasTable; }
+
+	// Indices into AllCharacterTemplates, from least used to most used.
+	const TArray<int>& GetBakedTemplateAllocationOrder() const { return BakedTemplateAllocationOrder; }
+
+	static void CreateGenerationAliasTable(const TArray<FPGNCharacterDemographicParameters>& AllDemographics,
+		FPGNAliasTable& Out_AliasTable);
+	static void CreateTemplateAllocationOrder(const TArray<FPGNCharacterTemplate>& AllTemplates,
+		TArray<int>& Out_AllocationOrder);
+
+protected:
+
+	virtual bool HasBakedDataOfExpectedSize() const override;
+
+private:
+
+	FPGNAliasTable BakedGenerationAliasTable;
+	TArray<int> BakedTemplateAllocationOrder;
+
+#pragma endregion Baked Data
 };
@@ -3,3 +3,59 @@
 
 #include "PGNEventDataAsset.h"
 
+void UPGNEventDataAsset::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	if (ShouldSerializeBakedData(Ar))
+	{
+		if (Ar.IsLoading())
+		{
+			BakedEventLibrary = MakeShared<FPGNEventLibrary, ESPMode::ThreadSafe>();
+		}
+
+		Ar << *BakedEventLibrary;
+	}
+}
+
+void UPGNEventDataAsset::BakeDerivedData()
+{
+	const TSharedRef<FPGNEventLibrary, ESPMode::ThreadSafe> NewEventLibrary = MakeShared<FPGNEventLibrary, ESPMode::ThreadSafe>();
+	NewEventLibrary->BuildFromDataAsset(this);
+
+	BakedEventLibrary = NewEventLibrary;
+	BakedSourceHash = CalculateSourceHash();
+}
+
+uint32 UPGNEventDataAsset::CalculateSourceHash() const
+{
+	uint32 SourceHash = BeginSourceHash();
+
+	// Packing an event is cheap, and the packed form holds exactly the fields that the baked library depends on.
+	const auto HashThisEvent = [&SourceHash](const FPGNEvent& ThisEvent, bool bIsThisAConclusionEvent)
+	{
+		uint32 FirstWord = 0;
+		uint32 SecondWord = 0;
+		FPGNPackedEvent::Pack(ThisEvent, bIsThisAConclusionEvent).GetWords(FirstWord, SecondWord);
+
+		SourceHash = FCrc::MemCrc32(&FirstWord, sizeof(FirstWord), SourceHash);
+		SourceHash = FCrc::MemCrc32(&SecondWord, sizeof(SecondWord), SourceHash);
+	};
+
+	for (const FPGNConclusionEvent& ThisConclusionEvent : AllConclusionEvents)
+	{
+		HashThisEvent(ThisConclusionEvent, true);
+	}
+
+	for (const FPGNEvent& ThisEvent : AllNonConclusionEvents)
+	{
+		HashThisEvent(ThisEvent, false);
+	}
+
+	return FinishSourceHash(SourceHash);
+}
+
+bool UPGNEventDataAsset::HasBakedDataOfExpectedSize() const
+{
+	return BakedEventLibrary->GetNumberOfEvents() == AllConclusionEvents.Num() + AllNonConclusionEvents.Num();
+}
@@ -3,15 +3,16 @@
 #pragma once
 
 #include "CoreMinimal.h"
-#include "Engine/DataAsset.h"
+#include "ProceduralNarrative/DataAssets/PGNBakedDataAsset.h"
 #include "ProceduralNarrative/PGNUtilities.h"
+#include "ProceduralNarrative/Events/PGNEventLibrary.h"
 #include "PGNEventDataAsset.generated.h"
 
 /**
  * 
  */
 UCLASS()
-class PROCEDURALNARRATIVE_API UPGNEventDataAsset : public UDataAsset
+class PROCEDURALNARRATIVE_API UPGNEventDataAsset : public UPGNBakedDataAsset
 {
 	GENERATED_BODY()
 
@@ -26,4 +27,25 @@ public:
 
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "All Events")
 	TArray<FPGNConclusionEvent> AllConclusionEvents;
+
+#pragma region Baked Data
+
+	virtual void Serialize(FArchive& Ar) override;
+
+	// Recompiles the event library from the authored events.
+	virtual void BakeDerivedData() override;
+	virtual uint32 CalculateSourceHash() const override;
+
+	// The library is shared with anything that is still using it, so it is replaced rather than rebuilt in place.
+	FPGNEventLibraryPtr GetBakedEventLibrary() const { return BakedEventLibrary; }
+
+protected:
+
+	virtual bool HasBakedDataOfExpectedSize() const override;
+
+private:
+
+	TSharedRef<FPGNEventLibrary, ESPMode::ThreadSafe> BakedEventLibrary = MakeShared<FPGNEventLibrary, ESPMode::ThreadSafe>();
+
+#pragma endregion Baked Data
 };
@@ -1,4 +1,44 @@
 // Fill out your copyright notice in the Description page of Project Settings.
 
 
-#include "PGNMoodGraphDataAsset.h"
\ No newline at end of file
+#include "PGNMoodGraphDataAsset.h"
+
+void UPGNMoodGraphDataAsset::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+
+	if (ShouldSerializeBakedData(Ar))
+	{
+		Ar << BakedMoodDistanceTable;
+	}
+}
+
+void UPGNMoodGraphDataAsset::BakeDerivedData()
+{
+	UMoodGraph::CreateAllPairsDistanceTable(AllVertices, AllEdges, BakedMoodDistanceTable);
+	BakedSourceHash = CalculateSourceHash();
+}
+
+uint32 UPGNMoodGraphDataAsset::CalculateSourceHash() const
+{
+	uint32 SourceHash = BeginSourceHash();
+
+	for (const FMoodGraphVertex& ThisVertex : AllVertices)
+	{
+		SourceHash = FCrc::MemCrc32(&ThisVertex.Mood, sizeof(ThisVertex.Mood), SourceHash);
+	}
+
+	for (const FMoodGraphEdge& ThisEdge : AllEdges)
+	{
+		SourceHash = FCrc::MemCrc32(&ThisEdge.VertexA_Mood, sizeof(ThisEdge.VertexA_Mood), SourceHash);
+		SourceHash = FCrc::MemCrc32(&ThisEdge.VertexB_Mood, sizeof(ThisEdge.VertexB_Mood), SourceHash);
+		SourceHash = FCrc::MemCrc32(&ThisEdge.DistanceBetweenVertices, sizeof(ThisEdge.DistanceBetweenVertices), SourceHash);
+	}
+
+	return FinishSourceHash(SourceHash);
+}
+
+bool UPGNMoodGraphDataAsset::HasBakedDataOfExpectedSize() const
+{
+	return BakedMoodDistanceTable.Num() == UMoodGraph::NUMBER_OF_MOODS * UMoodGraph::NUMBER_OF_MOODS;
+}
@@ -3,7 +3,7 @@
 #pragma once
 
 #include "CoreMinimal.h"
-#include "Engine/DataAsset.h"
+#include "ProceduralNarrative/DataAssets/PGNBakedDataAsset.h"
 #include "ProceduralNarrative/Graph.h"
 #include "ProceduralNarrative/Graphs/MoodGraph.h"
 #include "PGNMoodGraphDataAsset.generated.h"
@@ -12,7 +12,7 @@
  * 
  */
 UCLASS()
-class PROCEDURALNARRATIVE_API UPGNMoodGraphDataAsset : public UDataAsset
+class PROCEDURALNARRATIVE_API UPGNMoodGraphDataAsset : public UPGNBakedDataAsset
 {
 	GENERATED_BODY()
 
@@ -23,4 +23,25 @@ public:
 
 	UPROPERTY(EditAnywhere, Category = "Edges")
 	TArray<FMoodGraphEdge> AllEdges;
+
+#pragma region Baked Data
+
+	virtual void Serialize(FArchive& Ar) override;
+
+	// Recomputes everything that is derived from the vertices and edges.
+	virtual void BakeDerivedData() override;
+	virtual uint32 CalculateSourceHash() const override;
+
+	// All-pairs distances, indexed with UMoodGraph::GetIndexInDistanceTable.
+	const TArray<int>& GetBakedMoodDistanceTable() const { return BakedMoodDistanceTable; }
+
+protected:
+
+	virtual bool HasBakedDataOfExpectedSize() const override;
+
+private:
+
+	TArray<int> BakedMoodDistanceTable;
+
+#pragma endregion Baked Data
 };
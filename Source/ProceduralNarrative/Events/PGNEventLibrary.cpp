@@ -0,0 +1,287 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/Events/PGNEventLibrary.h"
+
+#include "Async/MappedFileHandle.h"
+#include "ProceduralNarrative/DataAssets/PGNEventDataAsset.h"
+#include "ProceduralNarrative/PGNCustomVersion.h"
+#include "ProceduralNarrative/Graphs/MoodGraph.h"
+
+FPGNEventLibrary::FPGNEventLibrary()
+{
+}
+
+FPGNEventLibrary::~FPGNEventLibrary()
+{
+	// The region has to be unmapped before the file it came from is closed.
+	MappedFileRegion.Reset();
+	MappedFileHandle.Reset();
+}
+
+void FPGNEventLibrary::BuildFromDataAsset(const UPGNEventDataAsset* EventDataAsset)
+{
+	TArray<FPGNPackedEvent> AllPackedEvents;
+
+	if (EventDataAsset == nullptr)
+	{
+		BuildFromPackedEvents(MoveTemp(AllPackedEvents), 0);
+		return;
+	}
+
+	AllPackedEvents.Reserve(EventDataAsset->AllConclusionEvents.Num() + EventDataAsset->AllNonConclusionEvents.Num());
+
+	// Conclusion events must come first so that their IDs line up with their indices in the data asset.
+	for (const FPGNConclusionEvent& ThisConclusionEvent : EventDataAsset->AllConclusionEvents)
+	{
+		AllPackedEvents.Add(FPGNPackedEvent::Pack(ThisConclusionEvent, true));
+	}
+
+	for (const FPGNEvent& ThisEvent : EventDataAsset->AllNonConclusionEvents)
+	{
+		AllPackedEvents.Add(FPGNPackedEvent::Pack(ThisEvent, false));
+	}
+
+	BuildFromPackedEvents(MoveTemp(AllPackedEvents), EventDataAsset->AllConclusionEvents.Num());
+}
+
+void FPGNEventLibrary::BuildFromPackedEvents(TArray<FPGNPackedEvent>&& AllPackedEvents,
+	int32 InNumberOfConclusionEvents, const TArray<FString>& AllEventNames)
+{
+	MappedFileRegion.Reset();
+	MappedFileHandle.Reset();
+
+	OwnedEvents = MoveTemp(AllPackedEvents);
+	NumberOfConclusionEvents = FMath::Clamp(InNumberOfConclusionEvents, 0, OwnedEvents.Num());
+
+	// The mood index reads from the views, so they have to point at the new events first.
+	PointViewsAtOwnedStorage();
+
+	BuildMoodIndex();
+	BuildNameTable(AllEventNames);
+
+	PointViewsAtOwnedStorage();
+}
+
+void FPGNEventLibrary::PointViewsAtOwnedStorage()
+{
+	AllEvents = OwnedEvents;
+	NonConclusionEventIdsByMood = OwnedNonConclusionEventIdsByMood;
+	MoodIndexOffsets = OwnedMoodIndexOffsets;
+	EventNameOffsets = OwnedEventNameOffsets;
+	EventNameTable = OwnedEventNameTable;
+}
+
+void FPGNEventLibrary::BuildMoodIndex()
+{
+	constexpr int NumberOfMoods = UMoodGraph::NUMBER_OF_MOODS;
+
+	// This is a counting sort, so the events keep their relative order within each mood.
+	OwnedMoodIndexOffsets.Init(0, NumberOfMoods + 1);
+
+	for (FPGNEventId ThisEventId = NumberOfConclusionEvents; ThisEventId < OwnedEvents.Num(); ThisEventId++)
+	{
+		OwnedMoodIndexOffsets[static_cast<int>(OwnedEvents[ThisEventId].GetMood()) + 1]++;
+	}
+
+	for (int Index_Mood = 0; Index_Mood < NumberOfMoods; Index_Mood++)
+	{
+		OwnedMoodIndexOffsets[Index_Mood + 1] += OwnedMoodIndexOffsets[Index_Mood];
+	}
+
+	OwnedNonConclusionEventIdsByMood.SetNumUninitialized(OwnedEvents.Num() - NumberOfConclusionEvents);
+
+	TArray<int32, TInlineAllocator<NumberOfMoods>> NextSlotForEachMood(OwnedMoodIndexOffsets.GetData(), NumberOfMoods);
+
+	for (FPGNEventId ThisEventId = NumberOfConclusionEvents; ThisEventId < OwnedEvents.Num(); ThisEventId++)
+	{
+		const int MoodOfThisEvent = static_cast<int>(OwnedEvents[ThisEventId].GetMood());
+		OwnedNonConclusionEventIdsByMood[NextSlotForEachMood[MoodOfThisEvent]++] = ThisEventId;
+	}
+}
+
+void FPGNEventLibrary::BuildNameTable(const TArray<FString>& AllEventNames)
+{
+	OwnedEventNameOffsets.Reset();
+	OwnedEventNameTable.Reset();
+
+	if (AllEventNames.Num() != OwnedEvents.Num())
+	{
+		if (AllEventNames.Num() > 0)
+		{
+			UE_LOG(LogTemp, Error, TEXT("There are %d event names for %d events, so the names will be ignored."),
+				AllEventNames.Num(), OwnedEvents.Num());
+		}
+
+		return;
+	}
+
+	OwnedEventNameOffsets.Reserve(AllEventNames.Num() + 1);
+	OwnedEventNameOffsets.Add(0);
+
+	for (const FString& ThisEventName : AllEventNames)
+	{
+		const FTCHARToUTF8 ThisEventNameAsUTF8(*ThisEventName);
+		OwnedEventNameTable.Append(ThisEventNameAsUTF8.Get(), ThisEventNameAsUTF8.Length());
+		OwnedEventNameOffsets.Add(OwnedEventNameTable.Num());
+	}
+}
+
+TArrayView<const FPGNEventId> FPGNEventLibrary::GetAllNonConclusionEventsWithThisMood(EPGNMood Mood) const
+{
+	const int IndexOfMood = static_cast<int>(Mood);
+
+	if (!MoodIndexOffsets.IsValidIndex(IndexOfMood + 1))
+	{
+		return TArrayView<const FPGNEventId>();
+	}
+
+	return TArrayView<const FPGNEventId>(NonConclusionEventIdsByMood.GetData() + MoodIndexOffsets[IndexOfMood],
+		MoodIndexOffsets[IndexOfMood + 1] - MoodIndexOffsets[IndexOfMood]);
+}
+
+SIZE_T FPGNEventLibrary::GetAllocatedSize() const
+{
+	return OwnedEvents.GetAllocatedSize() + OwnedNonConclusionEventIdsByMood.GetAllocatedSize()
+		+ OwnedMoodIndexOffsets.GetAllocatedSize() + OwnedEventNameOffsets.GetAllocatedSize()
+		+ OwnedEventNameTable.GetAllocatedSize();
+}
+
+FString FPGNEventLibrary::GetEventName(FPGNEventId EventId) const
+{
+	if (!HasEventNames() || !IsValidEventId(EventId))
+	{
+		return FString();
+	}
+
+	const int32 StartOfName = EventNameOffsets[EventId];
+	const int32 LengthOfName = EventNameOffsets[EventId + 1] - StartOfName;
+
+	// The name offsets in a mapped file are not checked when it is loaded, so we will check them here instead.
+	if (StartOfName < 0 || LengthOfName < 0 || StartOfName + LengthOfName > EventNameTable.Num())
+	{
+		return FString();
+	}
+
+	const FUTF8ToTCHAR EventNameAsTCHAR(EventNameTable.GetData() + StartOfName, LengthOfName);
+	return FString(EventNameAsTCHAR.Length(), EventNameAsTCHAR.Get());
+}
+
+FArchive& operator<<(FArchive& Ar, FPGNEventLibrary& EventLibrary)
+{
+	Ar.UsingCustomVersion(FPGNCustomVersion::GUID);
+	const bool bHasEventNames = Ar.CustomVer(FPGNCustomVersion::GUID) >= FPGNCustomVersion::AddedEventNamesToEventLibrary;
+	
+	// A mapped library is always written out from its views, and comes back as an owned one.
+	if (Ar.IsSaving() && EventLibrary.IsMemoryMapped())
+	{
+		TArray<FPGNPackedEvent> AllEvents(EventLibrary.AllEvents);
+		TArray<FPGNEventId> NonConclusionEventIdsByMood(EventLibrary.NonConclusionEventIdsByMood);
+		TArray<int32> MoodIndexOffsets(EventLibrary.MoodIndexOffsets);
+		TArray<int32> EventNameOffsets(EventLibrary.EventNameOffsets);
+		TArray<ANSICHAR> EventNameTable(EventLibrary.EventNameTable);
+
+		Ar << AllEvents << EventLibrary.NumberOfConclusionEvents << NonConclusionEventIdsByMood << MoodIndexOffsets;
+
+		if (bHasEventNames)
+		{
+			Ar << EventNameOffsets << EventNameTable;
+		}
+
+		return Ar;
+	}
+
+	Ar << EventLibrary.OwnedEvents;
+	Ar << EventLibrary.NumberOfConclusionEvents;
+	Ar << EventLibrary.OwnedNonConclusionEventIdsByMood;
+	Ar << EventLibrary.OwnedMoodIndexOffsets;
+
+	if (bHasEventNames)
+	{
+		Ar << EventLibrary.OwnedEventNameOffsets;
+		Ar << EventLibrary.OwnedEventNameTable;
+	}
+
+	if (Ar.IsLoading())
+	{
+		EventLibrary.MappedFileRegion.Reset();
+		EventLibrary.MappedFileHandle.Reset();
+		EventLibrary.PointViewsAtOwnedStorage();
+	}
+
+	return Ar;
+}
+
+void FPGNEventLibrary::UnpackEvent(FPGNEventId EventId, FPGNEvent& Out_Event) const
+{
+	if (!IsValidEventId(EventId))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Tried to unpack the event %d, which is not in the event library."), EventId);
+		return;
+	}
+
+	AllEvents[EventId].Unpack(Out_Event);
+}
+
+void FPGNEventLibrary::MatchEventsOfPreviousVersion(const FPGNEventLibrary& PreviousEventLibrary,
+	TArray<FPGNEventId>& Out_NewEventIdOfEachPreviousEvent) const
+{
+	Out_NewEventIdOfEachPreviousEvent.Init(INVALID_PGN_EVENT_ID, PreviousEventLibrary.GetNumberOfEvents());
+
+	// Both words of a packed event make up its whole content, including whether it is a conclusion event.
+	const auto GetContentOfEvent = [](const FPGNPackedEvent& ThisEvent)
+	{
+		uint32 FirstWord = 0;
+		uint32 SecondWord = 0;
+		ThisEvent.GetWords(FirstWord, SecondWord);
+
+		return static_cast<uint64>(FirstWord) << 32 | SecondWord;
+	};
+
+	TMultiMap<uint64, FPGNEventId> AllEventIdsByContent;
+	AllEventIdsByContent.Reserve(AllEvents.Num());
+
+	for (FPGNEventId ThisEventId = 0; ThisEventId < AllEvents.Num(); ThisEventId++)
+	{
+		AllEventIdsByContent.Add(GetContentOfEvent(AllEvents[ThisEventId]), ThisEventId);
+	}
+
+	TBitArray<> bIsEventMatched(false, AllEvents.Num());
+
+	for (FPGNEventId PreviousEventId = 0; PreviousEventId < PreviousEventLibrary.GetNumberOfEvents(); PreviousEventId++)
+	{
+		const uint64 ContentOfEvent = GetContentOfEvent(PreviousEventLibrary.GetEvent(PreviousEventId));
+
+		// Each event can only be matched once, so it is taken out of the map as soon as it is.
+		auto It = AllEventIdsByContent.CreateKeyIterator(ContentOfEvent);
+
+		if (It)
+		{
+			bIsEventMatched[It.Value()] = true;
+			Out_NewEventIdOfEachPreviousEvent[PreviousEventId] = It.Value();
+			It.RemoveCurrent();
+		}
+	}
+
+	// Conclusion events come first in both libraries, so an event's place is counted from the start of its own part.
+	for (FPGNEventId PreviousEventId = 0; PreviousEventId < PreviousEventLibrary.GetNumberOfEvents(); PreviousEventId++)
+	{
+		if (Out_NewEventIdOfEachPreviousEvent[PreviousEventId] != INVALID_PGN_EVENT_ID)
+		{
+			continue;
+		}
+
+		const bool bIsConclusionEvent = PreviousEventId < PreviousEventLibrary.GetNumberOfConclusionEvents();
+		const FPGNEventId CandidateEventId = bIsConclusionEvent ? PreviousEventId
+			: PreviousEventId - PreviousEventLibrary.GetNumberOfConclusionEvents() + NumberOfConclusionEvents;
+
+		const bool bIsCandidateInSamePart = bIsConclusionEvent ? CandidateEventId < NumberOfConclusionEvents
+			: CandidateEventId < AllEvents.Num();
+
+		if (bIsCandidateInSamePart && !bIsEventMatched[CandidateEventId])
+		{
+			bIsEventMatched[CandidateEventId] = true;
+			Out_NewEventIdOfEachPreviousEvent[PreviousEventId] = CandidateEventId;
+		}
+	}
+}
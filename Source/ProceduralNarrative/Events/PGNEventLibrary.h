@@ -0,0 +1,117 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralNarrative/Events/PGNPackedEvent.h"
+
+class IMappedFileHandle;
+class IMappedFileRegion;
+class UPGNEventDataAsset;
+
+/**
+ * Every event from an event data asset or an event library file, compiled into packed records.
+ *
+ * Conclusion events always come first, so the ID of a conclusion event is also its index in the data asset's
+ * AllConclusionEvents array (and in FPGNWorldData::AllConclusionEvents). Non-conclusion events follow after them.
+ *
+ * The library either owns its data or reads it straight out of a memory-mapped event library file (see
+ * FPGNEventLibraryFile). Every accessor goes through the same views, so nothing else needs to know which it is.
+ * A library never changes once it has been built, which is why it is always handed around as a shared pointer to
+ * const and is safe to read from any thread.
+ */
+class PROCEDURALNARRATIVE_API FPGNEventLibrary
+{
+public:
+
+	FPGNEventLibrary();
+	~FPGNEventLibrary();
+
+	// The views point into this object's own storage or its mapped file, so a library cannot be copied.
+	FPGNEventLibrary(const FPGNEventLibrary&) = delete;
+	FPGNEventLibrary& operator=(const FPGNEventLibrary&) = delete;
+
+	void BuildFromDataAsset(const UPGNEventDataAsset* EventDataAsset);
+
+	// Conclusion events must come first in AllPackedEvents. Names are optional; if there are any, there must be one
+	// for every event.
+	void BuildFromPackedEvents(TArray<FPGNPackedEvent>&& AllPackedEvents, int32 InNumberOfConclusionEvents,
+		const TArray<FString>& AllEventNames = TArray<FString>());
+
+	bool IsValidEventId(FPGNEventId EventId) const { return AllEvents.IsValidIndex(EventId); }
+
+	const FPGNPackedEvent& GetEvent(FPGNEventId EventId) const { return AllEvents[EventId]; }
+
+	int32 GetNumberOfEvents() const { return AllEvents.Num(); }
+	int32 GetNumberOfConclusionEvents() const { return NumberOfConclusionEvents; }
+
+	TArrayView<const FPGNPackedEvent> GetAllEvents() const { return AllEvents; }
+
+	// All non-conclusion events with this mood, without scanning the whole library.
+	TArrayView<const FPGNEventId> GetAllNonConclusionEventsWithThisMood(EPGNMood Mood) const;
+
+	// Events that were imported from a file can have a name written by the author. Events from a data asset do not.
+	bool HasEventNames() const { return EventNameOffsets.Num() > 0; }
+	FString GetEventName(FPGNEventId EventId) const;
+
+	bool IsMemoryMapped() const { return MappedFileRegion.IsValid(); }
+
+	// Only the events this library owns. A memory-mapped library is paged in by the OS, so it counts for nothing here.
+	SIZE_T GetAllocatedSize() const;
+
+	// For the editor, debugging and text output, and for casting, which is the only part of the generator that needs
+	// the unpacked form.
+	void UnpackEvent(FPGNEventId EventId, FPGNEvent& Out_Event) const;
+
+	/*
+	 * Works out which event in this library each event of an older version of it became, so that anything stored by
+	 * event ID can follow its events across a reload. Identical events are matched first. An event that was edited
+	 * is matched to whatever is at its old place among the conclusion or non-conclusion events, if that is not
+	 * matched to anything else. Events that were removed map to INVALID_PGN_EVENT_ID.
+	 */
+	void MatchEventsOfPreviousVersion(const FPGNEventLibrary& PreviousEventLibrary,
+		TArray<FPGNEventId>& Out_NewEventIdOfEachPreviousEvent) const;
+
+	friend FArchive& operator<<(FArchive& Ar, FPGNEventLibrary& EventLibrary);
+
+private:
+
+	friend class FPGNEventLibraryFile;
+
+	void BuildMoodIndex();
+	void BuildNameTable(const TArray<FString>& AllEventNames);
+	void PointViewsAtOwnedStorage();
+
+#pragma region Views
+
+	TArrayView<const FPGNPackedEvent> AllEvents;
+	int32 NumberOfConclusionEvents = 0;
+
+	// Non-conclusion event IDs grouped by mood. The IDs for a mood start at MoodIndexOffsets[Mood] and end just
+	// before MoodIndexOffsets[Mood + 1].
+	TArrayView<const FPGNEventId> NonConclusionEventIdsByMood;
+	TArrayView<const int32> MoodIndexOffsets;
+
+	// Names are stored back to back as UTF-8. The name of an event starts at EventNameOffsets[EventId] and ends
+	// just before EventNameOffsets[EventId + 1].
+	TArrayView<const int32> EventNameOffsets;
+	TArrayView<const ANSICHAR> EventNameTable;
+
+#pragma endregion Views
+
+#pragma region Owned Storage
+
+	TArray<FPGNPackedEvent> OwnedEvents;
+	TArray<FPGNEventId> OwnedNonConclusionEventIdsByMood;
+	TArray<int32> OwnedMoodIndexOffsets;
+	TArray<int32> OwnedEventNameOffsets;
+	TArray<ANSICHAR> OwnedEventNameTable;
+
+#pragma endregion Owned Storage
+
+	// Only set when the views point into a memory-mapped file. The region must be released before the handle.
+	TUniquePtr<IMappedFileHandle> MappedFileHandle;
+	TUniquePtr<IMappedFileRegion> MappedFileRegion;
+};
+
+using FPGNEventLibraryPtr = TSharedPtr<const FPGNEventLibrary, ESPMode::ThreadSafe>;
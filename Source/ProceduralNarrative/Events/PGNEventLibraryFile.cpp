@@ -0,0 +1,565 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/Events/PGNEventLibraryFile.h"
+
+#include "Async/MappedFileHandle.h"
+#include "Dom/JsonObject.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "ProceduralNarrative/DataAssets/PGNEventDataAsset.h"
+#include "ProceduralNarrative/Graphs/MoodGraph.h"
+#include "Serialization/JsonReader.h"
+#include "Serialization/JsonSerializer.h"
+
+// Turns the name of an enum value, such as MOOD_Joyful, into the value. An empty field gives back the default.
+template <typename EnumType>
+static bool ParseEnumField(const FString& Field, const TCHAR* NameOfField, EnumType DefaultValue, EnumType& Out_Value,
+	FString& Out_Error)
+{
+	if (Field.IsEmpty())
+	{
+		Out_Value = DefaultValue;
+		return true;
+	}
+
+	const int64 Value = StaticEnum<EnumType>()->GetValueByNameString(Field);
+
+	if (Value == INDEX_NONE)
+	{
+		Out_Error = FString::Printf(TEXT("'%s' is not a valid value for %s."), *Field, NameOfField);
+		return false;
+	}
+
+	Out_Value = static_cast<EnumType>(Value);
+	return true;
+}
+
+bool FPGNEventLibraryFile::WriteToFile(const FPGNEventLibrary& EventLibrary, const FString& Filename)
+{
+	FPGNEventLibraryFileHeader Header;
+	Header.Magic = MAGIC;
+	Header.FormatVersion = FORMAT_VERSION;
+	Header.NumberOfEvents = EventLibrary.GetNumberOfEvents();
+	Header.NumberOfConclusionEvents = EventLibrary.GetNumberOfConclusionEvents();
+	Header.NumberOfMoods = UMoodGraph::NUMBER_OF_MOODS;
+	Header.bHasEventNames = EventLibrary.HasEventNames() ? 1 : 0;
+	Header.SizeOfEventNameTable = EventLibrary.EventNameTable.Num();
+	CalculateLayout(Header);
+
+	TArray<uint8> FileData;
+	FileData.SetNumZeroed(Header.TotalSize);
+
+	const auto WriteSection = [&FileData](uint64 Offset, const void* Data, uint64 Size)
+	{
+		if (Size > 0)
+		{
+			FMemory::Memcpy(FileData.GetData() + Offset, Data, Size);
+		}
+	};
+
+	WriteSection(0, &Header, sizeof(Header));
+	WriteSection(Header.OffsetOfPackedEvents, EventLibrary.AllEvents.GetData(),
+		EventLibrary.AllEvents.Num() * sizeof(FPGNPackedEvent));
+	WriteSection(Header.OffsetOfMoodIndexOffsets, EventLibrary.MoodIndexOffsets.GetData(),
+		EventLibrary.MoodIndexOffsets.Num() * sizeof(int32));
+	WriteSection(Header.OffsetOfNonConclusionEventIdsByMood, EventLibrary.NonConclusionEventIdsByMood.GetData(),
+		EventLibrary.NonConclusionEventIdsByMood.Num() * sizeof(FPGNEventId));
+	WriteSection(Header.OffsetOfEventNameOffsets, EventLibrary.EventNameOffsets.GetData(),
+		EventLibrary.EventNameOffsets.Num() * sizeof(int32));
+	WriteSection(Header.OffsetOfEventNameTable, EventLibrary.EventNameTable.GetData(), Header.SizeOfEventNameTable);
+
+	if (!FFileHelper::SaveArrayToFile(FileData, *Filename))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not write the event library file %s."), *Filename);
+		return false;
+	}
+
+	return true;
+}
+
+void FPGNEventLibraryFile::CalculateLayout(FPGNEventLibraryFileHeader& InOut_Header)
+{
+	const uint64 NumberOfEvents = InOut_Header.NumberOfEvents;
+	const uint64 NumberOfNonConclusionEvents = NumberOfEvents - InOut_Header.NumberOfConclusionEvents;
+	const uint64 NumberOfEventNameOffsets = InOut_Header.bHasEventNames ? NumberOfEvents + 1 : 0;
+
+	uint64 EndOfFile = AlignSectionOffset(sizeof(FPGNEventLibraryFileHeader));
+
+	InOut_Header.OffsetOfPackedEvents = EndOfFile;
+	EndOfFile = AlignSectionOffset(EndOfFile + NumberOfEvents * sizeof(FPGNPackedEvent));
+
+	InOut_Header.OffsetOfMoodIndexOffsets = EndOfFile;
+	EndOfFile = AlignSectionOffset(EndOfFile + (InOut_Header.NumberOfMoods + 1) * sizeof(int32));
+
+	InOut_Header.OffsetOfNonConclusionEventIdsByMood = EndOfFile;
+	EndOfFile = AlignSectionOffset(EndOfFile + NumberOfNonConclusionEvents * sizeof(FPGNEventId));
+
+	InOut_Header.OffsetOfEventNameOffsets = EndOfFile;
+	EndOfFile = AlignSectionOffset(EndOfFile + NumberOfEventNameOffsets * sizeof(int32));
+
+	InOut_Header.OffsetOfEventNameTable = EndOfFile;
+	EndOfFile = AlignSectionOffset(EndOfFile + InOut_Header.SizeOfEventNameTable);
+
+	InOut_Header.TotalSize = EndOfFile;
+}
+
+bool FPGNEventLibraryFile::IsValidHeader(const FPGNEventLibraryFileHeader& Header, uint64 SizeOfFile,
+	const FString& Filename)
+{
+	if (Header.Magic != MAGIC)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s is not an event library file."), *Filename);
+		return false;
+	}
+
+	if (Header.FormatVersion != FORMAT_VERSION)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s was written with event library format %u, but we can only read format %u. Please import it again."),
+			*Filename, Header.FormatVersion, FORMAT_VERSION);
+		return false;
+	}
+
+	if (Header.NumberOfMoods != UMoodGraph::NUMBER_OF_MOODS || Header.NumberOfEvents < 0
+		|| Header.NumberOfConclusionEvents < 0 || Header.NumberOfConclusionEvents > Header.NumberOfEvents)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s does not match the events and moods that this build knows about. Please import it again."),
+			*Filename);
+		return false;
+	}
+
+	// We will lay the file out again from its counts. If any section has moved, or the file is shorter than it says
+	// it is, it cannot be trusted.
+	FPGNEventLibraryFileHeader ExpectedHeader = Header;
+	CalculateLayout(ExpectedHeader);
+
+	if (FMemory::Memcmp(&ExpectedHeader, &Header, sizeof(Header)) != 0 || Header.TotalSize > SizeOfFile)
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s is damaged or truncated. Please import it again."), *Filename);
+		return false;
+	}
+
+	return true;
+}
+
+FPGNEventLibraryPtr FPGNEventLibraryFile::LoadMemoryMapped(const FString& Filename)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	TUniquePtr<IMappedFileHandle> MappedFileHandle(PlatformFile.OpenMapped(*Filename));
+	TUniquePtr<IMappedFileRegion> MappedFileRegion;
+
+	// We will keep the whole file around in memory if this platform cannot map files.
+	TArray<uint8> FileDataIfNotMapped;
+
+	const uint8* FileData = nullptr;
+	uint64 SizeOfFile = 0;
+
+	if (MappedFileHandle.IsValid())
+	{
+		MappedFileRegion.Reset(MappedFileHandle->MapRegion());
+	}
+
+	if (MappedFileRegion.IsValid())
+	{
+		FileData = MappedFileRegion->GetMappedPtr();
+		SizeOfFile = MappedFileRegion->GetMappedSize();
+	}
+	else
+	{
+		MappedFileHandle.Reset();
+
+		if (!FFileHelper::LoadFileToArray(FileDataIfNotMapped, *Filename))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Could not open the event library file %s."), *Filename);
+			return nullptr;
+		}
+
+		FileData = FileDataIfNotMapped.GetData();
+		SizeOfFile = FileDataIfNotMapped.Num();
+	}
+
+	if (SizeOfFile < sizeof(FPGNEventLibraryFileHeader))
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s is too small to be an event library file."), *Filename);
+		return nullptr;
+	}
+
+	// Everything that the library indexes with is checked here, so that nothing read from the file can take it out of
+	// bounds later. Only the event names are left for the first time they are needed.
+	FPGNEventLibraryFileHeader Header;
+	FMemory::Memcpy(&Header, FileData, sizeof(Header));
+
+	if (!IsValidHeader(Header, SizeOfFile, Filename))
+	{
+		return nullptr;
+	}
+
+	const int32 NumberOfNonConclusionEvents = Header.NumberOfEvents - Header.NumberOfConclusionEvents;
+
+	const TArrayView<const int32> MoodIndexOffsets(
+		reinterpret_cast<const int32*>(FileData + Header.OffsetOfMoodIndexOffsets), Header.NumberOfMoods + 1);
+
+	for (int Index_Mood = 0; Index_Mood <= Header.NumberOfMoods; Index_Mood++)
+	{
+		const int32 PreviousOffset = Index_Mood > 0 ? MoodIndexOffsets[Index_Mood - 1] : 0;
+
+		if (MoodIndexOffsets[Index_Mood] < PreviousOffset || MoodIndexOffsets[Index_Mood] > NumberOfNonConclusionEvents
+			|| (Index_Mood == Header.NumberOfMoods && MoodIndexOffsets[Index_Mood] != NumberOfNonConclusionEvents))
+		{
+			UE_LOG(LogTemp, Error, TEXT("The mood index in %s is damaged. Please import it again."), *Filename);
+			return nullptr;
+		}
+	}
+
+	const TArrayView<const FPGNPackedEvent> AllEvents(
+		reinterpret_cast<const FPGNPackedEvent*>(FileData + Header.OffsetOfPackedEvents), Header.NumberOfEvents);
+
+	for (FPGNEventId ThisEventId = 0; ThisEventId < AllEvents.Num(); ThisEventId++)
+	{
+		const bool bShouldBeAConclusionEvent = ThisEventId < Header.NumberOfConclusionEvents;
+
+		if (!AllEvents[ThisEventId].HasValidFields()
+			|| static_cast<bool>(AllEvents[ThisEventId].bIsConclusionEvent) != bShouldBeAConclusionEvent)
+		{
+			UE_LOG(LogTemp, Error, TEXT("The event %d in %s is damaged. Please import it again."), ThisEventId, *Filename);
+			return nullptr;
+		}
+	}
+
+	const TArrayView<const FPGNEventId> NonConclusionEventIdsByMood(
+		reinterpret_cast<const FPGNEventId*>(FileData + Header.OffsetOfNonConclusionEventIdsByMood),
+		NumberOfNonConclusionEvents);
+
+	for (const FPGNEventId ThisEventId : NonConclusionEventIdsByMood)
+	{
+		if (ThisEventId < Header.NumberOfConclusionEvents || ThisEventId >= Header.NumberOfEvents)
+		{
+			UE_LOG(LogTemp, Error, TEXT("The events by mood in %s are damaged. Please import it again."), *Filename);
+			return nullptr;
+		}
+	}
+
+	const TSharedRef<FPGNEventLibrary, ESPMode::ThreadSafe> NewEventLibrary = MakeShared<FPGNEventLibrary, ESPMode::ThreadSafe>();
+
+	NewEventLibrary->NumberOfConclusionEvents = Header.NumberOfConclusionEvents;
+	NewEventLibrary->AllEvents = AllEvents;
+	NewEventLibrary->MoodIndexOffsets = MoodIndexOffsets;
+	NewEventLibrary->NonConclusionEventIdsByMood = NonConclusionEventIdsByMood;
+
+	if (Header.bHasEventNames)
+	{
+		NewEventLibrary->EventNameOffsets = TArrayView<const int32>(
+			reinterpret_cast<const int32*>(FileData + Header.OffsetOfEventNameOffsets), Header.NumberOfEvents + 1);
+		NewEventLibrary->EventNameTable = TArrayView<const ANSICHAR>(
+			reinterpret_cast<const ANSICHAR*>(FileData + Header.OffsetOfEventNameTable), Header.SizeOfEventNameTable);
+	}
+
+	if (MappedFileRegion.IsValid())
+	{
+		NewEventLibrary->MappedFileHandle = MoveTemp(MappedFileHandle);
+		NewEventLibrary->MappedFileRegion = MoveTemp(MappedFileRegion);
+	}
+	else
+	{
+		// The views point into a buffer that is about to go away, so the library has to take its own copy.
+		NewEventLibrary->OwnedEvents = TArray<FPGNPackedEvent>(NewEventLibrary->AllEvents);
+		NewEventLibrary->OwnedMoodIndexOffsets = TArray<int32>(NewEventLibrary->MoodIndexOffsets);
+		NewEventLibrary->OwnedNonConclusionEventIdsByMood = TArray<FPGNEventId>(NewEventLibrary->NonConclusionEventIdsByMood);
+		NewEventLibrary->OwnedEventNameOffsets = TArray<int32>(NewEventLibrary->EventNameOffsets);
+		NewEventLibrary->OwnedEventNameTable = TArray<ANSICHAR>(NewEventLibrary->EventNameTable);
+		NewEventLibrary->PointViewsAtOwnedStorage();
+	}
+
+	return NewEventLibrary;
+}
+
+#pragma region Importers
+
+bool FPGNEventLibraryFile::ImportFromCSV(const FString& Filename, FPGNEventLibrary& Out_EventLibrary)
+{
+	TArray<FString> AllLines;
+
+	if (!FFileHelper::LoadFileToStringArray(AllLines, *Filename))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not open the CSV file %s."), *Filename);
+		return false;
+	}
+
+	const auto SplitThisLine = [](const FString& ThisLine, TArray<FString>& Out_AllFields)
+	{
+		ThisLine.ParseIntoArray(Out_AllFields, TEXT(","), false);
+
+		for (FString& ThisField : Out_AllFields)
+		{
+			ThisField.TrimStartAndEndInline();
+			ThisField.TrimQuotesInline();
+		}
+	};
+
+	int Index_HeaderLine = 0;
+
+	while (AllLines.IsValidIndex(Index_HeaderLine) && AllLines[Index_HeaderLine].TrimStartAndEnd().IsEmpty())
+	{
+		Index_HeaderLine++;
+	}
+
+	if (!AllLines.IsValidIndex(Index_HeaderLine))
+	{
+		UE_LOG(LogTemp, Error, TEXT("The CSV file %s is empty."), *Filename);
+		return false;
+	}
+
+	TArray<FString> AllColumnNames;
+	SplitThisLine(AllLines[Index_HeaderLine], AllColumnNames);
+
+	TArray<FPGNEvent> AllImportedEvents;
+	TArray<bool> AllImportedConclusionFlags;
+	TArray<FString> AllImportedEventNames;
+
+	TArray<FString> AllFieldsInThisLine;
+
+	for (int Index_Line = Index_HeaderLine + 1; Index_Line < AllLines.Num(); Index_Line++)
+	{
+		if (AllLines[Index_Line].TrimStartAndEnd().IsEmpty())
+		{
+			continue;
+		}
+
+		SplitThisLine(AllLines[Index_Line], AllFieldsInThisLine);
+
+		const auto GetField = [&AllColumnNames, &AllFieldsInThisLine](const TCHAR* NameOfField)
+		{
+			const int IndexOfColumn = AllColumnNames.IndexOfByPredicate([NameOfField](const FString& ThisColumnName)
+			{
+				return ThisColumnName.Equals(NameOfField, ESearchCase::IgnoreCase);
+			});
+
+			return AllFieldsInThisLine.IsValidIndex(IndexOfColumn) ? AllFieldsInThisLine[IndexOfColumn] : FString();
+		};
+
+		FPGNEvent ThisEvent;
+		bool bIsThisAConclusionEvent = false;
+		FString NameOfThisEvent;
+		FString Error;
+
+		if (!ParseImportedEvent(GetField, ThisEvent, bIsThisAConclusionEvent, NameOfThisEvent, Error))
+		{
+			// Line numbers start at 1 in every text editor.
+			UE_LOG(LogTemp, Error, TEXT("%s(%d): %s"), *Filename, Index_Line + 1, *Error);
+			return false;
+		}
+
+		AllImportedEvents.Add(ThisEvent);
+		AllImportedConclusionFlags.Add(bIsThisAConclusionEvent);
+		AllImportedEventNames.Add(NameOfThisEvent);
+	}
+
+	BuildFromImportedEvents(AllImportedEvents, AllImportedConclusionFlags, AllImportedEventNames, Out_EventLibrary);
+	return true;
+}
+
+bool FPGNEventLibraryFile::ImportFromJSON(const FString& Filename, FPGNEventLibrary& Out_EventLibrary)
+{
+	FString FileContents;
+
+	if (!FFileHelper::LoadFileToString(FileContents, *Filename))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not open the JSON file %s."), *Filename);
+		return false;
+	}
+
+	TArray<TSharedPtr<FJsonValue>> AllJsonValues;
+	const TSharedRef<TJsonReader<>> JsonReader = TJsonReaderFactory<>::Create(FileContents);
+
+	if (!FJsonSerializer::Deserialize(JsonReader, AllJsonValues))
+	{
+		UE_LOG(LogTemp, Error, TEXT("%s is not a JSON array of events: %s"), *Filename, *JsonReader->GetErrorMessage());
+		return false;
+	}
+
+	TArray<FPGNEvent> AllImportedEvents;
+	TArray<bool> AllImportedConclusionFlags;
+	TArray<FString> AllImportedEventNames;
+
+	for (int Index_JsonValue = 0; Index_JsonValue < AllJsonValues.Num(); Index_JsonValue++)
+	{
+		const TSharedPtr<FJsonObject>* ThisJsonObject = nullptr;
+
+		if (!AllJsonValues[Index_JsonValue].IsValid() || !AllJsonValues[Index_JsonValue]->TryGetObject(ThisJsonObject))
+		{
+			UE_LOG(LogTemp, Error, TEXT("%s: element %d is not an object."), *Filename, Index_JsonValue);
+			return false;
+		}
+
+		const auto GetField = [ThisJsonObject](const TCHAR* NameOfField)
+		{
+			// Booleans and numbers are turned into strings too, so IsConclusion can be written either way.
+			FString Field;
+			(*ThisJsonObject)->TryGetStringField(NameOfField, Field);
+			return Field;
+		};
+
+		FPGNEvent ThisEvent;
+		bool bIsThisAConclusionEvent = false;
+		FString NameOfThisEvent;
+		FString Error;
+
+		if (!ParseImportedEvent(GetField, ThisEvent, bIsThisAConclusionEvent, NameOfThisEvent, Error))
+		{
+			UE_LOG(LogTemp, Error, TEXT("%s: element %d: %s"), *Filename, Index_JsonValue, *Error);
+			return false;
+		}
+
+		AllImportedEvents.Add(ThisEvent);
+		AllImportedConclusionFlags.Add(bIsThisAConclusionEvent);
+		AllImportedEventNames.Add(NameOfThisEvent);
+	}
+
+	BuildFromImportedEvents(AllImportedEvents, AllImportedConclusionFlags, AllImportedEventNames, Out_EventLibrary);
+	return true;
+}
+
+bool FPGNEventLibraryFile::ImportFromDataAsset(const UPGNEventDataAsset* EventDataAsset,
+	FPGNEventLibrary& Out_EventLibrary)
+{
+	if (EventDataAsset == nullptr)
+	{
+		UE_LOG(LogTemp, Error, TEXT("There is no Event Data Asset to import."));
+		return false;
+	}
+
+	Out_EventLibrary.BuildFromDataAsset(EventDataAsset);
+	return true;
+}
+
+void FPGNEventLibraryFile::BuildFromImportedEvents(const TArray<FPGNEvent>& AllImportedEvents,
+	const TArray<bool>& AllImportedConclusionFlags, const TArray<FString>& AllImportedEventNames,
+	FPGNEventLibrary& Out_EventLibrary)
+{
+	TArray<FPGNPackedEvent> AllPackedEvents;
+	TArray<FString> AllEventNames;
+	AllPackedEvents.Reserve(AllImportedEvents.Num());
+	AllEventNames.Reserve(AllImportedEvents.Num());
+
+	bool bDoesAnyEventHaveAName = false;
+
+	// We will take the conclusion events on the first pass and everything else on the second, so that each keeps the
+	// order it was written in.
+	for (const bool bTakeConclusionEvents : { true, false })
+	{
+		for (int Index_Event = 0; Index_Event < AllImportedEvents.Num(); Index_Event++)
+		{
+			if (AllImportedConclusionFlags[Index_Event] != bTakeConclusionEvents)
+			{
+				continue;
+			}
+
+			AllPackedEvents.Add(FPGNPackedEvent::Pack(AllImportedEvents[Index_Event], bTakeConclusionEvents));
+			AllEventNames.Add(AllImportedEventNames[Index_Event]);
+			bDoesAnyEventHaveAName |= !AllImportedEventNames[Index_Event].IsEmpty();
+		}
+	}
+
+	const int32 NumberOfConclusionEvents = AllImportedConclusionFlags.FilterByPredicate([](bool bIsConclusionEvent)
+	{
+		return bIsConclusionEvent;
+	}).Num();
+
+	if (!bDoesAnyEventHaveAName)
+	{
+		AllEventNames.Reset();
+	}
+
+	Out_EventLibrary.BuildFromPackedEvents(MoveTemp(AllPackedEvents), NumberOfConclusionEvents, AllEventNames);
+}
+
+bool FPGNEventLibraryFile::ParseImportedEvent(TFunctionRef<FString(const TCHAR*)> GetField, FPGNEvent& Out_Event,
+	bool& Out_bIsConclusionEvent, FString& Out_EventName, FString& Out_Error)
+{
+	Out_EventName = GetField(TEXT("Name"));
+	Out_bIsConclusionEvent = GetField(TEXT("IsConclusion")).ToBool();
+
+	const FString Subject = GetField(TEXT("Subject"));
+	const FString Action = GetField(TEXT("Action"));
+	const FString Mood = GetField(TEXT("Mood"));
+
+	if (Subject.IsEmpty() || Action.IsEmpty() || Mood.IsEmpty())
+	{
+		Out_Error = TEXT("Every event needs a Subject, an Action and a Mood.");
+		return false;
+	}
+
+	const bool bParsedAllFields =
+		ParseEnumField(Subject, TEXT("Subject"), EPGNCharacterTag::TAG_NONE, Out_Event.Subject, Out_Error)
+		&& ParseEnumField(GetField(TEXT("SubjectInitialAttitude")), TEXT("SubjectInitialAttitude"),
+			EPGNCharacterAttitude::ATTITUDE_NONE, Out_Event.SubjectInitialAttitude, Out_Error)
+		&& ParseEnumField(GetField(TEXT("SubjectFinalAttitude")), TEXT("SubjectFinalAttitude"),
+			EPGNCharacterAttitude::ATTITUDE_NONE, Out_Event.SubjectFinalAttitude, Out_Error)
+		&& ParseEnumField(Action, TEXT("Action"), EPGNEventAction::ACTION_NONE, Out_Event.Action, Out_Error)
+		&& ParseEnumField(GetField(TEXT("Object")), TEXT("Object"), EPGNCharacterTag::TAG_NONE, Out_Event.Object,
+			Out_Error)
+		&& ParseEnumField(GetField(TEXT("ObjectInitialAttitude")), TEXT("ObjectInitialAttitude"),
+			EPGNCharacterAttitude::ATTITUDE_NONE, Out_Event.ObjectInitialAttitude, Out_Error)
+		&& ParseEnumField(GetField(TEXT("ObjectFinalAttitude")), TEXT("ObjectFinalAttitude"),
+			EPGNCharacterAttitude::ATTITUDE_NONE, Out_Event.ObjectFinalAttitude, Out_Error)
+		&& ParseEnumField(GetField(TEXT("Setting")), TEXT("Setting"), EPGNEventSetting::SETTING_NONE, Out_Event.Setting,
+			Out_Error)
+		&& ParseEnumField(GetField(TEXT("TimeOfDay")), TEXT("TimeOfDay"), EPGNEventTime::TIME_NONE, Out_Event.TimeOfDay,
+			Out_Error)
+		&& ParseEnumField(Mood, TEXT("Mood"), EPGNMood::MOOD_Joyful, Out_Event.Mood, Out_Error);
+
+	if (!bParsedAllFields)
+	{
+		return false;
+	}
+
+	Out_Event.bDoesEventHaveObject = Out_Event.Object != EPGNCharacterTag::TAG_NONE;
+	Out_Event.bDoesEventOverrideSetting = Out_Event.Setting != EPGNEventSetting::SETTING_NONE;
+	Out_Event.bDoesEventOverrideTimeOfDay = Out_Event.TimeOfDay != EPGNEventTime::TIME_NONE;
+
+	return true;
+}
+
+// pgn.events.Import <Source.csv|Source.json|/Game/Path/To/EventDataAsset> <Destination.pgnevents>
+static FAutoConsoleCommand GImportEventLibraryCommand(
+	TEXT("pgn.events.Import"),
+	TEXT("Imports events from a CSV file, a JSON file or an Event Data Asset and writes them to an event library file."),
+	FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+	{
+		if (Args.Num() != 2)
+		{
+			UE_LOG(LogTemp, Error, TEXT("Usage: pgn.events.Import <Source.csv|Source.json|EventDataAssetPath> <Destination.pgnevents>"));
+			return;
+		}
+
+		const FString& Source = Args[0];
+		const FString Extension = FPaths::GetExtension(Source);
+
+		FPGNEventLibrary ImportedEventLibrary;
+		bool bImported = false;
+
+		if (Extension.Equals(TEXT("csv"), ESearchCase::IgnoreCase))
+		{
+			bImported = FPGNEventLibraryFile::ImportFromCSV(Source, ImportedEventLibrary);
+		}
+		else if (Extension.Equals(TEXT("json"), ESearchCase::IgnoreCase))
+		{
+			bImported = FPGNEventLibraryFile::ImportFromJSON(Source, ImportedEventLibrary);
+		}
+		else
+		{
+			bImported = FPGNEventLibraryFile::ImportFromDataAsset(LoadObject<UPGNEventDataAsset>(nullptr, *Source),
+				ImportedEventLibrary);
+		}
+
+		if (bImported && FPGNEventLibraryFile::WriteToFile(ImportedEventLibrary, Args[1]))
+		{
+			UE_LOG(LogTemp, Display, TEXT("Wrote %d events (%d conclusion events) to %s."),
+				ImportedEventLibrary.GetNumberOfEvents(), ImportedEventLibrary.GetNumberOfConclusionEvents(), *Args[1]);
+		}
+	}));
+
+#pragma endregion Importers
@@ -0,0 +1,109 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralNarrative/Events/PGNEventLibrary.h"
+
+class UPGNEventDataAsset;
+
+/**
+ * The header at the start of every event library file (.pgnevents).
+ *
+ * The rest of the file is a set of flat sections that the header points to, each one starting on an 8-byte boundary:
+ *
+ *	PackedEvents				NumberOfEvents FPGNPackedEvents, conclusion events first.
+ *	MoodIndexOffsets			NumberOfMoods + 1 int32s.
+ *	NonConclusionEventIdsByMood	NumberOfEvents - NumberOfConclusionEvents int32s.
+ *	EventNameOffsets			NumberOfEvents + 1 int32s, or nothing if the events have no names.
+ *	EventNameTable				SizeOfEventNameTable bytes of UTF-8.
+ *
+ * These are exactly the arrays that FPGNEventLibrary holds, so a mapped file can be read in place without any parsing.
+ * Everything is stored little-endian, which is what every platform we ship on uses.
+ */
+struct FPGNEventLibraryFileHeader
+{
+	uint32 Magic = 0;
+	uint32 FormatVersion = 0;
+
+	int32 NumberOfEvents = 0;
+	int32 NumberOfConclusionEvents = 0;
+	int32 NumberOfMoods = 0;
+	uint32 bHasEventNames = 0;
+
+	uint64 OffsetOfPackedEvents = 0;
+	uint64 OffsetOfMoodIndexOffsets = 0;
+	uint64 OffsetOfNonConclusionEventIdsByMood = 0;
+	uint64 OffsetOfEventNameOffsets = 0;
+	uint64 OffsetOfEventNameTable = 0;
+	uint64 SizeOfEventNameTable = 0;
+
+	// The size of the whole file, so that a truncated file is caught before anything reads past its end.
+	uint64 TotalSize = 0;
+};
+
+static_assert(sizeof(FPGNEventLibraryFileHeader) == 80, "FPGNEventLibraryFileHeader is written to disk as is.");
+
+/**
+ * Reads and writes event library files, and imports event libraries from the formats that writers author them in.
+ *
+ * A library that is loaded from a file is memory-mapped read-only, so loading even a very large one only costs the
+ * mapping itself. Pages are read from disk the first time something touches them.
+ */
+class PROCEDURALNARRATIVE_API FPGNEventLibraryFile
+{
+public:
+
+	// 'PGNE'
+	static constexpr uint32 MAGIC = 0x454E4750;
+
+	// Bump this whenever the layout of the file changes. Old files have to be imported again.
+	static constexpr uint32 FORMAT_VERSION = 1;
+
+	static constexpr uint64 SECTION_ALIGNMENT = 8;
+
+	static bool WriteToFile(const FPGNEventLibrary& EventLibrary, const FString& Filename);
+
+	// Returns null if the file could not be mapped or is not a valid event library file.
+	static FPGNEventLibraryPtr LoadMemoryMapped(const FString& Filename);
+
+#pragma region Importers
+
+	/*
+	 * CSV and JSON files both describe one event per row or object, with these columns or fields:
+	 *
+	 *	Name, IsConclusion, Subject, SubjectInitialAttitude, SubjectFinalAttitude, Action,
+	 *	Object, ObjectInitialAttitude, ObjectFinalAttitude, Setting, TimeOfDay, Mood
+	 *
+	 * Enum values are written by name, such as TAG_PROTAGONIST or MOOD_Joyful. Name, IsConclusion and everything from
+	 * Object onwards are optional. An event only has an object, or overrides its setting or time of day, if that field
+	 * is set to something other than its NONE value.
+	 *
+	 * The CSV file must start with a header row naming its columns. Fields cannot contain commas.
+	 * The JSON file must be an array of objects.
+	 */
+	static bool ImportFromCSV(const FString& Filename, FPGNEventLibrary& Out_EventLibrary);
+	static bool ImportFromJSON(const FString& Filename, FPGNEventLibrary& Out_EventLibrary);
+
+	static bool ImportFromDataAsset(const UPGNEventDataAsset* EventDataAsset, FPGNEventLibrary& Out_EventLibrary);
+
+#pragma endregion Importers
+
+private:
+
+	// Fills in where every section goes, and the size of the file, from the counts that are already in the header.
+	static void CalculateLayout(FPGNEventLibraryFileHeader& InOut_Header);
+
+	static bool IsValidHeader(const FPGNEventLibraryFileHeader& Header, uint64 SizeOfFile, const FString& Filename);
+
+	static uint64 AlignSectionOffset(uint64 Offset) { return Align(Offset, SECTION_ALIGNMENT); }
+
+	// Sorts the imported events so that the conclusion events come first, and builds the library from them.
+	static void BuildFromImportedEvents(const TArray<FPGNEvent>& AllImportedEvents,
+		const TArray<bool>& AllImportedConclusionFlags, const TArray<FString>& AllImportedEventNames,
+		FPGNEventLibrary& Out_EventLibrary);
+
+	// Reads one event from a CSV row or a JSON object. GetField returns an empty string for a missing field.
+	static bool ParseImportedEvent(TFunctionRef<FString(const TCHAR*)> GetField, FPGNEvent& Out_Event,
+		bool& Out_bIsConclusionEvent, FString& Out_EventName, FString& Out_Error);
+};
@@ -0,0 +1,103 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/Events/PGNPackedEvent.h"
+
+FPGNPackedEvent::FPGNPackedEvent()
+	: Subject(0), SubjectInitialAttitude(0), SubjectFinalAttitude(0), Action(0), Mood(0), TimeOfDay(0), Setting(0)
+	, Object(0), ObjectInitialAttitude(0), ObjectFinalAttitude(0), bDoesEventHaveObject(0)
+	, bDoesEventOverrideSetting(0), bDoesEventOverrideTimeOfDay(0), bIsConclusionEvent(0), Reserved(0)
+{
+}
+
+FPGNPackedEvent FPGNPackedEvent::Pack(const FPGNEvent& ThisEvent, bool bIsThisAConclusionEvent)
+{
+	FPGNPackedEvent PackedEvent;
+
+	PackedEvent.Subject = static_cast<uint32>(ThisEvent.Subject);
+	PackedEvent.SubjectInitialAttitude = static_cast<uint32>(ThisEvent.SubjectInitialAttitude);
+	PackedEvent.SubjectFinalAttitude = static_cast<uint32>(ThisEvent.SubjectFinalAttitude);
+	PackedEvent.Action = static_cast<uint32>(ThisEvent.Action);
+	PackedEvent.Mood = static_cast<uint32>(ThisEvent.Mood);
+	PackedEvent.TimeOfDay = static_cast<uint32>(ThisEvent.TimeOfDay);
+	PackedEvent.Setting = static_cast<uint32>(ThisEvent.Setting);
+
+	PackedEvent.Object = static_cast<uint32>(ThisEvent.Object);
+	PackedEvent.ObjectInitialAttitude = static_cast<uint32>(ThisEvent.ObjectInitialAttitude);
+	PackedEvent.ObjectFinalAttitude = static_cast<uint32>(ThisEvent.ObjectFinalAttitude);
+
+	PackedEvent.bDoesEventHaveObject = ThisEvent.bDoesEventHaveObject;
+	PackedEvent.bDoesEventOverrideSetting = ThisEvent.bDoesEventOverrideSetting;
+	PackedEvent.bDoesEventOverrideTimeOfDay = ThisEvent.bDoesEventOverrideTimeOfDay;
+	PackedEvent.bIsConclusionEvent = bIsThisAConclusionEvent;
+
+	return PackedEvent;
+}
+
+void FPGNPackedEvent::Unpack(FPGNEvent& Out_Event) const
+{
+	Out_Event.Subject = GetSubject();
+	Out_Event.SubjectInitialAttitude = GetSubjectInitialAttitude();
+	Out_Event.SubjectFinalAttitude = GetSubjectFinalAttitude();
+	Out_Event.Action = GetAction();
+	Out_Event.Mood = GetMood();
+	Out_Event.TimeOfDay = GetTimeOfDay();
+	Out_Event.Setting = GetSetting();
+
+	Out_Event.Object = GetObject();
+	Out_Event.ObjectInitialAttitude = GetObjectInitialAttitude();
+	Out_Event.ObjectFinalAttitude = GetObjectFinalAttitude();
+
+	Out_Event.bDoesEventHaveObject = bDoesEventHaveObject;
+	Out_Event.bDoesEventOverrideSetting = bDoesEventOverrideSetting;
+	Out_Event.bDoesEventOverrideTimeOfDay = bDoesEventOverrideTimeOfDay;
+}
+
+bool FPGNPackedEvent::HasValidFields() const
+{
+	constexpr uint32 LAST_CHARACTER_TAG = static_cast<uint32>(EPGNCharacterTag::TAG_CHARACTER_15);
+	constexpr uint32 LAST_ATTITUDE = static_cast<uint32>(EPGNCharacterAttitude::SENTIMENTAL);
+
+	return Subject <= LAST_CHARACTER_TAG
+		&& SubjectInitialAttitude <= LAST_ATTITUDE
+		&& SubjectFinalAttitude <= LAST_ATTITUDE
+		&& Action <= static_cast<uint32>(EPGNEventAction::REVEALED_PREGNANT_WITH_CHILD_OF)
+		&& Mood <= static_cast<uint32>(EPGNMood::MOOD_Melancholy)
+		&& TimeOfDay <= static_cast<uint32>(EPGNEventTime::LATE_NIGHT)
+		&& Setting <= static_cast<uint32>(EPGNEventSetting::SETTING_NONE)
+		&& Object <= LAST_CHARACTER_TAG
+		&& ObjectInitialAttitude <= LAST_ATTITUDE
+		&& ObjectFinalAttitude <= LAST_ATTITUDE;
+}
+
+void FPGNPackedEvent::GetWords(uint32& Out_FirstWord, uint32& Out_SecondWord) const
+{
+	uint32 Words[2];
+	FMemory::Memcpy(Words, this, sizeof(Words));
+
+	Out_FirstWord = Words[0];
+	Out_SecondWord = Words[1];
+}
+
+void FPGNPackedEvent::SetWords(uint32 FirstWord, uint32 SecondWord)
+{
+	const uint32 Words[2] = { FirstWord, SecondWord };
+	FMemory::Memcpy(this, Words, sizeof(Words));
+}
+
+FArchive& operator<<(FArchive& Ar, FPGNPackedEvent& PackedEvent)
+{
+	uint32 FirstWord = 0;
+	uint32 SecondWord = 0;
+	PackedEvent.GetWords(FirstWord, SecondWord);
+
+	Ar << FirstWord;
+	Ar << SecondWord;
+
+	if (Ar.IsLoading())
+	{
+		PackedEvent.SetWords(FirstWord, SecondWord);
+	}
+
+	return Ar;
+}
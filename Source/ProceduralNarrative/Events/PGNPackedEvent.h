@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralNarrative/PGNUtilities.h"
+
+// Events are referred to everywhere at runtime by their index in the FPGNEventLibrary.
+using FPGNEventId = int32;
+
+static constexpr FPGNEventId INVALID_PGN_EVENT_ID = INDEX_NONE;
+
+/**
+ * The compiled runtime form of an FPGNEvent.
+ *
+ * FPGNEvent is what writers edit, so it has one byte per enum plus bools and padding. This packs every enum and flag
+ * into two 32-bit words, so that a whole event library sits in cache while we search through it.
+ */
+struct FPGNPackedEvent
+{
+#pragma region Subject, Action and Tone
+
+	uint32 Subject : 5;
+	uint32 SubjectInitialAttitude : 5;
+	uint32 SubjectFinalAttitude : 5;
+	uint32 Action : 5;
+	uint32 Mood : 4;
+	uint32 TimeOfDay : 4;
+	uint32 Setting : 4;
+
+#pragma endregion Subject, Action and Tone
+
+#pragma region Object and Flags
+
+	uint32 Object : 5;
+	uint32 ObjectInitialAttitude : 5;
+	uint32 ObjectFinalAttitude : 5;
+	uint32 bDoesEventHaveObject : 1;
+	uint32 bDoesEventOverrideSetting : 1;
+	uint32 bDoesEventOverrideTimeOfDay : 1;
+	uint32 bIsConclusionEvent : 1;
+	uint32 Reserved : 13;
+
+#pragma endregion Object and Flags
+
+	FPGNPackedEvent();
+
+	static FPGNPackedEvent Pack(const FPGNEvent& ThisEvent, bool bIsThisAConclusionEvent);
+	void Unpack(FPGNEvent& Out_Event) const;
+
+	EPGNCharacterTag GetSubject() const { return static_cast<EPGNCharacterTag>(Subject); }
+	EPGNCharacterAttitude GetSubjectInitialAttitude() const { return static_cast<EPGNCharacterAttitude>(SubjectInitialAttitude); }
+	EPGNCharacterAttitude GetSubjectFinalAttitude() const { return static_cast<EPGNCharacterAttitude>(SubjectFinalAttitude); }
+	EPGNEventAction GetAction() const { return static_cast<EPGNEventAction>(Action); }
+	EPGNMood GetMood() const { return static_cast<EPGNMood>(Mood); }
+	EPGNEventTime GetTimeOfDay() const { return static_cast<EPGNEventTime>(TimeOfDay); }
+	EPGNEventSetting GetSetting() const { return static_cast<EPGNEventSetting>(Setting); }
+
+	EPGNCharacterTag GetObject() const { return static_cast<EPGNCharacterTag>(Object); }
+	EPGNCharacterAttitude GetObjectInitialAttitude() const { return static_cast<EPGNCharacterAttitude>(ObjectInitialAttitude); }
+	EPGNCharacterAttitude GetObjectFinalAttitude() const { return static_cast<EPGNCharacterAttitude>(ObjectFinalAttitude); }
+
+	// Whether every field holds one of the values of its enum. Packed events read straight from a file might not.
+	bool HasValidFields() const;
+
+	// The two words exactly as they are laid out in memory, for hashing and serialization.
+	void GetWords(uint32& Out_FirstWord, uint32& Out_SecondWord) const;
+	void SetWords(uint32 FirstWord, uint32 SecondWord);
+
+	friend FArchive& operator<<(FArchive& Ar, FPGNPackedEvent& PackedEvent);
+};
+
+static_assert(sizeof(FPGNPackedEvent) == 8, "FPGNPackedEvent should stay two words wide.");
+
+// If any of these fail, an enum has outgrown its bits in FPGNPackedEvent.
+static_assert(static_cast<uint32>(EPGNCharacterTag::TAG_CHARACTER_15) < (1u << 5), "EPGNCharacterTag no longer fits.");
+static_assert(static_cast<uint32>(EPGNCharacterAttitude::SENTIMENTAL) < (1u << 5), "EPGNCharacterAttitude no longer fits.");
+static_assert(static_cast<uint32>(EPGNEventAction::REVEALED_PREGNANT_WITH_CHILD_OF) < (1u << 5), "EPGNEventAction no longer fits.");
+static_assert(static_cast<uint32>(EPGNMood::MOOD_Melancholy) < (1u << 4), "EPGNMood no longer fits.");
+static_assert(static_cast<uint32>(EPGNEventTime::LATE_NIGHT) < (1u << 4), "EPGNEventTime no longer fits.");
+static_assert(static_cast<uint32>(EPGNEventSetting::SETTING_NONE) < (1u << 4), "EPGNEventSetting no longer fits.");
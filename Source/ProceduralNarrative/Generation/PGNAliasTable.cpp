@@ -0,0 +1,87 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/Generation/PGNAliasTable.h"
+
+void FPGNAliasTable::Build(const TArray<float>& AllWeights)
+{
+	const int32 NumberOfColumns = AllWeights.Num();
+
+	Probabilities.Reset();
+	Aliases.Reset();
+
+	float TotalWeight = 0.f;
+	for (const float ThisWeight : AllWeights)
+	{
+		TotalWeight += FMath::Max(ThisWeight, 0.f);
+	}
+
+	if (NumberOfColumns == 0 || TotalWeight <= 0.f)
+	{
+		return;
+	}
+
+	Probabilities.SetNumUninitialized(NumberOfColumns);
+	Aliases.Init(INDEX_NONE, NumberOfColumns);
+
+	// Scale every weight so that the average column is exactly full.
+	TArray<int32, TInlineAllocator<16>> SmallColumns;
+	TArray<int32, TInlineAllocator<16>> LargeColumns;
+
+	for (int32 Index_Column = 0; Index_Column < NumberOfColumns; Index_Column++)
+	{
+		Probabilities[Index_Column] = FMath::Max(AllWeights[Index_Column], 0.f) * NumberOfColumns / TotalWeight;
+
+		if (Probabilities[Index_Column] < 1.f)
+		{
+			SmallColumns.Add(Index_Column);
+		}
+		else
+		{
+			LargeColumns.Add(Index_Column);
+		}
+	}
+
+	// Top up every small column with the excess of a large one.
+	while (SmallColumns.Num() > 0 && LargeColumns.Num() > 0)
+	{
+		const int32 SmallColumn = SmallColumns.Pop(false);
+		const int32 LargeColumn = LargeColumns.Pop(false);
+
+		Aliases[SmallColumn] = LargeColumn;
+		Probabilities[LargeColumn] = (Probabilities[LargeColumn] + Probabilities[SmallColumn]) - 1.f;
+
+		if (Probabilities[LargeColumn] < 1.f)
+		{
+			SmallColumns.Add(LargeColumn);
+		}
+		else
+		{
+			LargeColumns.Add(LargeColumn);
+		}
+	}
+
+	// Whatever is left over is full, give or take floating point error.
+	for (const int32 ThisColumn : LargeColumns)
+	{
+		Probabilities[ThisColumn] = 1.f;
+	}
+
+	for (const int32 ThisColumn : SmallColumns)
+	{
+		Probabilities[ThisColumn] = 1.f;
+	}
+}
+
+int32 FPGNAliasTable::Sample(float RandomColumn, float RandomCoinFlip) const
+{
+	if (IsEmpty())
+	{
+		return INDEX_NONE;
+	}
+
+	const int32 Column = FMath::Clamp(FMath::FloorToInt(RandomColumn * Probabilities.Num()), 0, Probabilities.Num() - 1);
+
+	// Full columns have no alias, which only matters if the coin flip came out as exactly one.
+	return RandomCoinFlip < Probabilities[Column] || Aliases[Column] == INDEX_NONE ? Column : Aliases[Column];
+}
@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Samples an index from a discrete distribution in constant time (Vose's alias method).
+ *
+ * The weights do not need to add up to one; they are normalised when the table is built.
+ */
+struct PROCEDURALNARRATIVE_API FPGNAliasTable
+{
+	// The chance of keeping each column instead of jumping to its alias.
+	TArray<float> Probabilities;
+	TArray<int32> Aliases;
+
+	void Build(const TArray<float>& AllWeights);
+
+	bool IsEmpty() const { return Probabilities.Num() == 0; }
+	int32 Num() const { return Probabilities.Num(); }
+
+	// Both random numbers should be in [0, 1).
+	int32 Sample(float RandomColumn, float RandomCoinFlip) const;
+
+	friend FArchive& operator<<(FArchive& Ar, FPGNAliasTable& AliasTable)
+	{
+		Ar << AliasTable.Probabilities;
+		Ar << AliasTable.Aliases;
+		return Ar;
+	}
+};
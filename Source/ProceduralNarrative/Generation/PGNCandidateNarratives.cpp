@@ -0,0 +1,235 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/Generation/PGNCandidateNarratives.h"
+
+#include "Async/ParallelFor.h"
+#include "Math/RandomStream.h"
+#include "ProceduralNarrative/Generation/PGNScratchMemory.h"
+#include "ProceduralNarrative/History/PGNCharacterTimeline.h"
+
+int32 FPGNCandidateNarrativeBuilder::BuildCandidates(TArrayView<const FPGNEventId> AllConclusionEventIds,
+	const TArray<FPGNConclusionEvent>& AllConclusionEvents, int32 NumberOfEventsBeforeConclusion, int32 RandomSeed,
+	TArrayView<const FPGNCastingCandidate> AllCastingCandidates, TArrayView<const FPGNCastMember> InitialCast,
+	TFunctionRef<bool(int32, int32, FPGNRelationship&)> FindRelationship, FPGNNarrativeEvaluator& Evaluator,
+	double Deadline, TArray<FPGNCandidateNarrative>& Out_AllCandidates)
+{
+	Out_AllCandidates.Reset();
+	Out_AllCandidates.SetNum(AllConclusionEventIds.Num());
+
+	// Every candidate only writes to its own slot, so they can all be built at once.
+	ParallelFor(AllConclusionEventIds.Num(), [&](int32 Index_Candidate)
+	{
+		if (Index_Candidate > 0 && Deadline > 0.0 && FPlatformTime::Seconds() > Deadline)
+		{
+			return;
+		}
+
+		const FPGNEventId ConclusionEventId = AllConclusionEventIds[Index_Candidate];
+
+		if (!AllConclusionEvents.IsValidIndex(ConclusionEventId))
+		{
+			return;
+		}
+
+		FPGNCandidateNarrative& ThisCandidate = Out_AllCandidates[Index_Candidate];
+		ThisCandidate.Cast.Append(InitialCast.GetData(), InitialCast.Num());
+
+		// Each candidate gets its own stream, so the same seed always gives the same candidates, whatever thread they
+		// end up on.
+		BuildThisCandidate(ConclusionEventId, AllConclusionEvents[ConclusionEventId], NumberOfEventsBeforeConclusion,
+			RandomSeed + Index_Candidate, AllCastingCandidates, FindRelationship, Evaluator, ThisCandidate);
+	});
+
+	int32 IndexOfBestCandidate = INDEX_NONE;
+
+	for (int32 Index_Candidate = 0; Index_Candidate < Out_AllCandidates.Num(); Index_Candidate++)
+	{
+		const FPGNCandidateNarrative& ThisCandidate = Out_AllCandidates[Index_Candidate];
+
+		// Ties go to the candidate that comes first, which is the one with the better conclusion event.
+		if (ThisCandidate.bIsComplete && (IndexOfBestCandidate == INDEX_NONE
+			|| ThisCandidate.Fitness.Total > Out_AllCandidates[IndexOfBestCandidate].Fitness.Total))
+		{
+			IndexOfBestCandidate = Index_Candidate;
+		}
+	}
+
+	return IndexOfBestCandidate;
+}
+
+void FPGNCandidateNarrativeBuilder::BuildThisCandidate(FPGNEventId ConclusionEventId,
+	const FPGNConclusionEvent& ConclusionEvent, int32 NumberOfEventsBeforeConclusion, int32 RandomSeed,
+	TArrayView<const FPGNCastingCandidate> AllCastingCandidates,
+	TFunctionRef<bool(int32, int32, FPGNRelationship&)> FindRelationship, FPGNNarrativeEvaluator& Evaluator,
+	FPGNCandidateNarrative& InOut_Candidate)
+{
+	// Each task has its own memory stack, so this only releases what this candidate used.
+	FPGNGenerationScratchScope ScratchScope;
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	FPGNGeneratedNarrative& ThisNarrative = InOut_Candidate.Narrative;
+	ThisNarrative.ConclusionEventId = ConclusionEventId;
+
+	// The conclusion is cast first, so that the events before it are chosen for the people it needs.
+	const FPGNEvent* AllConclusionEventsToCast[] = { &ConclusionEvent };
+
+	bool bWasCast = FPGNCastingSolver::CastEvents(AllConclusionEventsToCast, AllCastingCandidates, FindRelationship,
+		InOut_Candidate.Cast);
+
+	// The evaluator takes the cast indexed by role, with anyone uncast left as INDEX_NONE. There is room for every
+	// role, since the events before the conclusion can bring in any of them.
+	TPGNScratchArray<FPGNCastingCandidate> CastByRole;
+	CastByRole.SetNum(FPGNCastingSolver::GetIndexInCast(EPGNCharacterTag::TAG_CHARACTER_15) + 1);
+
+	for (const FPGNCastMember& ThisCastMember : InOut_Candidate.Cast)
+	{
+		const int32 IndexInCast = FPGNCastingSolver::GetIndexInCast(ThisCastMember.Tag);
+
+		if (CastByRole.IsValidIndex(IndexInCast))
+		{
+			CastByRole[IndexInCast] = ThisCastMember.Character;
+		}
+	}
+
+	if (bWasCast)
+	{
+		FRandomStream RandomStream(RandomSeed);
+		ChooseEventsBeforeConclusion(ConclusionEventId, NumberOfEventsBeforeConclusion, RandomStream, CastByRole,
+			Evaluator, ThisNarrative);
+	}
+
+	// Every role the chosen events brought in is cast at once, around the people the conclusion already has.
+	const FPGNEventLibrary& EventLibrary = Evaluator.GetEventLibrary();
+
+	TPGNScratchArray<FPGNEvent> AllEventsBeforeConclusion;
+	AllEventsBeforeConclusion.SetNum(ThisNarrative.AllEventIds.Num());
+
+	TPGNScratchArray<const FPGNEvent*> AllEventsToCast;
+	AllEventsToCast.Reserve(ThisNarrative.AllEventIds.Num());
+
+	for (int32 Index_Event = 0; Index_Event < ThisNarrative.AllEventIds.Num(); Index_Event++)
+	{
+		EventLibrary.UnpackEvent(ThisNarrative.AllEventIds[Index_Event], AllEventsBeforeConclusion[Index_Event]);
+		AllEventsToCast.Add(&AllEventsBeforeConclusion[Index_Event]);
+	}
+
+	if (bWasCast && AllEventsToCast.Num() > 0)
+	{
+		bWasCast = FPGNCastingSolver::CastEvents(AllEventsToCast, AllCastingCandidates, FindRelationship,
+			InOut_Candidate.Cast);
+	}
+
+	// Attitudes carry from one event to the next, so the events are recorded in the order they happen.
+	for (const FPGNEvent& ThisEvent : AllEventsBeforeConclusion)
+	{
+		UPGNUtilities::RecordCastOfThisEvent(ThisNarrative, ThisEvent, InOut_Candidate.Cast);
+	}
+
+	UPGNUtilities::RecordCastOfThisEvent(ThisNarrative, ConclusionEvent, InOut_Candidate.Cast);
+
+	const double BuildTime = FPlatformTime::Seconds();
+	InOut_Candidate.BuildingTimeInSeconds = BuildTime - StartTime;
+
+	if (!bWasCast)
+	{
+		return;
+	}
+
+	TPGNScratchArray<FPGNEventId> AllEventIdsInOrder;
+	AllEventIdsInOrder.Reserve(ThisNarrative.AllEventIds.Num() + 1);
+	AllEventIdsInOrder.Append(ThisNarrative.AllEventIds);
+	AllEventIdsInOrder.Add(ConclusionEventId);
+
+	for (const FPGNCastMember& ThisCastMember : InOut_Candidate.Cast)
+	{
+		const int32 IndexInCast = FPGNCastingSolver::GetIndexInCast(ThisCastMember.Tag);
+
+		if (CastByRole.IsValidIndex(IndexInCast))
+		{
+			CastByRole[IndexInCast] = ThisCastMember.Character;
+		}
+	}
+
+	InOut_Candidate.bIsComplete = Evaluator.Evaluate(AllEventIdsInOrder, CastByRole, InOut_Candidate.Fitness);
+	InOut_Candidate.ScoringTimeInSeconds = FPlatformTime::Seconds() - BuildTime;
+}
+
+void FPGNCandidateNarrativeBuilder::ChooseEventsBeforeConclusion(FPGNEventId ConclusionEventId,
+	int32 NumberOfEventsBeforeConclusion, FRandomStream& RandomStream, TArrayView<const FPGNCastingCandidate> CastByRole,
+	FPGNNarrativeEvaluator& Evaluator, FPGNGeneratedNarrative& InOut_Narrative)
+{
+	const FPGNEventLibrary& EventLibrary = Evaluator.GetEventLibrary();
+
+	const int32 IdOfFirstNonConclusionEvent = EventLibrary.GetNumberOfConclusionEvents();
+	const int32 NumberOfNonConclusionEvents = EventLibrary.GetNumberOfEvents() - IdOfFirstNonConclusionEvent;
+
+	if (NumberOfNonConclusionEvents <= 0)
+	{
+		return;
+	}
+
+	const bool bShouldTryEveryEvent = NumberOfNonConclusionEvents <= MAXIMUM_EVENTS_TRIED_PER_POSITION;
+	const int32 NumberOfEventsToTry = bShouldTryEveryEvent ? NumberOfNonConclusionEvents : MAXIMUM_EVENTS_TRIED_PER_POSITION;
+
+	// The narrative so far, then the event being tried, then the conclusion.
+	TPGNScratchArray<FPGNEventId> AllEventIdsToScore;
+	AllEventIdsToScore.Reserve(NumberOfEventsBeforeConclusion + 1);
+
+	for (int32 Index_Position = 0; Index_Position < NumberOfEventsBeforeConclusion; Index_Position++)
+	{
+		FPGNEventId BestEventId = INVALID_PGN_EVENT_ID;
+		float BestFitness = -MAX_flt;
+
+		for (int32 Index_Try = 0; Index_Try < NumberOfEventsToTry; Index_Try++)
+		{
+			const FPGNEventId ThisEventId = IdOfFirstNonConclusionEvent
+				+ (bShouldTryEveryEvent ? Index_Try : RandomStream.RandRange(0, NumberOfNonConclusionEvents - 1));
+
+			if (InOut_Narrative.AllEventIds.Contains(ThisEventId))
+			{
+				continue;
+			}
+
+			// Anyone who is already cast has to be able to do what this event asks of them.
+			const FPGNPackedEvent& ThisEvent = EventLibrary.GetEvent(ThisEventId);
+			const int32 IndexOfSubjectInCast = FPGNCastingSolver::GetIndexInCast(ThisEvent.GetSubject());
+			const int32 IndexOfObjectInCast = FPGNCastingSolver::GetIndexInCast(ThisEvent.GetObject());
+
+			if (CastByRole.IsValidIndex(IndexOfSubjectInCast) && CastByRole[IndexOfSubjectInCast].IndexOfCharacter != INDEX_NONE
+				&& !FPGNCharacterTimeline::CanTakePartInAction(ThisEvent.GetAction(), true, CastByRole[IndexOfSubjectInCast].StateFlags))
+			{
+				continue;
+			}
+
+			if (ThisEvent.bDoesEventHaveObject && CastByRole.IsValidIndex(IndexOfObjectInCast)
+				&& CastByRole[IndexOfObjectInCast].IndexOfCharacter != INDEX_NONE
+				&& !FPGNCharacterTimeline::CanTakePartInAction(ThisEvent.GetAction(), false, CastByRole[IndexOfObjectInCast].StateFlags))
+			{
+				continue;
+			}
+
+			AllEventIdsToScore.Reset();
+			AllEventIdsToScore.Append(InOut_Narrative.AllEventIds);
+			AllEventIdsToScore.Add(ThisEventId);
+			AllEventIdsToScore.Add(ConclusionEventId);
+
+			FPGNNarrativeFitness ThisFitness;
+
+			if (Evaluator.Evaluate(AllEventIdsToScore, CastByRole, ThisFitness) && ThisFitness.Total > BestFitness)
+			{
+				BestEventId = ThisEventId;
+				BestFitness = ThisFitness.Total;
+			}
+		}
+
+		// Nothing fits the cast, so the narrative will be shorter.
+		if (BestEventId == INVALID_PGN_EVENT_ID)
+		{
+			return;
+		}
+
+		InOut_Narrative.AllEventIds.Add(BestEventId);
+	}
+}
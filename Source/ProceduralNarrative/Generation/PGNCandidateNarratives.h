@@ -0,0 +1,73 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralNarrative/PGNUtilities.h"
+#include "ProceduralNarrative/Generation/PGNCastingSolver.h"
+#include "ProceduralNarrative/Generation/PGNNarrativeEvaluator.h"
+
+// One of the narratives that were built side by side, with what it cost to build and how well it scored.
+struct FPGNCandidateNarrative
+{
+	FPGNGeneratedNarrative Narrative;
+
+	// The cast and the attitudes this narrative leaves them in, for carrying on from it.
+	TArray<FPGNCastMember> Cast;
+
+	FPGNNarrativeFitness Fitness;
+
+	// Choosing the events and casting them.
+	double BuildingTimeInSeconds = 0.0;
+	double ScoringTimeInSeconds = 0.0;
+
+	// False if the deadline passed before this candidate was started, or if it could not be cast or scored.
+	bool bIsComplete = false;
+};
+
+/**
+ * Builds a complete narrative for each of several conclusion events at once, and picks the one that scores best.
+ *
+ * A narrative is built backwards from its conclusion. The conclusion is cast first, and then the events that lead up
+ * to it are chosen one after another, each the one that gives the narrative so far the best fitness out of a sample of
+ * the event library. Finally, every role those events brought in is cast.
+ *
+ * Every candidate is built on its own task, with its own scratch memory and its own copy of the cast, so the only
+ * things they share are read-only: the conclusion events, the casting candidates, and the evaluator, whose caches are
+ * safe to fill from any thread. Spare cores therefore buy better narratives instead of slower ones.
+ *
+ * The first candidate is always built. Every other one is only started if the deadline has not passed, so a slow
+ * frame gives fewer candidates rather than a late narrative.
+ */
+class PROCEDURALNARRATIVE_API FPGNCandidateNarrativeBuilder
+{
+public:
+
+	// Above this many non-conclusion events, each event before the conclusion is chosen from a random sample of them.
+	static constexpr int32 MAXIMUM_EVENTS_TRIED_PER_POSITION = 32;
+
+	/*
+	 * Builds one candidate per conclusion event, starting from InitialCast, and returns the index of the best complete
+	 * one in Out_AllCandidates, or INDEX_NONE if none of them could be fully cast and scored. Deadline is in
+	 * FPlatformTime::Seconds, and zero or less means there is none. FindRelationship must be safe to call from any
+	 * thread.
+	 */
+	static int32 BuildCandidates(TArrayView<const FPGNEventId> AllConclusionEventIds,
+		const TArray<FPGNConclusionEvent>& AllConclusionEvents, int32 NumberOfEventsBeforeConclusion, int32 RandomSeed,
+		TArrayView<const FPGNCastingCandidate> AllCastingCandidates, TArrayView<const FPGNCastMember> InitialCast,
+		TFunctionRef<bool(int32, int32, FPGNRelationship&)> FindRelationship, FPGNNarrativeEvaluator& Evaluator,
+		double Deadline, TArray<FPGNCandidateNarrative>& Out_AllCandidates);
+
+	// Builds the narrative for one conclusion event, starting from whoever is already in InOut_Candidate.Cast.
+	static void BuildThisCandidate(FPGNEventId ConclusionEventId, const FPGNConclusionEvent& ConclusionEvent,
+		int32 NumberOfEventsBeforeConclusion, int32 RandomSeed, TArrayView<const FPGNCastingCandidate> AllCastingCandidates,
+		TFunctionRef<bool(int32, int32, FPGNRelationship&)> FindRelationship, FPGNNarrativeEvaluator& Evaluator,
+		FPGNCandidateNarrative& InOut_Candidate);
+
+private:
+
+	// Appends the events that lead up to the conclusion to InOut_Narrative.AllEventIds.
+	static void ChooseEventsBeforeConclusion(FPGNEventId ConclusionEventId, int32 NumberOfEventsBeforeConclusion,
+		FRandomStream& RandomStream, TArrayView<const FPGNCastingCandidate> CastByRole, FPGNNarrativeEvaluator& Evaluator,
+		FPGNGeneratedNarrative& InOut_Narrative);
+};
@@ -0,0 +1,496 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/Generation/PGNCastingSolver.h"
+
+#include "Async/ParallelFor.h"
+#include "ProceduralNarrative/Generation/PGNScratchMemory.h"
+#include "ProceduralNarrative/Text/PGNNarrativeTextRealiser.h"
+
+namespace PGNCasting
+{
+	// How two characters have to be related for an action to make sense between them.
+	enum class ERelationshipRequirement : uint8
+	{
+		None,
+		// Anyone else is forbidden.
+		Spouses,
+		OppositeGenders,
+		// Related characters are preferred, the closer the better.
+		Close,
+		Enemies
+	};
+
+	// Who an action suits. A morality below zero means the action does not care.
+	struct FActionProfile
+	{
+		float SubjectMorality;
+		bool bHasSubjectDesire;
+		EPGNCharacterDesire SubjectDesire;
+		float ObjectMorality;
+		ERelationshipRequirement RelationshipRequirement;
+	};
+
+	// Indexed by EPGNEventAction.
+	static const FActionProfile ALL_ACTION_PROFILES[] =
+	{
+		/* ACTION_NONE */							{ -1.f,  false, EPGNCharacterDesire::RAISE_A_FAMILY,		-1.f,  ERelationshipRequirement::None },
+		/* KILLED_IN_HIT_AND_RUN */					{ -1.f,  false, EPGNCharacterDesire::RAISE_A_FAMILY,		0.15f, ERelationshipRequirement::None },
+		/* DEPARTS_THE_TOWN */						{ -1.f,  true,  EPGNCharacterDesire::ACHIEVE_FAME,			-1.f,  ERelationshipRequirement::Close },
+		/* DIVORCES_AND_ENDS_MARRIAGE_WITH */		{ -1.f,  true,  EPGNCharacterDesire::FIND_LOVE,			-1.f,  ERelationshipRequirement::Spouses },
+		/* SENTENCED_TO_PRISON */					{ 0.1f,  false, EPGNCharacterDesire::RAISE_A_FAMILY,		-1.f,  ERelationshipRequirement::None },
+		/* PROMISES_TO_BE_BETTER */					{ 0.6f,  false, EPGNCharacterDesire::RAISE_A_FAMILY,		-1.f,  ERelationshipRequirement::Close },
+		/* BECOMES_A_DRUNK */						{ 0.3f,  false, EPGNCharacterDesire::RAISE_A_FAMILY,		-1.f,  ERelationshipRequirement::None },
+		/* LOSES_JOB */								{ -1.f,  true,  EPGNCharacterDesire::ACHIEVE_WEALTH,		-1.f,  ERelationshipRequirement::None },
+		/* CAUGHT_ROBBING */						{ 0.1f,  true,  EPGNCharacterDesire::COLLECT_POSSESSIONS,	-1.f,  ERelationshipRequirement::None },
+		/* WINS_LAWSUIT_AGAINST */					{ -1.f,  true,  EPGNCharacterDesire::ACHIEVE_WEALTH,		-1.f,  ERelationshipRequirement::Enemies },
+		/* REVEALED_PREGNANT_WITH_CHILD_OF */		{ -1.f,  true,  EPGNCharacterDesire::RAISE_A_FAMILY,		-1.f,  ERelationshipRequirement::OppositeGenders },
+	};
+
+	static_assert(UE_ARRAY_COUNT(ALL_ACTION_PROFILES) == FPGNNarrativeTextRealiser::NUMBER_OF_ACTIONS, "ALL_ACTION_PROFILES is out of date.");
+
+	static const FActionProfile& GetActionProfile(EPGNEventAction Action)
+	{
+		const int32 IndexOfAction = static_cast<int32>(Action);
+		return ALL_ACTION_PROFILES[IndexOfAction < static_cast<int32>(UE_ARRAY_COUNT(ALL_ACTION_PROFILES)) ? IndexOfAction : 0];
+	}
+
+	static constexpr float DESIRE_MISMATCH_COST = 0.5f;
+	static constexpr float UNRELATED_COST = 0.5f;
+}
+
+#pragma region Costs
+
+float FPGNCastingSolver::GetValenceOfAttitude(EPGNCharacterAttitude Attitude)
+{
+	switch (Attitude)
+	{
+	case EPGNCharacterAttitude::JOYFUL:
+	case EPGNCharacterAttitude::AMAZED:
+	case EPGNCharacterAttitude::BOLD:
+	case EPGNCharacterAttitude::COMFORTABLE:
+	case EPGNCharacterAttitude::OPTIMISTIC:
+	case EPGNCharacterAttitude::PROUD:
+	case EPGNCharacterAttitude::CURIOUS:
+	case EPGNCharacterAttitude::SENTIMENTAL:
+		return 1.f;
+	case EPGNCharacterAttitude::DEPRESSED:
+	case EPGNCharacterAttitude::AGGRAVATED:
+	case EPGNCharacterAttitude::PESSIMISTIC:
+	case EPGNCharacterAttitude::TENSE:
+	case EPGNCharacterAttitude::ANXIOUS:
+	case EPGNCharacterAttitude::TIRED:
+	case EPGNCharacterAttitude::DISTURBED:
+	case EPGNCharacterAttitude::SHY:
+		return -1.f;
+	default:
+		return 0.f;
+	}
+}
+
+float FPGNCastingSolver::CalculateTemplateFitCost(EPGNEventAction Action, bool bIsSubject,
+	const FPGNCharacterTemplate& Template)
+{
+	const PGNCasting::FActionProfile& ActionProfile = PGNCasting::GetActionProfile(Action);
+	const float IdealMorality = bIsSubject ? ActionProfile.SubjectMorality : ActionProfile.ObjectMorality;
+
+	float Cost = 0.f;
+
+	if (IdealMorality >= 0.f)
+	{
+		Cost += FMath::Abs(Template.TendencyTowardsMoralDecisions - IdealMorality);
+	}
+
+	// The more a character pursues their greatest desire, the less they fit an action it would not drive them to.
+	if (bIsSubject && ActionProfile.bHasSubjectDesire && Template.CharacterGreatestDesire != ActionProfile.SubjectDesire)
+	{
+		Cost += PGNCasting::DESIRE_MISMATCH_COST * Template.TendencyToPursueGreatestDesire;
+	}
+
+	return Cost;
+}
+
+float FPGNCastingSolver::CalculateAttitudeCost(EPGNCharacterAttitude InitialAttitudeOfRole,
+	EPGNCharacterAttitude CurrentAttitude, const FPGNCharacterTemplate& Template)
+{
+	if (InitialAttitudeOfRole == EPGNCharacterAttitude::ATTITUDE_NONE || InitialAttitudeOfRole == CurrentAttitude)
+	{
+		return 0.f;
+	}
+
+	// Moral characters lean towards positive attitudes, and the rest towards negative ones.
+	const float ValenceOfCharacter = CurrentAttitude != EPGNCharacterAttitude::ATTITUDE_NONE
+		? GetValenceOfAttitude(CurrentAttitude) : Template.TendencyTowardsMoralDecisions * 2.f - 1.f;
+
+	return FMath::Abs(GetValenceOfAttitude(InitialAttitudeOfRole) - ValenceOfCharacter) * 0.5f;
+}
+
+float FPGNCastingSolver::CalculateRelationshipCost(EPGNEventAction Action, const FPGNCastingCandidate& Subject,
+	const FPGNCastingCandidate& Object, const FPGNRelationship& Relationship)
+{
+	switch (PGNCasting::GetActionProfile(Action).RelationshipRequirement)
+	{
+	case PGNCasting::ERelationshipRequirement::Spouses:
+		return Relationship.bAreSpouses ? 0.f : FORBIDDEN_COST;
+
+	case PGNCasting::ERelationshipRequirement::OppositeGenders:
+		return Subject.bIsMale != Object.bIsMale ? 0.f : FORBIDDEN_COST;
+
+	case PGNCasting::ERelationshipRequirement::Close:
+		if (Relationship.bAreSpouses)
+		{
+			return 0.f;
+		}
+
+		return Relationship.bHasSocialRelationship
+			? FMath::Min(Relationship.DistanceBetweenCharacters / 10.f, PGNCasting::UNRELATED_COST)
+			: PGNCasting::UNRELATED_COST;
+
+	case PGNCasting::ERelationshipRequirement::Enemies:
+		return Relationship.bHasSocialRelationship
+			&& Relationship.SocialRelationship == EPGNCharacterSocialRelationship::ENEMIES ? 0.f : PGNCasting::UNRELATED_COST;
+
+	default:
+		return 0.f;
+	}
+}
+
+float FPGNCastingSolver::CalculateCostOfRole(const FRole& Role, const FPGNCastingCandidate& Candidate,
+	const TArray<FPGNCastMember>& Cast, TFunctionRef<bool(int32, int32, FPGNRelationship&)> FindRelationship)
+{
+	float Cost = 0.f;
+
+	EPGNCharacterAttitude AttitudeOfCandidate = Candidate.CurrentAttitude;
+
+	for (const FRoleAppearance& ThisAppearance : Role.AllAppearances)
+	{
+		const FPGNEvent& ThisEvent = *ThisAppearance.Event;
+
+		if (!FPGNCharacterTimeline::CanTakePartInAction(ThisEvent.Action, ThisAppearance.bIsSubject, Candidate.StateFlags))
+		{
+			return FORBIDDEN_COST;
+		}
+
+		Cost += CalculateTemplateFitCost(ThisEvent.Action, ThisAppearance.bIsSubject, Candidate.Template);
+		Cost += CalculateAttitudeCost(ThisAppearance.bIsSubject ? ThisEvent.SubjectInitialAttitude
+			: ThisEvent.ObjectInitialAttitude, AttitudeOfCandidate, Candidate.Template);
+
+		// The next event the role is in picks up from where this one leaves them.
+		AttitudeOfCandidate = ThisAppearance.bIsSubject ? ThisEvent.SubjectFinalAttitude : ThisEvent.ObjectFinalAttitude;
+
+		// The relationship only counts once the other role of the event has someone in it.
+		const FPGNCastMember* OtherCastMember = Cast.FindByPredicate([&ThisAppearance](const FPGNCastMember& ThisCastMember)
+		{
+			return ThisCastMember.Tag == ThisAppearance.OtherTag;
+		});
+
+		if (OtherCastMember != nullptr)
+		{
+			FPGNRelationship Relationship;
+			FindRelationship(Candidate.IndexOfCharacter, OtherCastMember->Character.IndexOfCharacter, Relationship);
+
+			Cost += ThisAppearance.bIsSubject
+				? CalculateRelationshipCost(ThisEvent.Action, Candidate, OtherCastMember->Character, Relationship)
+				: CalculateRelationshipCost(ThisEvent.Action, OtherCastMember->Character, Candidate, Relationship);
+		}
+	}
+
+	return FMath::Min(Cost, FORBIDDEN_COST);
+}
+
+#pragma endregion Costs
+
+bool FPGNCastingSolver::CastEvents(TArrayView<const FPGNEvent* const> AllEvents,
+	TArrayView<const FPGNCastingCandidate> AllCandidates, TFunctionRef<bool(int32, int32, FPGNRelationship&)> FindRelationship,
+	TArray<FPGNCastMember>& InOut_Cast)
+{
+	const auto IsTagInCast = [&InOut_Cast](EPGNCharacterTag Tag)
+	{
+		return InOut_Cast.ContainsByPredicate([Tag](const FPGNCastMember& ThisCastMember)
+		{
+			return ThisCastMember.Tag == Tag;
+		});
+	};
+
+	// First gather every role that still has to be cast, along with every event it is in.
+	TArray<FRole> AllRolesToCast;
+
+	const auto AddAppearance = [&](EPGNCharacterTag Tag, const FPGNEvent* Event, bool bIsSubject, EPGNCharacterTag OtherTag)
+	{
+		if (Tag == EPGNCharacterTag::TAG_NONE || IsTagInCast(Tag))
+		{
+			return;
+		}
+
+		FRole* ThisRole = AllRolesToCast.FindByPredicate([Tag](const FRole& Role) { return Role.Tag == Tag; });
+
+		if (ThisRole == nullptr)
+		{
+			ThisRole = &AllRolesToCast.AddDefaulted_GetRef();
+			ThisRole->Tag = Tag;
+		}
+
+		FRoleAppearance& NewAppearance = ThisRole->AllAppearances.AddDefaulted_GetRef();
+		NewAppearance.Event = Event;
+		NewAppearance.bIsSubject = bIsSubject;
+		NewAppearance.OtherTag = OtherTag;
+	};
+
+	for (const FPGNEvent* ThisEvent : AllEvents)
+	{
+		const EPGNCharacterTag ObjectTag = ThisEvent->bDoesEventHaveObject ? ThisEvent->Object : EPGNCharacterTag::TAG_NONE;
+
+		AddAppearance(ThisEvent->Subject, ThisEvent, true, ObjectTag);
+		AddAppearance(ObjectTag, ThisEvent, false, ThisEvent->Subject);
+	}
+
+	// The protagonist goes first, then whoever is in the most events, since they shape the cast the most.
+	AllRolesToCast.Sort([](const FRole& A, const FRole& B)
+	{
+		if ((A.Tag == EPGNCharacterTag::TAG_PROTAGONIST) != (B.Tag == EPGNCharacterTag::TAG_PROTAGONIST))
+		{
+			return A.Tag == EPGNCharacterTag::TAG_PROTAGONIST;
+		}
+
+		return A.AllAppearances.Num() != B.AllAppearances.Num() ? A.AllAppearances.Num() > B.AllAppearances.Num()
+			: A.Tag < B.Tag;
+	});
+
+	bool bWasEveryRoleCast = true;
+
+	TArray<int32> AllIndicesOfAvailableCandidates;
+	TArray<float> CostMatrix;
+	TArray<int32> ColumnOfEachRole;
+
+	while (AllRolesToCast.Num() > 0)
+	{
+		// Nobody can play two roles.
+		AllIndicesOfAvailableCandidates.Reset();
+
+		for (int32 Index_Candidate = 0; Index_Candidate < AllCandidates.Num(); Index_Candidate++)
+		{
+			const int32 IndexOfCharacter = AllCandidates[Index_Candidate].IndexOfCharacter;
+
+			if (!InOut_Cast.ContainsByPredicate([IndexOfCharacter](const FPGNCastMember& ThisCastMember)
+			{
+				return ThisCastMember.Character.IndexOfCharacter == IndexOfCharacter;
+			}))
+			{
+				AllIndicesOfAvailableCandidates.Add(Index_Candidate);
+			}
+		}
+
+		const int32 NumberOfRows = AllRolesToCast.Num();
+		const int32 NumberOfColumns = AllIndicesOfAvailableCandidates.Num();
+
+		CostMatrix.SetNumUninitialized(NumberOfRows * NumberOfColumns);
+
+		// Every cell only reads the roles, the candidates and the cast, so the columns can be filled on any thread.
+		ParallelFor(NumberOfColumns, [&](int32 Index_Column)
+		{
+			const FPGNCastingCandidate& ThisCandidate = AllCandidates[AllIndicesOfAvailableCandidates[Index_Column]];
+
+			for (int32 Index_Row = 0; Index_Row < NumberOfRows; Index_Row++)
+			{
+				CostMatrix[Index_Row * NumberOfColumns + Index_Column] = CalculateCostOfRole(AllRolesToCast[Index_Row],
+					ThisCandidate, InOut_Cast, FindRelationship);
+			}
+		}, CostMatrix.Num() < MINIMUM_CELLS_FOR_PARALLEL_FILL);
+
+		if (CostMatrix.Num() <= MAXIMUM_CELLS_FOR_OPTIMAL_ASSIGNMENT)
+		{
+			SolveAssignmentOptimally(CostMatrix, NumberOfRows, NumberOfColumns, ColumnOfEachRole);
+		}
+		else
+		{
+			SolveAssignmentGreedily(CostMatrix, NumberOfRows, NumberOfColumns, ColumnOfEachRole);
+		}
+
+		// If the first role shares an event with another uncast role, the other role's costs did not know who would
+		// play the first one yet, so we only keep the first and solve the rest again.
+		const FRole& FirstRole = AllRolesToCast[0];
+		const bool bIsFirstRoleLinkedToOtherRoles = AllRolesToCast.ContainsByPredicate([&FirstRole](const FRole& ThisRole)
+		{
+			return ThisRole.AllAppearances.ContainsByPredicate([&FirstRole](const FRoleAppearance& ThisAppearance)
+			{
+				return ThisAppearance.OtherTag == FirstRole.Tag;
+			});
+		});
+
+		const int32 NumberOfRolesToKeep = bIsFirstRoleLinkedToOtherRoles ? 1 : NumberOfRows;
+
+		for (int32 Index_Row = 0; Index_Row < NumberOfRolesToKeep; Index_Row++)
+		{
+			if (ColumnOfEachRole[Index_Row] == INDEX_NONE)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("Nobody could be cast as %s."), *UEnum::GetValueAsString(AllRolesToCast[Index_Row].Tag));
+				bWasEveryRoleCast = false;
+				continue;
+			}
+
+			FPGNCastMember& NewCastMember = InOut_Cast.AddDefaulted_GetRef();
+			NewCastMember.Tag = AllRolesToCast[Index_Row].Tag;
+			NewCastMember.Character = AllCandidates[AllIndicesOfAvailableCandidates[ColumnOfEachRole[Index_Row]]];
+			NewCastMember.CurrentAttitude = NewCastMember.Character.CurrentAttitude;
+		}
+
+		AllRolesToCast.RemoveAt(0, NumberOfRolesToKeep);
+	}
+
+	return bWasEveryRoleCast;
+}
+
+float FPGNCastingSolver::SolveAssignmentOptimally(TArrayView<const float> CostMatrix, int32 NumberOfRows,
+	int32 NumberOfColumns, TArray<int32>& Out_ColumnOfEachRow)
+{
+	Out_ColumnOfEachRow.Init(INDEX_NONE, NumberOfRows);
+
+	if (NumberOfRows == 0 || NumberOfColumns == 0)
+	{
+		return 0.f;
+	}
+
+	// The algorithm needs at least as many columns as rows, so any missing columns are forbidden to everyone.
+	const int32 NumberOfSolvedColumns = FMath::Max(NumberOfColumns, NumberOfRows);
+
+	const auto GetCost = [&](int32 Index_Row, int32 Index_Column)
+	{
+		return Index_Column < NumberOfColumns ? static_cast<double>(CostMatrix[Index_Row * NumberOfColumns + Index_Column])
+			: static_cast<double>(FORBIDDEN_COST);
+	};
+
+	FPGNGenerationScratchScope ScratchScope;
+
+	// The Hungarian algorithm with row and column potentials, in O(rows^2 * columns). Everything is indexed from one,
+	// with column zero standing for "not assigned yet".
+	TPGNScratchArray<double> RowPotentials;
+	TPGNScratchArray<double> ColumnPotentials;
+	TPGNScratchArray<double> MinimumSlackOfColumns;
+	TPGNScratchArray<int32> RowOfColumn;
+	TPGNScratchArray<int32> PreviousColumnOnPath;
+	TPGNScratchArray<bool> bIsColumnUsed;
+
+	RowPotentials.SetNumZeroed(NumberOfRows + 1);
+	ColumnPotentials.SetNumZeroed(NumberOfSolvedColumns + 1);
+	MinimumSlackOfColumns.SetNumUninitialized(NumberOfSolvedColumns + 1);
+	RowOfColumn.SetNumZeroed(NumberOfSolvedColumns + 1);
+	PreviousColumnOnPath.SetNumZeroed(NumberOfSolvedColumns + 1);
+	bIsColumnUsed.SetNumUninitialized(NumberOfSolvedColumns + 1);
+
+	for (int32 Index_Row = 1; Index_Row <= NumberOfRows; Index_Row++)
+	{
+		RowOfColumn[0] = Index_Row;
+		int32 CurrentColumn = 0;
+
+		for (int32 Index_Column = 0; Index_Column <= NumberOfSolvedColumns; Index_Column++)
+		{
+			MinimumSlackOfColumns[Index_Column] = MAX_dbl;
+			bIsColumnUsed[Index_Column] = false;
+		}
+
+		// Grow a tree of tight edges from the new row until it reaches a free column.
+		do
+		{
+			bIsColumnUsed[CurrentColumn] = true;
+
+			const int32 CurrentRow = RowOfColumn[CurrentColumn];
+			double SmallestSlack = MAX_dbl;
+			int32 NextColumn = 0;
+
+			for (int32 Index_Column = 1; Index_Column <= NumberOfSolvedColumns; Index_Column++)
+			{
+				if (bIsColumnUsed[Index_Column])
+				{
+					continue;
+				}
+
+				const double Slack = GetCost(CurrentRow - 1, Index_Column - 1) - RowPotentials[CurrentRow]
+					- ColumnPotentials[Index_Column];
+
+				if (Slack < MinimumSlackOfColumns[Index_Column])
+				{
+					MinimumSlackOfColumns[Index_Column] = Slack;
+					PreviousColumnOnPath[Index_Column] = CurrentColumn;
+				}
+
+				if (MinimumSlackOfColumns[Index_Column] < SmallestSlack)
+				{
+					SmallestSlack = MinimumSlackOfColumns[Index_Column];
+					NextColumn = Index_Column;
+				}
+			}
+
+			for (int32 Index_Column = 0; Index_Column <= NumberOfSolvedColumns; Index_Column++)
+			{
+				if (bIsColumnUsed[Index_Column])
+				{
+					RowPotentials[RowOfColumn[Index_Column]] += SmallestSlack;
+					ColumnPotentials[Index_Column] -= SmallestSlack;
+				}
+				else
+				{
+					MinimumSlackOfColumns[Index_Column] -= SmallestSlack;
+				}
+			}
+
+			CurrentColumn = NextColumn;
+		}
+		while (RowOfColumn[CurrentColumn] != 0);
+
+		// Then flip the assignments along the path back to the root.
+		do
+		{
+			const int32 PreviousColumn = PreviousColumnOnPath[CurrentColumn];
+			RowOfColumn[CurrentColumn] = RowOfColumn[PreviousColumn];
+			CurrentColumn = PreviousColumn;
+		}
+		while (CurrentColumn != 0);
+	}
+
+	float TotalCost = 0.f;
+
+	for (int32 Index_Column = 1; Index_Column <= NumberOfColumns; Index_Column++)
+	{
+		const int32 Index_Row = RowOfColumn[Index_Column] - 1;
+
+		if (Index_Row >= 0 && CostMatrix[Index_Row * NumberOfColumns + Index_Column - 1] < FORBIDDEN_COST)
+		{
+			Out_ColumnOfEachRow[Index_Row] = Index_Column - 1;
+			TotalCost += CostMatrix[Index_Row * NumberOfColumns + Index_Column - 1];
+		}
+	}
+
+	return TotalCost;
+}
+
+float FPGNCastingSolver::SolveAssignmentGreedily(TArrayView<const float> CostMatrix, int32 NumberOfRows,
+	int32 NumberOfColumns, TArray<int32>& Out_ColumnOfEachRow)
+{
+	Out_ColumnOfEachRow.Init(INDEX_NONE, NumberOfRows);
+
+	TBitArray<> bIsColumnTaken(false, NumberOfColumns);
+	float TotalCost = 0.f;
+
+	for (int32 Index_Row = 0; Index_Row < NumberOfRows; Index_Row++)
+	{
+		const float* RowOfCosts = &CostMatrix[Index_Row * NumberOfColumns];
+		float LowestCost = FORBIDDEN_COST;
+
+		for (int32 Index_Column = 0; Index_Column < NumberOfColumns; Index_Column++)
+		{
+			if (!bIsColumnTaken[Index_Column] && RowOfCosts[Index_Column] < LowestCost)
+			{
+				LowestCost = RowOfCosts[Index_Column];
+				Out_ColumnOfEachRow[Index_Row] = Index_Column;
+			}
+		}
+
+		if (Out_ColumnOfEachRow[Index_Row] != INDEX_NONE)
+		{
+			bIsColumnTaken[Out_ColumnOfEachRow[Index_Row]] = true;
+			TotalCost += LowestCost;
+		}
+	}
+
+	return TotalCost;
+}
@@ -0,0 +1,123 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralNarrative/PGNUtilities.h"
+#include "ProceduralNarrative/History/PGNCharacterTimeline.h"
+#include "ProceduralNarrative/Population/PGNRelationshipOracle.h"
+
+// A character who could be cast. Everything the costs need is copied in here, so the cost matrix can be filled on
+// any thread without touching the overseer.
+struct FPGNCastingCandidate
+{
+	int32 IndexOfCharacter = INDEX_NONE;
+	bool bIsMale = true;
+	FPGNCharacterTemplate Template;
+
+	// From the character timeline, so that nobody is cast in a part their past rules out.
+	EPGNCharacterStateFlags StateFlags = EPGNCharacterStateFlags::DEFAULT;
+
+	// The attitude the last event they were in left them with, or ATTITUDE_NONE if they have not been in one.
+	EPGNCharacterAttitude CurrentAttitude = EPGNCharacterAttitude::ATTITUDE_NONE;
+};
+
+// Someone who already has a role in the narrative, and the attitude the last event they were in left them with.
+struct FPGNCastMember
+{
+	EPGNCharacterTag Tag = EPGNCharacterTag::TAG_NONE;
+	FPGNCastingCandidate Character;
+	EPGNCharacterAttitude CurrentAttitude = EPGNCharacterAttitude::ATTITUDE_NONE;
+};
+
+/**
+ * Chooses who plays each role in a narrative.
+ *
+ * A role is a character tag, and the same tag is the same character in every event of the narrative, so casting is
+ * an assignment problem: every role that has not been cast yet is a row of a cost matrix, every candidate is a
+ * column, and the cheapest way to give each role a different character is found with the Hungarian algorithm. Roles
+ * that are already in the cast keep their character.
+ *
+ * The cost of giving a role to a character is the sum, over every event the role is in, of:
+ *
+ *	Template fit	How far the character's TendencyTowardsMoralDecisions is from what the action calls for, and
+ *					whether the action is something their CharacterGreatestDesire would drive them to.
+ *	Attitude		How well the attitude the event starts the role in suits the character's disposition.
+ *	Relationship	Whether the subject and the object of the event are related the way the action needs. Some
+ *					actions, such as a divorce, forbid anyone else outright.
+ *	Coherence		Whether the character's past allows the part at all. Anyone who is dead, gone or in prison, or
+ *					who is not married for a divorce, is forbidden. See FPGNCharacterTimeline.
+ *
+ * Relationships are between two roles, which a single assignment cannot express. When two uncast roles share an
+ * event, only the first of them is kept from each solve, and the matrix for the rest is built again knowing who
+ * plays it. Casts have at most sixteen roles, so this is a handful of very small solves.
+ */
+class PROCEDURALNARRATIVE_API FPGNCastingSolver
+{
+public:
+
+	// A cost that rules the character out of the role altogether.
+	static constexpr float FORBIDDEN_COST = 1.0e6f;
+
+	// Above this many cells, the matrix is solved greedily instead of optimally.
+	static constexpr int32 MAXIMUM_CELLS_FOR_OPTIMAL_ASSIGNMENT = 1 << 18;
+
+	// Below this many cells, filling the matrix on other threads costs more than it saves.
+	static constexpr int32 MINIMUM_CELLS_FOR_PARALLEL_FILL = 1 << 12;
+
+	// Where a role is in FPGNGeneratedNarrative::AllIndicesOfCharactersInUse, or INDEX_NONE for TAG_NONE.
+	static int32 GetIndexInCast(EPGNCharacterTag Tag) { return static_cast<int32>(Tag) - 1; }
+
+	/*
+	 * Casts every role in these events that is not in InOut_Cast yet, and adds them to it. FindRelationship must be
+	 * safe to call from any thread. Returns false if some role could not be given to anyone.
+	 */
+	static bool CastEvents(TArrayView<const FPGNEvent* const> AllEvents, TArrayView<const FPGNCastingCandidate> AllCandidates,
+		TFunctionRef<bool(int32, int32, FPGNRelationship&)> FindRelationship, TArray<FPGNCastMember>& InOut_Cast);
+
+	/*
+	 * Gives every row a different column for the lowest total cost, and returns that cost. CostMatrix is row-major.
+	 * Rows that can only be given a forbidden column are left as INDEX_NONE.
+	 */
+	static float SolveAssignmentOptimally(TArrayView<const float> CostMatrix, int32 NumberOfRows, int32 NumberOfColumns,
+		TArray<int32>& Out_ColumnOfEachRow);
+
+	// The same, taking the cheapest free column for each row in turn.
+	static float SolveAssignmentGreedily(TArrayView<const float> CostMatrix, int32 NumberOfRows, int32 NumberOfColumns,
+		TArray<int32>& Out_ColumnOfEachRow);
+
+#pragma region Costs
+
+	// 1 for a positive attitude, -1 for a negative one and 0 for ATTITUDE_NONE.
+	static float GetValenceOfAttitude(EPGNCharacterAttitude Attitude);
+
+	static float CalculateTemplateFitCost(EPGNEventAction Action, bool bIsSubject, const FPGNCharacterTemplate& Template);
+
+	// Characters who have never been in an event have no attitude, so they are judged by their disposition instead.
+	static float CalculateAttitudeCost(EPGNCharacterAttitude InitialAttitudeOfRole, EPGNCharacterAttitude CurrentAttitude,
+		const FPGNCharacterTemplate& Template);
+
+	static float CalculateRelationshipCost(EPGNEventAction Action, const FPGNCastingCandidate& Subject,
+		const FPGNCastingCandidate& Object, const FPGNRelationship& Relationship);
+
+#pragma endregion Costs
+
+private:
+
+	// One event that a role is in, and who plays the other role of that event if they are already cast.
+	struct FRoleAppearance
+	{
+		const FPGNEvent* Event = nullptr;
+		bool bIsSubject = true;
+		EPGNCharacterTag OtherTag = EPGNCharacterTag::TAG_NONE;
+	};
+
+	struct FRole
+	{
+		EPGNCharacterTag Tag = EPGNCharacterTag::TAG_NONE;
+		TArray<FRoleAppearance> AllAppearances;
+	};
+
+	static float CalculateCostOfRole(const FRole& Role, const FPGNCastingCandidate& Candidate,
+		const TArray<FPGNCastMember>& Cast, TFunctionRef<bool(int32, int32, FPGNRelationship&)> FindRelationship);
+};
@@ -0,0 +1,389 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/Generation/PGNNarrativeEvaluator.h"
+
+#include "ProceduralNarrative/Graphs/MoodGraph.h"
+#include "ProceduralNarrative/PGNHash.h"
+#include "ProceduralNarrative/Text/PGNNarrativeTextRealiser.h"
+
+namespace PGNNarrativeEvaluation
+{
+	uint64 HashNextEvent(uint64 HashOfPrefix, FPGNEventId EventId)
+	{
+		return MixBits(HashOfPrefix ^ (static_cast<uint64>(static_cast<uint32>(EventId)) + 0x9E3779B97F4A7C15ull));
+	}
+
+	// How much each action raises the stakes, indexed by EPGNEventAction.
+	static const float ALL_ACTION_TENSIONS[] =
+	{
+		/* ACTION_NONE */							0.f,
+		/* KILLED_IN_HIT_AND_RUN */					1.f,
+		/* DEPARTS_THE_TOWN */						0.4f,
+		/* DIVORCES_AND_ENDS_MARRIAGE_WITH */		0.7f,
+		/* SENTENCED_TO_PRISON */					0.8f,
+		/* PROMISES_TO_BE_BETTER */					0.2f,
+		/* BECOMES_A_DRUNK */						0.5f,
+		/* LOSES_JOB */								0.5f,
+		/* CAUGHT_ROBBING */						0.7f,
+		/* WINS_LAWSUIT_AGAINST */					0.6f,
+		/* REVEALED_PREGNANT_WITH_CHILD_OF */		0.6f,
+	};
+
+	static_assert(UE_ARRAY_COUNT(ALL_ACTION_TENSIONS) == FPGNNarrativeTextRealiser::NUMBER_OF_ACTIONS, "ALL_ACTION_TENSIONS is out of date.");
+
+	// Two neighbouring events that do not share anyone are neither coherent nor incoherent.
+	static constexpr float COHERENCE_WITHOUT_SHARED_CHARACTERS = 0.5f;
+}
+
+FPGNNarrativeEvaluator::FPGNNarrativeEvaluator(FPGNEventLibraryPtr InEventLibrary, const TArray<int>& InMoodDistanceTable,
+	float InDesiredFinalDramaticTension, TFunction<bool(int32, int32, FPGNRelationship&)> InFindRelationship,
+	int32 MaximumNumberOfCachedEntries)
+	: EventLibrary(MoveTemp(InEventLibrary))
+	, MoodDistanceTable(InMoodDistanceTable)
+	, DesiredFinalDramaticTension(InDesiredFinalDramaticTension)
+	, FindRelationship(MoveTemp(InFindRelationship))
+	, CachedPrefixes(MaximumNumberOfCachedEntries)
+	, CachedCastFits(MaximumNumberOfCachedEntries)
+{
+}
+
+bool FPGNNarrativeEvaluator::Evaluate(TArrayView<const FPGNEventId> AllEventIds,
+	TArrayView<const FPGNCastingCandidate> Cast, FPGNNarrativeFitness& Out_Fitness)
+{
+	if (!AreAllEventIdsValid(AllEventIds))
+	{
+		return false;
+	}
+
+	const int32 NumberOfEvents = AllEventIds.Num();
+
+	// The hash of every prefix is needed to look them up, and they only cost a multiply or two each.
+	TArray<uint64, TInlineAllocator<32>> AllHashesOfPrefixes;
+	AllHashesOfPrefixes.SetNumUninitialized(NumberOfEvents + 1);
+	AllHashesOfPrefixes[0] = HashCast(Cast);
+
+	for (int32 Index_Event = 0; Index_Event < NumberOfEvents; Index_Event++)
+	{
+		AllHashesOfPrefixes[Index_Event + 1] = PGNNarrativeEvaluation::HashNextEvent(AllHashesOfPrefixes[Index_Event],
+			AllEventIds[Index_Event]);
+	}
+
+	// We will start from the longest prefix that has been scored before. The whole narrative is always cached, so
+	// scoring it again is a single lookup.
+	FPGNNarrativeFitnessSums Sums;
+
+	if (!CachedPrefixes.Find(AllHashesOfPrefixes[NumberOfEvents], Sums))
+	{
+		for (int32 LengthOfPrefix = (NumberOfEvents - 1) / PREFIX_STRIDE * PREFIX_STRIDE; LengthOfPrefix > 0;
+			LengthOfPrefix -= PREFIX_STRIDE)
+		{
+			if (CachedPrefixes.Find(AllHashesOfPrefixes[LengthOfPrefix], Sums))
+			{
+				break;
+			}
+		}
+
+		for (int32 Index_Event = Sums.NumberOfEvents; Index_Event < NumberOfEvents; Index_Event++)
+		{
+			const FPGNPackedEvent& ThisEvent = EventLibrary->GetEvent(AllEventIds[Index_Event]);
+
+			Sums.SumOfWeightedTension += CalculateTension(ThisEvent) * (Index_Event + 1);
+			Sums.SumOfCastFit += CalculateCastFit(AllEventIds[Index_Event], Cast);
+
+			if (Index_Event > 0)
+			{
+				const FPGNPackedEvent& PreviousEvent = EventLibrary->GetEvent(AllEventIds[Index_Event - 1]);
+
+				Sums.SumOfCoherence += CalculateCoherence(PreviousEvent, ThisEvent);
+				Sums.SumOfMoodFlow += CalculateMoodFlow(PreviousEvent, ThisEvent);
+			}
+
+			Sums.NumberOfEvents = Index_Event + 1;
+
+			if (Sums.NumberOfEvents % PREFIX_STRIDE == 0 || Sums.NumberOfEvents == NumberOfEvents)
+			{
+				CachedPrefixes.Add(AllHashesOfPrefixes[Sums.NumberOfEvents], Sums);
+			}
+		}
+	}
+
+	Out_Fitness = CalculateFitness(Sums);
+	return true;
+}
+
+bool FPGNNarrativeEvaluator::BeginIncrementalEvaluation(TArrayView<const FPGNEventId> AllEventIds,
+	TArrayView<const FPGNCastingCandidate> Cast, FPGNNarrativeEvaluation& Out_Evaluation)
+{
+	if (!AreAllEventIdsValid(AllEventIds))
+	{
+		return false;
+	}
+
+	const int32 NumberOfEvents = AllEventIds.Num();
+	const int32 NumberOfLinks = FMath::Max(NumberOfEvents - 1, 0);
+
+	Out_Evaluation.AllEventIds.Reset();
+	Out_Evaluation.AllEventIds.Append(AllEventIds.GetData(), AllEventIds.Num());
+	Out_Evaluation.Cast.Reset();
+	Out_Evaluation.Cast.Append(Cast.GetData(), Cast.Num());
+	Out_Evaluation.AllTensions.SetNumUninitialized(NumberOfEvents);
+	Out_Evaluation.AllCastFits.SetNumUninitialized(NumberOfEvents);
+	Out_Evaluation.AllCoherences.SetNumUninitialized(NumberOfLinks);
+	Out_Evaluation.AllMoodFlows.SetNumUninitialized(NumberOfLinks);
+	Out_Evaluation.Sums = FPGNNarrativeFitnessSums();
+	Out_Evaluation.Sums.NumberOfEvents = NumberOfEvents;
+
+	for (int32 Index_Event = 0; Index_Event < NumberOfEvents; Index_Event++)
+	{
+		Out_Evaluation.AllTensions[Index_Event] = CalculateTension(EventLibrary->GetEvent(AllEventIds[Index_Event]));
+		Out_Evaluation.AllCastFits[Index_Event] = CalculateCastFit(AllEventIds[Index_Event], Cast);
+
+		Out_Evaluation.Sums.SumOfWeightedTension += Out_Evaluation.AllTensions[Index_Event] * (Index_Event + 1);
+		Out_Evaluation.Sums.SumOfCastFit += Out_Evaluation.AllCastFits[Index_Event];
+	}
+
+	for (int32 Index_Link = 0; Index_Link < NumberOfLinks; Index_Link++)
+	{
+		const FPGNPackedEvent& FromEvent = EventLibrary->GetEvent(AllEventIds[Index_Link]);
+		const FPGNPackedEvent& ToEvent = EventLibrary->GetEvent(AllEventIds[Index_Link + 1]);
+
+		Out_Evaluation.AllCoherences[Index_Link] = CalculateCoherence(FromEvent, ToEvent);
+		Out_Evaluation.AllMoodFlows[Index_Link] = CalculateMoodFlow(FromEvent, ToEvent);
+
+		Out_Evaluation.Sums.SumOfCoherence += Out_Evaluation.AllCoherences[Index_Link];
+		Out_Evaluation.Sums.SumOfMoodFlow += Out_Evaluation.AllMoodFlows[Index_Link];
+	}
+
+	Out_Evaluation.Fitness = CalculateFitness(Out_Evaluation.Sums);
+	return true;
+}
+
+bool FPGNNarrativeEvaluator::ReplaceEvent(FPGNNarrativeEvaluation& InOut_Evaluation, int32 IndexOfEvent,
+	FPGNEventId NewEventId)
+{
+	if (!InOut_Evaluation.AllEventIds.IsValidIndex(IndexOfEvent) || !EventLibrary->IsValidEventId(NewEventId))
+	{
+		return false;
+	}
+
+	FPGNNarrativeFitnessSums& Sums = InOut_Evaluation.Sums;
+	InOut_Evaluation.AllEventIds[IndexOfEvent] = NewEventId;
+
+	const FPGNPackedEvent& NewEvent = EventLibrary->GetEvent(NewEventId);
+
+	// Each term is swapped for its new value, so the sums stay what a full rescore would give, up to rounding.
+	const float NewTension = CalculateTension(NewEvent);
+	Sums.SumOfWeightedTension += (NewTension - InOut_Evaluation.AllTensions[IndexOfEvent]) * (IndexOfEvent + 1);
+	InOut_Evaluation.AllTensions[IndexOfEvent] = NewTension;
+
+	const float NewCastFit = CalculateCastFit(NewEventId, InOut_Evaluation.Cast);
+	Sums.SumOfCastFit += NewCastFit - InOut_Evaluation.AllCastFits[IndexOfEvent];
+	InOut_Evaluation.AllCastFits[IndexOfEvent] = NewCastFit;
+
+	// Only the link into this event and the link out of it can have changed.
+	for (int32 Index_Link = IndexOfEvent - 1; Index_Link <= IndexOfEvent; Index_Link++)
+	{
+		if (!InOut_Evaluation.AllCoherences.IsValidIndex(Index_Link))
+		{
+			continue;
+		}
+
+		const FPGNPackedEvent& FromEvent = EventLibrary->GetEvent(InOut_Evaluation.AllEventIds[Index_Link]);
+		const FPGNPackedEvent& ToEvent = EventLibrary->GetEvent(InOut_Evaluation.AllEventIds[Index_Link + 1]);
+
+		const float NewCoherence = CalculateCoherence(FromEvent, ToEvent);
+		Sums.SumOfCoherence += NewCoherence - InOut_Evaluation.AllCoherences[Index_Link];
+		InOut_Evaluation.AllCoherences[Index_Link] = NewCoherence;
+
+		const float NewMoodFlow = CalculateMoodFlow(FromEvent, ToEvent);
+		Sums.SumOfMoodFlow += NewMoodFlow - InOut_Evaluation.AllMoodFlows[Index_Link];
+		InOut_Evaluation.AllMoodFlows[Index_Link] = NewMoodFlow;
+	}
+
+	InOut_Evaluation.Fitness = CalculateFitness(Sums);
+	return true;
+}
+
+FPGNNarrativeFitness FPGNNarrativeEvaluator::CalculateFitness(const FPGNNarrativeFitnessSums& Sums) const
+{
+	FPGNNarrativeFitness Fitness;
+
+	if (Sums.NumberOfEvents == 0)
+	{
+		return Fitness;
+	}
+
+	const float NumberOfLinks = FMath::Max(Sums.NumberOfEvents - 1, 1);
+	const float SumOfTensionWeights = Sums.NumberOfEvents * (Sums.NumberOfEvents + 1) * 0.5f;
+
+	Fitness.Coherence = Sums.SumOfCoherence / NumberOfLinks;
+	Fitness.MoodFlow = Sums.SumOfMoodFlow / NumberOfLinks;
+	Fitness.DramaticTension = -FMath::Abs(Sums.SumOfWeightedTension / SumOfTensionWeights - DesiredFinalDramaticTension);
+	Fitness.CastFit = Sums.SumOfCastFit / Sums.NumberOfEvents;
+
+	Fitness.Total = Fitness.Coherence * WEIGHTING_FOR_COHERENCE + Fitness.MoodFlow * WEIGHTING_FOR_MOOD_FLOW
+		+ Fitness.DramaticTension * WEIGHTING_FOR_DRAMATIC_TENSION + Fitness.CastFit * WEIGHTING_FOR_CAST_FIT;
+
+	return Fitness;
+}
+
+void FPGNNarrativeEvaluator::EmptyCaches()
+{
+	CachedPrefixes.Empty();
+	CachedCastFits.Empty();
+}
+
+bool FPGNNarrativeEvaluator::AreAllEventIdsValid(TArrayView<const FPGNEventId> AllEventIds) const
+{
+	for (const FPGNEventId ThisEventId : AllEventIds)
+	{
+		if (!EventLibrary.IsValid() || !EventLibrary->IsValidEventId(ThisEventId))
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Cannot evaluate a narrative with the event ID %d in it."), ThisEventId);
+			return false;
+		}
+	}
+
+	return true;
+}
+
+uint64 FPGNNarrativeEvaluator::HashCast(TArrayView<const FPGNCastingCandidate> Cast)
+{
+	uint64 Hash = PGNHash::MixBits(static_cast<uint64>(Cast.Num()));
+
+	for (const FPGNCastingCandidate& ThisCastMember : Cast)
+	{
+		Hash = PGNHash::MixBits(Hash ^ static_cast<uint32>(ThisCastMember.IndexOfCharacter));
+	}
+
+	return Hash;
+}
+
+#pragma region Terms
+
+float FPGNNarrativeEvaluator::CalculateTension(const FPGNPackedEvent& ThisEvent) const
+{
+	const int32 IndexOfAction = static_cast<int32>(ThisEvent.GetAction());
+
+	return IndexOfAction < static_cast<int32>(UE_ARRAY_COUNT(PGNNarrativeEvaluation::ALL_ACTION_TENSIONS))
+		? PGNNarrativeEvaluation::ALL_ACTION_TENSIONS[IndexOfAction] : 0.f;
+}
+
+float FPGNNarrativeEvaluator::CalculateCastFit(FPGNEventId EventId, TArrayView<const FPGNCastingCandidate> Cast)
+{
+	const FPGNPackedEvent& ThisEvent = EventLibrary->GetEvent(EventId);
+
+	const auto FindCastMember = [&Cast](EPGNCharacterTag Tag) -> const FPGNCastingCandidate*
+	{
+		const int32 IndexInCast = FPGNCastingSolver::GetIndexInCast(Tag);
+
+		return Cast.IsValidIndex(IndexInCast) && Cast[IndexInCast].IndexOfCharacter != INDEX_NONE ? &Cast[IndexInCast]
+			: nullptr;
+	};
+
+	const FPGNCastingCandidate* Subject = FindCastMember(ThisEvent.GetSubject());
+	const FPGNCastingCandidate* Object = ThisEvent.bDoesEventHaveObject ? FindCastMember(ThisEvent.GetObject()) : nullptr;
+
+	const int32 IndexOfSubject = Subject != nullptr ? Subject->IndexOfCharacter : INDEX_NONE;
+	const int32 IndexOfObject = Object != nullptr ? Object->IndexOfCharacter : INDEX_NONE;
+
+	const uint64 PairOfCastMembers = static_cast<uint64>(static_cast<uint32>(IndexOfSubject)) << 32
+		| static_cast<uint32>(IndexOfObject);
+	// Mixed, so that neighbouring event IDs still land in different shards.
+	const uint64 Key = PGNHash::MixBits(PGNHash::MixBits(PairOfCastMembers) ^ static_cast<uint32>(EventId));
+
+	float CastFit = 0.f;
+
+	if (CachedCastFits.Find(Key, CastFit))
+	{
+		return CastFit;
+	}
+
+	// Roles nobody has been cast in do not count either way.
+	float Cost = 0.f;
+
+	if (Subject != nullptr)
+	{
+		Cost += FPGNCastingSolver::CalculateTemplateFitCost(ThisEvent.GetAction(), true, Subject->Template);
+	}
+
+	if (Object != nullptr)
+	{
+		Cost += FPGNCastingSolver::CalculateTemplateFitCost(ThisEvent.GetAction(), false, Object->Template);
+	}
+
+	if (Subject != nullptr && Object != nullptr)
+	{
+		FPGNRelationship Relationship;
+		FindRelationship(Subject->IndexOfCharacter, Object->IndexOfCharacter, Relationship);
+
+		Cost += FPGNCastingSolver::CalculateRelationshipCost(ThisEvent.GetAction(), *Subject, *Object, Relationship);
+	}
+
+	CastFit = -FMath::Min(Cost, MAXIMUM_CAST_COST_PER_EVENT);
+	CachedCastFits.Add(Key, CastFit);
+
+	return CastFit;
+}
+
+float FPGNNarrativeEvaluator::CalculateCoherence(const FPGNPackedEvent& FromEvent, const FPGNPackedEvent& ToEvent) const
+{
+	float SumOfCoherence = 0.f;
+	int32 NumberOfSharedCharacters = 0;
+
+	const auto AddCharacter = [&](EPGNCharacterTag Tag, EPGNCharacterAttitude FinalAttitude)
+	{
+		EPGNCharacterAttitude InitialAttitude;
+
+		if (Tag == ToEvent.GetSubject())
+		{
+			InitialAttitude = ToEvent.GetSubjectInitialAttitude();
+		}
+		else if (ToEvent.bDoesEventHaveObject && Tag == ToEvent.GetObject())
+		{
+			InitialAttitude = ToEvent.GetObjectInitialAttitude();
+		}
+		else
+		{
+			return;
+		}
+
+		NumberOfSharedCharacters++;
+
+		// The same attitude carries straight on, and a different one of the same kind is half way there.
+		if (InitialAttitude == FinalAttitude)
+		{
+			SumOfCoherence += 1.f;
+		}
+		else if (FPGNCastingSolver::GetValenceOfAttitude(InitialAttitude) * FPGNCastingSolver::GetValenceOfAttitude(FinalAttitude) >= 0.f)
+		{
+			SumOfCoherence += 0.5f;
+		}
+	};
+
+	if (FromEvent.GetSubject() != EPGNCharacterTag::TAG_NONE)
+	{
+		AddCharacter(FromEvent.GetSubject(), FromEvent.GetSubjectFinalAttitude());
+	}
+
+	if (FromEvent.bDoesEventHaveObject && FromEvent.GetObject() != EPGNCharacterTag::TAG_NONE)
+	{
+		AddCharacter(FromEvent.GetObject(), FromEvent.GetObjectFinalAttitude());
+	}
+
+	return NumberOfSharedCharacters > 0 ? SumOfCoherence / NumberOfSharedCharacters
+		: PGNNarrativeEvaluation::COHERENCE_WITHOUT_SHARED_CHARACTERS;
+}
+
+float FPGNNarrativeEvaluator::CalculateMoodFlow(const FPGNPackedEvent& FromEvent, const FPGNPackedEvent& ToEvent) const
+{
+	const int IndexInDistanceTable = UMoodGraph::GetIndexInDistanceTable(FromEvent.GetMood(), ToEvent.GetMood());
+
+	const int Distance = MoodDistanceTable.IsValidIndex(IndexInDistanceTable) ? MoodDistanceTable[IndexInDistanceTable]
+		: MAXIMUM_MOOD_DISTANCE_PER_LINK;
+
+	return -static_cast<float>(FMath::Min(Distance, MAXIMUM_MOOD_DISTANCE_PER_LINK));
+}
+
+#pragma endregion Terms
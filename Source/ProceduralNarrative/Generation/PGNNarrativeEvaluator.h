@@ -0,0 +1,248 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/LruCache.h"
+#include "HAL/CriticalSection.h"
+#include "ProceduralNarrative/Events/PGNEventLibrary.h"
+#include "ProceduralNarrative/Generation/PGNCastingSolver.h"
+#include "ProceduralNarrative/Memory/PGNMemoryTracking.h"
+
+// How good a narrative is. Every part is higher for a better narrative, and Total is their weighted sum.
+struct FPGNNarrativeFitness
+{
+	// How well each event picks up the attitudes its characters were left in by the event before it.
+	float Coherence = 0.f;
+
+	// How gently the mood moves from one event to the next through the mood graph.
+	float MoodFlow = 0.f;
+
+	// How close the tension the narrative builds up to is to DesiredFinalDramaticTension.
+	float DramaticTension = 0.f;
+
+	// How well the cast suits the events they are in.
+	float CastFit = 0.f;
+
+	float Total = 0.f;
+};
+
+// The running sums that a fitness is worked out from. Every term belongs either to one event or to the link between
+// an event and the one after it, which is what makes prefixes cacheable and single changes cheap to rescore.
+struct FPGNNarrativeFitnessSums
+{
+	int32 NumberOfEvents = 0;
+
+	float SumOfCoherence = 0.f;
+	float SumOfMoodFlow = 0.f;
+	float SumOfCastFit = 0.f;
+
+	// Later events count for more, so every tension is weighted by its position plus one.
+	float SumOfWeightedTension = 0.f;
+};
+
+// A narrative that is being searched over, with every one of its terms kept so that swapping an event only rescores
+// that event and its two links.
+struct FPGNNarrativeEvaluation
+{
+	// The events in order, with the conclusion event last.
+	TArray<FPGNEventId> AllEventIds;
+
+	// Indexed by role, like FPGNGeneratedNarrative::AllIndicesOfCharactersInUse.
+	TArray<FPGNCastingCandidate> Cast;
+
+	// One per event.
+	TArray<float> AllTensions;
+	TArray<float> AllCastFits;
+
+	// One per link, where link N is between event N and event N + 1.
+	TArray<float> AllCoherences;
+	TArray<float> AllMoodFlows;
+
+	FPGNNarrativeFitnessSums Sums;
+	FPGNNarrativeFitness Fitness;
+};
+
+/**
+ * A bounded cache that any number of threads can read and fill at once.
+ *
+ * Keys must already be well mixed hashes. They are spread over NUMBER_OF_SHARDS shards by their top bits, and each
+ * shard is its own least recently used cache behind its own lock, so threads rarely wait on each other.
+ */
+template <typename ValueType>
+class TPGNConcurrentMemoCache
+{
+public:
+
+	static constexpr int32 NUMBER_OF_SHARDS = 16;
+
+	explicit TPGNConcurrentMemoCache(int32 MaximumNumberOfEntries)
+	{
+		for (FShard& ThisShard : AllShards)
+		{
+			ThisShard.Entries.Empty(FMath::Max(1, MaximumNumberOfEntries / NUMBER_OF_SHARDS));
+		}
+	}
+
+	TPGNConcurrentMemoCache(const TPGNConcurrentMemoCache&) = delete;
+	TPGNConcurrentMemoCache& operator=(const TPGNConcurrentMemoCache&) = delete;
+
+	bool Find(uint64 Key, ValueType& Out_Value)
+	{
+		FShard& ThisShard = GetShard(Key);
+		FScopeLock Lock(&ThisShard.CriticalSection);
+
+		if (const ValueType* CachedValue = ThisShard.Entries.FindAndTouch(Key))
+		{
+			Out_Value = *CachedValue;
+			return true;
+		}
+
+		return false;
+	}
+
+	void Add(uint64 Key, const ValueType& Value)
+	{
+		FShard& ThisShard = GetShard(Key);
+		FScopeLock Lock(&ThisShard.CriticalSection);
+
+		ThisShard.Entries.Add(Key, Value);
+	}
+
+	void Empty()
+	{
+		for (FShard& ThisShard : AllShards)
+		{
+			FScopeLock Lock(&ThisShard.CriticalSection);
+			ThisShard.Entries.Empty(ThisShard.Entries.Max());
+		}
+	}
+
+	int32 Num() const
+	{
+		int32 NumberOfEntries = 0;
+
+		for (const FShard& ThisShard : AllShards)
+		{
+			FScopeLock Lock(&ThisShard.CriticalSection);
+			NumberOfEntries += ThisShard.Entries.Num();
+		}
+
+		return NumberOfEntries;
+	}
+
+	SIZE_T GetAllocatedSize() const
+	{
+		SIZE_T AllocatedSize = 0;
+
+		for (const FShard& ThisShard : AllShards)
+		{
+			FScopeLock Lock(&ThisShard.CriticalSection);
+			AllocatedSize += FPGNMemoryTracking::GetAllocatedSizeOfLruCache(ThisShard.Entries);
+		}
+
+		return AllocatedSize;
+	}
+
+private:
+
+	struct FShard
+	{
+		mutable FCriticalSection CriticalSection;
+		TLruCache<uint64, ValueType> Entries;
+	};
+
+	FShard& GetShard(uint64 Key) { return AllShards[(Key >> 60) % NUMBER_OF_SHARDS]; }
+
+	FShard AllShards[NUMBER_OF_SHARDS];
+};
+
+/**
+ * Scores narratives for the searches over events and casts.
+ *
+ * Searches score the same partial narratives, and the same events with the same cast, again and again, so both are
+ * remembered:
+ *
+ *	Prefixes	The sums of every PREFIX_STRIDE events of a narrative, keyed on a rolling hash of the cast and the event
+ *				IDs so far. Scoring a narrative starts from the longest prefix of it that has been scored before.
+ *	Cast fits	How well the cast suits each event, keyed on the event and who plays its subject and object. This is
+ *				the only term that needs relationships looked up.
+ *
+ * Searches that change one event at a time should use an FPGNNarrativeEvaluation instead, where swapping an event
+ * only rescores that event and its links to its neighbours.
+ *
+ * Coherence only looks at neighbouring events, so that no term depends on more than two of them. Everything here is
+ * safe to call from any thread, as long as FindRelationship is.
+ */
+class PROCEDURALNARRATIVE_API FPGNNarrativeEvaluator
+{
+public:
+
+	static constexpr int32 PREFIX_STRIDE = 4;
+
+	static constexpr float WEIGHTING_FOR_COHERENCE = 1.f;
+	static constexpr float WEIGHTING_FOR_MOOD_FLOW = 0.25f;
+	static constexpr float WEIGHTING_FOR_DRAMATIC_TENSION = 1.f;
+	static constexpr float WEIGHTING_FOR_CAST_FIT = 0.5f;
+
+	// Neither an impossible cast nor a dead end in the mood graph should outweigh every other term.
+	static constexpr float MAXIMUM_CAST_COST_PER_EVENT = 4.f;
+	static constexpr int MAXIMUM_MOOD_DISTANCE_PER_LINK = 8;
+
+	FPGNNarrativeEvaluator(FPGNEventLibraryPtr InEventLibrary, const TArray<int>& InMoodDistanceTable,
+		float InDesiredFinalDramaticTension, TFunction<bool(int32, int32, FPGNRelationship&)> InFindRelationship,
+		int32 MaximumNumberOfCachedEntries);
+
+	FPGNNarrativeEvaluator(const FPGNNarrativeEvaluator&) = delete;
+	FPGNNarrativeEvaluator& operator=(const FPGNNarrativeEvaluator&) = delete;
+
+	/*
+	 * Scores the events in order, with the conclusion event last, played by this cast. Cast is indexed by role, like
+	 * FPGNGeneratedNarrative::AllIndicesOfCharactersInUse. Returns false if any of the event IDs is not valid.
+	 */
+	bool Evaluate(TArrayView<const FPGNEventId> AllEventIds, TArrayView<const FPGNCastingCandidate> Cast,
+		FPGNNarrativeFitness& Out_Fitness);
+
+	// Scores a narrative in full and keeps every one of its terms for ReplaceEvent.
+	bool BeginIncrementalEvaluation(TArrayView<const FPGNEventId> AllEventIds, TArrayView<const FPGNCastingCandidate> Cast,
+		FPGNNarrativeEvaluation& Out_Evaluation);
+
+	// Swaps one event and rescores only what it touches. Returns false if either index is not valid.
+	bool ReplaceEvent(FPGNNarrativeEvaluation& InOut_Evaluation, int32 IndexOfEvent, FPGNEventId NewEventId);
+
+	FPGNNarrativeFitness CalculateFitness(const FPGNNarrativeFitnessSums& Sums) const;
+
+	// This must be called whenever relationships change, since every cached score depends on them.
+	void EmptyCaches();
+
+	const FPGNEventLibrary& GetEventLibrary() const { return *EventLibrary; }
+
+	int32 GetNumberOfCachedPrefixes() const { return CachedPrefixes.Num(); }
+	int32 GetNumberOfCachedCastFits() const { return CachedCastFits.Num(); }
+
+	// Only what EmptyCaches would give back.
+	SIZE_T GetAllocatedSizeOfCaches() const { return CachedPrefixes.GetAllocatedSize() + CachedCastFits.GetAllocatedSize(); }
+
+private:
+
+	bool AreAllEventIdsValid(TArrayView<const FPGNEventId> AllEventIds) const;
+
+	static uint64 HashCast(TArrayView<const FPGNCastingCandidate> Cast);
+
+#pragma region Terms
+
+	float CalculateTension(const FPGNPackedEvent& ThisEvent) const;
+	float CalculateCastFit(FPGNEventId EventId, TArrayView<const FPGNCastingCandidate> Cast);
+	float CalculateCoherence(const FPGNPackedEvent& FromEvent, const FPGNPackedEvent& ToEvent) const;
+	float CalculateMoodFlow(const FPGNPackedEvent& FromEvent, const FPGNPackedEvent& ToEvent) const;
+
+#pragma endregion Terms
+
+	FPGNEventLibraryPtr EventLibrary;
+	TArray<int> MoodDistanceTable;
+	float DesiredFinalDramaticTension = 0.f;
+	TFunction<bool(int32, int32, FPGNRelationship&)> FindRelationship;
+
+	TPGNConcurrentMemoCache<FPGNNarrativeFitnessSums> CachedPrefixes;
+	TPGNConcurrentMemoCache<float> CachedCastFits;
+};
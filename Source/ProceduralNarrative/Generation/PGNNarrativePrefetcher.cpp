@@ -0,0 +1,317 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/Generation/PGNNarrativePrefetcher.h"
+
+#include "HAL/Event.h"
+#include "HAL/PlatformProcess.h"
+#include "HAL/RunnableThread.h"
+#include "ProceduralNarrative/Generation/PGNScratchMemory.h"
+#include "ProceduralNarrative/Graphs/MoodGraph.h"
+#include "ProceduralNarrative/History/PGNCharacterTimeline.h"
+#include "ProceduralNarrative/Memory/PGNMemoryTracking.h"
+
+int FPGNNarrativeGenerationSnapshot::GetMoodGraphDistance(EPGNMood From, EPGNMood To) const
+{
+	const int IndexInDistanceTable = UMoodGraph::GetIndexInDistanceTable(From, To);
+	return MoodDistanceTable.IsValidIndex(IndexInDistanceTable) ? MoodDistanceTable[IndexInDistanceTable] : MAX_int32;
+}
+
+bool FPGNNarrativeGenerationSnapshot::CanBuildNarratives() const
+{
+	return EventLibrary.IsValid() && WorldData.IsValid() && RelationshipOracle.IsValid()
+		&& EventLibrary->GetNumberOfConclusionEvents() > 0
+		&& AllConclusionEventUsage.Num() == EventLibrary->GetNumberOfConclusionEvents()
+		&& WorldData->AllConclusionEvents.Num() == EventLibrary->GetNumberOfConclusionEvents();
+}
+
+FPGNNarrativePrefetcher::FPGNNarrativePrefetcher(int InNumberOfNarrativesToPrefetch)
+	: NumberOfNarrativesToPrefetch(FMath::Max(InNumberOfNarrativesToPrefetch, 1))
+	// The queue always keeps one slot free, so we need one more than we will ever hold.
+	, ReadyNarratives(NumberOfNarrativesToPrefetch + 1)
+{
+	WakeUpProducerEvent = FPlatformProcess::GetSynchEventFromPool(false);
+}
+
+FPGNNarrativePrefetcher::~FPGNNarrativePrefetcher()
+{
+	StopPrefetching();
+
+	FPlatformProcess::ReturnSynchEventToPool(WakeUpProducerEvent);
+	WakeUpProducerEvent = nullptr;
+}
+
+void FPGNNarrativePrefetcher::StartPrefetching()
+{
+	if (ProducerThread != nullptr)
+	{
+		return;
+	}
+
+	bShouldStopPrefetching = false;
+
+	// Generation should only ever use cores that would otherwise sit idle.
+	ProducerThread = FRunnableThread::Create(this, TEXT("PGNNarrativePrefetcher"), 0, TPri_BelowNormal);
+}
+
+void FPGNNarrativePrefetcher::StopPrefetching()
+{
+	if (ProducerThread == nullptr)
+	{
+		return;
+	}
+
+	// Kill will call Stop and then wait for Run to return.
+	ProducerThread->Kill(true);
+	delete ProducerThread;
+	ProducerThread = nullptr;
+}
+
+void FPGNNarrativePrefetcher::ResetWorldState(FPGNNarrativeGenerationSnapshot&& NewSnapshot)
+{
+	{
+		FScopeLock Lock(&PendingSnapshotLock);
+
+		PendingSnapshot = MakeUnique<FPGNNarrativeGenerationSnapshot>(MoveTemp(NewSnapshot));
+		PendingSnapshotVersion = WorldStateVersion.Increment();
+	}
+
+	// We are the consumer, so we are allowed to drop everything that is queued. Anything the producer is still
+	// building against the old snapshot will be discarded when it is dequeued.
+	ReadyNarratives.Empty();
+
+	WakeUpProducerEvent->Trigger();
+}
+
+bool FPGNNarrativePrefetcher::TryDequeueNarrative(FPGNGeneratedNarrative& Out_Narrative, TArray<FPGNCastMember>& Out_Cast)
+{
+	FPrefetchedNarrative ThisPrefetchedNarrative;
+
+	while (ReadyNarratives.Dequeue(ThisPrefetchedNarrative))
+	{
+		// There is room in the queue again.
+		WakeUpProducerEvent->Trigger();
+
+		if (ThisPrefetchedNarrative.WorldStateVersion != WorldStateVersion.GetValue())
+		{
+			continue;
+		}
+
+		Out_Narrative = MoveTemp(ThisPrefetchedNarrative.Narrative);
+		Out_Cast = MoveTemp(ThisPrefetchedNarrative.Cast);
+		return true;
+	}
+
+	return false;
+}
+
+int FPGNNarrativePrefetcher::GetNumberOfReadyNarratives() const
+{
+	return static_cast<int>(ReadyNarratives.Count());
+}
+
+bool FPGNNarrativePrefetcher::BuildNarrativeFromSnapshot(FPGNNarrativeGenerationSnapshot& Snapshot,
+	FRandomStream& RandomStream, FPGNNarrativeEvaluator& Evaluator, FPGNGeneratedNarrative& Out_Narrative,
+	TArray<FPGNCastMember>& Out_Cast)
+{
+	if (!Snapshot.CanBuildNarratives())
+	{
+		return false;
+	}
+
+	const FPGNEventLibrary& EventLibrary = *Snapshot.EventLibrary;
+	const int NumberOfConclusionEvents = EventLibrary.GetNumberOfConclusionEvents();
+
+	// These are scored exactly as UPGNUtilities::FindBestConclusionEvents scores them.
+	TPGNScratchArray<TPair<float, FPGNEventId>> AllScoredConclusionEvents;
+	AllScoredConclusionEvents.Reserve(NumberOfConclusionEvents);
+
+	for (FPGNEventId ThisConclusionEventId = 0; ThisConclusionEventId < NumberOfConclusionEvents; ThisConclusionEventId++)
+	{
+		// If we have no previous narratives, then a random score gives us a random selection.
+		float EvaluatedScore = RandomStream.FRand();
+
+		if (Snapshot.bHasLastConclusionEvent)
+		{
+			const EPGNMood ThisMood = EventLibrary.GetEvent(ThisConclusionEventId).GetMood();
+
+			float RecencySubScore = 0.f;
+			float MoodGraphSubScore = 0.f;
+			EvaluatedScore = UPGNUtilities::EvaluateThisPossibleConclusionEvent(
+				Snapshot.AllConclusionEventUsage[ThisConclusionEventId],
+				Snapshot.GetMoodGraphDistance(Snapshot.LastConclusionMood, ThisMood), RecencySubScore, MoodGraphSubScore);
+		}
+
+		AllScoredConclusionEvents.Emplace(EvaluatedScore, ThisConclusionEventId);
+	}
+
+	AllScoredConclusionEvents.Sort([](const TPair<float, FPGNEventId>& A, const TPair<float, FPGNEventId>& B)
+	{
+		return A.Key != B.Key ? A.Key > B.Key : A.Value < B.Value;
+	});
+
+	TPGNScratchArray<FPGNEventId> AllConclusionEventIds;
+
+	for (int Index_Best = 0; Index_Best < FMath::Min(Snapshot.NumberOfCandidateNarratives, AllScoredConclusionEvents.Num()); Index_Best++)
+	{
+		AllConclusionEventIds.Add(AllScoredConclusionEvents[Index_Best].Value);
+	}
+
+	const FPGNRelationshipOracle& RelationshipOracle = *Snapshot.RelationshipOracle;
+
+	// Nobody is waiting on the producer, so every candidate is built.
+	TArray<FPGNCandidateNarrative> AllCandidates;
+	const int32 IndexOfBestCandidate = FPGNCandidateNarrativeBuilder::BuildCandidates(AllConclusionEventIds,
+		Snapshot.WorldData->AllConclusionEvents, Snapshot.NumberOfEventsBeforeConclusion, RandomStream.RandHelper(MAX_int32),
+		Snapshot.AllCastingCandidates, TArrayView<const FPGNCastMember>(),
+		[&RelationshipOracle](int32 IndexOfCharacterA, int32 IndexOfCharacterB, FPGNRelationship& Out_Relationship)
+		{
+			return RelationshipOracle.FindRelationship(IndexOfCharacterA, IndexOfCharacterB, Out_Relationship);
+		}, Evaluator, 0.0, AllCandidates);
+
+	if (IndexOfBestCandidate == INDEX_NONE)
+	{
+		return false;
+	}
+
+	Out_Narrative = MoveTemp(AllCandidates[IndexOfBestCandidate].Narrative);
+	Out_Narrative.bIsNarrativeInitialized = true;
+	Out_Cast = MoveTemp(AllCandidates[IndexOfBestCandidate].Cast);
+
+	// Advance the snapshot exactly as the overseer will once this narrative is delivered, so that the next
+	// narrative we build accounts for this one.
+	Snapshot.AllConclusionEventUsage[Out_Narrative.ConclusionEventId].Add(Snapshot.NumberOfPreviouslyGeneratedNarratives);
+
+	Snapshot.NumberOfPreviouslyGeneratedNarratives++;
+	Snapshot.bHasLastConclusionEvent = true;
+	Snapshot.LastConclusionMood = EventLibrary.GetEvent(Out_Narrative.ConclusionEventId).GetMood();
+
+	// Whatever happened to the cast rules out the same parts for them as it will in the overseer's timeline, and
+	// leaves them in the attitudes the overseer will find there.
+	const auto ApplyActionToCharacterInRole = [&Snapshot, &Out_Narrative](EPGNCharacterTag Tag, EPGNEventAction Action,
+		bool bIsSubject, EPGNCharacterAttitude FinalAttitude)
+	{
+		const int32 IndexInCast = FPGNCastingSolver::GetIndexInCast(Tag);
+
+		if (!Out_Narrative.AllIndicesOfCharactersInUse.IsValidIndex(IndexInCast))
+		{
+			return;
+		}
+
+		const int32 IndexOfCharacter = Out_Narrative.AllIndicesOfCharactersInUse[IndexInCast];
+
+		if (FPGNCastingCandidate* ThisCandidate = Snapshot.AllCastingCandidates.FindByPredicate(
+			[IndexOfCharacter](const FPGNCastingCandidate& Candidate) { return Candidate.IndexOfCharacter == IndexOfCharacter; }))
+		{
+			ThisCandidate->StateFlags = FPGNCharacterTimeline::ApplyActionToFlags(Action, bIsSubject, ThisCandidate->StateFlags);
+			ThisCandidate->CurrentAttitude = FinalAttitude;
+		}
+	};
+
+	const auto ApplyThisEvent = [&EventLibrary, &ApplyActionToCharacterInRole](FPGNEventId ThisEventId)
+	{
+		const FPGNPackedEvent& ThisEvent = EventLibrary.GetEvent(ThisEventId);
+
+		ApplyActionToCharacterInRole(ThisEvent.GetSubject(), ThisEvent.GetAction(), true, ThisEvent.GetSubjectFinalAttitude());
+
+		if (ThisEvent.bDoesEventHaveObject && ThisEvent.GetObject() != ThisEvent.GetSubject())
+		{
+			ApplyActionToCharacterInRole(ThisEvent.GetObject(), ThisEvent.GetAction(), false,
+				ThisEvent.GetObjectFinalAttitude());
+		}
+	};
+
+	for (const FPGNEventId ThisEventId : Out_Narrative.AllEventIds)
+	{
+		ApplyThisEvent(ThisEventId);
+	}
+
+	ApplyThisEvent(Out_Narrative.ConclusionEventId);
+
+	return true;
+}
+
+uint32 FPGNNarrativePrefetcher::Run()
+{
+	// Everything the producer allocates is for generation, from its copy of the world to the narratives it queues.
+	PGN_LLM_SCOPE(Generation);
+
+	TUniquePtr<FPGNNarrativeGenerationSnapshot> WorkingSnapshot;
+	int32 WorkingSnapshotVersion = 0;
+	FRandomStream RandomStream;
+
+	// Its caches only hold for the relationships of one snapshot, so every snapshot gets an evaluator of its own.
+	TUniquePtr<FPGNNarrativeEvaluator> WorkingEvaluator;
+
+	while (!bShouldStopPrefetching)
+	{
+		{
+			FScopeLock Lock(&PendingSnapshotLock);
+
+			if (PendingSnapshot.IsValid())
+			{
+				WorkingSnapshot = MoveTemp(PendingSnapshot);
+				WorkingSnapshotVersion = PendingSnapshotVersion;
+				RandomStream.Initialize(WorkingSnapshot->RandomSeed);
+				WorkingEvaluator.Reset();
+			}
+		}
+
+		const bool bHasValidSnapshot = WorkingSnapshot.IsValid() && WorkingSnapshot->CanBuildNarratives()
+			&& WorkingSnapshotVersion == WorldStateVersion.GetValue();
+
+		if (!bHasValidSnapshot || GetNumberOfReadyNarratives() >= NumberOfNarrativesToPrefetch)
+		{
+			WakeUpProducerEvent->Wait();
+			continue;
+		}
+
+		if (!WorkingEvaluator.IsValid())
+		{
+			// The lambda keeps the oracle alive for as long as the evaluator needs it.
+			const TSharedPtr<const FPGNRelationshipOracle, ESPMode::ThreadSafe> RelationshipOracle = WorkingSnapshot->RelationshipOracle;
+
+			WorkingEvaluator = MakeUnique<FPGNNarrativeEvaluator>(WorkingSnapshot->EventLibrary,
+				WorkingSnapshot->MoodDistanceTable, WorkingSnapshot->DesiredFinalDramaticTension,
+				[RelationshipOracle](int32 IndexOfCharacterA, int32 IndexOfCharacterB, FPGNRelationship& Out_Relationship)
+				{
+					return RelationshipOracle->FindRelationship(IndexOfCharacterA, IndexOfCharacterB, Out_Relationship);
+				}, WorkingSnapshot->NumberOfEvaluationsToCache);
+		}
+
+		// Scratch memory is released after each narrative, and it lives on this thread's own memory stack.
+		FPGNGenerationScratchScope ScratchScope;
+		
+		FPrefetchedNarrative ThisPrefetchedNarrative;
+
+		// Nothing will change until the next snapshot, so if nothing can be built now, we will wait for one.
+		if (!BuildNarrativeFromSnapshot(*WorkingSnapshot, RandomStream, *WorkingEvaluator, ThisPrefetchedNarrative.Narrative,
+			ThisPrefetchedNarrative.Cast))
+		{
+			WorkingSnapshot.Reset();
+			continue;
+		}
+
+		ThisPrefetchedNarrative.WorldStateVersion = WorkingSnapshotVersion;
+
+		// A failed enqueue leaves the narrative where it is, so we wait for room and try again. It is only given up on
+		// once it has gone stale, since the snapshot has already been advanced past it.
+		while (!ReadyNarratives.Enqueue(MoveTemp(ThisPrefetchedNarrative)))
+		{
+			if (bShouldStopPrefetching || WorkingSnapshotVersion != WorldStateVersion.GetValue())
+			{
+				break;
+			}
+
+			WakeUpProducerEvent->Wait();
+		}
+	}
+
+	return 0;
+}
+
+void FPGNNarrativePrefetcher::Stop()
+{
+	bShouldStopPrefetching = true;
+	WakeUpProducerEvent->Trigger();
+}
@@ -0,0 +1,132 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/CircularQueue.h"
+#include "HAL/Runnable.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "Misc/ScopeLock.h"
+#include "ProceduralNarrative/PGNUtilities.h"
+#include "ProceduralNarrative/Events/PGNEventLibrary.h"
+#include "ProceduralNarrative/Generation/PGNCandidateNarratives.h"
+#include "ProceduralNarrative/Population/PGNRelationshipOracle.h"
+#include "ProceduralNarrative/World/PGNWorldData.h"
+
+class FRunnableThread;
+
+// Everything the producer needs to build narratives without reading the overseer. The producer owns its copy and
+// advances it after every narrative it builds, as if that narrative had already been delivered.
+struct FPGNNarrativeGenerationSnapshot
+{
+	TSharedPtr<const FPGNEventLibrary, ESPMode::ThreadSafe> EventLibrary;
+
+	// For the conclusion events, which are only ever read.
+	FPGNWorldDataPtr WorldData;
+
+	// Which narratives each conclusion event has been used in, indexed by conclusion event ID.
+	TArray<TArray<int>> AllConclusionEventUsage;
+
+	// All-pairs distances of the mood graph, indexed with UMoodGraph::GetIndexInDistanceTable.
+	TArray<int> MoodDistanceTable;
+
+	int NumberOfPreviouslyGeneratedNarratives = 0;
+
+	bool bHasLastConclusionEvent = false;
+	EPGNMood LastConclusionMood = EPGNMood::MOOD_Joyful;
+
+	int32 RandomSeed = 0;
+
+#pragma region Casting
+
+	// Everyone who can be cast, with the state flags the narratives built so far have left them in.
+	TArray<FPGNCastingCandidate> AllCastingCandidates;
+
+	// Shared with the overseer, which copies its own before changing it while any snapshot still holds it. Without
+	// one, as with a virtual population, the producer cannot look relationships up and builds nothing.
+	TSharedPtr<const FPGNRelationshipOracle, ESPMode::ThreadSafe> RelationshipOracle;
+
+#pragma endregion Casting
+
+#pragma region Candidate Narratives
+
+	// The overseer's settings, so that a prefetched narrative is built exactly like a generated one.
+	int NumberOfCandidateNarratives = 1;
+	int NumberOfEventsBeforeConclusion = 0;
+	float DesiredFinalDramaticTension = 0.f;
+	int NumberOfEvaluationsToCache = 0;
+
+#pragma endregion Candidate Narratives
+
+	int GetMoodGraphDistance(EPGNMood From, EPGNMood To) const;
+
+	// False if anything BuildNarrativeFromSnapshot reads is missing, or the usage does not match the conclusions.
+	bool CanBuildNarratives() const;
+};
+
+/**
+ * Keeps a bounded number of ready narratives on a background thread.
+ *
+ * The queue is single producer (the prefetch thread) and single consumer (the game thread), so handing over a
+ * narrative is a lock-free dequeue. Every narrative is stamped with the world state version it was built against;
+ * resetting the world state bumps the version and anything older is thrown away instead of delivered.
+ */
+class PROCEDURALNARRATIVE_API FPGNNarrativePrefetcher : public FRunnable
+{
+public:
+
+	explicit FPGNNarrativePrefetcher(int InNumberOfNarrativesToPrefetch);
+	virtual ~FPGNNarrativePrefetcher() override;
+
+	void StartPrefetching();
+	void StopPrefetching();
+
+	// Game thread only. Discards every queued narrative and restarts the producer from this snapshot.
+	void ResetWorldState(FPGNNarrativeGenerationSnapshot&& NewSnapshot);
+
+	// Game thread only. Returns false if no narrative built against the current world state is ready. Out_Cast is the
+	// cast with the attitudes the narrative leaves them in.
+	bool TryDequeueNarrative(FPGNGeneratedNarrative& Out_Narrative, TArray<FPGNCastMember>& Out_Cast);
+
+	int GetNumberOfReadyNarratives() const;
+
+	/*
+	 * Builds the next narrative from the snapshot, the same way APGNOverseer::GenerateNewNarrative does, and then
+	 * advances the snapshot past it. Returns false, and leaves the snapshot as it is, if no narrative could be built.
+	 */
+	static bool BuildNarrativeFromSnapshot(FPGNNarrativeGenerationSnapshot& Snapshot, FRandomStream& RandomStream,
+		FPGNNarrativeEvaluator& Evaluator, FPGNGeneratedNarrative& Out_Narrative, TArray<FPGNCastMember>& Out_Cast);
+
+#pragma region FRunnable
+
+	virtual uint32 Run() override;
+	virtual void Stop() override;
+
+#pragma endregion FRunnable
+
+private:
+
+	struct FPrefetchedNarrative
+	{
+		FPGNGeneratedNarrative Narrative;
+		TArray<FPGNCastMember> Cast;
+		int32 WorldStateVersion = 0;
+	};
+
+	const int NumberOfNarrativesToPrefetch;
+
+	TCircularQueue<FPrefetchedNarrative> ReadyNarratives;
+
+	FThreadSafeCounter WorldStateVersion;
+	FThreadSafeBool bShouldStopPrefetching;
+
+	// The snapshot waiting to be picked up by the producer, guarded by the lock.
+	FCriticalSection PendingSnapshotLock;
+	TUniquePtr<FPGNNarrativeGenerationSnapshot> PendingSnapshot;
+	int32 PendingSnapshotVersion = 0;
+
+	// Wakes the producer when there is room in the queue, a new snapshot, or when we are shutting down.
+	FEvent* WakeUpProducerEvent = nullptr;
+	FRunnableThread* ProducerThread = nullptr;
+};
@@ -0,0 +1,48 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/MemStack.h"
+
+/*
+ * Scratch containers for everything that only lives for the duration of a single narrative generation.
+ *
+ * They allocate from the calling thread's FMemStack instead of the global heap. Nothing is ever freed individually;
+ * instead, the FPGNGenerationScratchScope that was opened at the start of the generation releases all of it at once
+ * when it goes out of scope. Because of that, a scratch container must never outlive the scope it was created in and
+ * must never be copied into anything that does (such as FPGNGeneratedNarrative).
+ */
+
+using FPGNScratchAllocator = TMemStackAllocator<>;
+using FPGNScratchSetAllocator = TSetAllocator<TSparseArrayAllocator<FPGNScratchAllocator, FPGNScratchAllocator>,
+	FPGNScratchAllocator>;
+
+template <typename ElementType>
+using TPGNScratchArray = TArray<ElementType, FPGNScratchAllocator>;
+
+template <typename ElementType>
+using TPGNScratchSet = TSet<ElementType, DefaultKeyFuncs<ElementType>, FPGNScratchSetAllocator>;
+
+template <typename KeyType, typename ValueType>
+using TPGNScratchMap = TMap<KeyType, ValueType, FPGNScratchSetAllocator>;
+
+// Opens a region of the thread's memory stack. Every scratch allocation made while this is alive is released in a
+// single reset when it is destroyed. Scopes can be nested, and each thread has its own memory stack, so the narrative
+// prefetcher and the game thread never share one.
+class FPGNGenerationScratchScope
+{
+public:
+
+	FPGNGenerationScratchScope()
+		: Mark(FMemStack::Get())
+	{
+	}
+
+	FPGNGenerationScratchScope(const FPGNGenerationScratchScope&) = delete;
+	FPGNGenerationScratchScope& operator=(const FPGNGenerationScratchScope&) = delete;
+
+private:
+
+	FMemMark Mark;
+};
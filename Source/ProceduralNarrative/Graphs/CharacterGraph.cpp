@@ -4,88 +4,39 @@
 #include "ProceduralNarrative/Graphs/CharacterGraph.h"
 
 #include "ProceduralNarrative/PGNOverseer.h"
+#include "ProceduralNarrative/Memory/PGNMemoryTracking.h"
 
 void UCharacterGraph::InitializeCharacterGraphWithErdosRenyi(APGNOverseer* Overseer, float ThresholdForEdgeCreation,
 	int MaximumDistanceBetweenVertices)
 {
+	PGN_LLM_SCOPE(Graphs);
+
 	// Create an adjacency list.
-	CharacterAdjacencyList = TMap<FCharacterGraphVertex, TArray<FCharacterGraphVertexDistance>>();
+	CharacterAdjacencyList.Reset();
+	AllVerticesInGraph.Reset();
+	AllEdges.Reset();
+	GraphVersion++;
 	
 	// First, generate all of our vertices from the Overseer.
 	TArray<FCharacterGraphVertex> AllVertices;
 	GenerateListOfVerticesFromOverseer(Overseer, AllVertices);
 
-	const int NumberOfVertices = AllVertices.Num();
+	TArray<int> AllIndicesOfCharacters;
+	AllIndicesOfCharacters.Reserve(AllVertices.Num());
 
-	// These represent our A Vertex.
-	for (int i = 0; i < NumberOfVertices; i++)
+	for (const FCharacterGraphVertex& ThisVertex : AllVertices)
 	{
-		// These represent our B vertex.
-		// Determine if we should add an edge between this vertex and any other vertex.
-		for (int j = 0; j < NumberOfVertices; j++)
-		{
-			if (AllVertices[j].IndexInAllCharactersArray == AllVertices[i].IndexInAllCharactersArray)
-			{
-				continue;
-			}
-			
-			// Before anything else, we need to check if this vertex is already has an edge or connection to the other vertex.
-			// If it does, we don't need to add another edge.
-
-			bool bShouldContinue = false;
-			
-			for (auto ThisVertex : CharacterAdjacencyList[AllVertices[j]])
-			{
-				if (ThisVertex.Vertex == AllVertices[i])
-				{
-					bShouldContinue = true;
-					break;
-				}
-			}
-
-			for (auto ThisVertex : CharacterAdjacencyList[AllVertices[i]])
-			{
-				if (ThisVertex.Vertex == AllVertices[j])
-				{
-					bShouldContinue = true;
-					break;
-				}
-			}
-
-			if (bShouldContinue)
-			{
-				continue;
-			}
-
-			// First, generate our edge probability.
-			const float ProbabilityOfEdgeCreation = FMath::FRandRange(0.0f, 1.0f);
-			
-			if (ProbabilityOfEdgeCreation < ThresholdForEdgeCreation)
-			{
-				// Add an edge between these two vertices.
-				FCharacterGraphEdge ThisEdge;
-				ThisEdge.VertexA = AllVertices[i];
-				ThisEdge.VertexB = AllVertices[j];
-				
-				FCharacterGraphVertexDistance ThisDistance;
-				ThisDistance.Vertex.IndexInAllCharactersArray = AllVertices[j].IndexInAllCharactersArray;
-
-				// The distance should be calculated based off of how close the probability of edge is to the global threshold.
-				constexpr int MinimumDistanceBetweenEdges = 1;
-				
-				// The lower the generated score, the lower the distance.
-				const float AlphaForDistance = (ProbabilityOfEdgeCreation / ThresholdForEdgeCreation);
-				
-				ThisDistance.Distance = FMath::Clamp(static_cast<int>(AlphaForDistance * MaximumDistanceBetweenVertices),
-				                                     MinimumDistanceBetweenEdges, MaximumDistanceBetweenVertices);
-
-				ThisEdge.DistanceBetweenVertices = FMath::Clamp(static_cast<int>(AlphaForDistance * MaximumDistanceBetweenVertices),
-													 MinimumDistanceBetweenEdges, MaximumDistanceBetweenVertices);
-				AllEdges.Add(ThisEdge);
-				
-				CharacterAdjacencyList[AllVertices[i]].Add(ThisDistance);
-			}
-		}
+		AllIndicesOfCharacters.Add(ThisVertex.IndexInAllCharactersArray);
+	}
+
+	// Each character only rolls against those after them, so that every pair is rolled exactly once.
+	TArray<int> AllIndicesOfNewEdges;
+
+	for (int Index_Vertex = 0; Index_Vertex < AllIndicesOfCharacters.Num(); Index_Vertex++)
+	{
+		TryCreateErdosRenyiEdgesForThisVertex(AllIndicesOfCharacters[Index_Vertex],
+			TArrayView<const int>(AllIndicesOfCharacters).RightChop(Index_Vertex + 1), ThresholdForEdgeCreation,
+			MaximumDistanceBetweenVertices, AllIndicesOfNewEdges);
 	}
 
 	UE_LOG(LogTemp, Warning, TEXT("*** WE GENERATED %d SOCIAL RELATIONSHIPS FOR OUR CHARACTERS. ***"), AllEdges.Num());
@@ -96,12 +47,355 @@ void UCharacterGraph::GenerateListOfVerticesFromOverseer(APGNOverseer* Overseer,
 {
 	Out_AllVertices.Reserve(Overseer->AllCharacters.Num());
 
+	CharacterAdjacencyList.SetNum(Overseer->AllCharacters.Num());
+	AllVerticesInGraph.Init(false, Overseer->AllCharacters.Num());
+
 	for (int Index_Character = 0; Index_Character < Overseer->AllCharacters.Num(); Index_Character++)
 	{
+		// Characters who have died or left town keep their index, but they are no longer part of the town.
+		if (!Overseer->AllCharacters[Index_Character].bIsInTown)
+		{
+			continue;
+		}
+
 		FCharacterGraphVertex ThisVertex;
 		ThisVertex.IndexInAllCharactersArray = Index_Character;
 		Out_AllVertices.Add(ThisVertex);
 
-		CharacterAdjacencyList.Add(ThisVertex, TArray<FCharacterGraphVertexDistance>());
+		AllVerticesInGraph[Index_Character] = true;
+	}
+}
+
+void UCharacterGraph::TryCreateErdosRenyiEdgesForThisVertex(int IndexOfCharacter,
+	TArrayView<const int> AllIndicesOfOtherCharacters, float ThresholdForEdgeCreation,
+	int MaximumDistanceBetweenVertices, TArray<int>& Out_AllIndicesOfNewEdges)
+{
+	Out_AllIndicesOfNewEdges.Reset();
+
+	for (const int IndexOfOtherCharacter : AllIndicesOfOtherCharacters)
+	{
+		if (IndexOfOtherCharacter == IndexOfCharacter)
+		{
+			continue;
+		}
+
+		const int IndexOfNewEdge = TryCreateErdosRenyiEdge(IndexOfCharacter, IndexOfOtherCharacter,
+			ThresholdForEdgeCreation, MaximumDistanceBetweenVertices);
+
+		if (IndexOfNewEdge != INDEX_NONE)
+		{
+			Out_AllIndicesOfNewEdges.Add(IndexOfNewEdge);
+		}
+	}
+}
+
+int UCharacterGraph::TryCreateErdosRenyiEdge(int IndexOfCharacterA, int IndexOfCharacterB,
+	float ThresholdForEdgeCreation, int MaximumDistanceBetweenVertices)
+{
+	// Before anything else, we need to check if this vertex is already has an edge or connection to the other vertex.
+	// If it does, we don't need to add another edge.
+	if (FindEdge(IndexOfCharacterA, IndexOfCharacterB) != nullptr)
+	{
+		return INDEX_NONE;
+	}
+
+	// First, generate our edge probability.
+	const float ProbabilityOfEdgeCreation = FMath::FRandRange(0.0f, 1.0f);
+
+	if (ProbabilityOfEdgeCreation >= ThresholdForEdgeCreation)
+	{
+		return INDEX_NONE;
+	}
+
+	const int DistanceBetweenVertices = CalculateDistanceFromEdgeProbability(ProbabilityOfEdgeCreation,
+		ThresholdForEdgeCreation, MaximumDistanceBetweenVertices);
+
+	// Add an edge between these two vertices.
+	if (!AddEdge(IndexOfCharacterA, IndexOfCharacterB, DistanceBetweenVertices))
+	{
+		return INDEX_NONE;
+	}
+
+	return AllEdges.Num() - 1;
+}
+
+int UCharacterGraph::CalculateDistanceFromEdgeProbability(float ProbabilityOfEdgeCreation,
+	float ThresholdForEdgeCreation, int MaximumDistanceBetweenVertices)
+{
+	// The distance should be calculated based off of how close the probability of edge is to the global threshold.
+	constexpr int MinimumDistanceBetweenEdges = 1;
+
+	// The lower the generated score, the lower the distance.
+	const float AlphaForDistance = (ProbabilityOfEdgeCreation / ThresholdForEdgeCreation);
+
+	return FMath::Clamp(static_cast<int>(AlphaForDistance * MaximumDistanceBetweenVertices),
+		MinimumDistanceBetweenEdges, MaximumDistanceBetweenVertices);
+}
+
+#pragma region Incremental Changes
+
+void UCharacterGraph::MarkVertexAsDirty(int IndexOfCharacter)
+{
+	AllDirtyVertices.Add(IndexOfCharacter);
+	GraphVersion++;
+}
+
+void UCharacterGraph::ConsumeDirtyVertices(TArray<int>& Out_AllDirtyVertices)
+{
+	Out_AllDirtyVertices = AllDirtyVertices.Array();
+	AllDirtyVertices.Reset();
+}
+
+bool UCharacterGraph::HasVertex(int IndexOfCharacter) const
+{
+	return AllVerticesInGraph.IsValidIndex(IndexOfCharacter) && AllVerticesInGraph[IndexOfCharacter];
+}
+
+void UCharacterGraph::AddVertex(int IndexOfCharacter)
+{
+	PGN_LLM_SCOPE(Graphs);
+
+	if (IndexOfCharacter < 0 || HasVertex(IndexOfCharacter))
+	{
+		return;
+	}
+
+	// Characters are only ever added at the end of AllCharacters, so this only grows by one slot at a time.
+	if (IndexOfCharacter >= CharacterAdjacencyList.Num())
+	{
+		CharacterAdjacencyList.SetNum(IndexOfCharacter + 1);
+		AllVerticesInGraph.Add(false, IndexOfCharacter + 1 - AllVerticesInGraph.Num());
+	}
+
+	AllVerticesInGraph[IndexOfCharacter] = true;
+	MarkVertexAsDirty(IndexOfCharacter);
+}
+
+void UCharacterGraph::RemoveVertex(int IndexOfCharacter, TArray<int>& Out_AllFormerNeighbours)
+{
+	Out_AllFormerNeighbours.Reset();
+
+	if (!HasVertex(IndexOfCharacter))
+	{
+		return;
+	}
+
+	for (const FCharacterGraphVertexDistance& ThisNeighbour : CharacterAdjacencyList[IndexOfCharacter])
+	{
+		Out_AllFormerNeighbours.Add(ThisNeighbour.Vertex.IndexInAllCharactersArray);
+	}
+
+	// RemoveEdge changes the adjacency list as it goes, so we work from the copy.
+	for (const int IndexOfNeighbour : Out_AllFormerNeighbours)
+	{
+		RemoveEdge(IndexOfCharacter, IndexOfNeighbour);
+	}
+
+	CharacterAdjacencyList[IndexOfCharacter].Empty();
+	AllVerticesInGraph[IndexOfCharacter] = false;
+	MarkVertexAsDirty(IndexOfCharacter);
+}
+
+FCharacterGraphVertexDistance* UCharacterGraph::FindNeighbour(int IndexOfCharacter, int IndexOfNeighbour)
+{
+	if (!CharacterAdjacencyList.IsValidIndex(IndexOfCharacter))
+	{
+		return nullptr;
+	}
+
+	for (FCharacterGraphVertexDistance& ThisNeighbour : CharacterAdjacencyList[IndexOfCharacter])
+	{
+		if (ThisNeighbour.Vertex.IndexInAllCharactersArray == IndexOfNeighbour)
+		{
+			return &ThisNeighbour;
+		}
+	}
+
+	return nullptr;
+}
+
+const FCharacterGraphVertexDistance* UCharacterGraph::FindNeighbour(int IndexOfCharacter, int IndexOfNeighbour) const
+{
+	return const_cast<UCharacterGraph*>(this)->FindNeighbour(IndexOfCharacter, IndexOfNeighbour);
+}
+
+const FCharacterGraphEdge* UCharacterGraph::FindEdge(int IndexOfCharacterA, int IndexOfCharacterB) const
+{
+	if (!CharacterAdjacencyList.IsValidIndex(IndexOfCharacterA) || !CharacterAdjacencyList.IsValidIndex(IndexOfCharacterB))
+	{
+		return nullptr;
+	}
+
+	// Both characters list the edge, so we only need to look through whichever of them knows fewer people.
+	const FCharacterGraphVertexDistance* ThisNeighbour =
+		CharacterAdjacencyList[IndexOfCharacterA].Num() <= CharacterAdjacencyList[IndexOfCharacterB].Num()
+		? FindNeighbour(IndexOfCharacterA, IndexOfCharacterB) : FindNeighbour(IndexOfCharacterB, IndexOfCharacterA);
+
+	return ThisNeighbour != nullptr ? &AllEdges[ThisNeighbour->IndexOfEdge] : nullptr;
+}
+
+bool UCharacterGraph::AddEdge(int IndexOfCharacterA, int IndexOfCharacterB, int DistanceBetweenVertices)
+{
+	PGN_LLM_SCOPE(Graphs);
+
+	if (IndexOfCharacterA == IndexOfCharacterB || !HasVertex(IndexOfCharacterA) || !HasVertex(IndexOfCharacterB)
+		|| FindEdge(IndexOfCharacterA, IndexOfCharacterB) != nullptr)
+	{
+		return false;
+	}
+
+	FCharacterGraphEdge ThisEdge;
+	ThisEdge.VertexA.IndexInAllCharactersArray = IndexOfCharacterA;
+	ThisEdge.VertexB.IndexInAllCharactersArray = IndexOfCharacterB;
+	ThisEdge.DistanceBetweenVertices = DistanceBetweenVertices;
+
+	const int IndexOfEdge = AllEdges.Add(ThisEdge);
+
+	SetNeighbourDistance(IndexOfCharacterA, IndexOfCharacterB, DistanceBetweenVertices, IndexOfEdge);
+	SetNeighbourDistance(IndexOfCharacterB, IndexOfCharacterA, DistanceBetweenVertices, IndexOfEdge);
+
+	MarkVertexAsDirty(IndexOfCharacterA);
+	MarkVertexAsDirty(IndexOfCharacterB);
+
+	return true;
+}
+
+bool UCharacterGraph::RemoveEdge(int IndexOfCharacterA, int IndexOfCharacterB)
+{
+	const FCharacterGraphVertexDistance* NeighbourOfA = FindNeighbour(IndexOfCharacterA, IndexOfCharacterB);
+
+	if (NeighbourOfA == nullptr)
+	{
+		return false;
+	}
+
+	const int IndexOfEdge = NeighbourOfA->IndexOfEdge;
+
+	// The last edge moves into the gap, so both of its vertices have to be told where it went.
+	AllEdges.RemoveAtSwap(IndexOfEdge, 1, false);
+
+	if (AllEdges.IsValidIndex(IndexOfEdge))
+	{
+		const FCharacterGraphEdge& MovedEdge = AllEdges[IndexOfEdge];
+		const int IndexOfMovedCharacterA = MovedEdge.VertexA.IndexInAllCharactersArray;
+		const int IndexOfMovedCharacterB = MovedEdge.VertexB.IndexInAllCharactersArray;
+
+		FindNeighbour(IndexOfMovedCharacterA, IndexOfMovedCharacterB)->IndexOfEdge = IndexOfEdge;
+		FindNeighbour(IndexOfMovedCharacterB, IndexOfMovedCharacterA)->IndexOfEdge = IndexOfEdge;
+	}
+
+	RemoveNeighbour(IndexOfCharacterA, IndexOfCharacterB);
+	RemoveNeighbour(IndexOfCharacterB, IndexOfCharacterA);
+
+	MarkVertexAsDirty(IndexOfCharacterA);
+	MarkVertexAsDirty(IndexOfCharacterB);
+
+	return true;
+}
+
+bool UCharacterGraph::SetEdgeDistance(int IndexOfCharacterA, int IndexOfCharacterB, int NewDistanceBetweenVertices)
+{
+	const FCharacterGraphVertexDistance* NeighbourOfA = FindNeighbour(IndexOfCharacterA, IndexOfCharacterB);
+
+	if (NeighbourOfA == nullptr)
+	{
+		return false;
+	}
+
+	const int IndexOfEdge = NeighbourOfA->IndexOfEdge;
+	AllEdges[IndexOfEdge].DistanceBetweenVertices = NewDistanceBetweenVertices;
+
+	SetNeighbourDistance(IndexOfCharacterA, IndexOfCharacterB, NewDistanceBetweenVertices, IndexOfEdge);
+	SetNeighbourDistance(IndexOfCharacterB, IndexOfCharacterA, NewDistanceBetweenVertices, IndexOfEdge);
+
+	MarkVertexAsDirty(IndexOfCharacterA);
+	MarkVertexAsDirty(IndexOfCharacterB);
+
+	return true;
+}
+
+void UCharacterGraph::SetNeighbourDistance(int IndexOfCharacter, int IndexOfNeighbour, int NewDistance, int IndexOfEdge)
+{
+	if (FCharacterGraphVertexDistance* ExistingNeighbour = FindNeighbour(IndexOfCharacter, IndexOfNeighbour))
+	{
+		ExistingNeighbour->Distance = NewDistance;
+		ExistingNeighbour->IndexOfEdge = IndexOfEdge;
+		return;
+	}
+
+	FCharacterGraphVertexDistance NewNeighbour;
+	NewNeighbour.Vertex.IndexInAllCharactersArray = IndexOfNeighbour;
+	NewNeighbour.Distance = NewDistance;
+	NewNeighbour.IndexOfEdge = IndexOfEdge;
+
+	CharacterAdjacencyList[IndexOfCharacter].Add(NewNeighbour);
+}
+
+void UCharacterGraph::RemoveNeighbour(int IndexOfCharacter, int IndexOfNeighbour)
+{
+	if (CharacterAdjacencyList.IsValidIndex(IndexOfCharacter))
+	{
+		CharacterAdjacencyList[IndexOfCharacter].RemoveAllSwap([IndexOfNeighbour](const FCharacterGraphVertexDistance& ThisNeighbour)
+		{
+			return ThisNeighbour.Vertex.IndexInAllCharactersArray == IndexOfNeighbour;
+		});
+	}
+}
+
+#pragma endregion Incremental Changes
+
+#pragma region Distances
+
+const FPGNCharacterGraph& UCharacterGraph::GetCompactGraph()
+{
+	if (CompactGraphVersion != GraphVersion)
+	{
+		PGN_LLM_SCOPE(Graphs);
+
+		TArray<FPGNCharacterGraph::FEdge> AllCompactEdges;
+		AllCompactEdges.Reserve(AllEdges.Num());
+
+		for (const FCharacterGraphEdge& ThisEdge : AllEdges)
+		{
+			AllCompactEdges.Add({ ThisEdge.VertexA.IndexInAllCharactersArray, ThisEdge.VertexB.IndexInAllCharactersArray,
+				ThisEdge.DistanceBetweenVertices });
+		}
+
+		CompactGraph.Build(CharacterAdjacencyList.Num(), AllCompactEdges);
+		CompactGraphVersion = GraphVersion;
+	}
+
+	return CompactGraph;
+}
+
+void UCharacterGraph::FindDistancesFromCharacter(int IndexOfCharacter, TArray<int>& Out_AllDistances)
+{
+	PGNGraph::Dijkstra(GetCompactGraph(), IndexOfCharacter, Out_AllDistances);
+}
+
+void UCharacterGraph::FindNumberOfHopsFromCharacter(int IndexOfCharacter, TArray<int32>& Out_AllHops)
+{
+	PGNGraph::BreadthFirstSearch(GetCompactGraph(), IndexOfCharacter, Out_AllHops);
+}
+
+#pragma endregion Distances
+
+SIZE_T UCharacterGraph::GetAllocatedSize() const
+{
+	SIZE_T AllocatedSize = CharacterAdjacencyList.GetAllocatedSize() + AllEdges.GetAllocatedSize()
+		+ AllVerticesInGraph.GetAllocatedSize() + AllDirtyVertices.GetAllocatedSize() + CompactGraph.GetAllocatedSize();
+
+	for (const TArray<FCharacterGraphVertexDistance>& AllNeighbours : CharacterAdjacencyList)
+	{
+		AllocatedSize += AllNeighbours.GetAllocatedSize();
 	}
+
+	return AllocatedSize;
+}
+
+void UCharacterGraph::GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize)
+{
+	Super::GetResourceSizeEx(CumulativeResourceSize);
+
+	CumulativeResourceSize.AddDedicatedSystemMemoryBytes(GetAllocatedSize());
 }
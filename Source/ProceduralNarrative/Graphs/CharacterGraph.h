@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "ProceduralNarrative/Graph.h"
+#include "ProceduralNarrative/Graphs/PGNGraph.h"
 #include "ProceduralNarrative/PGNUtilities.h"
 #include "CharacterGraph.generated.h"
 
@@ -36,14 +37,17 @@ struct FCharacterGraphVertexDistance
 	UPROPERTY(EditAnywhere)
 	int Distance;
 
+	// Where the edge to this neighbour is in UCharacterGraph::AllEdges.
+	int IndexOfEdge = INDEX_NONE;
+
 	bool operator == (const FCharacterGraphVertexDistance& Other) const
 	{
-		return Distance == Other.Distance;
+		return Vertex == Other.Vertex && Distance == Other.Distance;
 	}
 	
 	friend uint32 GetTypeHash (const FCharacterGraphVertexDistance& Other)
 	{
-		return GetTypeHash(Other.Distance);
+		return GetTypeHash(Other.Vertex);
 	}
 
 	FCharacterGraphVertex GetVertex() const
@@ -66,17 +70,22 @@ struct FCharacterGraphEdge
 	UPROPERTY(EditAnywhere)
 	int DistanceBetweenVertices;
 
+	// Edges are undirected, so the same two characters in either order are the same edge.
 	bool operator == (const FCharacterGraphEdge& Other) const
 	{
-		return DistanceBetweenVertices == Other.DistanceBetweenVertices;
+		return DistanceBetweenVertices == Other.DistanceBetweenVertices
+			&& ((VertexA == Other.VertexA && VertexB == Other.VertexB) || (VertexA == Other.VertexB && VertexB == Other.VertexA));
 	}
 	
 	friend uint32 GetTypeHash (const FCharacterGraphEdge& Other)
 	{
-		return GetTypeHash(Other.DistanceBetweenVertices);
+		return HashCombine(GetTypeHash(FMath::Min(Other.VertexA.IndexInAllCharactersArray, Other.VertexB.IndexInAllCharactersArray)),
+			GetTypeHash(FMath::Max(Other.VertexA.IndexInAllCharactersArray, Other.VertexB.IndexInAllCharactersArray)));
 	}
 };
 
+using FPGNCharacterGraph = TPGNGraph<int32, int>;
+
 /**
  * 
  */
@@ -92,7 +101,91 @@ public:
 
 	void GenerateListOfVerticesFromOverseer(APGNOverseer* Overseer, TArray<FCharacterGraphVertex>& Out_AllVertices);
 
-	TMap<FCharacterGraphVertex, TArray<FCharacterGraphVertexDistance>> CharacterAdjacencyList;
+	// Rolls once for an edge between this character and each of the others. This is how every pair is rolled, both
+	// when the town is first built and when someone new arrives. Out_AllIndicesOfNewEdges is filled with the indices
+	// in AllEdges of the edges that were created.
+	void TryCreateErdosRenyiEdgesForThisVertex(int IndexOfCharacter, TArrayView<const int> AllIndicesOfOtherCharacters,
+		float ThresholdForEdgeCreation, int MaximumDistanceBetweenVertices, TArray<int>& Out_AllIndicesOfNewEdges);
+
+	// Rolls for an edge between these two characters. Returns the index of the new edge in AllEdges, or INDEX_NONE if
+	// no edge was created.
+	int TryCreateErdosRenyiEdge(int IndexOfCharacterA, int IndexOfCharacterB, float ThresholdForEdgeCreation,
+		int MaximumDistanceBetweenVertices);
+
+	// The lower the roll that created an edge, the closer the two characters are.
+	static int CalculateDistanceFromEdgeProbability(float ProbabilityOfEdgeCreation, float ThresholdForEdgeCreation,
+		int MaximumDistanceBetweenVertices);
+
+#pragma region Incremental Changes
+
+	/*
+	 * These only touch the vertices they are given and their neighbours, so the town can change one character at a time
+	 * without rebuilding the graph. Every change bumps the graph version and marks the vertices it touched as dirty, so
+	 * that anything derived from the graph can tell what it needs to recompute.
+	 */
+
+	void AddVertex(int IndexOfCharacter);
+
+	// Removes every edge of this vertex as well. Out_AllFormerNeighbours is filled with the characters it was connected to.
+	void RemoveVertex(int IndexOfCharacter, TArray<int>& Out_AllFormerNeighbours);
+
+	bool HasVertex(int IndexOfCharacter) const;
+
+	// Returns false if the edge already exists or either vertex is missing.
+	bool AddEdge(int IndexOfCharacterA, int IndexOfCharacterB, int DistanceBetweenVertices);
+	bool RemoveEdge(int IndexOfCharacterA, int IndexOfCharacterB);
+	bool SetEdgeDistance(int IndexOfCharacterA, int IndexOfCharacterB, int NewDistanceBetweenVertices);
+
+	const FCharacterGraphEdge* FindEdge(int IndexOfCharacterA, int IndexOfCharacterB) const;
+
+	int32 GetGraphVersion() const { return GraphVersion; }
+
+	// Hands over every vertex that has changed since this was last called.
+	void ConsumeDirtyVertices(TArray<int>& Out_AllDirtyVertices);
+
+#pragma endregion Incremental Changes
+
+#pragma region Distances
+
+	// The graph in compressed sparse rows, for the shared graph kernels. It is rebuilt here whenever the graph has
+	// changed since it was last asked for.
+	const FPGNCharacterGraph& GetCompactGraph();
+
+	// The sum of the distances along the shortest chain of acquaintances from this character to every character,
+	// indexed by character. MAX_int32 if there is no such chain.
+	void FindDistancesFromCharacter(int IndexOfCharacter, TArray<int>& Out_AllDistances);
+
+	// The number of people in the shortest chain of acquaintances from this character to every character.
+	void FindNumberOfHopsFromCharacter(int IndexOfCharacter, TArray<int32>& Out_AllHops);
+
+#pragma endregion Distances
+
+	// Everything the graph holds, including the compact graph.
+	SIZE_T GetAllocatedSize() const;
+
+	virtual void GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize) override;
+
+	// Indexed by the index of the character in the overseer's AllCharacters. Every vertex lists all of its neighbours,
+	// so each edge appears in the adjacency lists of both of its vertices.
+	TArray<TArray<FCharacterGraphVertexDistance>> CharacterAdjacencyList;
 
 	TArray<FCharacterGraphEdge> AllEdges;
+
+private:
+
+	FCharacterGraphVertexDistance* FindNeighbour(int IndexOfCharacter, int IndexOfNeighbour);
+	const FCharacterGraphVertexDistance* FindNeighbour(int IndexOfCharacter, int IndexOfNeighbour) const;
+
+	void SetNeighbourDistance(int IndexOfCharacter, int IndexOfNeighbour, int NewDistance, int IndexOfEdge);
+	void RemoveNeighbour(int IndexOfCharacter, int IndexOfNeighbour);
+	void MarkVertexAsDirty(int IndexOfCharacter);
+
+	// Which indices are characters in the graph. Characters who have left keep their slot in the adjacency list.
+	TBitArray<> AllVerticesInGraph;
+
+	int32 GraphVersion = 0;
+	TSet<int> AllDirtyVertices;
+
+	FPGNCharacterGraph CompactGraph;
+	int32 CompactGraphVersion = INDEX_NONE;
 };
@@ -3,102 +3,67 @@
 
 #include "ProceduralNarrative/Graphs/MoodGraph.h"
 
-void UMoodGraph::InitializeMoodGraphWithAllData(TArray<FMoodGraphVertex> AllVertices, TArray<FMoodGraphEdge> AllEdges)
+void UMoodGraph::InitializeMoodGraphWithAllData(const TArray<FMoodGraphVertex>& AllVertices,
+	const TArray<FMoodGraphEdge>& AllEdges)
 {
-	// Initialize all of our vertices
-	Vertices = TSet<FMoodGraphVertex>();
-	for (FMoodGraphVertex& ThisVertex : AllVertices)
-	{
-		Vertices.Add(ThisVertex);
-	}
+	BuildGraph(AllVertices, AllEdges, Graph);
+}
 
-	// Initialize all of our edges
-	Edges = TSet<FMoodGraphEdge>();
-	for (FMoodGraphEdge& ThisEdge : AllEdges)
-	{
-		ThisEdge.VertexA.Mood = ThisEdge.VertexA_Mood;
-		ThisEdge.VertexB.Mood = ThisEdge.VertexB_Mood;
-		Edges.Add(ThisEdge);
-	}
+void UMoodGraph::BuildGraph(const TArray<FMoodGraphVertex>& AllVertices, const TArray<FMoodGraphEdge>& AllEdges,
+	FPGNMoodGraph& Out_Graph)
+{
+	Out_Graph.Reset();
 
-	// Create an adjacency list.
-	AdjacencyList = TMap<FMoodGraphVertex, TArray<FMoodGraphVertexDistance>>();
-	for (FMoodGraphVertex& ThisVertex : AllVertices)
+	for (const FMoodGraphVertex& ThisVertex : AllVertices)
 	{
-		AdjacencyList.Add(ThisVertex, TArray<FMoodGraphVertexDistance>());
+		Out_Graph.AddVertex(ThisVertex.Mood);
 	}
 
-	for (FMoodGraphEdge& ThisEdge : AllEdges)
+	// Only moods that are vertices of the graph can be travelled through, so any other edge is left out.
+	for (const FMoodGraphEdge& ThisEdge : AllEdges)
 	{
-		if (AdjacencyList.Contains(ThisEdge.VertexA))
-		{
-			FMoodGraphVertexDistance ThisDistance;
-			ThisDistance.Vertex = ThisEdge.VertexB;
-			ThisDistance.Distance = ThisEdge.DistanceBetweenVertices;
-			
-			AdjacencyList[ThisEdge.VertexA].Add(ThisDistance);
-		}
-
-		if (AdjacencyList.Contains(ThisEdge.VertexB))
-		{
-			FMoodGraphVertexDistance ThisDistance;
-			ThisDistance.Vertex = ThisEdge.VertexA;
-			ThisDistance.Distance = ThisEdge.DistanceBetweenVertices;
-			AdjacencyList[ThisEdge.VertexB].Add(ThisDistance);
-		}
+		Out_Graph.AddEdge(ThisEdge.VertexA_Mood, ThisEdge.VertexB_Mood, ThisEdge.DistanceBetweenVertices);
 	}
 }
 
 TMap<FMoodGraphVertex, int> UMoodGraph::CreateDistanceMapUsingDijkstra(FMoodGraphVertex& StartVertex)
 {
-	TSet<FMoodGraphVertex> VisitedSet = TSet<FMoodGraphVertex>();
-	TMap<FMoodGraphVertex, int> GeneratedDistanceMap = TMap<FMoodGraphVertex, int>();
+	TArray<int> AllDistances;
+	CreateDistancesUsingDijkstra(StartVertex.Mood, AllDistances);
 
-	// Create a queue of vertices to visit
-	TArray<FMoodGraphVertexDistance> Queue = TArray<FMoodGraphVertexDistance>();
+	// Every vertex of the graph is in the map, including the ones that cannot be reached.
+	TMap<FMoodGraphVertex, int> GeneratedDistanceMap;
 
-	// Add all of our vertices and initialize the distance map to be the maximum value
-	for (FMoodGraphVertex ThisVertex : Vertices)
+	for (int Index_Mood = 0; Index_Mood < NUMBER_OF_MOODS; Index_Mood++)
 	{
-		GeneratedDistanceMap.Add(ThisVertex, MAX_int32);
-	}
-
-	FMoodGraphVertexDistance StartVertexDistance;
-	StartVertexDistance.Vertex = StartVertex;
-	StartVertexDistance.Distance = 0;
-	
-	Queue.Add(StartVertexDistance);
+		if (!Graph.HasVertex(Index_Mood))
+		{
+			continue;
+		}
 
-	while (Queue.Num() > 0 && VisitedSet.Num() < Vertices.Num())
-	{
-		// Get the next vertex to visit
-		FMoodGraphVertexDistance ThisVertexDistance = Queue[0];
-		Queue.RemoveAt(0);
+		FMoodGraphVertex ThisVertex;
+		ThisVertex.Mood = static_cast<EPGNMood>(Index_Mood);
+		GeneratedDistanceMap.Add(ThisVertex, AllDistances[Index_Mood]);
+	}
 
-		if (!VisitedSet.Contains(ThisVertexDistance.Vertex))
-		{
-			VisitedSet.Add(ThisVertexDistance.Vertex);
+	return GeneratedDistanceMap;
+}
 
-			if (ThisVertexDistance.Distance < GeneratedDistanceMap[ThisVertexDistance.Vertex])
-			{
-				GeneratedDistanceMap[ThisVertexDistance.Vertex] = ThisVertexDistance.Distance;
-			}
-			
-			for (FMoodGraphVertexDistance ThisDistance : AdjacencyList[ThisVertexDistance.Vertex])
-			{
-				FMoodGraphVertexDistance NewVertexDistance;
-				NewVertexDistance.GetVertex() = ThisDistance.GetVertex();
-				NewVertexDistance.Distance = ThisDistance.Distance + ThisVertexDistance.Distance;
+void UMoodGraph::CreateDistancesUsingDijkstra(EPGNMood StartMood, TArray<int>& Out_AllDistances) const
+{
+	PGNGraph::Dijkstra(Graph, static_cast<int32>(StartMood), Out_AllDistances);
+}
 
-				Queue.Add(NewVertexDistance);
-			}
+void UMoodGraph::CreateAllPairsDistanceTable(TArray<int>& Out_DistanceTable) const
+{
+	PGNGraph::AllPairsShortestPaths(Graph, Out_DistanceTable);
+}
 
-			Queue.Sort([](const FMoodGraphVertexDistance& A, const FMoodGraphVertexDistance& B)
-			{
-				return A.Distance < B.Distance;
-			});
-		}
-	}
+void UMoodGraph::CreateAllPairsDistanceTable(const TArray<FMoodGraphVertex>& AllVertices,
+	const TArray<FMoodGraphEdge>& AllEdges, TArray<int>& Out_DistanceTable)
+{
+	FPGNMoodGraph AuthoredGraph;
+	BuildGraph(AllVertices, AllEdges, AuthoredGraph);
 
-	return GeneratedDistanceMap;
+	PGNGraph::AllPairsShortestPaths(AuthoredGraph, Out_DistanceTable);
 }
@@ -4,9 +4,19 @@
 
 #include "CoreMinimal.h"
 #include "ProceduralNarrative/Graph.h"
+#include "ProceduralNarrative/Graphs/PGNGraph.h"
 #include "ProceduralNarrative/PGNUtilities.h"
 #include "MoodGraph.generated.h"
 
+// Every mood is a vertex slot, so the mood graph is a fixed-size matrix.
+template <>
+struct TPGNGraphEnumVertexCount<EPGNMood>
+{
+	static constexpr int32 Value = static_cast<int32>(EPGNMood::MOOD_Melancholy) + 1;
+};
+
+using FPGNMoodGraph = TPGNGraph<EPGNMood, int>;
+
 USTRUCT()
 struct FMoodGraphVertex
 {
@@ -82,7 +92,7 @@ struct FMoodGraphEdge
 	
 	friend uint32 GetTypeHash (const FMoodGraphEdge& Other)
 	{
-		return GetTypeHash(Other.DistanceBetweenVertices);
+		return HashCombine(GetTypeHash(Other.VertexA_Mood), GetTypeHash(Other.VertexB_Mood));
 	}
 };
 
@@ -96,14 +106,34 @@ class PROCEDURALNARRATIVE_API UMoodGraph : public UGraph
 
 public:
 
-	void InitializeMoodGraphWithAllData(TArray<FMoodGraphVertex> AllVertices, TArray<FMoodGraphEdge> AllEdges);
+	static constexpr int NUMBER_OF_MOODS = FPGNMoodGraph::NUMBER_OF_VERTICES;
+
+	void InitializeMoodGraphWithAllData(const TArray<FMoodGraphVertex>& AllVertices, const TArray<FMoodGraphEdge>& AllEdges);
 
 	virtual TMap<FMoodGraphVertex, int> CreateDistanceMapUsingDijkstra(FMoodGraphVertex& StartVertex);
-	
-	TSet<FMoodGraphVertex> Vertices;
-	TSet<FMoodGraphEdge> Edges;
 
-	// Map<Vertex<T>, List<VertexDistance<T>>> adjList;
-	TMap<FMoodGraphVertex, TArray<FMoodGraphVertexDistance>> AdjacencyList;
+	// The distance from this mood to every mood, indexed by mood. Unreachable moods are MAX_int32.
+	void CreateDistancesUsingDijkstra(EPGNMood StartMood, TArray<int>& Out_AllDistances) const;
+
+	// Finds the distance between every pair of moods so they can be read without touching the graph afterwards.
+	void CreateAllPairsDistanceTable(TArray<int>& Out_DistanceTable) const;
+
+	// The same table straight from the authored vertices and edges, without creating a UMoodGraph first.
+	static void CreateAllPairsDistanceTable(const TArray<FMoodGraphVertex>& AllVertices,
+		const TArray<FMoodGraphEdge>& AllEdges, TArray<int>& Out_DistanceTable);
+
+	static int GetIndexInDistanceTable(EPGNMood From, EPGNMood To)
+	{
+		return static_cast<int>(From) * NUMBER_OF_MOODS + static_cast<int>(To);
+	}
+
+	const FPGNMoodGraph& GetGraph() const { return Graph; }
+
+private:
+
+	static void BuildGraph(const TArray<FMoodGraphVertex>& AllVertices, const TArray<FMoodGraphEdge>& AllEdges,
+		FPGNMoodGraph& Out_Graph);
+
+	FPGNMoodGraph Graph;
 
 };
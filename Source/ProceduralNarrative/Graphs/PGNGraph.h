@@ -0,0 +1,453 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/IsEnum.h"
+#include "ProceduralNarrative/Generation/PGNScratchMemory.h"
+
+/*
+ * A small graph core that works on dense vertex indices instead of hashed vertex structs.
+ *
+ *	TPGNGraph<EnumType, WeightType>		Every value of the enum is a vertex slot, so the graph is a fixed-size adjacency
+ *										matrix whose size is known at compile time. Specialise
+ *										TPGNGraphEnumVertexCount for the enum to use it.
+ *	TPGNGraph<IntegerType, WeightType>	The key is the vertex index. Edges are stored in compressed sparse rows (CSR):
+ *										the neighbours of every vertex are contiguous, and the graph is rebuilt from an
+ *										edge list whenever it changes.
+ *
+ * Both expose the same interface, so BFS, Dijkstra and all-pairs shortest paths in PGNGraph:: are written once for
+ * either storage. Edges are undirected. A distance of UNREACHABLE means there is no path.
+ */
+
+// How many vertices an enum-keyed graph has. Specialise this next to the enum's graph.
+template <typename EnumType>
+struct TPGNGraphEnumVertexCount;
+
+template <typename VertexKeyType, bool bIsEnum = TIsEnum<VertexKeyType>::Value>
+struct TPGNGraphVertexTraits
+{
+	static constexpr bool bHasFixedNumberOfVertices = false;
+
+	static int32 ToIndex(VertexKeyType Vertex) { return static_cast<int32>(Vertex); }
+	static VertexKeyType FromIndex(int32 VertexIndex) { return static_cast<VertexKeyType>(VertexIndex); }
+};
+
+template <typename VertexKeyType>
+struct TPGNGraphVertexTraits<VertexKeyType, true>
+{
+	static constexpr bool bHasFixedNumberOfVertices = true;
+	static constexpr int32 NUMBER_OF_VERTICES = TPGNGraphEnumVertexCount<VertexKeyType>::Value;
+
+	static int32 ToIndex(VertexKeyType Vertex) { return static_cast<int32>(Vertex); }
+	static VertexKeyType FromIndex(int32 VertexIndex) { return static_cast<VertexKeyType>(VertexIndex); }
+};
+
+template <typename VertexKeyType, typename WeightType>
+struct TPGNGraphEdge
+{
+	VertexKeyType VertexA;
+	VertexKeyType VertexB;
+	WeightType Weight;
+};
+
+template <typename VertexKeyType, typename WeightType = int,
+	bool bHasFixedNumberOfVertices = TPGNGraphVertexTraits<VertexKeyType>::bHasFixedNumberOfVertices>
+class TPGNGraph;
+
+#pragma region Fixed-Size Graph
+
+template <typename VertexKeyType, typename WeightType>
+class TPGNGraph<VertexKeyType, WeightType, true>
+{
+public:
+
+	using FVertexTraits = TPGNGraphVertexTraits<VertexKeyType>;
+	using FWeight = WeightType;
+	using FEdge = TPGNGraphEdge<VertexKeyType, WeightType>;
+
+	static constexpr int32 NUMBER_OF_VERTICES = FVertexTraits::NUMBER_OF_VERTICES;
+	static constexpr WeightType UNREACHABLE = TNumericLimits<WeightType>::Max();
+
+	TPGNGraph()
+	{
+		Reset();
+	}
+
+	void Reset()
+	{
+		for (int32 Index_Vertex = 0; Index_Vertex < NUMBER_OF_VERTICES; Index_Vertex++)
+		{
+			bIsVertexInGraph[Index_Vertex] = false;
+		}
+
+		for (int32 Index_Weight = 0; Index_Weight < NUMBER_OF_VERTICES * NUMBER_OF_VERTICES; Index_Weight++)
+		{
+			EdgeWeights[Index_Weight] = UNREACHABLE;
+		}
+	}
+
+	// Edges whose vertices are not in the graph are ignored. If the same edge is added twice, the shorter one is kept.
+	void Build(TArrayView<const VertexKeyType> AllVertices, TArrayView<const FEdge> AllEdges)
+	{
+		Reset();
+
+		for (const VertexKeyType ThisVertex : AllVertices)
+		{
+			AddVertex(ThisVertex);
+		}
+
+		for (const FEdge& ThisEdge : AllEdges)
+		{
+			AddEdge(ThisEdge.VertexA, ThisEdge.VertexB, ThisEdge.Weight);
+		}
+	}
+
+	void AddVertex(VertexKeyType Vertex)
+	{
+		bIsVertexInGraph[FVertexTraits::ToIndex(Vertex)] = true;
+	}
+
+	bool AddEdge(VertexKeyType VertexA, VertexKeyType VertexB, WeightType Weight)
+	{
+		const int32 VertexIndexA = FVertexTraits::ToIndex(VertexA);
+		const int32 VertexIndexB = FVertexTraits::ToIndex(VertexB);
+
+		if (!HasVertex(VertexIndexA) || !HasVertex(VertexIndexB))
+		{
+			return false;
+		}
+
+		WeightType& WeightFromAToB = EdgeWeights[VertexIndexA * NUMBER_OF_VERTICES + VertexIndexB];
+		WeightType& WeightFromBToA = EdgeWeights[VertexIndexB * NUMBER_OF_VERTICES + VertexIndexA];
+
+		WeightFromAToB = FMath::Min(WeightFromAToB, Weight);
+		WeightFromBToA = FMath::Min(WeightFromBToA, Weight);
+
+		return true;
+	}
+
+	constexpr int32 GetNumberOfVertices() const { return NUMBER_OF_VERTICES; }
+
+	bool HasVertex(int32 VertexIndex) const
+	{
+		return VertexIndex >= 0 && VertexIndex < NUMBER_OF_VERTICES && bIsVertexInGraph[VertexIndex];
+	}
+
+	WeightType GetEdgeWeight(int32 VertexIndexA, int32 VertexIndexB) const
+	{
+		return EdgeWeights[VertexIndexA * NUMBER_OF_VERTICES + VertexIndexB];
+	}
+
+	// Calls Function(NeighbourIndex, Weight) for every edge of this vertex.
+	template <typename FunctionType>
+	void ForEachNeighbour(int32 VertexIndex, FunctionType&& Function) const
+	{
+		const WeightType* RowOfVertex = &EdgeWeights[VertexIndex * NUMBER_OF_VERTICES];
+
+		for (int32 Index_Neighbour = 0; Index_Neighbour < NUMBER_OF_VERTICES; Index_Neighbour++)
+		{
+			if (RowOfVertex[Index_Neighbour] != UNREACHABLE)
+			{
+				Function(Index_Neighbour, RowOfVertex[Index_Neighbour]);
+			}
+		}
+	}
+
+private:
+
+	bool bIsVertexInGraph[NUMBER_OF_VERTICES];
+	WeightType EdgeWeights[NUMBER_OF_VERTICES * NUMBER_OF_VERTICES];
+};
+
+#pragma endregion Fixed-Size Graph
+
+#pragma region Compressed Sparse Row Graph
+
+template <typename VertexKeyType, typename WeightType>
+class TPGNGraph<VertexKeyType, WeightType, false>
+{
+public:
+
+	using FVertexTraits = TPGNGraphVertexTraits<VertexKeyType>;
+	using FWeight = WeightType;
+	using FEdge = TPGNGraphEdge<VertexKeyType, WeightType>;
+
+	static constexpr WeightType UNREACHABLE = TNumericLimits<WeightType>::Max();
+
+	void Reset()
+	{
+		NeighbourOffsets.Reset();
+		AllNeighbours.Reset();
+		AllNeighbourWeights.Reset();
+	}
+
+	// Every index below InNumberOfVertices is a vertex; the ones that should not be are simply left without edges.
+	// Edges outside of that range, and edges from a vertex to itself, are ignored.
+	void Build(int32 InNumberOfVertices, TArrayView<const FEdge> AllEdges)
+	{
+		Reset();
+
+		NeighbourOffsets.SetNumZeroed(InNumberOfVertices + 1);
+
+		const auto IsValidEdge = [InNumberOfVertices](int32 VertexIndexA, int32 VertexIndexB)
+		{
+			return VertexIndexA != VertexIndexB && VertexIndexA >= 0 && VertexIndexA < InNumberOfVertices
+				&& VertexIndexB >= 0 && VertexIndexB < InNumberOfVertices;
+		};
+
+		// First count the degree of every vertex, then turn the counts into the start of each row.
+		for (const FEdge& ThisEdge : AllEdges)
+		{
+			const int32 VertexIndexA = FVertexTraits::ToIndex(ThisEdge.VertexA);
+			const int32 VertexIndexB = FVertexTraits::ToIndex(ThisEdge.VertexB);
+
+			if (IsValidEdge(VertexIndexA, VertexIndexB))
+			{
+				NeighbourOffsets[VertexIndexA + 1]++;
+				NeighbourOffsets[VertexIndexB + 1]++;
+			}
+		}
+
+		for (int32 Index_Vertex = 0; Index_Vertex < InNumberOfVertices; Index_Vertex++)
+		{
+			NeighbourOffsets[Index_Vertex + 1] += NeighbourOffsets[Index_Vertex];
+		}
+
+		AllNeighbours.SetNumUninitialized(NeighbourOffsets[InNumberOfVertices]);
+		AllNeighbourWeights.SetNumUninitialized(NeighbourOffsets[InNumberOfVertices]);
+
+		// Then fill every row, using a copy of the offsets as the write position of each row.
+		TArray<int32> NextNeighbourInRow(NeighbourOffsets.GetData(), InNumberOfVertices);
+
+		for (const FEdge& ThisEdge : AllEdges)
+		{
+			const int32 VertexIndexA = FVertexTraits::ToIndex(ThisEdge.VertexA);
+			const int32 VertexIndexB = FVertexTraits::ToIndex(ThisEdge.VertexB);
+
+			if (!IsValidEdge(VertexIndexA, VertexIndexB))
+			{
+				continue;
+			}
+
+			const int32 PositionInRowOfA = NextNeighbourInRow[VertexIndexA]++;
+			AllNeighbours[PositionInRowOfA] = VertexIndexB;
+			AllNeighbourWeights[PositionInRowOfA] = ThisEdge.Weight;
+
+			const int32 PositionInRowOfB = NextNeighbourInRow[VertexIndexB]++;
+			AllNeighbours[PositionInRowOfB] = VertexIndexA;
+			AllNeighbourWeights[PositionInRowOfB] = ThisEdge.Weight;
+		}
+	}
+
+	int32 GetNumberOfVertices() const { return FMath::Max(NeighbourOffsets.Num() - 1, 0); }
+	int32 GetNumberOfEdges() const { return AllNeighbours.Num() / 2; }
+
+	bool HasVertex(int32 VertexIndex) const { return VertexIndex >= 0 && VertexIndex < GetNumberOfVertices(); }
+
+	TArrayView<const int32> GetNeighbours(int32 VertexIndex) const
+	{
+		return TArrayView<const int32>(AllNeighbours.GetData() + NeighbourOffsets[VertexIndex],
+			NeighbourOffsets[VertexIndex + 1] - NeighbourOffsets[VertexIndex]);
+	}
+
+	// Calls Function(NeighbourIndex, Weight) for every edge of this vertex.
+	template <typename FunctionType>
+	void ForEachNeighbour(int32 VertexIndex, FunctionType&& Function) const
+	{
+		for (int32 Index_Neighbour = NeighbourOffsets[VertexIndex]; Index_Neighbour < NeighbourOffsets[VertexIndex + 1]; Index_Neighbour++)
+		{
+			Function(AllNeighbours[Index_Neighbour], AllNeighbourWeights[Index_Neighbour]);
+		}
+	}
+
+	SIZE_T GetAllocatedSize() const
+	{
+		return NeighbourOffsets.GetAllocatedSize() + AllNeighbours.GetAllocatedSize()
+			+ AllNeighbourWeights.GetAllocatedSize();
+	}
+
+private:
+
+	// The neighbours of vertex V are AllNeighbours[NeighbourOffsets[V]] up to, but not including,
+	// AllNeighbours[NeighbourOffsets[V + 1]].
+	TArray<int32> NeighbourOffsets;
+	TArray<int32> AllNeighbours;
+	TArray<WeightType> AllNeighbourWeights;
+};
+
+#pragma endregion Compressed Sparse Row Graph
+
+#pragma region Kernels
+
+namespace PGNGraph
+{
+	// Above this many vertices, all-pairs shortest paths runs Dijkstra from every vertex instead of Floyd-Warshall.
+	static constexpr int32 MAXIMUM_VERTICES_FOR_FLOYD_WARSHALL = 64;
+
+	// The number of edges on the shortest path from the source to every vertex, ignoring weights.
+	template <typename GraphType, typename AllocatorType>
+	void BreadthFirstSearch(const GraphType& Graph, int32 SourceVertexIndex, TArray<int32, AllocatorType>& Out_AllHops)
+	{
+		const int32 NumberOfVertices = Graph.GetNumberOfVertices();
+		Out_AllHops.Init(MAX_int32, NumberOfVertices);
+
+		if (!Graph.HasVertex(SourceVertexIndex))
+		{
+			return;
+		}
+
+		// The output is sized before the scope is opened, so it is never released along with the scratch memory.
+		FPGNGenerationScratchScope ScratchScope;
+
+		TPGNScratchArray<int32> Queue;
+		Queue.Reserve(NumberOfVertices);
+		Queue.Add(SourceVertexIndex);
+		Out_AllHops[SourceVertexIndex] = 0;
+
+		for (int32 Index_Queue = 0; Index_Queue < Queue.Num(); Index_Queue++)
+		{
+			const int32 ThisVertexIndex = Queue[Index_Queue];
+			const int32 HopsToNeighbours = Out_AllHops[ThisVertexIndex] + 1;
+
+			Graph.ForEachNeighbour(ThisVertexIndex, [&](int32 NeighbourIndex, typename GraphType::FWeight)
+			{
+				if (Out_AllHops[NeighbourIndex] == MAX_int32)
+				{
+					Out_AllHops[NeighbourIndex] = HopsToNeighbours;
+					Queue.Add(NeighbourIndex);
+				}
+			});
+		}
+	}
+
+	// The length of the shortest path from the source to every vertex. Weights must not be negative.
+	template <typename GraphType, typename AllocatorType>
+	void Dijkstra(const GraphType& Graph, int32 SourceVertexIndex,
+		TArray<typename GraphType::FWeight, AllocatorType>& Out_AllDistances)
+	{
+		using FWeight = typename GraphType::FWeight;
+
+		const int32 NumberOfVertices = Graph.GetNumberOfVertices();
+		Out_AllDistances.Init(GraphType::UNREACHABLE, NumberOfVertices);
+
+		if (!Graph.HasVertex(SourceVertexIndex))
+		{
+			return;
+		}
+
+		FPGNGenerationScratchScope ScratchScope;
+
+		struct FQueuedVertex
+		{
+			FWeight Distance;
+			int32 VertexIndex;
+		};
+
+		const auto ClosestVertexFirst = [](const FQueuedVertex& A, const FQueuedVertex& B)
+		{
+			return A.Distance < B.Distance;
+		};
+
+		// The queue is a binary heap, and a vertex can be queued more than once; only its first pop counts.
+		TPGNScratchArray<FQueuedVertex> Queue;
+		Queue.Reserve(NumberOfVertices);
+		Queue.HeapPush({ FWeight(0), SourceVertexIndex }, ClosestVertexFirst);
+		Out_AllDistances[SourceVertexIndex] = FWeight(0);
+
+		while (Queue.Num() > 0)
+		{
+			FQueuedVertex ThisQueuedVertex;
+			Queue.HeapPop(ThisQueuedVertex, ClosestVertexFirst, false);
+
+			if (ThisQueuedVertex.Distance > Out_AllDistances[ThisQueuedVertex.VertexIndex])
+			{
+				continue;
+			}
+
+			Graph.ForEachNeighbour(ThisQueuedVertex.VertexIndex, [&](int32 NeighbourIndex, FWeight Weight)
+			{
+				const FWeight DistanceThroughThisVertex = ThisQueuedVertex.Distance + Weight;
+
+				if (DistanceThroughThisVertex < Out_AllDistances[NeighbourIndex])
+				{
+					Out_AllDistances[NeighbourIndex] = DistanceThroughThisVertex;
+					Queue.HeapPush({ DistanceThroughThisVertex, NeighbourIndex }, ClosestVertexFirst);
+				}
+			});
+		}
+	}
+
+	// Out_DistanceTable[From * NumberOfVertices + To] for every pair. Vertices that are not in the graph are
+	// unreachable from everything, including themselves.
+	template <typename GraphType>
+	void AllPairsShortestPaths(const GraphType& Graph, TArray<typename GraphType::FWeight>& Out_DistanceTable)
+	{
+		using FWeight = typename GraphType::FWeight;
+
+		const int32 NumberOfVertices = Graph.GetNumberOfVertices();
+		Out_DistanceTable.Init(GraphType::UNREACHABLE, NumberOfVertices * NumberOfVertices);
+
+		if (NumberOfVertices > MAXIMUM_VERTICES_FOR_FLOYD_WARSHALL)
+		{
+			TArray<FWeight> DistancesFromThisVertex;
+
+			for (int32 Index_From = 0; Index_From < NumberOfVertices; Index_From++)
+			{
+				if (!Graph.HasVertex(Index_From))
+				{
+					continue;
+				}
+
+				Dijkstra(Graph, Index_From, DistancesFromThisVertex);
+				FMemory::Memcpy(&Out_DistanceTable[Index_From * NumberOfVertices], DistancesFromThisVertex.GetData(),
+					NumberOfVertices * sizeof(FWeight));
+			}
+
+			return;
+		}
+
+		// For a graph this small, Floyd-Warshall is both the simplest and the fastest way to get every pair.
+		for (int32 Index_From = 0; Index_From < NumberOfVertices; Index_From++)
+		{
+			if (!Graph.HasVertex(Index_From))
+			{
+				continue;
+			}
+
+			Out_DistanceTable[Index_From * NumberOfVertices + Index_From] = FWeight(0);
+
+			Graph.ForEachNeighbour(Index_From, [&](int32 NeighbourIndex, FWeight Weight)
+			{
+				FWeight& DistanceFromTo = Out_DistanceTable[Index_From * NumberOfVertices + NeighbourIndex];
+				DistanceFromTo = FMath::Min(DistanceFromTo, Weight);
+			});
+		}
+
+		for (int32 Index_Through = 0; Index_Through < NumberOfVertices; Index_Through++)
+		{
+			for (int32 Index_From = 0; Index_From < NumberOfVertices; Index_From++)
+			{
+				const FWeight DistanceToThrough = Out_DistanceTable[Index_From * NumberOfVertices + Index_Through];
+				if (DistanceToThrough == GraphType::UNREACHABLE)
+				{
+					continue;
+				}
+
+				for (int32 Index_To = 0; Index_To < NumberOfVertices; Index_To++)
+				{
+					const FWeight DistanceFromThrough = Out_DistanceTable[Index_Through * NumberOfVertices + Index_To];
+					if (DistanceFromThrough == GraphType::UNREACHABLE)
+					{
+						continue;
+					}
+
+					FWeight& DistanceFromTo = Out_DistanceTable[Index_From * NumberOfVertices + Index_To];
+					DistanceFromTo = FMath::Min(DistanceFromTo, DistanceToThrough + DistanceFromThrough);
+				}
+			}
+		}
+	}
+}
+
+#pragma endregion Kernels
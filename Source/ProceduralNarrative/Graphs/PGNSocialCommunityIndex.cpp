@@ -0,0 +1,313 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/Graphs/PGNSocialCommunityIndex.h"
+
+#include "Async/ParallelFor.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "ProceduralNarrative/Graphs/CharacterGraph.h"
+
+void FPGNSocialCommunityIndex::Initialize(UCharacterGraph* InCharacterGraph)
+{
+	CharacterGraph = InCharacterGraph;
+
+	bAreComponentsStale = true;
+	CommunityGraphVersion = INDEX_NONE;
+
+	RefreshComponents();
+}
+
+void FPGNSocialCommunityIndex::Reset()
+{
+	CharacterGraph = nullptr;
+
+	ParentOfCharacter.Reset();
+	SizeOfComponent.Reset();
+	bAreComponentsStale = true;
+
+	CommunityOfCharacter.Reset();
+	SizeOfCommunity.Reset();
+	CommunityGraphVersion = INDEX_NONE;
+}
+
+SIZE_T FPGNSocialCommunityIndex::GetAllocatedSize() const
+{
+	return ParentOfCharacter.GetAllocatedSize() + SizeOfComponent.GetAllocatedSize()
+		+ CommunityOfCharacter.GetAllocatedSize() + SizeOfCommunity.GetAllocatedSize();
+}
+
+#pragma region Incremental Changes
+
+void FPGNSocialCommunityIndex::OnCharacterAdded(int32 IndexOfCharacter)
+{
+	// Anyone who arrives starts in a component of their own.
+	while (ParentOfCharacter.Num() <= IndexOfCharacter)
+	{
+		ParentOfCharacter.Add(ParentOfCharacter.Num());
+		SizeOfComponent.Add(1);
+	}
+}
+
+void FPGNSocialCommunityIndex::OnRelationshipAdded(int32 IndexOfCharacterA, int32 IndexOfCharacterB)
+{
+	// Stale components will be found from the graph in full anyway.
+	if (bAreComponentsStale)
+	{
+		return;
+	}
+
+	OnCharacterAdded(FMath::Max(IndexOfCharacterA, IndexOfCharacterB));
+	UniteComponents(IndexOfCharacterA, IndexOfCharacterB);
+}
+
+void FPGNSocialCommunityIndex::OnRelationshipRemoved(int32 IndexOfCharacterA, int32 IndexOfCharacterB)
+{
+	bAreComponentsStale = true;
+}
+
+#pragma endregion Incremental Changes
+
+#pragma region Components
+
+int32 FPGNSocialCommunityIndex::FindComponent(int32 IndexOfCharacter)
+{
+	RefreshComponents();
+
+	if (!IsInGraph(IndexOfCharacter) || !ParentOfCharacter.IsValidIndex(IndexOfCharacter))
+	{
+		return INDEX_NONE;
+	}
+
+	return FindRoot(IndexOfCharacter);
+}
+
+int32 FPGNSocialCommunityIndex::GetSizeOfComponent(int32 IndexOfCharacter)
+{
+	const int32 IndexOfComponent = FindComponent(IndexOfCharacter);
+	return IndexOfComponent != INDEX_NONE ? SizeOfComponent[IndexOfComponent] : 0;
+}
+
+bool FPGNSocialCommunityIndex::AreInSameComponent(int32 IndexOfCharacterA, int32 IndexOfCharacterB)
+{
+	const int32 IndexOfComponent = FindComponent(IndexOfCharacterA);
+	return IndexOfComponent != INDEX_NONE && IndexOfComponent == FindComponent(IndexOfCharacterB);
+}
+
+void FPGNSocialCommunityIndex::GatherCharactersInSameComponent(int32 IndexOfCharacter,
+	TArray<int32>& Out_AllIndicesOfCharacters)
+{
+	Out_AllIndicesOfCharacters.Reset();
+
+	const int32 IndexOfComponent = FindComponent(IndexOfCharacter);
+
+	if (IndexOfComponent == INDEX_NONE)
+	{
+		return;
+	}
+
+	Out_AllIndicesOfCharacters.Reserve(SizeOfComponent[IndexOfComponent]);
+
+	for (int32 Index_Character = 0; Index_Character < ParentOfCharacter.Num(); Index_Character++)
+	{
+		if (IsInGraph(Index_Character) && FindRoot(Index_Character) == IndexOfComponent)
+		{
+			Out_AllIndicesOfCharacters.Add(Index_Character);
+		}
+	}
+}
+
+int32 FPGNSocialCommunityIndex::FindRoot(int32 IndexOfCharacter)
+{
+	while (ParentOfCharacter[IndexOfCharacter] != IndexOfCharacter)
+	{
+		ParentOfCharacter[IndexOfCharacter] = ParentOfCharacter[ParentOfCharacter[IndexOfCharacter]];
+		IndexOfCharacter = ParentOfCharacter[IndexOfCharacter];
+	}
+
+	return IndexOfCharacter;
+}
+
+void FPGNSocialCommunityIndex::UniteComponents(int32 IndexOfCharacterA, int32 IndexOfCharacterB)
+{
+	int32 RootOfA = FindRoot(IndexOfCharacterA);
+	int32 RootOfB = FindRoot(IndexOfCharacterB);
+
+	if (RootOfA == RootOfB)
+	{
+		return;
+	}
+
+	// The smaller component goes under the larger one, so that no path gets long.
+	if (SizeOfComponent[RootOfA] < SizeOfComponent[RootOfB])
+	{
+		Swap(RootOfA, RootOfB);
+	}
+
+	ParentOfCharacter[RootOfB] = RootOfA;
+	SizeOfComponent[RootOfA] += SizeOfComponent[RootOfB];
+}
+
+void FPGNSocialCommunityIndex::RefreshComponents()
+{
+	if (!bAreComponentsStale || CharacterGraph == nullptr)
+	{
+		return;
+	}
+
+	ParentOfCharacter.Reset();
+	SizeOfComponent.Reset();
+	OnCharacterAdded(CharacterGraph->CharacterAdjacencyList.Num() - 1);
+
+	for (const FCharacterGraphEdge& ThisEdge : CharacterGraph->AllEdges)
+	{
+		UniteComponents(ThisEdge.VertexA.IndexInAllCharactersArray, ThisEdge.VertexB.IndexInAllCharactersArray);
+	}
+
+	bAreComponentsStale = false;
+}
+
+#pragma endregion Components
+
+#pragma region Communities
+
+int32 FPGNSocialCommunityIndex::FindCommunity(int32 IndexOfCharacter)
+{
+	RefreshCommunities();
+
+	if (!IsInGraph(IndexOfCharacter) || !CommunityOfCharacter.IsValidIndex(IndexOfCharacter))
+	{
+		return INDEX_NONE;
+	}
+
+	return CommunityOfCharacter[IndexOfCharacter];
+}
+
+int32 FPGNSocialCommunityIndex::GetSizeOfCommunity(int32 IndexOfCharacter)
+{
+	const int32 IndexOfCommunity = FindCommunity(IndexOfCharacter);
+	return IndexOfCommunity != INDEX_NONE ? SizeOfCommunity[IndexOfCommunity] : 0;
+}
+
+void FPGNSocialCommunityIndex::GatherCharactersInSameCommunity(int32 IndexOfCharacter,
+	TArray<int32>& Out_AllIndicesOfCharacters)
+{
+	Out_AllIndicesOfCharacters.Reset();
+
+	const int32 IndexOfCommunity = FindCommunity(IndexOfCharacter);
+
+	if (IndexOfCommunity == INDEX_NONE)
+	{
+		return;
+	}
+
+	Out_AllIndicesOfCharacters.Reserve(SizeOfCommunity[IndexOfCommunity]);
+
+	for (int32 Index_Character = 0; Index_Character < CommunityOfCharacter.Num(); Index_Character++)
+	{
+		if (CommunityOfCharacter[Index_Character] == IndexOfCommunity && IsInGraph(Index_Character))
+		{
+			Out_AllIndicesOfCharacters.Add(Index_Character);
+		}
+	}
+}
+
+void FPGNSocialCommunityIndex::RefreshCommunities()
+{
+	if (CharacterGraph == nullptr || CommunityGraphVersion == CharacterGraph->GetGraphVersion())
+	{
+		return;
+	}
+
+	const FPGNCharacterGraph& Graph = CharacterGraph->GetCompactGraph();
+	const int32 NumberOfCharacters = Graph.GetNumberOfVertices();
+
+	TArray<int32> NextCommunityOfCharacter;
+	NextCommunityOfCharacter.SetNumUninitialized(NumberOfCharacters);
+
+	CommunityOfCharacter.SetNumUninitialized(NumberOfCharacters);
+
+	for (int32 Index_Character = 0; Index_Character < NumberOfCharacters; Index_Character++)
+	{
+		CommunityOfCharacter[Index_Character] = Index_Character;
+	}
+
+	const int32 NumberOfChangesForConvergence = FMath::FloorToInt(NumberOfCharacters * SHARE_OF_CHANGES_FOR_CONVERGENCE);
+
+	for (int32 Index_Round = 0; Index_Round < MAXIMUM_ROUNDS_OF_LABEL_PROPAGATION; Index_Round++)
+	{
+		FThreadSafeCounter NumberOfChanges;
+
+		// Every character only reads the previous round and writes their own slot of the next one.
+		ParallelFor(NumberOfCharacters, [&](int32 Index_Character)
+		{
+			const int32 CurrentCommunity = CommunityOfCharacter[Index_Character];
+
+			// Staying put counts as much as one acquaintance, so that two halves of a pair cannot keep swapping.
+			TArray<TPair<int32, float>, TInlineAllocator<16>> AllWeightsOfCommunities;
+			AllWeightsOfCommunities.Emplace(CurrentCommunity, 1.f);
+
+			Graph.ForEachNeighbour(Index_Character, [&](int32 IndexOfNeighbour, int DistanceToNeighbour)
+			{
+				const int32 CommunityOfNeighbour = CommunityOfCharacter[IndexOfNeighbour];
+				const float Weight = 1.f / FMath::Max(DistanceToNeighbour, 1);
+
+				if (TPair<int32, float>* ThisWeight = AllWeightsOfCommunities.FindByPredicate(
+					[CommunityOfNeighbour](const TPair<int32, float>& Entry) { return Entry.Key == CommunityOfNeighbour; }))
+				{
+					ThisWeight->Value += Weight;
+				}
+				else
+				{
+					AllWeightsOfCommunities.Emplace(CommunityOfNeighbour, Weight);
+				}
+			});
+
+			// Ties go to the community with the lowest ID, so that the result does not depend on the order of edges.
+			int32 BestCommunity = CurrentCommunity;
+			float BestWeight = 0.f;
+
+			for (const TPair<int32, float>& ThisWeight : AllWeightsOfCommunities)
+			{
+				if (ThisWeight.Value > BestWeight || (ThisWeight.Value == BestWeight && ThisWeight.Key < BestCommunity))
+				{
+					BestCommunity = ThisWeight.Key;
+					BestWeight = ThisWeight.Value;
+				}
+			}
+
+			NextCommunityOfCharacter[Index_Character] = BestCommunity;
+
+			if (BestCommunity != CurrentCommunity)
+			{
+				NumberOfChanges.Increment();
+			}
+		});
+
+		Swap(CommunityOfCharacter, NextCommunityOfCharacter);
+
+		if (NumberOfChanges.GetValue() <= NumberOfChangesForConvergence)
+		{
+			break;
+		}
+	}
+
+	SizeOfCommunity.Reset();
+	SizeOfCommunity.SetNumZeroed(NumberOfCharacters);
+
+	for (int32 Index_Character = 0; Index_Character < NumberOfCharacters; Index_Character++)
+	{
+		if (IsInGraph(Index_Character))
+		{
+			SizeOfCommunity[CommunityOfCharacter[Index_Character]]++;
+		}
+	}
+
+	CommunityGraphVersion = CharacterGraph->GetGraphVersion();
+}
+
+#pragma endregion Communities
+
+bool FPGNSocialCommunityIndex::IsInGraph(int32 IndexOfCharacter) const
+{
+	return CharacterGraph != nullptr && CharacterGraph->HasVertex(IndexOfCharacter);
+}
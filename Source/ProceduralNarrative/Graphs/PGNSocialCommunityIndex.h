@@ -0,0 +1,97 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UCharacterGraph;
+
+/**
+ * Knows which characters can reach each other through the people they know, so that casting only has to look at the
+ * people who are actually connected to the cast instead of the whole town.
+ *
+ *	Components	Everyone who is connected at all. They are kept in a union-find with path halving and union by
+ *				size, which new relationships are added to as they are made. A union-find cannot split, so removing a
+ *				relationship only marks the components as stale, and they are found again from the character graph the
+ *				next time they are asked for.
+ *	Communities	Tightly knit groups within a component, found by label propagation: everyone starts in a community of
+ *				their own and then, for a number of rounds, joins whichever community their acquaintances mostly
+ *				belong to, with closer acquaintances counting for more. Every round updates all characters at once
+ *				from the previous round, so it runs in parallel and always gives the same result. They are only found
+ *				when asked for, and again whenever the graph has changed since.
+ *
+ * Component and community IDs are only stable until the next change to the graph. Characters who are not in the
+ * graph are in neither.
+ */
+class PROCEDURALNARRATIVE_API FPGNSocialCommunityIndex
+{
+public:
+
+	static constexpr int32 MAXIMUM_ROUNDS_OF_LABEL_PROPAGATION = 20;
+
+	// Label propagation stops early once fewer than this share of the characters change community in a round.
+	static constexpr float SHARE_OF_CHANGES_FOR_CONVERGENCE = 0.001f;
+
+	// The character graph must outlive the index.
+	void Initialize(UCharacterGraph* InCharacterGraph);
+	void Reset();
+
+	bool IsInitialized() const { return CharacterGraph != nullptr; }
+
+#pragma region Incremental Changes
+
+	void OnCharacterAdded(int32 IndexOfCharacter);
+	void OnRelationshipAdded(int32 IndexOfCharacterA, int32 IndexOfCharacterB);
+
+	// This is also how characters who leave town are taken out of their component, one relationship at a time.
+	void OnRelationshipRemoved(int32 IndexOfCharacterA, int32 IndexOfCharacterB);
+
+#pragma endregion Incremental Changes
+
+#pragma region Components
+
+	// INDEX_NONE if the character is not in the graph.
+	int32 FindComponent(int32 IndexOfCharacter);
+	int32 GetSizeOfComponent(int32 IndexOfCharacter);
+
+	bool AreInSameComponent(int32 IndexOfCharacterA, int32 IndexOfCharacterB);
+
+	void GatherCharactersInSameComponent(int32 IndexOfCharacter, TArray<int32>& Out_AllIndicesOfCharacters);
+
+#pragma endregion Components
+
+#pragma region Communities
+
+	// INDEX_NONE if the character is not in the graph.
+	int32 FindCommunity(int32 IndexOfCharacter);
+	int32 GetSizeOfCommunity(int32 IndexOfCharacter);
+
+	void GatherCharactersInSameCommunity(int32 IndexOfCharacter, TArray<int32>& Out_AllIndicesOfCharacters);
+
+#pragma endregion Communities
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+
+	// Follows the character up to the root of their component, halving the path on the way.
+	int32 FindRoot(int32 IndexOfCharacter);
+	void UniteComponents(int32 IndexOfCharacterA, int32 IndexOfCharacterB);
+
+	void RefreshComponents();
+	void RefreshCommunities();
+
+	bool IsInGraph(int32 IndexOfCharacter) const;
+
+	UCharacterGraph* CharacterGraph = nullptr;
+
+	// Indexed by character. Only the sizes of roots mean anything.
+	TArray<int32> ParentOfCharacter;
+	TArray<int32> SizeOfComponent;
+	bool bAreComponentsStale = true;
+
+	// Indexed by character. A community is named after one of its members, so its size is indexed by character too.
+	TArray<int32> CommunityOfCharacter;
+	TArray<int32> SizeOfCommunity;
+	int32 CommunityGraphVersion = INDEX_NONE;
+};
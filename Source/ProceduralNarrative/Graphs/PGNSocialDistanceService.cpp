@@ -0,0 +1,404 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/Graphs/PGNSocialDistanceService.h"
+
+#include "Async/ParallelFor.h"
+#include "ProceduralNarrative/Graphs/CharacterGraph.h"
+#include "ProceduralNarrative/Memory/PGNMemoryTracking.h"
+
+FPGNSocialDistanceService::FPGNSocialDistanceService()
+	: CachedDistances(1)
+	, CachedHops(1)
+{
+}
+
+void FPGNSocialDistanceService::Initialize(UCharacterGraph* InCharacterGraph, int32 NumberOfSourcesToCache)
+{
+	CharacterGraph = InCharacterGraph;
+	CachedGraphVersion = INDEX_NONE;
+
+	CachedDistances.Empty(FMath::Max(NumberOfSourcesToCache, 1));
+	CachedHops.Empty(FMath::Max(NumberOfSourcesToCache, 1));
+}
+
+void FPGNSocialDistanceService::Reset()
+{
+	CharacterGraph = nullptr;
+	CachedGraphVersion = INDEX_NONE;
+
+	EmptyCaches();
+}
+
+void FPGNSocialDistanceService::EmptyCaches()
+{
+	CachedDistances.Empty(CachedDistances.Max());
+	CachedHops.Empty(CachedHops.Max());
+}
+
+SIZE_T FPGNSocialDistanceService::GetAllocatedSize() const
+{
+	return FPGNMemoryTracking::GetAllocatedSizeOfLruCache(CachedDistances,
+			[](const TArray<int>& AllDistances) { return AllDistances.GetAllocatedSize(); })
+		+ FPGNMemoryTracking::GetAllocatedSizeOfLruCache(CachedHops,
+			[](const TArray<int32>& AllHops) { return AllHops.GetAllocatedSize(); });
+}
+
+const FPGNCharacterGraph* FPGNSocialDistanceService::RefreshCompactGraph()
+{
+	if (CharacterGraph == nullptr)
+	{
+		return nullptr;
+	}
+
+	// Any edge that changed can shorten or lengthen a path between anyone, so every cached source is out of date.
+	if (CachedGraphVersion != CharacterGraph->GetGraphVersion())
+	{
+		CachedDistances.Empty(CachedDistances.Max());
+		CachedHops.Empty(CachedHops.Max());
+		CachedGraphVersion = CharacterGraph->GetGraphVersion();
+	}
+
+	return &CharacterGraph->GetCompactGraph();
+}
+
+const TArray<int>* FPGNSocialDistanceService::GetDistancesFromCharacter(int32 IndexOfCharacter)
+{
+	PGN_LLM_SCOPE(Caches);
+
+	const FPGNCharacterGraph* Graph = RefreshCompactGraph();
+
+	if (Graph == nullptr || !Graph->HasVertex(IndexOfCharacter))
+	{
+		return nullptr;
+	}
+
+	if (const TArray<int>* CachedDistancesFromCharacter = CachedDistances.FindAndTouch(IndexOfCharacter))
+	{
+		return CachedDistancesFromCharacter;
+	}
+
+	TArray<int> DistancesFromCharacter;
+	PGNGraph::Dijkstra(*Graph, IndexOfCharacter, DistancesFromCharacter);
+
+	CachedDistances.Add(IndexOfCharacter, MoveTemp(DistancesFromCharacter));
+	return CachedDistances.FindAndTouch(IndexOfCharacter);
+}
+
+const TArray<int32>* FPGNSocialDistanceService::GetHopsFromCharacter(int32 IndexOfCharacter)
+{
+	PGN_LLM_SCOPE(Caches);
+
+	const FPGNCharacterGraph* Graph = RefreshCompactGraph();
+
+	if (Graph == nullptr || !Graph->HasVertex(IndexOfCharacter))
+	{
+		return nullptr;
+	}
+
+	if (const TArray<int32>* CachedHopsFromCharacter = CachedHops.FindAndTouch(IndexOfCharacter))
+	{
+		return CachedHopsFromCharacter;
+	}
+
+	// A single source does not gain anything from the bit-parallel search, so we use the plain one.
+	TArray<int32> HopsFromCharacter;
+	PGNGraph::BreadthFirstSearch(*Graph, IndexOfCharacter, HopsFromCharacter);
+
+	CachedHops.Add(IndexOfCharacter, MoveTemp(HopsFromCharacter));
+	return CachedHops.FindAndTouch(IndexOfCharacter);
+}
+
+void FPGNSocialDistanceService::FindDistancesFromCharacters(TArrayView<const int32> AllIndicesOfSources,
+	TArray<TArray<int>>& Out_AllDistances)
+{
+	PGN_LLM_SCOPE(Caches);
+
+	Out_AllDistances.Reset();
+	Out_AllDistances.SetNum(AllIndicesOfSources.Num());
+
+	const FPGNCharacterGraph* Graph = RefreshCompactGraph();
+
+	if (Graph == nullptr)
+	{
+		return;
+	}
+
+	// First take everything we already have, and collect the sources that still have to be searched from.
+	TArray<int32> AllPositionsToFind;
+
+	for (int32 Index_Source = 0; Index_Source < AllIndicesOfSources.Num(); Index_Source++)
+	{
+		if (const TArray<int>* CachedDistancesFromSource = CachedDistances.FindAndTouch(AllIndicesOfSources[Index_Source]))
+		{
+			Out_AllDistances[Index_Source] = *CachedDistancesFromSource;
+		}
+		else if (Graph->HasVertex(AllIndicesOfSources[Index_Source]))
+		{
+			AllPositionsToFind.Add(Index_Source);
+		}
+		else
+		{
+			Out_AllDistances[Index_Source].Init(MAX_int32, Graph->GetNumberOfVertices());
+		}
+	}
+
+	// The compact graph is only read from here on, so every search can run on its own worker.
+	ParallelFor(AllPositionsToFind.Num(), [&](int32 Index_Position)
+	{
+		const int32 Index_Source = AllPositionsToFind[Index_Position];
+		PGNGraph::Dijkstra(*Graph, AllIndicesOfSources[Index_Source], Out_AllDistances[Index_Source]);
+	});
+
+	for (const int32 Index_Source : AllPositionsToFind)
+	{
+		CachedDistances.Add(AllIndicesOfSources[Index_Source], Out_AllDistances[Index_Source]);
+	}
+}
+
+void FPGNSocialDistanceService::FindHopsFromCharacters(TArrayView<const int32> AllIndicesOfSources,
+	TArray<TArray<int32>>& Out_AllHops)
+{
+	PGN_LLM_SCOPE(Caches);
+
+	Out_AllHops.Reset();
+	Out_AllHops.SetNum(AllIndicesOfSources.Num());
+
+	const FPGNCharacterGraph* Graph = RefreshCompactGraph();
+
+	if (Graph == nullptr)
+	{
+		return;
+	}
+
+	TArray<int32> AllPositionsToFind;
+
+	for (int32 Index_Source = 0; Index_Source < AllIndicesOfSources.Num(); Index_Source++)
+	{
+		if (const TArray<int32>* CachedHopsFromSource = CachedHops.FindAndTouch(AllIndicesOfSources[Index_Source]))
+		{
+			Out_AllHops[Index_Source] = *CachedHopsFromSource;
+		}
+		else
+		{
+			AllPositionsToFind.Add(Index_Source);
+		}
+	}
+
+	// Every pass searches from as many sources as there are bits in a word.
+	TArray<int32> SourcesInThisPass;
+	TArray<TArray<int32>> HopsInThisPass;
+
+	for (int32 Index_FirstPosition = 0; Index_FirstPosition < AllPositionsToFind.Num(); Index_FirstPosition += SOURCES_PER_BREADTH_FIRST_PASS)
+	{
+		const int32 NumberOfSourcesInThisPass = FMath::Min(SOURCES_PER_BREADTH_FIRST_PASS,
+			AllPositionsToFind.Num() - Index_FirstPosition);
+
+		SourcesInThisPass.Reset();
+
+		for (int32 Index_Position = 0; Index_Position < NumberOfSourcesInThisPass; Index_Position++)
+		{
+			SourcesInThisPass.Add(AllIndicesOfSources[AllPositionsToFind[Index_FirstPosition + Index_Position]]);
+		}
+
+		HopsInThisPass.Reset();
+		HopsInThisPass.SetNum(NumberOfSourcesInThisPass);
+		RunBitParallelBreadthFirstSearch(*Graph, SourcesInThisPass, HopsInThisPass);
+
+		for (int32 Index_Position = 0; Index_Position < NumberOfSourcesInThisPass; Index_Position++)
+		{
+			const int32 Index_Source = AllPositionsToFind[Index_FirstPosition + Index_Position];
+
+			if (Graph->HasVertex(AllIndicesOfSources[Index_Source]))
+			{
+				CachedHops.Add(AllIndicesOfSources[Index_Source], HopsInThisPass[Index_Position]);
+			}
+
+			Out_AllHops[Index_Source] = MoveTemp(HopsInThisPass[Index_Position]);
+		}
+	}
+}
+
+void FPGNSocialDistanceService::RunBitParallelBreadthFirstSearch(const FPGNCharacterGraph& Graph,
+	TArrayView<const int32> AllIndicesOfSources, TArrayView<TArray<int32>> Out_AllHops)
+{
+	check(AllIndicesOfSources.Num() <= SOURCES_PER_BREADTH_FIRST_PASS);
+
+	const int32 NumberOfVertices = Graph.GetNumberOfVertices();
+
+	for (TArray<int32>& ThisHops : Out_AllHops)
+	{
+		ThisHops.Init(MAX_int32, NumberOfVertices);
+	}
+
+	FPGNGenerationScratchScope ScratchScope;
+
+	// Bit N of each word stands for the Nth source: which sources have reached each vertex, which reached it on the
+	// last level, and which reach it on this one.
+	TPGNScratchArray<uint64> AllVisitedSources;
+	TPGNScratchArray<uint64> AllFrontierSources;
+	TPGNScratchArray<uint64> AllNextFrontierSources;
+	AllVisitedSources.SetNumZeroed(NumberOfVertices);
+	AllFrontierSources.SetNumZeroed(NumberOfVertices);
+	AllNextFrontierSources.SetNumZeroed(NumberOfVertices);
+
+	bool bHasFrontier = false;
+
+	for (int32 Index_Source = 0; Index_Source < AllIndicesOfSources.Num(); Index_Source++)
+	{
+		const int32 IndexOfSourceVertex = AllIndicesOfSources[Index_Source];
+
+		if (Graph.HasVertex(IndexOfSourceVertex))
+		{
+			AllVisitedSources[IndexOfSourceVertex] |= 1ull << Index_Source;
+			AllFrontierSources[IndexOfSourceVertex] |= 1ull << Index_Source;
+			Out_AllHops[Index_Source][IndexOfSourceVertex] = 0;
+			bHasFrontier = true;
+		}
+	}
+
+	for (int32 Hops = 1; bHasFrontier; Hops++)
+	{
+		// Every vertex on the frontier hands all of its sources to its neighbours in one go.
+		for (int32 Index_Vertex = 0; Index_Vertex < NumberOfVertices; Index_Vertex++)
+		{
+			const uint64 FrontierSourcesOfThisVertex = AllFrontierSources[Index_Vertex];
+
+			if (FrontierSourcesOfThisVertex == 0)
+			{
+				continue;
+			}
+
+			Graph.ForEachNeighbour(Index_Vertex, [&AllNextFrontierSources, FrontierSourcesOfThisVertex](int32 NeighbourIndex, int)
+			{
+				AllNextFrontierSources[NeighbourIndex] |= FrontierSourcesOfThisVertex;
+			});
+		}
+
+		bHasFrontier = false;
+
+		// Then only the sources that had not reached a vertex before make up the next frontier.
+		for (int32 Index_Vertex = 0; Index_Vertex < NumberOfVertices; Index_Vertex++)
+		{
+			uint64 NewSourcesOfThisVertex = AllNextFrontierSources[Index_Vertex] & ~AllVisitedSources[Index_Vertex];
+			AllNextFrontierSources[Index_Vertex] = 0;
+			AllFrontierSources[Index_Vertex] = NewSourcesOfThisVertex;
+
+			if (NewSourcesOfThisVertex == 0)
+			{
+				continue;
+			}
+
+			AllVisitedSources[Index_Vertex] |= NewSourcesOfThisVertex;
+			bHasFrontier = true;
+
+			while (NewSourcesOfThisVertex != 0)
+			{
+				const int32 Index_Source = static_cast<int32>(FMath::CountTrailingZeros64(NewSourcesOfThisVertex));
+				Out_AllHops[Index_Source][Index_Vertex] = Hops;
+				NewSourcesOfThisVertex &= NewSourcesOfThisVertex - 1;
+			}
+		}
+	}
+}
+
+int FPGNSocialDistanceService::FindSocialDistance(int32 IndexOfCharacterA, int32 IndexOfCharacterB)
+{
+	if (RefreshCompactGraph() == nullptr)
+	{
+		return MAX_int32;
+	}
+
+	// The graph is undirected, so if we already have the other character's distances we do not need to search at all.
+	const TArray<int>* DistancesFromCharacter = CachedDistances.FindAndTouch(IndexOfCharacterB);
+	int32 IndexOfOtherCharacter = IndexOfCharacterA;
+
+	if (DistancesFromCharacter == nullptr)
+	{
+		DistancesFromCharacter = GetDistancesFromCharacter(IndexOfCharacterA);
+		IndexOfOtherCharacter = IndexOfCharacterB;
+	}
+
+	return DistancesFromCharacter != nullptr && DistancesFromCharacter->IsValidIndex(IndexOfOtherCharacter)
+		? (*DistancesFromCharacter)[IndexOfOtherCharacter] : MAX_int32;
+}
+
+int32 FPGNSocialDistanceService::FindNumberOfHops(int32 IndexOfCharacterA, int32 IndexOfCharacterB)
+{
+	if (RefreshCompactGraph() == nullptr)
+	{
+		return MAX_int32;
+	}
+
+	const TArray<int32>* HopsFromCharacter = CachedHops.FindAndTouch(IndexOfCharacterB);
+	int32 IndexOfOtherCharacter = IndexOfCharacterA;
+
+	if (HopsFromCharacter == nullptr)
+	{
+		HopsFromCharacter = GetHopsFromCharacter(IndexOfCharacterA);
+		IndexOfOtherCharacter = IndexOfCharacterB;
+	}
+
+	return HopsFromCharacter != nullptr && HopsFromCharacter->IsValidIndex(IndexOfOtherCharacter)
+		? (*HopsFromCharacter)[IndexOfOtherCharacter] : MAX_int32;
+}
+
+void FPGNSocialDistanceService::FindCharactersWithinDistance(int32 IndexOfCharacter, int MinimumDistance,
+	int MaximumDistance, TArray<int32>& Out_AllIndicesOfCharacters)
+{
+	Out_AllIndicesOfCharacters.Reset();
+
+	const TArray<int>* DistancesFromCharacter = GetDistancesFromCharacter(IndexOfCharacter);
+
+	if (DistancesFromCharacter == nullptr)
+	{
+		return;
+	}
+
+	for (int32 Index_Character = 0; Index_Character < DistancesFromCharacter->Num(); Index_Character++)
+	{
+		const int ThisDistance = (*DistancesFromCharacter)[Index_Character];
+
+		if (Index_Character != IndexOfCharacter && CharacterGraph->HasVertex(Index_Character)
+			&& ThisDistance >= MinimumDistance && ThisDistance <= MaximumDistance)
+		{
+			Out_AllIndicesOfCharacters.Add(Index_Character);
+		}
+	}
+
+	Out_AllIndicesOfCharacters.Sort([DistancesFromCharacter](int32 A, int32 B)
+	{
+		return (*DistancesFromCharacter)[A] != (*DistancesFromCharacter)[B]
+			? (*DistancesFromCharacter)[A] < (*DistancesFromCharacter)[B] : A < B;
+	});
+}
+
+float FPGNSocialDistanceService::CalculateAverageDistanceWithinCast(TArrayView<const int32> AllIndicesOfCast,
+	int DistanceForUnconnectedPairs)
+{
+	if (AllIndicesOfCast.Num() < 2)
+	{
+		return 0.f;
+	}
+
+	int64 TotalDistance = 0;
+	int32 NumberOfPairs = 0;
+
+	// We only need the distances from every member but the last, since each pair is counted once.
+	for (int32 Index_CastA = 0; Index_CastA < AllIndicesOfCast.Num() - 1; Index_CastA++)
+	{
+		const TArray<int>* DistancesFromThisMember = GetDistancesFromCharacter(AllIndicesOfCast[Index_CastA]);
+
+		for (int32 Index_CastB = Index_CastA + 1; Index_CastB < AllIndicesOfCast.Num(); Index_CastB++)
+		{
+			const int32 IndexOfOtherMember = AllIndicesOfCast[Index_CastB];
+			const int ThisDistance = DistancesFromThisMember != nullptr && DistancesFromThisMember->IsValidIndex(IndexOfOtherMember)
+				? (*DistancesFromThisMember)[IndexOfOtherMember] : MAX_int32;
+
+			TotalDistance += ThisDistance == MAX_int32 ? DistanceForUnconnectedPairs : ThisDistance;
+			NumberOfPairs++;
+		}
+	}
+
+	return static_cast<float>(TotalDistance) / NumberOfPairs;
+}
@@ -0,0 +1,87 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/LruCache.h"
+#include "ProceduralNarrative/Graphs/PGNGraph.h"
+
+class UCharacterGraph;
+
+/**
+ * Answers how far apart characters are in the character graph, for casting and for scoring casts.
+ *
+ * There are two kinds of distance:
+ *
+ *	Distance	The sum of DistanceBetweenVertices along the closest chain of acquaintances, found with Dijkstra.
+ *	Hops		The number of people in the shortest chain of acquaintances, found with breadth-first search.
+ *
+ * Both are found from a source to everyone at once, and are cached per source. Many sources can be asked for at once:
+ * distances are then found in parallel, and hops are found for up to SOURCES_PER_BREADTH_FIRST_PASS sources in a
+ * single pass over the graph, with one bit per source. Every edit to the graph changes its version, which empties
+ * both caches the next time they are used.
+ */
+class PROCEDURALNARRATIVE_API FPGNSocialDistanceService
+{
+public:
+
+	static constexpr int32 SOURCES_PER_BREADTH_FIRST_PASS = 64;
+
+	FPGNSocialDistanceService();
+
+	FPGNSocialDistanceService(const FPGNSocialDistanceService&) = delete;
+	FPGNSocialDistanceService& operator=(const FPGNSocialDistanceService&) = delete;
+
+	// The character graph must outlive the service.
+	void Initialize(UCharacterGraph* InCharacterGraph, int32 NumberOfSourcesToCache);
+	void Reset();
+
+	bool IsInitialized() const { return CharacterGraph != nullptr; }
+
+	// The distance from this character to everyone, indexed by character, or MAX_int32 for anyone they are not
+	// connected to. The pointer is only valid until the next source is found, since that can evict this one.
+	const TArray<int>* GetDistancesFromCharacter(int32 IndexOfCharacter);
+
+	// The same for the number of hops.
+	const TArray<int32>* GetHopsFromCharacter(int32 IndexOfCharacter);
+
+	// Finds the distances from every one of these characters, in parallel for the ones that are not cached yet.
+	void FindDistancesFromCharacters(TArrayView<const int32> AllIndicesOfSources, TArray<TArray<int>>& Out_AllDistances);
+
+	// Finds the hops from every one of these characters, in bit-parallel passes for the ones that are not cached yet.
+	void FindHopsFromCharacters(TArrayView<const int32> AllIndicesOfSources, TArray<TArray<int32>>& Out_AllHops);
+
+	// MAX_int32 if the two characters are not connected.
+	int FindSocialDistance(int32 IndexOfCharacterA, int32 IndexOfCharacterB);
+	int32 FindNumberOfHops(int32 IndexOfCharacterA, int32 IndexOfCharacterB);
+
+	// Everyone in town whose distance from this character is in [MinimumDistance, MaximumDistance], closest first.
+	void FindCharactersWithinDistance(int32 IndexOfCharacter, int MinimumDistance, int MaximumDistance,
+		TArray<int32>& Out_AllIndicesOfCharacters);
+
+	// The average distance between every pair in the cast; the lower it is, the more tightly knit the cast. Pairs who
+	// are not connected at all count as DistanceForUnconnectedPairs.
+	float CalculateAverageDistanceWithinCast(TArrayView<const int32> AllIndicesOfCast, int DistanceForUnconnectedPairs);
+
+	int32 GetNumberOfCachedSources() const { return CachedDistances.Num() + CachedHops.Num(); }
+
+	// Throws away every cached source without changing how many can be cached.
+	void EmptyCaches();
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+
+	// Empties both caches if the graph has changed since they were filled. Returns the up-to-date compact graph, or
+	// null if there is no graph.
+	const FPGNCharacterGraph* RefreshCompactGraph();
+
+	static void RunBitParallelBreadthFirstSearch(const FPGNCharacterGraph& Graph, TArrayView<const int32> AllIndicesOfSources,
+		TArrayView<TArray<int32>> Out_AllHops);
+
+	UCharacterGraph* CharacterGraph = nullptr;
+	int32 CachedGraphVersion = INDEX_NONE;
+
+	TLruCache<int32, TArray<int>> CachedDistances;
+	TLruCache<int32, TArray<int32>> CachedHops;
+};
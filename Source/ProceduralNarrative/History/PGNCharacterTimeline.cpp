@@ -0,0 +1,349 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/History/PGNCharacterTimeline.h"
+
+#include "Algo/BinarySearch.h"
+#include "ProceduralNarrative/Events/PGNEventLibrary.h"
+#include "ProceduralNarrative/Generation/PGNCastingSolver.h"
+
+namespace PGNCharacterTimeline
+{
+	// What someone has to be, and must not be, to take one part in an action.
+	struct FActionRequirement
+	{
+		EPGNCharacterStateFlags Required;
+		EPGNCharacterStateFlags Forbidden;
+	};
+
+	// What taking one part in an action does to someone.
+	struct FActionOutcome
+	{
+		EPGNCharacterStateFlags FlagsToSet;
+		EPGNCharacterStateFlags FlagsToClear;
+	};
+
+	using EFlags = EPGNCharacterStateFlags;
+
+	// Nobody who is dead, gone or in prison takes part in anything.
+	constexpr EFlags REQUIRED_OF_EVERYONE = EFlags::ALIVE | EFlags::IN_TOWN;
+	constexpr EFlags FORBIDDEN_FOR_EVERYONE = EFlags::IMPRISONED;
+
+	// Both tables are indexed by action, with the subject first and the object second.
+	const FActionRequirement REQUIREMENTS_OF_ACTIONS[][2] =
+	{
+		// ACTION_NONE
+		{ { EFlags::NONE, EFlags::NONE }, { EFlags::NONE, EFlags::NONE } },
+		// KILLED_IN_HIT_AND_RUN
+		{ { EFlags::NONE, EFlags::NONE }, { EFlags::NONE, EFlags::NONE } },
+		// DEPARTS_THE_TOWN
+		{ { EFlags::NONE, EFlags::NONE }, { EFlags::NONE, EFlags::NONE } },
+		// DIVORCES_AND_ENDS_MARRIAGE_WITH
+		{ { EFlags::MARRIED, EFlags::NONE }, { EFlags::MARRIED, EFlags::NONE } },
+		// SENTENCED_TO_PRISON
+		{ { EFlags::NONE, EFlags::NONE }, { EFlags::NONE, EFlags::NONE } },
+		// PROMISES_TO_BE_BETTER
+		{ { EFlags::NONE, EFlags::NONE }, { EFlags::NONE, EFlags::NONE } },
+		// BECOMES_A_DRUNK
+		{ { EFlags::NONE, EFlags::DRUNK }, { EFlags::NONE, EFlags::NONE } },
+		// LOSES_JOB
+		{ { EFlags::NONE, EFlags::UNEMPLOYED }, { EFlags::NONE, EFlags::NONE } },
+		// CAUGHT_ROBBING
+		{ { EFlags::NONE, EFlags::NONE }, { EFlags::NONE, EFlags::NONE } },
+		// WINS_LAWSUIT_AGAINST
+		{ { EFlags::NONE, EFlags::NONE }, { EFlags::NONE, EFlags::NONE } },
+		// REVEALED_PREGNANT_WITH_CHILD_OF
+		{ { EFlags::NONE, EFlags::PREGNANT }, { EFlags::NONE, EFlags::NONE } }
+	};
+
+	const FActionOutcome OUTCOMES_OF_ACTIONS[][2] =
+	{
+		// ACTION_NONE
+		{ { EFlags::NONE, EFlags::NONE }, { EFlags::NONE, EFlags::NONE } },
+		// KILLED_IN_HIT_AND_RUN
+		{ { EFlags::NONE, EFlags::ALIVE | EFlags::IN_TOWN | EFlags::MARRIED }, { EFlags::NONE, EFlags::NONE } },
+		// DEPARTS_THE_TOWN
+		{ { EFlags::NONE, EFlags::IN_TOWN }, { EFlags::NONE, EFlags::NONE } },
+		// DIVORCES_AND_ENDS_MARRIAGE_WITH
+		{ { EFlags::NONE, EFlags::MARRIED }, { EFlags::NONE, EFlags::MARRIED } },
+		// SENTENCED_TO_PRISON
+		{ { EFlags::IMPRISONED, EFlags::NONE }, { EFlags::NONE, EFlags::NONE } },
+		// PROMISES_TO_BE_BETTER
+		{ { EFlags::NONE, EFlags::NONE }, { EFlags::NONE, EFlags::NONE } },
+		// BECOMES_A_DRUNK
+		{ { EFlags::DRUNK, EFlags::NONE }, { EFlags::NONE, EFlags::NONE } },
+		// LOSES_JOB
+		{ { EFlags::UNEMPLOYED, EFlags::NONE }, { EFlags::NONE, EFlags::NONE } },
+		// CAUGHT_ROBBING
+		{ { EFlags::NONE, EFlags::NONE }, { EFlags::NONE, EFlags::NONE } },
+		// WINS_LAWSUIT_AGAINST
+		{ { EFlags::NONE, EFlags::NONE }, { EFlags::NONE, EFlags::NONE } },
+		// REVEALED_PREGNANT_WITH_CHILD_OF
+		{ { EFlags::PREGNANT, EFlags::NONE }, { EFlags::NONE, EFlags::NONE } }
+	};
+
+	static_assert(UE_ARRAY_COUNT(REQUIREMENTS_OF_ACTIONS) == FPGNCharacterTimeline::NUMBER_OF_ACTIONS, "REQUIREMENTS_OF_ACTIONS is out of date.");
+	static_assert(UE_ARRAY_COUNT(OUTCOMES_OF_ACTIONS) == FPGNCharacterTimeline::NUMBER_OF_ACTIONS, "OUTCOMES_OF_ACTIONS is out of date.");
+}
+
+FPGNCharacterTimeline::FCharacterHistory::FCharacterHistory()
+{
+	for (int32& ThisFirstNarrative : FirstNarrativeOfAction)
+	{
+		ThisFirstNarrative = INDEX_NONE;
+	}
+}
+
+void FPGNCharacterTimeline::Reset()
+{
+	AllFlags.Reset();
+	HistoryOfCharacter.Reset();
+}
+
+SIZE_T FPGNCharacterTimeline::GetAllocatedSize() const
+{
+	SIZE_T AllocatedSize = AllFlags.GetAllocatedSize() + HistoryOfCharacter.GetAllocatedSize();
+
+	for (const TPair<int32, FCharacterHistory>& ThisHistory : HistoryOfCharacter)
+	{
+		AllocatedSize += ThisHistory.Value.AllEntries.GetAllocatedSize()
+			+ ThisHistory.Value.AllOccurrencesByEvent.GetAllocatedSize();
+	}
+
+	return AllocatedSize;
+}
+
+EPGNCharacterStateFlags FPGNCharacterTimeline::GetInitialFlagsOfCharacter(const FPGNCharacter& ThisCharacter)
+{
+	EPGNCharacterStateFlags InitialFlags = EPGNCharacterStateFlags::ALIVE;
+
+	if (ThisCharacter.bIsInTown)
+	{
+		InitialFlags |= EPGNCharacterStateFlags::IN_TOWN;
+	}
+
+	if (ThisCharacter.MyRomanticData.RomanticRelationship == EPGNCharacterRomanticRelationship::MARRIED)
+	{
+		InitialFlags |= EPGNCharacterStateFlags::MARRIED;
+	}
+
+	return InitialFlags;
+}
+
+#pragma region Flags
+
+void FPGNCharacterTimeline::IntroduceCharacter(int32 IndexOfCharacter, EPGNCharacterStateFlags InitialFlags)
+{
+	if (IndexOfCharacter < 0)
+	{
+		return;
+	}
+
+	if (AllFlags.Num() <= IndexOfCharacter)
+	{
+		AllFlags.SetNumZeroed(IndexOfCharacter + 1);
+	}
+
+	if (!EnumHasAnyFlags(AllFlags[IndexOfCharacter], EPGNCharacterStateFlags::KNOWN))
+	{
+		AllFlags[IndexOfCharacter] = InitialFlags | EPGNCharacterStateFlags::KNOWN;
+	}
+}
+
+void FPGNCharacterTimeline::SetFlags(int32 IndexOfCharacter, EPGNCharacterStateFlags Flags, bool bValue)
+{
+	IntroduceCharacter(IndexOfCharacter, EPGNCharacterStateFlags::DEFAULT);
+
+	if (!AllFlags.IsValidIndex(IndexOfCharacter))
+	{
+		return;
+	}
+
+	if (bValue)
+	{
+		AllFlags[IndexOfCharacter] |= Flags;
+	}
+	else
+	{
+		AllFlags[IndexOfCharacter] &= ~Flags;
+	}
+
+	// Nobody stops being known.
+	AllFlags[IndexOfCharacter] |= EPGNCharacterStateFlags::KNOWN;
+}
+
+bool FPGNCharacterTimeline::CanTakePartInAction(EPGNEventAction Action, bool bIsSubject, EPGNCharacterStateFlags Flags)
+{
+	const int32 IndexOfAction = FMath::Min(static_cast<int32>(Action), NUMBER_OF_ACTIONS - 1);
+	const PGNCharacterTimeline::FActionRequirement& Requirement =
+		PGNCharacterTimeline::REQUIREMENTS_OF_ACTIONS[IndexOfAction][bIsSubject ? 0 : 1];
+
+	const EPGNCharacterStateFlags Required = Requirement.Required | PGNCharacterTimeline::REQUIRED_OF_EVERYONE;
+	const EPGNCharacterStateFlags Forbidden = Requirement.Forbidden | PGNCharacterTimeline::FORBIDDEN_FOR_EVERYONE;
+
+	return EnumHasAllFlags(Flags, Required) && !EnumHasAnyFlags(Flags, Forbidden);
+}
+
+EPGNCharacterStateFlags FPGNCharacterTimeline::ApplyActionToFlags(EPGNEventAction Action, bool bIsSubject,
+	EPGNCharacterStateFlags Flags)
+{
+	const int32 IndexOfAction = static_cast<int32>(Action);
+
+	if (IndexOfAction >= NUMBER_OF_ACTIONS)
+	{
+		return Flags;
+	}
+
+	const PGNCharacterTimeline::FActionOutcome& Outcome =
+		PGNCharacterTimeline::OUTCOMES_OF_ACTIONS[IndexOfAction][bIsSubject ? 0 : 1];
+
+	return ((Flags & ~Outcome.FlagsToClear) | Outcome.FlagsToSet) | EPGNCharacterStateFlags::KNOWN;
+}
+
+void FPGNCharacterTimeline::ApplyAction(int32 IndexOfCharacter, EPGNEventAction Action, bool bIsSubject)
+{
+	const int32 IndexOfAction = static_cast<int32>(Action);
+
+	if (IndexOfAction >= NUMBER_OF_ACTIONS)
+	{
+		return;
+	}
+
+	const PGNCharacterTimeline::FActionOutcome& Outcome =
+		PGNCharacterTimeline::OUTCOMES_OF_ACTIONS[IndexOfAction][bIsSubject ? 0 : 1];
+
+	SetFlags(IndexOfCharacter, Outcome.FlagsToClear, false);
+	SetFlags(IndexOfCharacter, Outcome.FlagsToSet, true);
+}
+
+#pragma endregion Flags
+
+#pragma region Timeline
+
+void FPGNCharacterTimeline::RecordNarrative(int32 NarrativeIndex, const FPGNGeneratedNarrative& ThisNarrative,
+	const FPGNEventLibrary& EventLibrary)
+{
+	const auto FindCharacterInRole = [&ThisNarrative](EPGNCharacterTag Tag)
+	{
+		const int32 IndexInCast = FPGNCastingSolver::GetIndexInCast(Tag);
+		return ThisNarrative.AllIndicesOfCharactersInUse.IsValidIndex(IndexInCast)
+			? ThisNarrative.AllIndicesOfCharactersInUse[IndexInCast] : INDEX_NONE;
+	};
+
+	const auto RecordThisEvent = [&](FPGNEventId EventId)
+	{
+		if (!EventLibrary.IsValidEventId(EventId))
+		{
+			return;
+		}
+
+		const FPGNPackedEvent& ThisEvent = EventLibrary.GetEvent(EventId);
+
+		FPGNCharacterTimelineEntry NewEntry;
+		NewEntry.NarrativeIndex = NarrativeIndex;
+		NewEntry.EventId = EventId;
+		NewEntry.Action = ThisEvent.GetAction();
+
+		const int32 IndexOfSubject = FindCharacterInRole(ThisEvent.GetSubject());
+
+		if (IndexOfSubject != INDEX_NONE)
+		{
+			NewEntry.bWasSubject = true;
+			AddEntry(IndexOfSubject, NewEntry);
+			ApplyAction(IndexOfSubject, NewEntry.Action, true);
+		}
+
+		const int32 IndexOfObject = ThisEvent.bDoesEventHaveObject ? FindCharacterInRole(ThisEvent.GetObject()) : INDEX_NONE;
+
+		if (IndexOfObject != INDEX_NONE && IndexOfObject != IndexOfSubject)
+		{
+			NewEntry.bWasSubject = false;
+			AddEntry(IndexOfObject, NewEntry);
+			ApplyAction(IndexOfObject, NewEntry.Action, false);
+		}
+	};
+
+	for (const int ThisEventId : ThisNarrative.AllEventIds)
+	{
+		RecordThisEvent(ThisEventId);
+	}
+
+	RecordThisEvent(ThisNarrative.ConclusionEventId);
+}
+
+void FPGNCharacterTimeline::AddEntry(int32 IndexOfCharacter, const FPGNCharacterTimelineEntry& NewEntry)
+{
+	FCharacterHistory& ThisHistory = HistoryOfCharacter.FindOrAdd(IndexOfCharacter);
+
+	if (!ensureMsgf(ThisHistory.AllEntries.Num() == 0 || ThisHistory.AllEntries.Last().NarrativeIndex <= NewEntry.NarrativeIndex,
+		TEXT("Narrative %d was recorded after a later one."), NewEntry.NarrativeIndex))
+	{
+		return;
+	}
+
+	ThisHistory.AllEntries.Add(NewEntry);
+
+	const FEventOccurrence NewOccurrence { NewEntry.EventId, NewEntry.NarrativeIndex };
+	ThisHistory.AllOccurrencesByEvent.Insert(NewOccurrence, Algo::UpperBound(ThisHistory.AllOccurrencesByEvent, NewOccurrence));
+
+	const int32 IndexOfAction = static_cast<int32>(NewEntry.Action);
+
+	if (IndexOfAction < NUMBER_OF_ACTIONS && ThisHistory.FirstNarrativeOfAction[IndexOfAction] == INDEX_NONE)
+	{
+		ThisHistory.FirstNarrativeOfAction[IndexOfAction] = NewEntry.NarrativeIndex;
+	}
+}
+
+TArrayView<const FPGNCharacterTimelineEntry> FPGNCharacterTimeline::GetTimeline(int32 IndexOfCharacter) const
+{
+	const FCharacterHistory* ThisHistory = HistoryOfCharacter.Find(IndexOfCharacter);
+	return ThisHistory != nullptr ? TArrayView<const FPGNCharacterTimelineEntry>(ThisHistory->AllEntries)
+		: TArrayView<const FPGNCharacterTimelineEntry>();
+}
+
+TArrayView<const FPGNCharacterTimelineEntry> FPGNCharacterTimeline::GetTimelineBefore(int32 IndexOfCharacter,
+	int32 NarrativeIndex) const
+{
+	const TArrayView<const FPGNCharacterTimelineEntry> WholeTimeline = GetTimeline(IndexOfCharacter);
+
+	const int32 NumberOfEntriesBefore = Algo::LowerBoundBy(WholeTimeline, NarrativeIndex,
+		&FPGNCharacterTimelineEntry::NarrativeIndex);
+
+	return WholeTimeline.Slice(0, NumberOfEntriesBefore);
+}
+
+int32 FPGNCharacterTimeline::FindFirstNarrativeWithAction(int32 IndexOfCharacter, EPGNEventAction Action) const
+{
+	const FCharacterHistory* ThisHistory = HistoryOfCharacter.Find(IndexOfCharacter);
+	const int32 IndexOfAction = static_cast<int32>(Action);
+
+	return ThisHistory != nullptr && IndexOfAction < NUMBER_OF_ACTIONS ? ThisHistory->FirstNarrativeOfAction[IndexOfAction]
+		: INDEX_NONE;
+}
+
+bool FPGNCharacterTimeline::DidActionHappenBefore(int32 IndexOfCharacter, EPGNEventAction Action,
+	int32 NarrativeIndex) const
+{
+	const int32 FirstNarrative = FindFirstNarrativeWithAction(IndexOfCharacter, Action);
+	return FirstNarrative != INDEX_NONE && FirstNarrative < NarrativeIndex;
+}
+
+bool FPGNCharacterTimeline::DidEventHappenBefore(int32 IndexOfCharacter, FPGNEventId EventId, int32 NarrativeIndex) const
+{
+	const FCharacterHistory* ThisHistory = HistoryOfCharacter.Find(IndexOfCharacter);
+
+	if (ThisHistory == nullptr)
+	{
+		return false;
+	}
+
+	// The first occurrence of the event is the earliest one, so it is the only one we need to look at.
+	const FEventOccurrence FirstPossibleOccurrence { EventId, MIN_int32 };
+	const int32 IndexOfFirstOccurrence = Algo::LowerBound(ThisHistory->AllOccurrencesByEvent, FirstPossibleOccurrence);
+
+	return ThisHistory->AllOccurrencesByEvent.IsValidIndex(IndexOfFirstOccurrence)
+		&& ThisHistory->AllOccurrencesByEvent[IndexOfFirstOccurrence].EventId == EventId
+		&& ThisHistory->AllOccurrencesByEvent[IndexOfFirstOccurrence].NarrativeIndex < NarrativeIndex;
+}
+
+#pragma endregion Timeline
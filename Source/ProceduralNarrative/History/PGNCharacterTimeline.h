@@ -0,0 +1,154 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralNarrative/PGNUtilities.h"
+#include "ProceduralNarrative/Events/PGNPackedEvent.h"
+
+class FPGNEventLibrary;
+
+// What has become of a character, as far as the narratives and the town are concerned.
+enum class EPGNCharacterStateFlags : uint16
+{
+	NONE = 0,
+
+	// Set once the timeline has been told about the character. Anyone else is assumed to be in the default state.
+	KNOWN = 1 << 0,
+
+	ALIVE = 1 << 1,
+	IN_TOWN = 1 << 2,
+	MARRIED = 1 << 3,
+	IMPRISONED = 1 << 4,
+	DRUNK = 1 << 5,
+	UNEMPLOYED = 1 << 6,
+	PREGNANT = 1 << 7,
+
+	DEFAULT = ALIVE | IN_TOWN
+};
+
+ENUM_CLASS_FLAGS(EPGNCharacterStateFlags);
+
+// One event a character took part in.
+struct FPGNCharacterTimelineEntry
+{
+	// The index the narrative has, or will have once it is archived, in the narrative history.
+	int32 NarrativeIndex = INDEX_NONE;
+
+	// The ID the event had when the narrative was committed. Like archived narratives, entries keep it across reloads
+	// of the events, but the action never changes.
+	FPGNEventId EventId = INVALID_PGN_EVENT_ID;
+	EPGNEventAction Action = EPGNEventAction::ACTION_NONE;
+
+	bool bWasSubject = true;
+};
+
+/**
+ * Everything that has happened to each character, for keeping the narratives coherent: nobody who was killed acts
+ * again, nobody who left town is cast in it, and nobody divorces without being married.
+ *
+ *	Flags		One word per character, updated as narratives are committed and as the town changes, so that casting
+ *				can rule people out with a mask test instead of a search through their past.
+ *	Timeline	An append-only log per character of every event they took part in, in the order it was committed.
+ *				The first narrative each action happened to them in is kept alongside it, so "did X happen before
+ *				narrative N" is constant time for an action and a binary search for a particular event.
+ *
+ * Only characters who have been in a narrative have a timeline, so a virtual population costs nothing for everyone
+ * who was never cast. Character indices are not kept between sessions, so neither is the timeline.
+ */
+class PROCEDURALNARRATIVE_API FPGNCharacterTimeline
+{
+public:
+
+	static constexpr int32 NUMBER_OF_ACTIONS = static_cast<int32>(EPGNEventAction::REVEALED_PREGNANT_WITH_CHILD_OF) + 1;
+
+	void Reset();
+
+	// The flags a character should start with, from what the town knows about them.
+	static EPGNCharacterStateFlags GetInitialFlagsOfCharacter(const FPGNCharacter& ThisCharacter);
+
+#pragma region Flags
+
+	// Only does anything the first time the timeline is told about this character.
+	void IntroduceCharacter(int32 IndexOfCharacter, EPGNCharacterStateFlags InitialFlags);
+
+	void SetFlags(int32 IndexOfCharacter, EPGNCharacterStateFlags Flags, bool bValue);
+
+	EPGNCharacterStateFlags GetFlags(int32 IndexOfCharacter) const
+	{
+		return AllFlags.IsValidIndex(IndexOfCharacter) && EnumHasAnyFlags(AllFlags[IndexOfCharacter], EPGNCharacterStateFlags::KNOWN)
+			? AllFlags[IndexOfCharacter] : EPGNCharacterStateFlags::DEFAULT;
+	}
+
+	bool HasAllFlags(int32 IndexOfCharacter, EPGNCharacterStateFlags Flags) const
+	{
+		return EnumHasAllFlags(GetFlags(IndexOfCharacter), Flags);
+	}
+
+	// Whether someone in this state can take this part in an event with this action. This is a pair of mask tests, so
+	// it is cheap enough for every cell of a casting cost matrix.
+	static bool CanTakePartInAction(EPGNEventAction Action, bool bIsSubject, EPGNCharacterStateFlags Flags);
+
+	// The state someone is left in after taking this part in an event with this action, for anyone who keeps flags of
+	// their own, like the narrative prefetcher.
+	static EPGNCharacterStateFlags ApplyActionToFlags(EPGNEventAction Action, bool bIsSubject, EPGNCharacterStateFlags Flags);
+
+#pragma endregion Flags
+
+#pragma region Timeline
+
+	// Narratives have to be recorded in the order they are committed.
+	void RecordNarrative(int32 NarrativeIndex, const FPGNGeneratedNarrative& ThisNarrative,
+		const FPGNEventLibrary& EventLibrary);
+
+	TArrayView<const FPGNCharacterTimelineEntry> GetTimeline(int32 IndexOfCharacter) const;
+
+	// Every event the character took part in before this narrative.
+	TArrayView<const FPGNCharacterTimelineEntry> GetTimelineBefore(int32 IndexOfCharacter, int32 NarrativeIndex) const;
+
+	// INDEX_NONE if it never happened to them.
+	int32 FindFirstNarrativeWithAction(int32 IndexOfCharacter, EPGNEventAction Action) const;
+
+	bool DidActionHappenBefore(int32 IndexOfCharacter, EPGNEventAction Action, int32 NarrativeIndex) const;
+	bool DidEventHappenBefore(int32 IndexOfCharacter, FPGNEventId EventId, int32 NarrativeIndex) const;
+
+#pragma endregion Timeline
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+
+	struct FEventOccurrence
+	{
+		FPGNEventId EventId = INVALID_PGN_EVENT_ID;
+		int32 NarrativeIndex = INDEX_NONE;
+
+		bool operator<(const FEventOccurrence& Other) const
+		{
+			return EventId != Other.EventId ? EventId < Other.EventId : NarrativeIndex < Other.NarrativeIndex;
+		}
+	};
+
+	struct FCharacterHistory
+	{
+		FCharacterHistory();
+
+		// In the order they were committed, which is also by narrative.
+		TArray<FPGNCharacterTimelineEntry> AllEntries;
+
+		// The same events, by event and then by narrative.
+		TArray<FEventOccurrence> AllOccurrencesByEvent;
+
+		int32 FirstNarrativeOfAction[NUMBER_OF_ACTIONS];
+	};
+
+	// Applies what the action does to the state of whoever took this part in it.
+	void ApplyAction(int32 IndexOfCharacter, EPGNEventAction Action, bool bIsSubject);
+
+	void AddEntry(int32 IndexOfCharacter, const FPGNCharacterTimelineEntry& NewEntry);
+
+	// Indexed by character, and grown as characters are introduced.
+	TArray<EPGNCharacterStateFlags> AllFlags;
+
+	TMap<int32, FCharacterHistory> HistoryOfCharacter;
+};
@@ -0,0 +1,656 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/History/PGNNarrativeHistoryArchive.h"
+
+#include "Algo/BinarySearch.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/Paths.h"
+#include "ProceduralNarrative/Memory/PGNMemoryTracking.h"
+#include "ProceduralNarrative/PGNVarint.h"
+
+static bool AreTheseCharacterTemplatesIdentical(const FPGNCharacterTemplate& A, const FPGNCharacterTemplate& B)
+{
+	return A.Occupation == B.Occupation && A.OccupationSalary == B.OccupationSalary
+		&& A.CharacterGreatestDesire == B.CharacterGreatestDesire
+		&& A.TendencyTowardsMoralDecisions == B.TendencyTowardsMoralDecisions
+		&& A.TendencyToPursueGreatestDesire == B.TendencyToPursueGreatestDesire
+		&& A.NumberOfTimesTemplateUsed == B.NumberOfTimesTemplateUsed;
+}
+
+FPGNNarrativeHistoryArchive::FPGNNarrativeHistoryArchive()
+{
+}
+
+FPGNNarrativeHistoryArchive::~FPGNNarrativeHistoryArchive()
+{
+	Close();
+}
+
+void FPGNNarrativeHistoryArchive::Reset()
+{
+	ChunkIndex.Reset();
+	NumberOfNarrativesInChunks = 0;
+	PendingNarratives.Reset();
+	LastConclusionEventId = INDEX_NONE;
+	InMemoryChunks.Reset();
+}
+
+bool FPGNNarrativeHistoryArchive::OpenFile(const FString& Filename)
+{
+	Close();
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(Filename));
+
+	ArchiveFilename = Filename;
+
+	bool bStartOver = true;
+
+	if (PlatformFile.FileExists(*Filename))
+	{
+		FileHandle.Reset(PlatformFile.OpenWrite(*Filename, true, true));
+
+		FFileHeader FileHeader;
+
+		if (FileHandle.IsValid() && FileHandle->Seek(0)
+			&& FileHandle->Read(reinterpret_cast<uint8*>(&FileHeader), sizeof(FileHeader))
+			&& FileHeader.Magic == FILE_MAGIC && FileHeader.FormatVersion == FORMAT_VERSION)
+		{
+			bStartOver = false;
+
+			// We will cut off anything after the last whole chunk, so that new chunks follow straight on from it.
+			const int64 EndOfLastWholeChunk = ReadChunkIndexFromFile();
+
+			if (EndOfLastWholeChunk < FileHandle->Size())
+			{
+				UE_LOG(LogTemp, Warning, TEXT("The narrative history %s ends with a damaged chunk, which will be dropped."),
+					*Filename);
+
+				if (!FileHandle->Truncate(EndOfLastWholeChunk))
+				{
+					UE_LOG(LogTemp, Error, TEXT("Could not drop the damaged chunk from %s."), *Filename);
+					Reset();
+					FileHandle.Reset();
+					return false;
+				}
+			}
+		}
+		else
+		{
+			UE_LOG(LogTemp, Warning, TEXT("%s is not a narrative history that we can read, so it will be started over."),
+				*Filename);
+			Reset();
+		}
+	}
+
+	if (bStartOver)
+	{
+		FileHandle.Reset(PlatformFile.OpenWrite(*Filename, false, true));
+
+		FFileHeader FileHeader;
+		FileHeader.Magic = FILE_MAGIC;
+		FileHeader.FormatVersion = FORMAT_VERSION;
+
+		if (!FileHandle.IsValid() || !FileHandle->Write(reinterpret_cast<const uint8*>(&FileHeader), sizeof(FileHeader)))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Could not create the narrative history %s."), *Filename);
+			FileHandle.Reset();
+			return false;
+		}
+	}
+
+	// The last conclusion event is needed for the mood graph, so we will find it now rather than on every lookup.
+	if (ChunkIndex.Num() > 0)
+	{
+		TArray<uint8> Payload;
+		TArray<int> AllConclusionEventIds;
+
+		if (ReadChunkPayload(ChunkIndex.Last(), Payload)
+			&& DecodeConclusionEventIds(Payload, ChunkIndex.Last().NumberOfNarratives, AllConclusionEventIds))
+		{
+			LastConclusionEventId = AllConclusionEventIds.Last();
+		}
+	}
+
+	return true;
+}
+
+int64 FPGNNarrativeHistoryArchive::ReadChunkIndexFromFile()
+{
+	const int64 SizeOfFile = FileHandle->Size();
+	int64 OffsetOfChunk = sizeof(FFileHeader);
+
+	while (OffsetOfChunk + static_cast<int64>(sizeof(FChunkHeader)) <= SizeOfFile)
+	{
+		FChunkHeader ChunkHeader;
+
+		if (!FileHandle->Seek(OffsetOfChunk)
+			|| !FileHandle->Read(reinterpret_cast<uint8*>(&ChunkHeader), sizeof(ChunkHeader)))
+		{
+			break;
+		}
+
+		const int64 OffsetOfPayload = OffsetOfChunk + sizeof(FChunkHeader);
+
+		if (ChunkHeader.Magic != CHUNK_MAGIC || ChunkHeader.FirstNarrativeIndex != NumberOfNarrativesInChunks
+			|| ChunkHeader.NumberOfNarratives <= 0 || OffsetOfPayload + ChunkHeader.SizeOfPayload > SizeOfFile)
+		{
+			break;
+		}
+
+		FChunkIndexEntry ThisChunk;
+		ThisChunk.OffsetOfPayload = OffsetOfPayload;
+		ThisChunk.SizeOfPayload = ChunkHeader.SizeOfPayload;
+		ThisChunk.PayloadChecksum = ChunkHeader.PayloadChecksum;
+		ThisChunk.FirstNarrativeIndex = ChunkHeader.FirstNarrativeIndex;
+		ThisChunk.NumberOfNarratives = ChunkHeader.NumberOfNarratives;
+
+		ChunkIndex.Add(ThisChunk);
+		NumberOfNarrativesInChunks += ThisChunk.NumberOfNarratives;
+
+		OffsetOfChunk = OffsetOfPayload + ChunkHeader.SizeOfPayload;
+	}
+
+	// Only the last chunk can have been cut short by a crash, so that is the only one we check in full here. Every
+	// chunk is checked again whenever it is read.
+	TArray<uint8> Payload;
+
+	if (ChunkIndex.Num() > 0 && !ReadChunkPayload(ChunkIndex.Last(), Payload))
+	{
+		OffsetOfChunk = ChunkIndex.Last().OffsetOfPayload - sizeof(FChunkHeader);
+		NumberOfNarrativesInChunks -= ChunkIndex.Last().NumberOfNarratives;
+		ChunkIndex.Pop();
+	}
+
+	return OffsetOfChunk;
+}
+
+void FPGNNarrativeHistoryArchive::Close()
+{
+	if (FileHandle.IsValid())
+	{
+		Flush();
+		FileHandle.Reset();
+	}
+
+	ArchiveFilename.Reset();
+	Reset();
+}
+
+void FPGNNarrativeHistoryArchive::Append(const FPGNGeneratedNarrative& Narrative)
+{
+	PendingNarratives.Add(Narrative);
+	LastConclusionEventId = Narrative.ConclusionEventId;
+
+	if (PendingNarratives.Num() >= NARRATIVES_PER_CHUNK)
+	{
+		Flush();
+	}
+}
+
+bool FPGNNarrativeHistoryArchive::Flush()
+{
+	if (PendingNarratives.Num() == 0)
+	{
+		return true;
+	}
+
+	TArray<uint8> Payload;
+	EncodeChunk(PendingNarratives, Payload);
+
+	if (!WriteChunk(Payload, NumberOfNarrativesInChunks, PendingNarratives.Num()))
+	{
+		// The narratives stay pending, so nothing is lost if the next flush succeeds.
+		return false;
+	}
+
+	NumberOfNarrativesInChunks += PendingNarratives.Num();
+	PendingNarratives.Reset();
+
+	return true;
+}
+
+bool FPGNNarrativeHistoryArchive::WriteChunk(const TArray<uint8>& Payload, int32 FirstNarrativeIndex,
+	int32 NumberOfNarratives)
+{
+	FChunkIndexEntry ThisChunk;
+	ThisChunk.SizeOfPayload = Payload.Num();
+	ThisChunk.PayloadChecksum = FCrc::MemCrc32(Payload.GetData(), Payload.Num());
+	ThisChunk.FirstNarrativeIndex = FirstNarrativeIndex;
+	ThisChunk.NumberOfNarratives = NumberOfNarratives;
+
+	if (!FileHandle.IsValid())
+	{
+		ThisChunk.OffsetOfPayload = InMemoryChunks.Num();
+		InMemoryChunks.Append(Payload);
+		ChunkIndex.Add(ThisChunk);
+		return true;
+	}
+
+	FChunkHeader ChunkHeader;
+	ChunkHeader.Magic = CHUNK_MAGIC;
+	ChunkHeader.FirstNarrativeIndex = FirstNarrativeIndex;
+	ChunkHeader.NumberOfNarratives = NumberOfNarratives;
+	ChunkHeader.SizeOfPayload = ThisChunk.SizeOfPayload;
+	ChunkHeader.PayloadChecksum = ThisChunk.PayloadChecksum;
+
+	// Reads move the file position around, so we will always go back to the end before writing.
+	const int64 OffsetOfChunk = FileHandle->Size();
+
+	// The header and payload go out in one write, so a crash leaves at most one partial chunk at the end.
+	TArray<uint8> WholeChunk;
+	WholeChunk.Reserve(sizeof(ChunkHeader) + Payload.Num());
+	WholeChunk.Append(reinterpret_cast<const uint8*>(&ChunkHeader), sizeof(ChunkHeader));
+	WholeChunk.Append(Payload);
+
+	if (!FileHandle->SeekFromEnd(0) || !FileHandle->Write(WholeChunk.GetData(), WholeChunk.Num()) || !FileHandle->Flush())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not write to the narrative history %s."), *ArchiveFilename);
+		return false;
+	}
+
+	ThisChunk.OffsetOfPayload = OffsetOfChunk + sizeof(ChunkHeader);
+	ChunkIndex.Add(ThisChunk);
+
+	return true;
+}
+
+bool FPGNNarrativeHistoryArchive::ReadChunkPayload(const FChunkIndexEntry& Chunk, TArray<uint8>& Out_Payload) const
+{
+	Out_Payload.SetNumUninitialized(Chunk.SizeOfPayload);
+
+	if (FileHandle.IsValid())
+	{
+		if (!FileHandle->Seek(Chunk.OffsetOfPayload) || !FileHandle->Read(Out_Payload.GetData(), Chunk.SizeOfPayload))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Could not read from the narrative history %s."), *ArchiveFilename);
+			return false;
+		}
+	}
+	else
+	{
+		FMemory::Memcpy(Out_Payload.GetData(), InMemoryChunks.GetData() + Chunk.OffsetOfPayload, Chunk.SizeOfPayload);
+	}
+
+	if (FCrc::MemCrc32(Out_Payload.GetData(), Out_Payload.Num()) != Chunk.PayloadChecksum)
+	{
+		UE_LOG(LogTemp, Error, TEXT("The chunk starting at narrative %d in the narrative history %s is damaged."),
+			Chunk.FirstNarrativeIndex, *ArchiveFilename);
+		return false;
+	}
+
+	return true;
+}
+
+int32 FPGNNarrativeHistoryArchive::FindChunkWithThisNarrative(int32 NarrativeIndex) const
+{
+	// The chunks are in order, so the one we want is the last one that starts at or before this narrative.
+	return Algo::UpperBoundBy(ChunkIndex, NarrativeIndex, &FChunkIndexEntry::FirstNarrativeIndex) - 1;
+}
+
+bool FPGNNarrativeHistoryArchive::GetNarrative(int32 NarrativeIndex, FPGNGeneratedNarrative& Out_Narrative) const
+{
+	if (NarrativeIndex < 0 || NarrativeIndex >= Num())
+	{
+		return false;
+	}
+
+	if (NarrativeIndex >= NumberOfNarrativesInChunks)
+	{
+		Out_Narrative = PendingNarratives[NarrativeIndex - NumberOfNarrativesInChunks];
+		return true;
+	}
+
+	const int32 IndexOfChunk = FindChunkWithThisNarrative(NarrativeIndex);
+
+	// The narrative was in a chunk that has been trimmed away.
+	if (IndexOfChunk == INDEX_NONE)
+	{
+		return false;
+	}
+
+	const FChunkIndexEntry& Chunk = ChunkIndex[IndexOfChunk];
+
+	TArray<uint8> Payload;
+	TArray<FPGNGeneratedNarrative> AllNarrativesInChunk;
+
+	if (!ReadChunkPayload(Chunk, Payload) || !DecodeChunk(Payload, Chunk.NumberOfNarratives, AllNarrativesInChunk))
+	{
+		return false;
+	}
+
+	Out_Narrative = MoveTemp(AllNarrativesInChunk[NarrativeIndex - Chunk.FirstNarrativeIndex]);
+	return true;
+}
+
+void FPGNNarrativeHistoryArchive::ForEachNarrative(int32 StartIndex,
+	TFunctionRef<bool(int32 NarrativeIndex, const FPGNGeneratedNarrative& Narrative)> Visitor) const
+{
+	StartIndex = FMath::Max(StartIndex, 0);
+
+	// Only one chunk is ever decoded at a time, so walking the whole history costs no more memory than one chunk.
+	TArray<uint8> Payload;
+	TArray<FPGNGeneratedNarrative> AllNarrativesInChunk;
+
+	for (int32 Index_Chunk = FMath::Max(FindChunkWithThisNarrative(StartIndex), 0); Index_Chunk < ChunkIndex.Num();
+		Index_Chunk++)
+	{
+		const FChunkIndexEntry& Chunk = ChunkIndex[Index_Chunk];
+
+		if (!ReadChunkPayload(Chunk, Payload) || !DecodeChunk(Payload, Chunk.NumberOfNarratives, AllNarrativesInChunk))
+		{
+			continue;
+		}
+
+		for (int32 Index_Narrative = 0; Index_Narrative < AllNarrativesInChunk.Num(); Index_Narrative++)
+		{
+			const int32 NarrativeIndex = Chunk.FirstNarrativeIndex + Index_Narrative;
+
+			if (NarrativeIndex >= StartIndex && !Visitor(NarrativeIndex, AllNarrativesInChunk[Index_Narrative]))
+			{
+				return;
+			}
+		}
+	}
+
+	for (int32 Index_Pending = 0; Index_Pending < PendingNarratives.Num(); Index_Pending++)
+	{
+		const int32 NarrativeIndex = NumberOfNarrativesInChunks + Index_Pending;
+
+		if (NarrativeIndex >= StartIndex && !Visitor(NarrativeIndex, PendingNarratives[Index_Pending]))
+		{
+			return;
+		}
+	}
+}
+
+void FPGNNarrativeHistoryArchive::ForEachConclusionEventId(
+	TFunctionRef<void(int32 NarrativeIndex, int ConclusionEventId)> Visitor) const
+{
+	TArray<uint8> Payload;
+	TArray<int> AllConclusionEventIds;
+
+	for (const FChunkIndexEntry& Chunk : ChunkIndex)
+	{
+		if (!ReadChunkPayload(Chunk, Payload)
+			|| !DecodeConclusionEventIds(Payload, Chunk.NumberOfNarratives, AllConclusionEventIds))
+		{
+			continue;
+		}
+
+		for (int32 Index_Narrative = 0; Index_Narrative < AllConclusionEventIds.Num(); Index_Narrative++)
+		{
+			Visitor(Chunk.FirstNarrativeIndex + Index_Narrative, AllConclusionEventIds[Index_Narrative]);
+		}
+	}
+
+	for (int32 Index_Pending = 0; Index_Pending < PendingNarratives.Num(); Index_Pending++)
+	{
+		Visitor(NumberOfNarrativesInChunks + Index_Pending, PendingNarratives[Index_Pending].ConclusionEventId);
+	}
+}
+
+SIZE_T FPGNNarrativeHistoryArchive::GetAllocatedSize() const
+{
+	SIZE_T AllocatedSize = ChunkIndex.GetAllocatedSize() + PendingNarratives.GetAllocatedSize()
+		+ InMemoryChunks.GetAllocatedSize();
+
+	for (const FPGNGeneratedNarrative& ThisNarrative : PendingNarratives)
+	{
+		AllocatedSize += FPGNMemoryTracking::GetAllocatedSizeOfNarrative(ThisNarrative);
+	}
+
+	return AllocatedSize;
+}
+
+void FPGNNarrativeHistoryArchive::TrimToSize(SIZE_T MaximumSize)
+{
+	if (GetAllocatedSize() <= MaximumSize)
+	{
+		return;
+	}
+
+	// A pending narrative takes several times the memory it does once it is encoded, so they go first.
+	if (Flush())
+	{
+		PendingNarratives.Shrink();
+	}
+
+	// The chunks in a file only cost their index entry, which is all there is left to give back.
+	if (FileHandle.IsValid())
+	{
+		ChunkIndex.Shrink();
+		return;
+	}
+
+	const SIZE_T AllocatedSize = GetAllocatedSize();
+
+	int32 NumberOfChunksToForget = 0;
+	SIZE_T SizeOfChunksToForget = 0;
+
+	while (NumberOfChunksToForget < ChunkIndex.Num() && AllocatedSize - SizeOfChunksToForget > MaximumSize)
+	{
+		SizeOfChunksToForget += ChunkIndex[NumberOfChunksToForget].SizeOfPayload + sizeof(FChunkIndexEntry);
+		NumberOfChunksToForget++;
+	}
+
+	if (NumberOfChunksToForget == 0)
+	{
+		return;
+	}
+
+	const int64 OffsetOfFirstChunkToKeep = NumberOfChunksToForget < ChunkIndex.Num()
+		? ChunkIndex[NumberOfChunksToForget].OffsetOfPayload : InMemoryChunks.Num();
+
+	UE_LOG(LogTemp, Log, TEXT("Forgetting the first %d narratives of the narrative history to stay within its budget."),
+		NumberOfChunksToForget < ChunkIndex.Num() ? ChunkIndex[NumberOfChunksToForget].FirstNarrativeIndex
+		: NumberOfNarrativesInChunks);
+
+	InMemoryChunks.RemoveAt(0, static_cast<int32>(OffsetOfFirstChunkToKeep), false);
+	ChunkIndex.RemoveAt(0, NumberOfChunksToForget, false);
+
+	for (FChunkIndexEntry& ThisChunk : ChunkIndex)
+	{
+		ThisChunk.OffsetOfPayload -= OffsetOfFirstChunkToKeep;
+	}
+
+	InMemoryChunks.Shrink();
+	ChunkIndex.Shrink();
+}
+
+#pragma region Encoding
+
+void FPGNNarrativeHistoryArchive::EncodeChunk(const TArray<FPGNGeneratedNarrative>& AllNarrativesInChunk,
+	TArray<uint8>& Out_Payload)
+{
+	Out_Payload.Reset();
+
+	// Conclusion event IDs. INDEX_NONE is stored as zero.
+	for (const FPGNGeneratedNarrative& ThisNarrative : AllNarrativesInChunk)
+	{
+		PGNVarint::WriteVarint(Out_Payload, static_cast<uint32>(ThisNarrative.ConclusionEventId + 1));
+	}
+
+	// Event IDs. Events in the same narrative tend to sit close together in the library, so the deltas are small.
+	for (const FPGNGeneratedNarrative& ThisNarrative : AllNarrativesInChunk)
+	{
+		PGNVarint::WriteVarint(Out_Payload, ThisNarrative.AllEventIds.Num());
+	}
+
+	for (const FPGNGeneratedNarrative& ThisNarrative : AllNarrativesInChunk)
+	{
+		int PreviousEventId = 0;
+
+		for (const int ThisEventId : ThisNarrative.AllEventIds)
+		{
+			PGNVarint::WriteVarint(Out_Payload, PGNVarint::EncodeZigZag(ThisEventId - PreviousEventId));
+			PreviousEventId = ThisEventId;
+		}
+	}
+
+	// Character templates. The same few templates turn up in narrative after narrative, so each is stored once.
+	TArray<const FPGNCharacterTemplate*> TemplateDictionary;
+	TArray<int32> AllIndicesInTemplateDictionary;
+
+	for (const FPGNGeneratedNarrative& ThisNarrative : AllNarrativesInChunk)
+	{
+		for (const FPGNCharacterTemplate& ThisTemplate : ThisNarrative.AllCharactersInUse)
+		{
+			int32 IndexInDictionary = TemplateDictionary.IndexOfByPredicate(
+				[&ThisTemplate](const FPGNCharacterTemplate* ThisEntry)
+			{
+				return AreTheseCharacterTemplatesIdentical(*ThisEntry, ThisTemplate);
+			});
+
+			if (IndexInDictionary == INDEX_NONE)
+			{
+				IndexInDictionary = TemplateDictionary.Add(&ThisTemplate);
+			}
+
+			AllIndicesInTemplateDictionary.Add(IndexInDictionary);
+		}
+	}
+
+	PGNVarint::WriteVarint(Out_Payload, TemplateDictionary.Num());
+
+	for (const FPGNCharacterTemplate* ThisTemplate : TemplateDictionary)
+	{
+		Out_Payload.Add(static_cast<uint8>(ThisTemplate->Occupation));
+		PGNVarint::WriteVarint(Out_Payload, PGNVarint::EncodeZigZag(ThisTemplate->OccupationSalary));
+		Out_Payload.Add(static_cast<uint8>(ThisTemplate->CharacterGreatestDesire));
+		Out_Payload.Append(reinterpret_cast<const uint8*>(&ThisTemplate->TendencyTowardsMoralDecisions), sizeof(float));
+		Out_Payload.Append(reinterpret_cast<const uint8*>(&ThisTemplate->TendencyToPursueGreatestDesire), sizeof(float));
+		PGNVarint::WriteVarint(Out_Payload, PGNVarint::EncodeZigZag(ThisTemplate->NumberOfTimesTemplateUsed));
+	}
+
+	int32 Index_NextTemplate = 0;
+
+	for (const FPGNGeneratedNarrative& ThisNarrative : AllNarrativesInChunk)
+	{
+		PGNVarint::WriteVarint(Out_Payload, ThisNarrative.AllCharactersInUse.Num());
+
+		for (int32 Index_Character = 0; Index_Character < ThisNarrative.AllCharactersInUse.Num(); Index_Character++)
+		{
+			PGNVarint::WriteVarint(Out_Payload, AllIndicesInTemplateDictionary[Index_NextTemplate++]);
+		}
+	}
+
+	// Cast. There is one role for each template above, so the count is not stored again.
+	for (const FPGNGeneratedNarrative& ThisNarrative : AllNarrativesInChunk)
+	{
+		for (int32 Index_Character = 0; Index_Character < ThisNarrative.AllCharactersInUse.Num(); Index_Character++)
+		{
+			const int IndexOfCharacter = ThisNarrative.AllIndicesOfCharactersInUse.IsValidIndex(Index_Character)
+				? ThisNarrative.AllIndicesOfCharactersInUse[Index_Character] : INDEX_NONE;
+
+			PGNVarint::WriteVarint(Out_Payload, static_cast<uint32>(IndexOfCharacter + 1));
+		}
+	}
+}
+
+bool FPGNNarrativeHistoryArchive::DecodeConclusionEventIds(const TArray<uint8>& Payload, int32 NumberOfNarratives,
+	TArray<int>& Out_AllConclusionEventIds)
+{
+	PGNVarint::FReader Reader(Payload);
+
+	Out_AllConclusionEventIds.SetNumUninitialized(NumberOfNarratives);
+
+	for (int32 Index_Narrative = 0; Index_Narrative < NumberOfNarratives; Index_Narrative++)
+	{
+		Out_AllConclusionEventIds[Index_Narrative] = static_cast<int>(Reader.ReadVarint()) - 1;
+	}
+
+	return Reader.bIsValid;
+}
+
+bool FPGNNarrativeHistoryArchive::DecodeChunk(const TArray<uint8>& Payload, int32 NumberOfNarratives,
+	TArray<FPGNGeneratedNarrative>& Out_AllNarrativesInChunk)
+{
+	PGNVarint::FReader Reader(Payload);
+
+	Out_AllNarrativesInChunk.Reset();
+	Out_AllNarrativesInChunk.SetNum(NumberOfNarratives);
+
+	for (FPGNGeneratedNarrative& ThisNarrative : Out_AllNarrativesInChunk)
+	{
+		ThisNarrative.bIsNarrativeInitialized = true;
+		ThisNarrative.ConclusionEventId = static_cast<int>(Reader.ReadVarint()) - 1;
+	}
+
+	for (FPGNGeneratedNarrative& ThisNarrative : Out_AllNarrativesInChunk)
+	{
+		// A damaged count could ask for billions of events, so the payload size bounds it.
+		ThisNarrative.AllEventIds.SetNum(static_cast<int32>(FMath::Min<uint32>(Reader.ReadVarint(), Payload.Num())));
+	}
+
+	for (FPGNGeneratedNarrative& ThisNarrative : Out_AllNarrativesInChunk)
+	{
+		int PreviousEventId = 0;
+
+		for (int& ThisEventId : ThisNarrative.AllEventIds)
+		{
+			ThisEventId = PreviousEventId + Reader.ReadZigZag();
+			PreviousEventId = ThisEventId;
+		}
+	}
+
+	TArray<FPGNCharacterTemplate> TemplateDictionary;
+	TemplateDictionary.SetNum(static_cast<int32>(FMath::Min<uint32>(Reader.ReadVarint(), Payload.Num())));
+
+	for (FPGNCharacterTemplate& ThisTemplate : TemplateDictionary)
+	{
+		uint8 Occupation = 0;
+		uint8 CharacterGreatestDesire = 0;
+
+		Reader.ReadBytes(&Occupation, sizeof(Occupation));
+		ThisTemplate.OccupationSalary = Reader.ReadZigZag();
+		Reader.ReadBytes(&CharacterGreatestDesire, sizeof(CharacterGreatestDesire));
+		Reader.ReadBytes(&ThisTemplate.TendencyTowardsMoralDecisions, sizeof(float));
+		Reader.ReadBytes(&ThisTemplate.TendencyToPursueGreatestDesire, sizeof(float));
+		ThisTemplate.NumberOfTimesTemplateUsed = Reader.ReadZigZag();
+
+		ThisTemplate.Occupation = static_cast<EPGNCharacterOccupation>(Occupation);
+		ThisTemplate.CharacterGreatestDesire = static_cast<EPGNCharacterDesire>(CharacterGreatestDesire);
+	}
+
+	for (FPGNGeneratedNarrative& ThisNarrative : Out_AllNarrativesInChunk)
+	{
+		const int32 NumberOfCharacters = static_cast<int32>(FMath::Min<uint32>(Reader.ReadVarint(), Payload.Num()));
+		ThisNarrative.AllCharactersInUse.Reset(NumberOfCharacters);
+
+		for (int32 Index_Character = 0; Index_Character < NumberOfCharacters && Reader.bIsValid; Index_Character++)
+		{
+			const uint32 IndexInDictionary = Reader.ReadVarint();
+
+			if (!TemplateDictionary.IsValidIndex(static_cast<int32>(IndexInDictionary)))
+			{
+				return false;
+			}
+
+			ThisNarrative.AllCharactersInUse.Add(TemplateDictionary[IndexInDictionary]);
+		}
+	}
+
+	const bool bDoesChunkHaveCast = Reader.Offset < Payload.Num();
+
+	for (FPGNGeneratedNarrative& ThisNarrative : Out_AllNarrativesInChunk)
+	{
+		ThisNarrative.AllIndicesOfCharactersInUse.Init(INDEX_NONE, ThisNarrative.AllCharactersInUse.Num());
+
+		if (!bDoesChunkHaveCast)
+		{
+			continue;
+		}
+
+		for (int& IndexOfCharacter : ThisNarrative.AllIndicesOfCharactersInUse)
+		{
+			IndexOfCharacter = static_cast<int>(Reader.ReadVarint()) - 1;
+		}
+	}
+
+	return Reader.bIsValid;
+}
+
+#pragma endregion Encoding
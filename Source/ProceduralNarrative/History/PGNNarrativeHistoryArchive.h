@@ -0,0 +1,148 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralNarrative/PGNUtilities.h"
+
+class IFileHandle;
+
+/**
+ * Every narrative that has ever been generated, stored compactly and in order.
+ *
+ * Narratives are appended to a small pending list, and every NARRATIVES_PER_CHUNK of them are encoded into a chunk
+ * and appended to the archive file. Only the pending narratives and a small index entry per chunk stay in memory,
+ * so the cost of the history stays flat however long the world has been running.
+ *
+ * Each chunk is laid out in columns, so that restoring the recency state only decodes the conclusion event IDs:
+ *
+ *	Conclusion event IDs		One varint per narrative.
+ *	Event IDs					A count per narrative, then each ID as a zigzag varint delta from the one before it.
+ *	Character templates			A dictionary of every distinct template in the chunk, then per narrative a count
+ *								and an index into the dictionary for each character.
+ *	Cast						Per narrative, the index of the character in each role, plus one, as a varint. Chunks
+ *								written before the cast was stored end before this column, and decode as nobody cast.
+ *
+ * The file is append only. A chunk that was cut short by a crash fails its checksum and is dropped when the file is
+ * opened again. If no file is opened, the chunks are kept in memory instead, which is still far smaller than keeping
+ * the narratives themselves, and the oldest of them can be forgotten with TrimToSize.
+ */
+class PROCEDURALNARRATIVE_API FPGNNarrativeHistoryArchive
+{
+public:
+
+	static constexpr int32 NARRATIVES_PER_CHUNK = 64;
+
+	// 'PGNH'
+	static constexpr uint32 FILE_MAGIC = 0x484E4750;
+	// 'PGNC'
+	static constexpr uint32 CHUNK_MAGIC = 0x434E4750;
+
+	// Bump this whenever the encoding of a chunk changes. Old history files will then be started over.
+	static constexpr uint32 FORMAT_VERSION = 1;
+
+	FPGNNarrativeHistoryArchive();
+	~FPGNNarrativeHistoryArchive();
+
+	FPGNNarrativeHistoryArchive(const FPGNNarrativeHistoryArchive&) = delete;
+	FPGNNarrativeHistoryArchive& operator=(const FPGNNarrativeHistoryArchive&) = delete;
+
+	// Opens the archive file, creating it if it does not exist, and reads its chunk index. Anything that was in the
+	// archive before is forgotten. If this fails, the archive falls back to keeping its chunks in memory.
+	bool OpenFile(const FString& Filename);
+
+	// Writes out any pending narratives, closes the file and empties the archive.
+	void Close();
+
+	bool IsFileOpen() const { return FileHandle.IsValid(); }
+
+	void Append(const FPGNGeneratedNarrative& Narrative);
+
+	// Encodes the pending narratives into a chunk, even if there are fewer than NARRATIVES_PER_CHUNK of them.
+	bool Flush();
+
+	int32 Num() const { return NumberOfNarrativesInChunks + PendingNarratives.Num(); }
+
+	// INDEX_NONE if the archive is empty.
+	int GetLastConclusionEventId() const { return LastConclusionEventId; }
+
+	// Only for following the live event IDs across a reload of the events. The archived narratives themselves keep
+	// the IDs they were written with.
+	void SetLastConclusionEventId(int InLastConclusionEventId) { LastConclusionEventId = InLastConclusionEventId; }
+
+	// Random access. Only the chunk that holds the narrative is read and decoded.
+	bool GetNarrative(int32 NarrativeIndex, FPGNGeneratedNarrative& Out_Narrative) const;
+
+	// Streams through every narrative from StartIndex onwards, one chunk at a time. Return false to stop early.
+	void ForEachNarrative(int32 StartIndex,
+		TFunctionRef<bool(int32 NarrativeIndex, const FPGNGeneratedNarrative& Narrative)> Visitor) const;
+
+	// Streams through the conclusion event of every narrative without decoding anything else. This is all that is
+	// needed to restore the recency and mood state at startup.
+	void ForEachConclusionEventId(TFunctionRef<void(int32 NarrativeIndex, int ConclusionEventId)> Visitor) const;
+
+	// What the archive is holding in memory, which is everything if no file is open.
+	SIZE_T GetAllocatedSize() const;
+
+	// Encodes the pending narratives, and if no file is open, forgets the oldest chunks until the archive fits. The
+	// narratives that are left keep their indices, and the ones that were forgotten can no longer be found.
+	void TrimToSize(SIZE_T MaximumSize);
+
+private:
+
+	struct FChunkIndexEntry
+	{
+		// Where the chunk's payload starts in the file, or in InMemoryChunks if no file is open.
+		int64 OffsetOfPayload = 0;
+		uint32 SizeOfPayload = 0;
+		uint32 PayloadChecksum = 0;
+
+		int32 FirstNarrativeIndex = 0;
+		int32 NumberOfNarratives = 0;
+	};
+
+	// Written in front of every chunk's payload.
+	struct FChunkHeader
+	{
+		uint32 Magic = 0;
+		int32 FirstNarrativeIndex = 0;
+		int32 NumberOfNarratives = 0;
+		uint32 SizeOfPayload = 0;
+		uint32 PayloadChecksum = 0;
+		uint32 Reserved = 0;
+	};
+
+	struct FFileHeader
+	{
+		uint32 Magic = 0;
+		uint32 FormatVersion = 0;
+	};
+
+	void Reset();
+
+	// Reads the header of every chunk in the file, without their payloads. Returns the offset just past the last
+	// whole chunk.
+	int64 ReadChunkIndexFromFile();
+
+	bool WriteChunk(const TArray<uint8>& Payload, int32 FirstNarrativeIndex, int32 NumberOfNarratives);
+	bool ReadChunkPayload(const FChunkIndexEntry& Chunk, TArray<uint8>& Out_Payload) const;
+
+	int32 FindChunkWithThisNarrative(int32 NarrativeIndex) const;
+
+	static void EncodeChunk(const TArray<FPGNGeneratedNarrative>& AllNarrativesInChunk, TArray<uint8>& Out_Payload);
+	static bool DecodeChunk(const TArray<uint8>& Payload, int32 NumberOfNarratives,
+		TArray<FPGNGeneratedNarrative>& Out_AllNarrativesInChunk);
+	static bool DecodeConclusionEventIds(const TArray<uint8>& Payload, int32 NumberOfNarratives,
+		TArray<int>& Out_AllConclusionEventIds);
+
+	TArray<FChunkIndexEntry> ChunkIndex;
+	int32 NumberOfNarrativesInChunks = 0;
+
+	TArray<FPGNGeneratedNarrative> PendingNarratives;
+	int LastConclusionEventId = INDEX_NONE;
+
+	FString ArchiveFilename;
+	TUniquePtr<IFileHandle> FileHandle;
+
+	TArray<uint8> InMemoryChunks;
+};
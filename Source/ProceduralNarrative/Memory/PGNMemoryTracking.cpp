@@ -0,0 +1,130 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/Memory/PGNMemoryTracking.h"
+
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/LowLevelMemStats.h"
+#include "ProceduralNarrative/PGNOverseer.h"
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+
+DECLARE_LLM_MEMORY_STAT(TEXT("ProceduralNarrative"), STAT_PGNSummaryLLM, STATGROUP_LLM);
+DECLARE_LLM_MEMORY_STAT(TEXT("PGN Characters"), STAT_PGNCharactersLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("PGN Graphs"), STAT_PGNGraphsLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("PGN Events"), STAT_PGNEventsLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("PGN History"), STAT_PGNHistoryLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("PGN Generation"), STAT_PGNGenerationLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("PGN Caches"), STAT_PGNCachesLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("PGN Save"), STAT_PGNSaveLLM, STATGROUP_LLMFULL);
+
+#endif
+
+void FPGNMemoryTracking::RegisterLowLevelMemoryTags()
+{
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	static bool bHaveTagsBeenRegistered = false;
+
+	if (bHaveTagsBeenRegistered)
+	{
+		return;
+	}
+
+	bHaveTagsBeenRegistered = true;
+
+	FLowLevelMemTracker& LowLevelMemTracker = FLowLevelMemTracker::Get();
+
+	// Every tag adds up into the one ProceduralNarrative line of "stat LLM", and is broken down in "stat LLMFull".
+	const FName SummaryStatName = GET_STATFNAME(STAT_PGNSummaryLLM);
+
+	LowLevelMemTracker.RegisterProjectTag(static_cast<int32>(EPGNLLMTag::Characters), TEXT("PGNCharacters"),
+		GET_STATFNAME(STAT_PGNCharactersLLM), SummaryStatName);
+	LowLevelMemTracker.RegisterProjectTag(static_cast<int32>(EPGNLLMTag::Graphs), TEXT("PGNGraphs"),
+		GET_STATFNAME(STAT_PGNGraphsLLM), SummaryStatName);
+	LowLevelMemTracker.RegisterProjectTag(static_cast<int32>(EPGNLLMTag::Events), TEXT("PGNEvents"),
+		GET_STATFNAME(STAT_PGNEventsLLM), SummaryStatName);
+	LowLevelMemTracker.RegisterProjectTag(static_cast<int32>(EPGNLLMTag::History), TEXT("PGNHistory"),
+		GET_STATFNAME(STAT_PGNHistoryLLM), SummaryStatName);
+	LowLevelMemTracker.RegisterProjectTag(static_cast<int32>(EPGNLLMTag::Generation), TEXT("PGNGeneration"),
+		GET_STATFNAME(STAT_PGNGenerationLLM), SummaryStatName);
+	LowLevelMemTracker.RegisterProjectTag(static_cast<int32>(EPGNLLMTag::Caches), TEXT("PGNCaches"),
+		GET_STATFNAME(STAT_PGNCachesLLM), SummaryStatName);
+	LowLevelMemTracker.RegisterProjectTag(static_cast<int32>(EPGNLLMTag::Save), TEXT("PGNSave"),
+		GET_STATFNAME(STAT_PGNSaveLLM), SummaryStatName);
+#endif
+}
+
+SIZE_T FPGNMemoryTracking::GetAllocatedSizeOfCharacter(const FPGNCharacter& ThisCharacter)
+{
+	SIZE_T AllocatedSize = ThisCharacter.Name.GetAllocatedSize()
+		+ ThisCharacter.MyRomanticData.NameOfRomanticPartner.GetAllocatedSize()
+		+ ThisCharacter.AllMySocialData.GetAllocatedSize();
+
+	for (const FPGNCharacterSocialData& ThisSocialData : ThisCharacter.AllMySocialData)
+	{
+		AllocatedSize += ThisSocialData.NameOfSocialPartner.GetAllocatedSize();
+	}
+
+	return AllocatedSize;
+}
+
+SIZE_T FPGNMemoryTracking::GetAllocatedSizeOfNarrative(const FPGNGeneratedNarrative& ThisNarrative)
+{
+	return ThisNarrative.AllEventIds.GetAllocatedSize() + ThisNarrative.AllIndicesOfCharactersInUse.GetAllocatedSize()
+		+ ThisNarrative.AllCharactersInUse.GetAllocatedSize();
+}
+
+void FPGNMemoryUsage::Log(FOutputDevice& Output, const TCHAR* NameOfOverseer) const
+{
+	Output.Logf(TEXT("%s: %.1f KB in total"), NameOfOverseer, GetTotal() / 1024.f);
+	Output.Logf(TEXT("    Characters: %.1f KB"), Characters / 1024.f);
+	Output.Logf(TEXT("    Graphs:     %.1f KB"), Graphs / 1024.f);
+	Output.Logf(TEXT("    Events:     %.1f KB (shared)"), Events / 1024.f);
+	Output.Logf(TEXT("    History:    %.1f KB"), History / 1024.f);
+	Output.Logf(TEXT("    Caches:     %.1f KB"), Caches / 1024.f);
+}
+
+// pgn.mem
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice GLogMemoryUsageCommand(
+	TEXT("pgn.mem"),
+	TEXT("Lists how much memory every overseer in the world is using, and whether it is over its budgets."),
+	FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateLambda(
+		[](const TArray<FString>& Args, UWorld* World, FOutputDevice& Output)
+		{
+			if (World == nullptr)
+			{
+				Output.Log(TEXT("There is no world to find overseers in."));
+				return;
+			}
+
+			int NumberOfOverseers = 0;
+
+			for (TActorIterator<APGNOverseer> It(World); It; ++It)
+			{
+				const APGNOverseer* ThisOverseer = *It;
+
+				FPGNMemoryUsage MemoryUsage;
+				ThisOverseer->GatherMemoryUsage(MemoryUsage);
+				MemoryUsage.Log(Output, *ThisOverseer->GetName());
+
+				if (ThisOverseer->HistoryMemoryBudgetInKilobytes > 0)
+				{
+					Output.Logf(TEXT("    History budget: %d KB%s"), ThisOverseer->HistoryMemoryBudgetInKilobytes,
+						MemoryUsage.History > ThisOverseer->HistoryMemoryBudgetInKilobytes * 1024ull ? TEXT(", exceeded") : TEXT(""));
+				}
+
+				if (ThisOverseer->CacheMemoryBudgetInKilobytes > 0)
+				{
+					Output.Logf(TEXT("    Cache budget:   %d KB%s"), ThisOverseer->CacheMemoryBudgetInKilobytes,
+						MemoryUsage.Caches > ThisOverseer->CacheMemoryBudgetInKilobytes * 1024ull ? TEXT(", exceeded") : TEXT(""));
+				}
+
+				NumberOfOverseers++;
+			}
+
+			if (NumberOfOverseers == 0)
+			{
+				Output.Log(TEXT("There are no overseers in this world."));
+			}
+		}));
@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/LruCache.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "ProceduralNarrative/PGNUtilities.h"
+
+/*
+ * Every allocation the narrative subsystem makes is tagged for the Low-Level Memory tracker with one of these, so that
+ * it shows up under ProceduralNarrative in memory captures and in "stat LLM" instead of in the engine's generic
+ * buckets. Wrap anything that allocates in PGN_LLM_SCOPE(<Tag>). The tags are registered when the module starts up.
+ */
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+
+enum class EPGNLLMTag : LLM_TAG_TYPE
+{
+	Characters = static_cast<LLM_TAG_TYPE>(ELLMTag::ProjectTagStart),
+	Graphs,
+	Events,
+	History,
+	Generation,
+	Caches,
+	Save,
+
+	Count
+};
+
+#define PGN_LLM_SCOPE(Tag) LLM_SCOPE(static_cast<ELLMTag>(EPGNLLMTag::Tag))
+
+#else
+
+#define PGN_LLM_SCOPE(Tag)
+
+#endif
+
+// How much memory each part of an overseer is using right now, in bytes.
+struct PROCEDURALNARRATIVE_API FPGNMemoryUsage
+{
+	// AllCharacters, the waiting list for spouses and the cached characters of a virtual population.
+	SIZE_T Characters = 0;
+
+	// The character graph, the relationship oracle and the social community index.
+	SIZE_T Graphs = 0;
+
+	// The world data and event library. These are shared with every other overseer that uses the same assets.
+	SIZE_T Events = 0;
+
+	// The narrative history, the character timeline and the usage of every conclusion event.
+	SIZE_T History = 0;
+
+	// The scores the narrative evaluator remembers and the distances the social distance service remembers. All of
+	// this can be thrown away and found again.
+	SIZE_T Caches = 0;
+
+	SIZE_T GetTotal() const { return Characters + Graphs + Events + History + Caches; }
+
+	// One line per part, in kilobytes.
+	void Log(FOutputDevice& Output, const TCHAR* NameOfOverseer) const;
+};
+
+class PROCEDURALNARRATIVE_API FPGNMemoryTracking
+{
+public:
+
+	// Only does anything the first time it is called.
+	static void RegisterLowLevelMemoryTags();
+
+	// TLruCache allocates each entry on its own, so this adds the entries to whatever each value holds on the heap.
+	template <typename KeyType, typename ValueType, typename FunctorType>
+	static SIZE_T GetAllocatedSizeOfLruCache(const TLruCache<KeyType, ValueType>& Cache, FunctorType GetAllocatedSizeOfValue)
+	{
+		SIZE_T AllocatedSize = GetAllocatedSizeOfLruCache(Cache);
+
+		for (typename TLruCache<KeyType, ValueType>::TConstIterator It(Cache); It; ++It)
+		{
+			AllocatedSize += GetAllocatedSizeOfValue(It.Value());
+		}
+
+		return AllocatedSize;
+	}
+
+	template <typename KeyType, typename ValueType>
+	static SIZE_T GetAllocatedSizeOfLruCache(const TLruCache<KeyType, ValueType>& Cache)
+	{
+		// Each entry is the key, the value and a link either way, plus its slot in the set that finds it by key.
+		constexpr SIZE_T SIZE_OF_ENTRY = sizeof(KeyType) + sizeof(ValueType) + 2 * sizeof(void*);
+		constexpr SIZE_T SIZE_OF_SET_ELEMENT = sizeof(void*) + 2 * sizeof(int32);
+
+		return Cache.Num() * (SIZE_OF_ENTRY + SIZE_OF_SET_ELEMENT);
+	}
+
+	static SIZE_T GetAllocatedSizeOfCharacter(const FPGNCharacter& ThisCharacter);
+	static SIZE_T GetAllocatedSizeOfNarrative(const FPGNGeneratedNarrative& ThisNarrative);
+};
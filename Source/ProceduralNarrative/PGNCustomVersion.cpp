@@ -0,0 +1,11 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "PGNCustomVersion.h"
+
+#include "Serialization/CustomVersion.h"
+
+const FGuid FPGNCustomVersion::GUID(0x83B724C9, 0x18CD4CD2, 0xAAAFAACA, 0x67E46F36);
+
+// Register the custom version with core
+FCustomVersionRegistration GRegisterPGNCustomVersion(FPGNCustomVersion::GUID, FPGNCustomVersion::LatestVersion,
+	TEXT("ProceduralNarrativeVer"));
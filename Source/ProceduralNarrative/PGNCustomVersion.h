@@ -0,0 +1,32 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/Guid.h"
+
+// Custom serialization version for everything in the Procedural Narrative module that is saved as raw binary.
+struct PROCEDURALNARRATIVE_API FPGNCustomVersion
+{
+	enum Type
+	{
+		// Before any version changes were made
+		BeforeCustomVersionWasAdded = 0,
+
+		// The data assets store their derived data alongside the authored data.
+		AddedBakedDerivedData,
+
+		// The event library can carry the names of imported events.
+		AddedEventNamesToEventLibrary,
+
+		// -----<new versions can be added above this line>-------------------------------------------------
+		VersionPlusOne,
+		LatestVersion = VersionPlusOne - 1
+	};
+
+	// The GUID for this custom version number
+	const static FGuid GUID;
+
+private:
+	FPGNCustomVersion() {}
+};
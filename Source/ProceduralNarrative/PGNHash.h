@@ -0,0 +1,20 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+namespace PGNHash
+{
+	// The SplitMix64 finaliser. Neighbouring inputs come out completely unrelated, and changing any bit of the input
+	// changes every bit of the output with even odds.
+	FORCEINLINE uint64 MixBits(uint64 Value)
+	{
+		Value ^= Value >> 30;
+		Value *= 0xBF58476D1CE4E5B9ull;
+		Value ^= Value >> 27;
+		Value *= 0x94D049BB133111EBull;
+		Value ^= Value >> 31;
+		return Value;
+	}
+}
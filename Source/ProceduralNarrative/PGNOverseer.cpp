@@ -3,17 +3,25 @@
 
 #include "PGNOverseer.h"
 
+#include "Algo/AnyOf.h"
+#include "Algo/Count.h"
 #include "DataAssets/PGNCharacterDataAsset.h"
 #include "DataAssets/PGNEventDataAsset.h"
 #include "DataAssets/PGNMoodGraphDataAsset.h"
+#include "Events/PGNEventLibraryFile.h"
+#include "Generation/PGNScratchMemory.h"
 #include "Graphs/CharacterGraph.h"
 #include "Graphs/MoodGraph.h"
+#include "Misc/Paths.h"
+#include "World/PGNWorldData.h"
 
 // Sets default values
 APGNOverseer::APGNOverseer()
 {
- 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
-	PrimaryActorTick.bCanEverTick = true;
+ 	// Narratives are generated when they are requested, so there is nothing to do every frame.
+	PrimaryActorTick.bCanEverTick = false;
+
+	RelationshipOracle = MakeShared<FPGNRelationshipOracle, ESPMode::ThreadSafe>();
 }
 
 // Called when the game starts or when spawned
@@ -21,22 +29,104 @@ void APGNOverseer::BeginPlay()
 {
 	Super::BeginPlay();
 	InitializeOverseer();
+
+#if WITH_EDITOR
+	// Writers can then edit the events and the mood graph during play and see the results straight away.
+	ObjectPropertyChangedHandle = FCoreUObjectDelegates::OnObjectPropertyChanged.AddUObject(this,
+		&APGNOverseer::OnObjectPropertyChanged);
+#endif
+}
+
+void APGNOverseer::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+#if WITH_EDITOR
+	FCoreUObjectDelegates::OnObjectPropertyChanged.Remove(ObjectPropertyChangedHandle);
+#endif
+
+	// Nobody will serve these any more, so whoever is waiting on them hears back now.
+	if (NarrativeRequestTickerHandle.IsValid())
+	{
+		FPGNCoreTicker::GetCoreTicker().RemoveTicker(NarrativeRequestTickerHandle);
+		NarrativeRequestTickerHandle.Reset();
+	}
+	NarrativeRequests.CancelAll();
+
+	// The producer must not outlive the data it was handed.
+	NarrativePrefetcher.Reset();
+	NarrativeEvaluator.Reset();
+
+	// This is saved before it is archived, so that loading can tell it is already in the history.
+	SaveOverseerState();
+
+	// The narrative that is playing out now is part of the history too.
+	ArchiveCurrentNarrative();
+	NarrativeHistory.Close();
+
+	SaveJournal.WaitForPendingWrites();
+	
+	Super::EndPlay(EndPlayReason);
 }
 
 void APGNOverseer::InitializeOverseer()
 {
-	// Characters should be initialized first
-	InitializeAllCharacters();
+	// Everything that is read-only comes from the shared world data, so that has to be found first.
+	if (!InitializeWorldData())
+	{
+		return;
+	}
+
+	NarrativeRandomStream.Initialize(NarrativeGenerationSeed);
+
+	// The events and the history come before the characters, since a saved current narrative refers to both.
 	InitializeAllEvents();
-	InitializeMoodGraph();
+	InitializeNarrativeHistory();
+
+	if (!LoadOverseerState())
+	{
+		InitializeAllCharacters();
+
+		// A new town replaces whatever was saved before.
+		WriteSave(true);
+	}
+
+	InitializeNarrativeEvaluator();
+
+	if (bPrefetchNarratives)
+	{
+		NarrativePrefetcher = MakeUnique<FPGNNarrativePrefetcher>(NumberOfNarrativesToPrefetch);
+		InvalidatePrefetchedNarratives();
+		NarrativePrefetcher->StartPrefetching();
+	}
+}
+
+bool APGNOverseer::InitializeWorldData()
+{
+	PGN_LLM_SCOPE(Events);
+
+	// Relative paths to the event library file start from the project's Content folder.
+	FString EventLibraryFilename = EventLibraryFile.FilePath;
+
+	if (!EventLibraryFilename.IsEmpty() && FPaths::IsRelative(EventLibraryFilename))
+	{
+		EventLibraryFilename = FPaths::Combine(FPaths::ProjectContentDir(), EventLibraryFilename);
+	}
+
+	// Every overseer in the process that uses the same assets shares a single copy of this.
+	WorldData = FPGNWorldDataCache::Get().FindOrCreate(EventDataAsset, EventLibraryFilename, MoodGraphDataAsset,
+		CharacterDataAsset);
+
+	return WorldData.IsValid();
 }
 
 bool APGNOverseer::InitializeAllEvents()
 {
-	// We are going to get all of the possible conclusion events from our Event Data Asset.
-	CONCLUSION_AllEvents = EventDataAsset->AllConclusionEvents;
+	EventLibrary = WorldData->EventLibrary;
 
-	if (CONCLUSION_AllEvents.Num() == 0)
+	// Only the usage of each conclusion event belongs to us; the events themselves are shared.
+	AllConclusionEventUsage.Reset();
+	AllConclusionEventUsage.SetNum(WorldData->AllConclusionEvents.Num());
+
+	if (WorldData->AllConclusionEvents.Num() == 0)
 	{
 		UE_LOG(LogTemp, Error, TEXT("There are no conclusion events in the Event Data Asset. Please add some and try again."));
 		return false;
@@ -45,58 +135,286 @@ bool APGNOverseer::InitializeAllEvents()
 	return true;
 }
 
-void APGNOverseer::InitializeMoodGraph()
+void APGNOverseer::InitializeNarrativeEvaluator()
 {
-	MoodGraph = NewObject<UMoodGraph>(this);
+	// The evaluator looks relationships up on whichever thread is scoring, which is safe since lookups never change
+	// anything.
+	NarrativeEvaluator = MakeUnique<FPGNNarrativeEvaluator>(EventLibrary, GetMoodDistanceTable(),
+		EventDataAsset != nullptr ? EventDataAsset->DesiredFinalDramaticTension : 0.f,
+		[this](int32 IndexOfCharacterA, int32 IndexOfCharacterB, FPGNRelationship& Out_Relationship)
+		{
+			return FindRelationshipBetweenCharacters(IndexOfCharacterA, IndexOfCharacterB, Out_Relationship);
+		}, NumberOfEvaluationsToCache);
+}
 
-	const TArray<FMoodGraphVertex> AllVertices = MoodGraphDataAsset->AllVertices;
-	const TArray<FMoodGraphEdge> AllEdges = MoodGraphDataAsset->AllEdges;
-	
-	MoodGraph->InitializeMoodGraphWithAllData(MoodGraphDataAsset->AllVertices, MoodGraphDataAsset->AllEdges);
+#pragma region Hot Reload
+
+void APGNOverseer::ReloadWorldData()
+{
+	const double StartTime = FPlatformTime::Seconds();
+	const FPGNWorldDataPtr PreviousWorldData = WorldData;
+
+	// If we never started, there is nothing to keep, so we will start from scratch.
+	if (!PreviousWorldData.IsValid())
+	{
+		InitializeOverseer();
+		return;
+	}
+
+	// Only the parts of the world data whose assets changed are built again. See FPGNWorldDataCache.
+	if (!InitializeWorldData())
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not reload the world data, so the previous version will be kept."));
+		WorldData = PreviousWorldData;
+		return;
+	}
+
+	if (WorldData == PreviousWorldData)
+	{
+		return;
+	}
+
+	if (WorldData->EventLibrary != PreviousWorldData->EventLibrary)
+	{
+		ApplyEventLibraryChanges(*PreviousWorldData->EventLibrary);
+	}
+
+	// The mood graph is built again the next time something asks for it.
+	if (WorldData->MoodDistanceTable != PreviousWorldData->MoodDistanceTable)
+	{
+		MoodGraph = nullptr;
+	}
+
+	// Every cached score and every queued narrative refers to the previous events and moods.
+	InitializeNarrativeEvaluator();
+	InvalidatePrefetchedNarratives();
+
+	// The current narrative may refer to different event IDs now.
+	PublishNarrativeState();
+
+	UE_LOG(LogTemp, Log, TEXT("Reloaded the world data in %.2f ms."), (FPlatformTime::Seconds() - StartTime) * 1000.0);
+}
+
+void APGNOverseer::ApplyEventLibraryChanges(const FPGNEventLibrary& PreviousEventLibrary)
+{
+	EventLibrary = WorldData->EventLibrary;
+
+	TArray<FPGNEventId> NewEventIdOfEachPreviousEvent;
+	EventLibrary->MatchEventsOfPreviousVersion(PreviousEventLibrary, NewEventIdOfEachPreviousEvent);
+
+	const auto FindNewEventId = [&NewEventIdOfEachPreviousEvent](int PreviousEventId)
+	{
+		return NewEventIdOfEachPreviousEvent.IsValidIndex(PreviousEventId) ? NewEventIdOfEachPreviousEvent[PreviousEventId]
+			: INVALID_PGN_EVENT_ID;
+	};
+
+	// Conclusion events take their usage with them. The usage of conclusion events that were removed is dropped.
+	TArray<TArray<int>> NewConclusionEventUsage;
+	NewConclusionEventUsage.SetNum(WorldData->AllConclusionEvents.Num());
+
+	for (int PreviousEventId = 0; PreviousEventId < AllConclusionEventUsage.Num(); PreviousEventId++)
+	{
+		const FPGNEventId NewEventId = FindNewEventId(PreviousEventId);
+
+		if (NewConclusionEventUsage.IsValidIndex(NewEventId))
+		{
+			NewConclusionEventUsage[NewEventId] = MoveTemp(AllConclusionEventUsage[PreviousEventId]);
+		}
+	}
+
+	AllConclusionEventUsage = MoveTemp(NewConclusionEventUsage);
+
+	// The next narrative carries on from the mood of the last conclusion, so if that event was removed, we will keep
+	// its mood instead.
+	const bool bIsCurrentNarrativeTheLast = CurrentNarrative.bIsNarrativeInitialized && !bIsCurrentNarrativeArchived;
+	const int PreviousLastConclusionEventId = bIsCurrentNarrativeTheLast ? CurrentNarrative.ConclusionEventId
+		: NarrativeHistory.GetLastConclusionEventId();
+
+	if (PreviousEventLibrary.IsValidEventId(PreviousLastConclusionEventId)
+		&& FindNewEventId(PreviousLastConclusionEventId) == INVALID_PGN_EVENT_ID)
+	{
+		bHasMoodOfRemovedConclusionEvent = true;
+		MoodOfRemovedConclusionEvent = PreviousEventLibrary.GetEvent(PreviousLastConclusionEventId).GetMood();
+	}
+
+	// Archived narratives keep the IDs they were written with, but the last conclusion is looked up live.
+	if (NarrativeHistory.GetLastConclusionEventId() != INDEX_NONE)
+	{
+		NarrativeHistory.SetLastConclusionEventId(FindNewEventId(NarrativeHistory.GetLastConclusionEventId()));
+	}
+
+	// The current narrative carries on without any of its events that were removed.
+	CurrentNarrative.ConclusionEventId = FindNewEventId(CurrentNarrative.ConclusionEventId);
+
+	for (int& ThisEventId : CurrentNarrative.AllEventIds)
+	{
+		ThisEventId = FindNewEventId(ThisEventId);
+	}
+
+	CurrentNarrative.AllEventIds.Remove(INVALID_PGN_EVENT_ID);
+
+	// A narrative without its conclusion is no narrative at all, so it will not be archived, and readers will see that
+	// there is no current narrative.
+	if (CurrentNarrative.ConclusionEventId == INVALID_PGN_EVENT_ID)
+	{
+		CurrentNarrative.bIsNarrativeInitialized = false;
+		CastOfNarrativeBeingGenerated.Reset();
+	}
+
+	if (CurrentNarrative.bIsNarrativeInitialized && WorldData->AllConclusionEvents.IsValidIndex(CurrentNarrative.ConclusionEventId))
+	{
+		CurrentConclusionEvent = WorldData->AllConclusionEvents[CurrentNarrative.ConclusionEventId];
+		CurrentConclusionEvent.AllNarrativesThisConclusionEventIsIn = AllConclusionEventUsage[CurrentNarrative.ConclusionEventId];
+	}
+	else
+	{
+		CurrentConclusionEvent = FPGNConclusionEvent();
+	}
+
+	const int NumberOfEventsKept = NewEventIdOfEachPreviousEvent.Num()
+		- Algo::Count(NewEventIdOfEachPreviousEvent, INVALID_PGN_EVENT_ID);
+
+	UE_LOG(LogTemp, Log, TEXT("Reloaded the events: %d kept, %d removed and %d added."), NumberOfEventsKept,
+		NewEventIdOfEachPreviousEvent.Num() - NumberOfEventsKept, EventLibrary->GetNumberOfEvents() - NumberOfEventsKept);
+}
+
+#if WITH_EDITOR
+void APGNOverseer::OnObjectPropertyChanged(UObject* ChangedObject, FPropertyChangedEvent& PropertyChangedEvent)
+{
+	// Dragging a value sends a change for every step of the drag, so we will wait for the drag to end.
+	if (PropertyChangedEvent.ChangeType == EPropertyChangeType::Interactive)
+	{
+		return;
+	}
+
+	if (ChangedObject != nullptr && (ChangedObject == EventDataAsset || ChangedObject == MoodGraphDataAsset))
+	{
+		ReloadWorldData();
+	}
+}
+#endif
+
+#pragma endregion Hot Reload
+
+const TArray<FPGNConclusionEvent>& APGNOverseer::GetAllConclusionEvents() const
+{
+	static const TArray<FPGNConclusionEvent> NoConclusionEvents;
+	return WorldData.IsValid() ? WorldData->AllConclusionEvents : NoConclusionEvents;
+}
+
+const TArray<int>& APGNOverseer::GetMoodDistanceTable() const
+{
+	static const TArray<int> NoMoodDistances;
+	return WorldData.IsValid() ? WorldData->MoodDistanceTable : NoMoodDistances;
+}
+
+UMoodGraph* APGNOverseer::GetMoodGraph()
+{
+	// Generation only needs the shared distance table, so the graph itself is only built if something asks for it.
+	if (MoodGraph == nullptr && MoodGraphDataAsset != nullptr)
+	{
+		MoodGraph = NewObject<UMoodGraph>(this);
+		MoodGraph->InitializeMoodGraphWithAllData(MoodGraphDataAsset->AllVertices, MoodGraphDataAsset->AllEdges);
+	}
+
+	return MoodGraph;
 }
 
-// Called every frame
-void APGNOverseer::Tick(float DeltaTime)
+void APGNOverseer::InitializeNarrativeHistory()
 {
-	Super::Tick(DeltaTime);
+	PGN_LLM_SCOPE(History);
+
+	if (!bPersistNarrativeHistory || NarrativeHistoryFilename.IsEmpty())
+	{
+		return;
+	}
+
+	const FString HistoryFilename = FPaths::IsRelative(NarrativeHistoryFilename)
+		? FPaths::Combine(FPaths::ProjectSavedDir(), NarrativeHistoryFilename)
+		: NarrativeHistoryFilename;
+
+	if (!NarrativeHistory.OpenFile(HistoryFilename))
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not open the narrative history %s, so it will only be kept for this session."),
+			*HistoryFilename);
+		return;
+	}
+
+	// We only need to know which narratives each conclusion event was used in; nothing else is decoded.
+	for (TArray<int>& ThisConclusionEventUsage : AllConclusionEventUsage)
+	{
+		ThisConclusionEventUsage.Reset();
+	}
+
+	NarrativeHistory.ForEachConclusionEventId([this](int32 NarrativeIndex, int ConclusionEventId)
+	{
+		if (AllConclusionEventUsage.IsValidIndex(ConclusionEventId))
+		{
+			AllConclusionEventUsage[ConclusionEventId].Add(NarrativeIndex);
+		}
+	});
 
-	// We will generate a new narrative every second.
-	TimerSinceLastNarrativeGeneration += DeltaTime;
-	if (TimerSinceLastNarrativeGeneration > HOW_LONG_BEFORE_GENERATING_NEW_NARRATIVES)
+	// The events may have changed since the history was written.
+	if (NarrativeHistory.Num() > 0 && !AllConclusionEventUsage.IsValidIndex(NarrativeHistory.GetLastConclusionEventId()))
 	{
-		TimerSinceLastNarrativeGeneration = 0.f;
-		GenerateNewNarrative();
+		UE_LOG(LogTemp, Warning, TEXT("The last narrative in %s ended with a conclusion event that no longer exists."),
+			*HistoryFilename);
 	}
 }
 
 void APGNOverseer::InitializeAllCharacters()
 {
-	InitializeAllCharacterPopulationIntervalsFromDataAsset();
-	
+	PGN_LLM_SCOPE(Characters);
+
 	// How many characters should we generate? This should be dictated by the length of the campaign's.
 	constexpr int NUM_CHARACTERS_TO_GENERATE = 20;
 	AllCharacters.Reserve(NUM_CHARACTERS_TO_GENERATE);
 	
-	TArray<FPGNCharacterTemplate>& AllCharacterTemplates = CharacterDataAsset->AllCharacterTemplates;
+	const TArray<FPGNCharacterTemplate>& AllCharacterTemplates = CharacterDataAsset->AllCharacterTemplates;
+
+	if (AllCharacterTemplates.Num() == 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("There are no character templates in the Character Data Asset. Please add some and try again."));
+		return;
+	}
+
+	// We always use the template that has been used the least so far. The templates start out in that order (this
+	// is normally baked into the data asset), so they already form a valid heap and we never need to sort them.
+	const TArray<int>& TemplateAllocationOrder = WorldData->TemplateAllocationOrder;
+
+	// A virtual population generates its characters when they are needed, so there is nothing more to do up front.
+	if (bUseVirtualPopulation)
+	{
+		VirtualPopulation.Initialize(CharacterDataAsset, WorldData->GenerationAliasTable, TemplateAllocationOrder,
+			VirtualPopulationSeed, NumberOfVirtualCharacters, AverageNumberOfSocialPartnersInVirtualPopulation,
+			NumberOfVirtualCharactersToCache);
+		return;
+	}
+
+	TArray<FPGNTemplateAllocation> TemplateHeap;
+	TemplateHeap.Reserve(TemplateAllocationOrder.Num());
+	
+	for (const int IndexOfTemplate : TemplateAllocationOrder)
+	{
+		TemplateHeap.Add({ AllCharacterTemplates[IndexOfTemplate].NumberOfTimesTemplateUsed, IndexOfTemplate });
+	}
 
 	// Initialize the structs for all of our characters from the given Character Templates.
 	for (int Index_Character = 0; Index_Character < NUM_CHARACTERS_TO_GENERATE; Index_Character++)
 	{
-		// We will first sort our array of all of the character templates based off of the number of times the
-		// template has been used thus far.
-		AllCharacterTemplates.Sort([](const FPGNCharacterTemplate& A, const FPGNCharacterTemplate& B)
-		{
-			return A.NumberOfTimesTemplateUsed < B.NumberOfTimesTemplateUsed;
-		});
+		FPGNTemplateAllocation LeastUsedTemplate;
+		TemplateHeap.HeapPop(LeastUsedTemplate, false);
 
-		FPGNCharacterTemplate& ThisCharacterTemplateToUse = AllCharacterTemplates[0];
+		FPGNCharacterTemplate ThisCharacterTemplateToUse = AllCharacterTemplates[LeastUsedTemplate.IndexOfTemplate];
 
 		FPGNCharacter ThisInitializedCharacter;
 		InitializeThisIndividualCharacter(ThisCharacterTemplateToUse, ThisInitializedCharacter);
 		
 		AllCharacters.Add(ThisInitializedCharacter);
-		
-		ThisCharacterTemplateToUse.NumberOfTimesTemplateUsed++;
+
+		// The usage count lives on our side, so the data asset itself is never modified at runtime.
+		LeastUsedTemplate.NumberOfTimesUsed++;
+		TemplateHeap.HeapPush(LeastUsedTemplate);
 	}
 
 	InitializeAllCharacterRelationships();
@@ -121,17 +439,6 @@ void APGNOverseer::InitializeAllCharacters()
 	UE_LOG(LogTemp, Log, TEXT("**********************************"));
 }
 
-void APGNOverseer::InitializeAllCharacterPopulationIntervalsFromDataAsset() const
-{
-	int Start = 0.f;
-
-	for (auto ThisDemographic : CharacterDataAsset->AllDemographicParameters)
-	{
-		ThisDemographic.IntervalOfPopulation = Start + ThisDemographic.PopulationShare;
-		Start = ThisDemographic.IntervalOfPopulation;
-	}
-}
-
 void APGNOverseer::InitializeThisIndividualCharacter(FPGNCharacterTemplate& ThisCharacterTemplate,
 	FPGNCharacter& Out_ThisCharacter)
 {
@@ -141,6 +448,8 @@ void APGNOverseer::InitializeThisIndividualCharacter(FPGNCharacterTemplate& This
 	// We will then generate the character's age as a random number between the min and max age.
 	InitializeThisCharacterAge(Out_ThisCharacter);
 
+	Out_ThisCharacter.MyCharacterTemplate = ThisCharacterTemplate;
+
 	InitializeThisCharacterName(Out_ThisCharacter);
 }
 
@@ -152,24 +461,15 @@ void APGNOverseer::InitializeThisCharacterGender(FPGNCharacter& Out_ThisCharacte
 
 void APGNOverseer::InitializeThisCharacterAge(FPGNCharacter& Out_ThisCharacter) const
 {
-	const float RandomNumber = FMath::FRandRange(0.f, 1.f);
-
 	FPGNCharacterDemographicParameters SelectedDemographic;
 	SelectedDemographic.Generation = EPGNCharacterGeneration::GENERATION_Z;
-	
-	float CurrentMin = 0.f;
 
-	for (FPGNCharacterDemographicParameters ThisDemographic : CharacterDataAsset->AllDemographicParameters)
+	// This picks a generation in proportion to its population share in constant time.
+	const int IndexOfDemographic = WorldData->GenerationAliasTable.Sample(FMath::FRand(), FMath::FRand());
+	
+	if (CharacterDataAsset->AllDemographicParameters.IsValidIndex(IndexOfDemographic))
 	{
-		const float CurrentMax = CurrentMin + ThisDemographic.PopulationShare;
-
-		if (RandomNumber >= CurrentMin && RandomNumber < CurrentMax)
-		{
-			SelectedDemographic = ThisDemographic;
-			break;
-		}
-		
-		CurrentMin = CurrentMax;
+		SelectedDemographic = CharacterDataAsset->AllDemographicParameters[IndexOfDemographic];
 	}
 
 	Out_ThisCharacter.Generation = SelectedDemographic.Generation;
@@ -202,8 +502,24 @@ void APGNOverseer::InitializeThisCharacterName(FPGNCharacter& Out_ThisCharacter)
 
 void APGNOverseer::InitializeAllCharacterRelationships()
 {
+	GetMutableRelationshipOracle().Reset(AllCharacters.Num());
+
 	InitializeAllCharactersRomanticRelationships();
 	InitializeAllCharactersSocialRelationships();
+
+	InitializeCharacterTimeline();
+}
+
+void APGNOverseer::InitializeCharacterTimeline()
+{
+	CharacterTimeline.Reset();
+
+	// A virtual population is far too large to go through, so its characters are introduced as they are cast.
+	for (int Index_Character = 0; Index_Character < AllCharacters.Num(); Index_Character++)
+	{
+		CharacterTimeline.IntroduceCharacter(Index_Character,
+			FPGNCharacterTimeline::GetInitialFlagsOfCharacter(AllCharacters[Index_Character]));
+	}
 }
 
 void APGNOverseer::InitializeAllCharactersRomanticRelationships()
@@ -238,7 +554,7 @@ void APGNOverseer::InitializeAllCharactersRomanticRelationships()
 		}
 
 		// If we cannot find a spouse for this character, then set them to be single.
-		if (!FindPotentialRomanticSpouseForThisCharacter(ThisCharacter))
+		if (!FindPotentialRomanticSpouseForThisCharacter(AllCharactersWaitingForMarriagePartners[i]))
 		{
 			ThisCharacter.MyRomanticData.RomanticRelationship = EPGNCharacterRomanticRelationship::SINGLE;
 			ThisCharacter.bFoundValidMarriagePartner = false;
@@ -248,36 +564,20 @@ void APGNOverseer::InitializeAllCharactersRomanticRelationships()
 
 EPGNCharacterRomanticRelationship APGNOverseer::DetermineRelationshipFromRandomPercentage(float GeneratedChance)
 {
-	GeneratedChance = FMath::Clamp(GeneratedChance, 0.f, 1.f);
-	if (GeneratedChance <= CharacterDataAsset->PercentageOfCharactersWhoAreMarried)
-	{
-		return EPGNCharacterRomanticRelationship::MARRIED;
-	}
-
-	float CurrentIntervalLocation = CharacterDataAsset->PercentageOfCharactersWhoAreMarried;
-
-	if (GeneratedChance <= CharacterDataAsset->PercentageOfCharactersWhoAreDivorced + CurrentIntervalLocation)
-	{
-		return EPGNCharacterRomanticRelationship::DIVORCED;
-	}
-
-	CurrentIntervalLocation += CharacterDataAsset->PercentageOfCharactersWhoAreDivorced;
-
-	if (GeneratedChance <= CharacterDataAsset->PercentageOfCharactersWhoAreWidowed + CurrentIntervalLocation)
-	{
-		return EPGNCharacterRomanticRelationship::WIDOWED;
-	}
-
-	return EPGNCharacterRomanticRelationship::SINGLE;
+	return CharacterDataAsset->DetermineRomanticRelationshipFromPercentage(GeneratedChance);
 }
 
-bool APGNOverseer::FindPotentialRomanticSpouseForThisCharacter(FPGNCharacter& ThisCharacter)
+bool APGNOverseer::FindPotentialRomanticSpouseForThisCharacter(int IndexOfCharacter)
 {
+	FPGNCharacter& ThisCharacter = AllCharacters[IndexOfCharacter];
+
 	// We are going to search through all of the characters and find a potential romantic partner for this character.
 	for (int Index_Character = 0; Index_Character < AllCharactersWaitingForMarriagePartners.Num(); Index_Character++)
 	{
-		FPGNCharacter& ThisPotentialRomanticPartner = AllCharacters[AllCharactersWaitingForMarriagePartners[Index_Character]];
-		if (ThisPotentialRomanticPartner.bFoundValidMarriagePartner)
+		const int IndexOfPotentialRomanticPartner = AllCharactersWaitingForMarriagePartners[Index_Character];
+		
+		FPGNCharacter& ThisPotentialRomanticPartner = AllCharacters[IndexOfPotentialRomanticPartner];
+		if (ThisPotentialRomanticPartner.bFoundValidMarriagePartner || !ThisPotentialRomanticPartner.bIsInTown)
 		{
 			continue;
 		}
@@ -292,9 +592,14 @@ bool APGNOverseer::FindPotentialRomanticSpouseForThisCharacter(FPGNCharacter& Th
 		{
 			ThisPotentialRomanticPartner.MyRomanticData.NameOfRomanticPartner = ThisCharacter.Name;
 			ThisCharacter.MyRomanticData.NameOfRomanticPartner = ThisPotentialRomanticPartner.Name;
+
+			ThisPotentialRomanticPartner.MyRomanticData.IndexOfRomanticPartner = IndexOfCharacter;
+			ThisCharacter.MyRomanticData.IndexOfRomanticPartner = IndexOfPotentialRomanticPartner;
 			
 			ThisPotentialRomanticPartner.bFoundValidMarriagePartner = true;
 			ThisCharacter.bFoundValidMarriagePartner = true;
+
+			GetMutableRelationshipOracle().SetAreSpouses(IndexOfCharacter, IndexOfPotentialRomanticPartner, true);
 			
 			return true;
 		}
@@ -305,17 +610,23 @@ bool APGNOverseer::FindPotentialRomanticSpouseForThisCharacter(FPGNCharacter& Th
 
 void APGNOverseer::InitializeAllCharactersSocialRelationships()
 {
+	PGN_LLM_SCOPE(Graphs);
+
 	UE_LOG(LogTemp, Log, TEXT("* INITIALIZING ALL CHARACTERS SOCIAL RELATIONSHIPS *"));
 
-	const float ThresholdForEdgeCreation = FMath::FRandRange(0.f, 1.f);
+	ThresholdForSocialEdgeCreation = FMath::FRandRange(0.f, 1.f);
 
-	UE_LOG(LogTemp, Warning, TEXT("THE PROBABILITY IS %f"), ThresholdForEdgeCreation);
+	UE_LOG(LogTemp, Warning, TEXT("THE PROBABILITY IS %f"), ThresholdForSocialEdgeCreation);
 
-	// This will generate edges randomly between all of our characters.
-	UCharacterGraph* CharacterRelationsGraph = NewObject<UCharacterGraph>(this);
-	CharacterRelationsGraph->InitializeCharacterGraphWithErdosRenyi(this, ThresholdForEdgeCreation,
+	// This will generate edges randomly between all of our characters. We keep the graph afterwards, so that the town
+	// can change one character at a time instead of being built again.
+	CharacterGraph = NewObject<UCharacterGraph>(this);
+	CharacterGraph->InitializeCharacterGraphWithErdosRenyi(this, ThresholdForSocialEdgeCreation,
 		CharacterDataAsset->MaximumDistanceBetweenCharactersInSingleEdge);
 
+	SocialDistanceService.Initialize(CharacterGraph, NumberOfSocialDistanceSourcesToCache);
+	SocialCommunityIndex.Initialize(CharacterGraph);
+
 	// However, we still need to go through and determine the distances/weights of all the characters.
 	// We need to use the parameters as defined by the Character data asset to determine the social relationship.
 
@@ -336,132 +647,1528 @@ void APGNOverseer::InitializeAllCharactersSocialRelationships()
 
 	// After we do this for all edges in the graph, we will have successfully generated all social relationships.
 
-	for (const auto& ThisEdge : CharacterRelationsGraph->AllEdges)
+	for (const FCharacterGraphEdge& ThisEdge : CharacterGraph->AllEdges)
 	{
-		const float PercentageOfMaxDistance = static_cast<float>(ThisEdge.DistanceBetweenVertices) /
-			CharacterDataAsset->MaximumDistanceBetweenCharactersInSingleEdge;
+		AddSocialDataForThisEdge(ThisEdge);
+	}
 
-		const EPGNCharacterSocialRelationship SocialRelationship = DetermineSocialRelationshipFromRandomPercentage(
-			PercentageOfMaxDistance);
+	// Everything is built from scratch here, so nothing is out of date yet.
+	TArray<int> AllDirtyVertices;
+	CharacterGraph->ConsumeDirtyVertices(AllDirtyVertices);
+}
+
+void APGNOverseer::AddSocialDataForThisEdge(const FCharacterGraphEdge& ThisEdge)
+{
+	const float PercentageOfMaxDistance = static_cast<float>(ThisEdge.DistanceBetweenVertices) /
+		CharacterDataAsset->MaximumDistanceBetweenCharactersInSingleEdge;
 
-		const int IndexOfCharacterA = ThisEdge.VertexA.IndexInAllCharactersArray;
-		const int IndexOfCharacterB = ThisEdge.VertexB.IndexInAllCharactersArray;
+	const EPGNCharacterSocialRelationship SocialRelationship = DetermineSocialRelationshipFromRandomPercentage(
+		PercentageOfMaxDistance);
 
-		// Generate a new social relationship struct for both characters.
-		FPGNCharacterSocialData NewSocialDataForCharacterA;
-		NewSocialDataForCharacterA.NameOfSocialPartner = AllCharacters[IndexOfCharacterB].Name;
-		NewSocialDataForCharacterA.SocialRelationship = SocialRelationship;
+	const int IndexOfCharacterA = ThisEdge.VertexA.IndexInAllCharactersArray;
+	const int IndexOfCharacterB = ThisEdge.VertexB.IndexInAllCharactersArray;
 
-		AllCharacters[IndexOfCharacterA].AllMySocialData.Add(NewSocialDataForCharacterA);
+	// Generate a new social relationship struct for both characters.
+	FPGNCharacterSocialData NewSocialDataForCharacterA;
+	NewSocialDataForCharacterA.NameOfSocialPartner = AllCharacters[IndexOfCharacterB].Name;
+	NewSocialDataForCharacterA.IndexOfSocialPartner = IndexOfCharacterB;
+	NewSocialDataForCharacterA.SocialRelationship = SocialRelationship;
 
-		FPGNCharacterSocialData NewSocialDataForCharacterB;
-		NewSocialDataForCharacterB.NameOfSocialPartner = AllCharacters[IndexOfCharacterA].Name;
-		NewSocialDataForCharacterB.SocialRelationship = SocialRelationship;
+	AllCharacters[IndexOfCharacterA].AllMySocialData.Add(NewSocialDataForCharacterA);
 
-		AllCharacters[IndexOfCharacterB].AllMySocialData.Add(NewSocialDataForCharacterB);
-	}
+	FPGNCharacterSocialData NewSocialDataForCharacterB;
+	NewSocialDataForCharacterB.NameOfSocialPartner = AllCharacters[IndexOfCharacterA].Name;
+	NewSocialDataForCharacterB.IndexOfSocialPartner = IndexOfCharacterA;
+	NewSocialDataForCharacterB.SocialRelationship = SocialRelationship;
+
+	AllCharacters[IndexOfCharacterB].AllMySocialData.Add(NewSocialDataForCharacterB);
+
+	GetMutableRelationshipOracle().SetSocialRelationship(IndexOfCharacterA, IndexOfCharacterB, SocialRelationship,
+		ThisEdge.DistanceBetweenVertices);
+
+	SocialCommunityIndex.OnRelationshipAdded(IndexOfCharacterA, IndexOfCharacterB);
+
+	MarkRelationshipAsChangedSinceLastSave(IndexOfCharacterA, IndexOfCharacterB);
+}
+
+void APGNOverseer::RemoveSocialDataBetweenTheseCharacters(int IndexOfCharacterA, int IndexOfCharacterB)
+{
+	AllCharacters[IndexOfCharacterA].AllMySocialData.RemoveAll([IndexOfCharacterB](const FPGNCharacterSocialData& ThisSocialData)
+	{
+		return ThisSocialData.IndexOfSocialPartner == IndexOfCharacterB;
+	});
+
+	AllCharacters[IndexOfCharacterB].AllMySocialData.RemoveAll([IndexOfCharacterA](const FPGNCharacterSocialData& ThisSocialData)
+	{
+		return ThisSocialData.IndexOfSocialPartner == IndexOfCharacterA;
+	});
+
+	GetMutableRelationshipOracle().RemoveSocialRelationship(IndexOfCharacterA, IndexOfCharacterB);
+
+	SocialCommunityIndex.OnRelationshipRemoved(IndexOfCharacterA, IndexOfCharacterB);
+
+	MarkRelationshipAsChangedSinceLastSave(IndexOfCharacterA, IndexOfCharacterB);
 }
 
 EPGNCharacterSocialRelationship APGNOverseer::DetermineSocialRelationshipFromRandomPercentage(float GeneratedChance)
 {
-	float CurrentStartOfInterval = 0.f;
-	float CurrentEndOfInterval = CurrentStartOfInterval + CharacterDataAsset->PercentageOfCharactersWhoAreNeighbors;
+	return CharacterDataAsset->DetermineSocialRelationshipFromPercentage(GeneratedChance);
+}
+
+const FPGNCharacter* APGNOverseer::GetCharacter(int IndexOfCharacter)
+{
+	if (bUseVirtualPopulation)
+	{
+		return VirtualPopulation.GetCharacter(IndexOfCharacter);
+	}
+
+	return AllCharacters.IsValidIndex(IndexOfCharacter) ? &AllCharacters[IndexOfCharacter] : nullptr;
+}
 
-	if (GeneratedChance >= CurrentStartOfInterval && GeneratedChance <= CurrentEndOfInterval)
+int APGNOverseer::GetNumberOfCharacters() const
+{
+	return bUseVirtualPopulation ? VirtualPopulation.Num() : AllCharacters.Num();
+}
+
+bool APGNOverseer::FindRelationshipBetweenCharacters(int IndexOfCharacterA, int IndexOfCharacterB,
+	FPGNRelationship& Out_Relationship) const
+{
+	if (bUseVirtualPopulation)
 	{
-		return EPGNCharacterSocialRelationship::NEIGHBORS;
+		return VirtualPopulation.FindRelationship(IndexOfCharacterA, IndexOfCharacterB, Out_Relationship);
 	}
 
-	CurrentStartOfInterval = CurrentEndOfInterval;
-	CurrentEndOfInterval += CharacterDataAsset->PercentageOfCharactersWhoAreFamily;
+	return RelationshipOracle->FindRelationship(IndexOfCharacterA, IndexOfCharacterB, Out_Relationship);
+}
 
-	if (GeneratedChance >= CurrentStartOfInterval && GeneratedChance <= CurrentEndOfInterval)
+FPGNRelationshipOracle& APGNOverseer::GetMutableRelationshipOracle()
+{
+	// Only the game thread ever adds a reference, so once this is the only one, nobody else can be reading it.
+	if (!RelationshipOracle.IsUnique())
 	{
-		return EPGNCharacterSocialRelationship::FAMILY;
+		RelationshipOracle = MakeShared<FPGNRelationshipOracle, ESPMode::ThreadSafe>(*RelationshipOracle);
 	}
 
-	CurrentStartOfInterval = CurrentEndOfInterval;
-	CurrentEndOfInterval += CharacterDataAsset->PercentageOfCharactersWhoAreCoworkers;
+	return *RelationshipOracle;
+}
+
+EPGNCharacterAttitude APGNOverseer::FindCurrentAttitudeOfCharacter(int IndexOfCharacter) const
+{
+	const TArrayView<const FPGNCharacterTimelineEntry> Timeline = CharacterTimeline.GetTimeline(IndexOfCharacter);
 
-	if (GeneratedChance >= CurrentStartOfInterval && GeneratedChance <= CurrentEndOfInterval)
+	if (Timeline.Num() == 0 || !EventLibrary.IsValid())
 	{
-		return EPGNCharacterSocialRelationship::COWORKERS;
+		return EPGNCharacterAttitude::ATTITUDE_NONE;
 	}
 
-	CurrentStartOfInterval = CurrentEndOfInterval;
-	CurrentEndOfInterval += CharacterDataAsset->PercentageOfCharactersWhoAreFriends;
+	// Entries are not remapped when the events are reloaded, so the ID is only trusted while it still names an event
+	// with the same action.
+	const FPGNCharacterTimelineEntry& LastEntry = Timeline.Last();
 
-	if (GeneratedChance >= CurrentStartOfInterval && GeneratedChance <= CurrentEndOfInterval)
+	if (!EventLibrary->IsValidEventId(LastEntry.EventId) || EventLibrary->GetEvent(LastEntry.EventId).GetAction() != LastEntry.Action)
 	{
-		return EPGNCharacterSocialRelationship::FRIENDS;
+		return EPGNCharacterAttitude::ATTITUDE_NONE;
 	}
 
-	return EPGNCharacterSocialRelationship::ENEMIES;
+	const FPGNPackedEvent& LastEvent = EventLibrary->GetEvent(LastEntry.EventId);
+	return LastEntry.bWasSubject ? LastEvent.GetSubjectFinalAttitude() : LastEvent.GetObjectFinalAttitude();
 }
 
-void APGNOverseer::GenerateNewNarrative()
+void APGNOverseer::GatherCastingCandidates(TArray<FPGNCastingCandidate>& Out_AllCandidates)
 {
-	UE_LOG(LogTemp, Error, TEXT("_____________________________________________________"));
+	Out_AllCandidates.Reset();
 
-	if (CurrentNarrative.bIsNarrativeInitialized)
+	const auto AddCandidate = [this, &Out_AllCandidates](int IndexOfCharacter, const FPGNCharacter& ThisCharacter)
 	{
-		AllPreviouslyGeneratedNarratives.Add(CurrentNarrative);
-	}
+		CharacterTimeline.IntroduceCharacter(IndexOfCharacter, FPGNCharacterTimeline::GetInitialFlagsOfCharacter(ThisCharacter));
 
-	FPGNGeneratedNarrative NewNarrative;
+		FPGNCastingCandidate& NewCandidate = Out_AllCandidates.AddDefaulted_GetRef();
+		NewCandidate.IndexOfCharacter = IndexOfCharacter;
+		NewCandidate.bIsMale = ThisCharacter.bIsMale;
+		NewCandidate.Template = ThisCharacter.MyCharacterTemplate;
+		NewCandidate.StateFlags = CharacterTimeline.GetFlags(IndexOfCharacter);
+		NewCandidate.CurrentAttitude = FindCurrentAttitudeOfCharacter(IndexOfCharacter);
+	};
 
-#pragma region GenerateConclusionEvent
-	
-	// First, we need to randomly generate a conclusion.
-	// ToDo: Later on, we will want to use genetic algorithms to determine the best conclusion event.
-	UPGNUtilities::FindBestConclusionEvent(CurrentConclusionEvent, this);
-	UPGNUtilities::GeneratePossibleCastOfCharactersForThisEvent(NewNarrative, CurrentConclusionEvent,
-		this);
+	if (!bUseVirtualPopulation)
+	{
+		TArray<int32> AllIndicesOfConnectedCharacters;
+		GatherCharactersConnectedToTheCast(AllIndicesOfConnectedCharacters);
 
-	// Assign this value so we can use it for recency checks later down the line.
-	CurrentConclusionEvent.AllNarrativesThisConclusionEventIsIn.Add(AllPreviouslyGeneratedNarratives.Num());
-	
-	NewNarrative.ConclusionEvent = CurrentConclusionEvent;
+		if (AllIndicesOfConnectedCharacters.Num() > 0)
+		{
+			Out_AllCandidates.Reserve(AllIndicesOfConnectedCharacters.Num());
 
-	UPGNUtilities::DEBUG_PrintOutThisConclusionEvent(CurrentConclusionEvent);
+			for (const int32 IndexOfCharacter : AllIndicesOfConnectedCharacters)
+			{
+				if (AllCharacters[IndexOfCharacter].bIsInTown)
+				{
+					AddCandidate(IndexOfCharacter, AllCharacters[IndexOfCharacter]);
+				}
+			}
+
+			return;
+		}
 
-#pragma endregion GenerateConclusionEvent
+		for (int Index_Character = 0; Index_Character < AllCharacters.Num(); Index_Character++)
+		{
+			if (AllCharacters[Index_Character].bIsInTown)
+			{
+				AddCandidate(Index_Character, AllCharacters[Index_Character]);
+			}
+		}
 
-#pragma region GenerateEvents
+		return;
+	}
 
-	// Convergence is used for when we have reached the end of our narrative / genetic algorithm.
-	while (!HasCurrentNarrativeReachedConvergence())
+	if (VirtualPopulation.Num() == 0)
 	{
-		UPGNUtilities::FindBestNextEvent(CurrentEvent, this);
-		UPGNUtilities::GeneratePossibleCastOfCharactersForThisEvent(NewNarrative, CurrentEvent,
-			this);
+		return;
 	}
 
-#pragma endregion GenerateEvents
+	// Virtual characters only know the people who live near them, so we will cast from around the protagonist, or
+	// whoever was cast first, to keep the cast within reach of each other.
+	const int IndexOfAnchor = CastOfNarrativeBeingGenerated.Num() > 0
+		? CastOfNarrativeBeingGenerated[0].Character.IndexOfCharacter : NarrativeRandomStream.RandRange(0, VirtualPopulation.Num() - 1);
 
-	NewNarrative.bIsNarrativeInitialized = true;
-	
-	CurrentNarrative = NewNarrative;
+	const int NumberOfCandidates = FMath::Min(NumberOfVirtualCastingCandidates, VirtualPopulation.Num());
+	const int IndexOfFirstCandidate = FMath::Clamp(IndexOfAnchor - NumberOfCandidates / 2, 0,
+		VirtualPopulation.Num() - NumberOfCandidates);
 
-	UE_LOG(LogTemp, Error, TEXT("_____________________________________________________"));
+	Out_AllCandidates.Reserve(NumberOfCandidates);
+
+	FPGNCharacter ThisCharacter;
+
+	for (int Index_Character = IndexOfFirstCandidate; Index_Character < IndexOfFirstCandidate + NumberOfCandidates; Index_Character++)
+	{
+		if (VirtualPopulation.MaterializeCharacter(Index_Character, ThisCharacter))
+		{
+			AddCandidate(Index_Character, ThisCharacter);
+		}
+	}
 }
 
-bool APGNOverseer::HasCurrentNarrativeReachedConvergence()
+FPGNWorldState APGNOverseer::CreateWorldState() const
 {
-	// ToDo: This needs to be implemented.
-	return true;
+	// Nobody in a virtual population ever leaves it, so they all start in town.
+	return bUseVirtualPopulation ? FPGNWorldState(VirtualPopulation.Num())
+		: FPGNWorldState::CreateFromCharacters(AllCharacters);
 }
 
-// We use the mood graph to ensure that we do not jump from one tone to another too quickly.
-int APGNOverseer::EvaluateScoreFromMoodGraphForThisConclusionEvent(FPGNConclusionEvent& ThisConclusionEvent)
+void APGNOverseer::GatherCharactersConnectedToTheCast(TArray<int32>& Out_AllIndicesOfCharacters)
 {
-	/* All Moods to Use (12):
-	 *
-	 * VERTICES:
-	 * 1. Joyful
-	 * 2. Optimistic
-	 * 3. Playful
-	 * 4. Empathetic
+	Out_AllIndicesOfCharacters.Reset();
+
+	if (!bOnlyCastCharactersWhoAreConnected || !SocialCommunityIndex.IsInitialized())
+	{
+		return;
+	}
+
+	// We will look around whoever was cast first, or around someone in town at random for the first role.
+	int IndexOfAnchor = CastOfNarrativeBeingGenerated.Num() > 0 ? CastOfNarrativeBeingGenerated[0].Character.IndexOfCharacter
+		: INDEX_NONE;
+
+	if (IndexOfAnchor == INDEX_NONE)
+	{
+		TArray<int32> AllIndicesOfCharactersInTown;
+
+		for (int Index_Character = 0; Index_Character < AllCharacters.Num(); Index_Character++)
+		{
+			if (AllCharacters[Index_Character].bIsInTown)
+			{
+				AllIndicesOfCharactersInTown.Add(Index_Character);
+			}
+		}
+
+		if (AllIndicesOfCharactersInTown.Num() == 0)
+		{
+			return;
+		}
+
+		IndexOfAnchor = AllIndicesOfCharactersInTown[NarrativeRandomStream.RandRange(0, AllIndicesOfCharactersInTown.Num() - 1)];
+	}
+
+	// The people closest to the anchor make the most believable cast of all.
+	if (MaximumSocialDistanceOfCastingCandidates > 0 && SocialDistanceService.IsInitialized())
+	{
+		SocialDistanceService.FindCharactersWithinDistance(IndexOfAnchor, 0, MaximumSocialDistanceOfCastingCandidates,
+			Out_AllIndicesOfCharacters);
+		Out_AllIndicesOfCharacters.Insert(IndexOfAnchor, 0);
+
+		if (Out_AllIndicesOfCharacters.Num() >= MinimumNumberOfCastingCandidates)
+		{
+			return;
+		}
+
+		Out_AllIndicesOfCharacters.Reset();
+	}
+
+	if (bOnlyCastCharactersInTheSameCommunity
+		&& SocialCommunityIndex.GetSizeOfCommunity(IndexOfAnchor) >= MinimumNumberOfCastingCandidates)
+	{
+		SocialCommunityIndex.GatherCharactersInSameCommunity(IndexOfAnchor, Out_AllIndicesOfCharacters);
+		return;
+	}
+
+	if (SocialCommunityIndex.GetSizeOfComponent(IndexOfAnchor) >= MinimumNumberOfCastingCandidates)
+	{
+		SocialCommunityIndex.GatherCharactersInSameComponent(IndexOfAnchor, Out_AllIndicesOfCharacters);
+	}
+}
+
+void APGNOverseer::GatherCastOfThisNarrative(const FPGNGeneratedNarrative& ThisNarrative,
+	TArray<FPGNCastingCandidate>& Out_Cast)
+{
+	Out_Cast.Reset();
+	Out_Cast.SetNum(ThisNarrative.AllIndicesOfCharactersInUse.Num());
+
+	for (int Index_Role = 0; Index_Role < ThisNarrative.AllIndicesOfCharactersInUse.Num(); Index_Role++)
+	{
+		const FPGNCharacter* ThisCharacter = GetCharacter(ThisNarrative.AllIndicesOfCharactersInUse[Index_Role]);
+
+		if (ThisCharacter == nullptr)
+		{
+			continue;
+		}
+
+		Out_Cast[Index_Role].IndexOfCharacter = ThisNarrative.AllIndicesOfCharactersInUse[Index_Role];
+		Out_Cast[Index_Role].bIsMale = ThisCharacter->bIsMale;
+		Out_Cast[Index_Role].Template = ThisCharacter->MyCharacterTemplate;
+	}
+}
+
+#pragma region Population Changes
+
+bool APGNOverseer::IsCharacterInTown(int IndexOfCharacter) const
+{
+	return AllCharacters.IsValidIndex(IndexOfCharacter) && AllCharacters[IndexOfCharacter].bIsInTown;
+}
+
+int APGNOverseer::AddCharacterToTown(const FPGNCharacterTemplate& ThisCharacterTemplate)
+{
+	PGN_LLM_SCOPE(Characters);
+
+	FPGNCharacterTemplate ThisCharacterTemplateToUse = ThisCharacterTemplate;
+
+	FPGNCharacter NewCharacter;
+	InitializeThisIndividualCharacter(ThisCharacterTemplateToUse, NewCharacter);
+
+	const int IndexOfNewCharacter = AllCharacters.Add(NewCharacter);
+	GetMutableRelationshipOracle().SetNumberOfCharacters(AllCharacters.Num());
+
+	// New arrivals are connected to the people already in town in the same way the town was first built, so only the
+	// new character's own edges are rolled.
+	if (CharacterGraph != nullptr)
+	{
+		CharacterGraph->AddVertex(IndexOfNewCharacter);
+		SocialCommunityIndex.OnCharacterAdded(IndexOfNewCharacter);
+
+		TArray<int> AllIndicesOfCharactersInTown;
+		AllIndicesOfCharactersInTown.Reserve(AllCharacters.Num());
+
+		for (int Index_Character = 0; Index_Character < AllCharacters.Num(); Index_Character++)
+		{
+			if (Index_Character != IndexOfNewCharacter && AllCharacters[Index_Character].bIsInTown)
+			{
+				AllIndicesOfCharactersInTown.Add(Index_Character);
+			}
+		}
+
+		TArray<int> AllIndicesOfNewEdges;
+		CharacterGraph->TryCreateErdosRenyiEdgesForThisVertex(IndexOfNewCharacter, AllIndicesOfCharactersInTown,
+			ThresholdForSocialEdgeCreation, CharacterDataAsset->MaximumDistanceBetweenCharactersInSingleEdge,
+			AllIndicesOfNewEdges);
+
+		for (const int IndexOfNewEdge : AllIndicesOfNewEdges)
+		{
+			AddSocialDataForThisEdge(CharacterGraph->AllEdges[IndexOfNewEdge]);
+		}
+	}
+
+	if (DetermineRelationshipFromRandomPercentage(FMath::FRandRange(0.f, 1.f)) == EPGNCharacterRomanticRelationship::MARRIED)
+	{
+		FindNewSpouseForThisCharacter(IndexOfNewCharacter);
+	}
+	else
+	{
+		AllCharacters[IndexOfNewCharacter].MyRomanticData.RomanticRelationship = EPGNCharacterRomanticRelationship::SINGLE;
+	}
+
+	CharacterTimeline.IntroduceCharacter(IndexOfNewCharacter,
+		FPGNCharacterTimeline::GetInitialFlagsOfCharacter(AllCharacters[IndexOfNewCharacter]));
+
+	MarkCharacterAsChangedSinceLastSave(IndexOfNewCharacter);
+	OnCharactersChanged();
+
+	return IndexOfNewCharacter;
+}
+
+void APGNOverseer::RemoveCharacterFromTown(int IndexOfCharacter, bool bDidCharacterDie)
+{
+	if (!IsCharacterInTown(IndexOfCharacter))
+	{
+		return;
+	}
+
+	// A spouse who is left behind is widowed if the character died, and divorced if they simply left.
+	EndMarriageOfThisCharacter(IndexOfCharacter, bDidCharacterDie ? EPGNCharacterRomanticRelationship::WIDOWED
+		: EPGNCharacterRomanticRelationship::DIVORCED);
+
+	if (CharacterGraph != nullptr)
+	{
+		TArray<int> AllFormerNeighbours;
+		CharacterGraph->RemoveVertex(IndexOfCharacter, AllFormerNeighbours);
+
+		for (const int IndexOfFormerNeighbour : AllFormerNeighbours)
+		{
+			RemoveSocialDataBetweenTheseCharacters(IndexOfCharacter, IndexOfFormerNeighbour);
+		}
+	}
+
+	AllCharactersWaitingForMarriagePartners.Remove(static_cast<uint16>(IndexOfCharacter));
+
+	AllCharacters[IndexOfCharacter].bIsInTown = false;
+
+	CharacterTimeline.SetFlags(IndexOfCharacter, EPGNCharacterStateFlags::IN_TOWN, false);
+
+	if (bDidCharacterDie)
+	{
+		CharacterTimeline.SetFlags(IndexOfCharacter, EPGNCharacterStateFlags::ALIVE, false);
+	}
+
+	MarkCharacterAsChangedSinceLastSave(IndexOfCharacter);
+	OnCharactersChanged();
+}
+
+void APGNOverseer::EndMarriageOfThisCharacter(int IndexOfCharacter,
+	EPGNCharacterRomanticRelationship RelationshipForSpouse)
+{
+	FPGNCharacterRomanticData& ThisRomanticData = AllCharacters[IndexOfCharacter].MyRomanticData;
+
+	if (ThisRomanticData.RomanticRelationship != EPGNCharacterRomanticRelationship::MARRIED)
+	{
+		return;
+	}
+
+	const int IndexOfSpouse = ThisRomanticData.IndexOfRomanticPartner;
+
+	if (AllCharacters.IsValidIndex(IndexOfSpouse))
+	{
+		GetMutableRelationshipOracle().SetAreSpouses(IndexOfCharacter, IndexOfSpouse, false);
+
+		FPGNCharacter& Spouse = AllCharacters[IndexOfSpouse];
+		Spouse.MyRomanticData.RomanticRelationship = RelationshipForSpouse;
+		Spouse.MyRomanticData.IndexOfRomanticPartner = INDEX_NONE;
+		Spouse.MyRomanticData.NameOfRomanticPartner = TEXT("INVALID");
+		Spouse.bFoundValidMarriagePartner = false;
+
+		CharacterTimeline.SetFlags(IndexOfSpouse, EPGNCharacterStateFlags::MARRIED, false);
+		MarkCharacterAsChangedSinceLastSave(IndexOfSpouse);
+	}
+
+	CharacterTimeline.SetFlags(IndexOfCharacter, EPGNCharacterStateFlags::MARRIED, false);
+
+	ThisRomanticData.RomanticRelationship = EPGNCharacterRomanticRelationship::DIVORCED;
+	ThisRomanticData.IndexOfRomanticPartner = INDEX_NONE;
+	ThisRomanticData.NameOfRomanticPartner = TEXT("INVALID");
+	AllCharacters[IndexOfCharacter].bFoundValidMarriagePartner = false;
+
+	MarkCharacterAsChangedSinceLastSave(IndexOfCharacter);
+}
+
+void APGNOverseer::DivorceThisCharacter(int IndexOfCharacter, int IndexOfFormerSpouse)
+{
+	if (!IsCharacterInTown(IndexOfCharacter))
+	{
+		return;
+	}
+
+	if (IndexOfFormerSpouse == INDEX_NONE)
+	{
+		IndexOfFormerSpouse = AllCharacters[IndexOfCharacter].MyRomanticData.IndexOfRomanticPartner;
+	}
+
+	EndMarriageOfThisCharacter(IndexOfCharacter, EPGNCharacterRomanticRelationship::DIVORCED);
+
+	// The narrative may have been cast before either of them married someone else, so the former spouse's own
+	// marriage is ended too rather than assumed to be the one above.
+	if (IsCharacterInTown(IndexOfFormerSpouse) && IndexOfFormerSpouse != IndexOfCharacter)
+	{
+		EndMarriageOfThisCharacter(IndexOfFormerSpouse, EPGNCharacterRomanticRelationship::DIVORCED);
+
+		// Going through the graph marks both of them as dirty, and lets the community index split them up.
+		if (CharacterGraph != nullptr && CharacterGraph->RemoveEdge(IndexOfCharacter, IndexOfFormerSpouse))
+		{
+			RemoveSocialDataBetweenTheseCharacters(IndexOfCharacter, IndexOfFormerSpouse);
+		}
+
+		MarkRelationshipAsChangedSinceLastSave(IndexOfCharacter, IndexOfFormerSpouse);
+	}
+
+	OnCharactersChanged();
+}
+
+bool APGNOverseer::FindNewSpouseForThisCharacter(int IndexOfCharacter)
+{
+	if (!IsCharacterInTown(IndexOfCharacter))
+	{
+		return false;
+	}
+
+	FPGNCharacter& ThisCharacter = AllCharacters[IndexOfCharacter];
+
+	if (ThisCharacter.bFoundValidMarriagePartner)
+	{
+		return true;
+	}
+
+	// Everyone on the waiting list who has already been paired up, or has left, can be dropped from it now.
+	AllCharactersWaitingForMarriagePartners.RemoveAll([this](uint16 IndexOfWaitingCharacter)
+	{
+		const FPGNCharacter& ThisWaitingCharacter = AllCharacters[IndexOfWaitingCharacter];
+		return ThisWaitingCharacter.bFoundValidMarriagePartner || !ThisWaitingCharacter.bIsInTown;
+	});
+
+	ThisCharacter.MyRomanticData.RomanticRelationship = EPGNCharacterRomanticRelationship::MARRIED;
+	MarkCharacterAsChangedSinceLastSave(IndexOfCharacter);
+
+	if (FindPotentialRomanticSpouseForThisCharacter(IndexOfCharacter))
+	{
+		AllCharactersWaitingForMarriagePartners.Remove(static_cast<uint16>(
+			ThisCharacter.MyRomanticData.IndexOfRomanticPartner));
+
+		CharacterTimeline.SetFlags(IndexOfCharacter, EPGNCharacterStateFlags::MARRIED, true);
+		CharacterTimeline.SetFlags(ThisCharacter.MyRomanticData.IndexOfRomanticPartner, EPGNCharacterStateFlags::MARRIED, true);
+		MarkCharacterAsChangedSinceLastSave(ThisCharacter.MyRomanticData.IndexOfRomanticPartner);
+		OnCharactersChanged();
+		return true;
+	}
+
+	// Just like when the town is first built, a character that nobody suits is single instead.
+	ThisCharacter.MyRomanticData.RomanticRelationship = EPGNCharacterRomanticRelationship::SINGLE;
+	OnCharactersChanged();
+	return false;
+}
+
+bool APGNOverseer::AddSocialRelationship(int IndexOfCharacterA, int IndexOfCharacterB, int DistanceBetweenCharacters)
+{
+	if (CharacterGraph == nullptr || !IsCharacterInTown(IndexOfCharacterA) || !IsCharacterInTown(IndexOfCharacterB)
+		|| !CharacterGraph->AddEdge(IndexOfCharacterA, IndexOfCharacterB, DistanceBetweenCharacters))
+	{
+		return false;
+	}
+
+	AddSocialDataForThisEdge(*CharacterGraph->FindEdge(IndexOfCharacterA, IndexOfCharacterB));
+	OnCharactersChanged();
+
+	return true;
+}
+
+bool APGNOverseer::RemoveSocialRelationship(int IndexOfCharacterA, int IndexOfCharacterB)
+{
+	if (CharacterGraph == nullptr || !CharacterGraph->RemoveEdge(IndexOfCharacterA, IndexOfCharacterB))
+	{
+		return false;
+	}
+
+	RemoveSocialDataBetweenTheseCharacters(IndexOfCharacterA, IndexOfCharacterB);
+	OnCharactersChanged();
+
+	return true;
+}
+
+bool APGNOverseer::SetSocialRelationshipDistance(int IndexOfCharacterA, int IndexOfCharacterB,
+	int NewDistanceBetweenCharacters)
+{
+	if (CharacterGraph == nullptr
+		|| !CharacterGraph->SetEdgeDistance(IndexOfCharacterA, IndexOfCharacterB, NewDistanceBetweenCharacters))
+	{
+		return false;
+	}
+
+	// The relationship comes from the distance, so both characters' view of it is worked out again.
+	RemoveSocialDataBetweenTheseCharacters(IndexOfCharacterA, IndexOfCharacterB);
+	AddSocialDataForThisEdge(*CharacterGraph->FindEdge(IndexOfCharacterA, IndexOfCharacterB));
+	OnCharactersChanged();
+
+	return true;
+}
+
+void APGNOverseer::ApplyOutcomeOfThisEventAction(EPGNEventAction Action, int IndexOfSubject, int IndexOfObject)
+{
+	switch (Action)
+	{
+	case EPGNEventAction::KILLED_IN_HIT_AND_RUN:
+		RemoveCharacterFromTown(IndexOfSubject, true);
+		break;
+	case EPGNEventAction::DEPARTS_THE_TOWN:
+		RemoveCharacterFromTown(IndexOfSubject, false);
+		break;
+	case EPGNEventAction::DIVORCES_AND_ENDS_MARRIAGE_WITH:
+		DivorceThisCharacter(IndexOfSubject, IndexOfObject);
+		break;
+	default:
+		break;
+	}
+}
+
+bool APGNOverseer::ApplyOutcomesOfThisNarrative(const FPGNGeneratedNarrative& ThisNarrative)
+{
+	if (!EventLibrary.IsValid())
+	{
+		return false;
+	}
+
+	const auto FindCharacterInRole = [&ThisNarrative](EPGNCharacterTag Tag)
+	{
+		const int32 IndexInCast = FPGNCastingSolver::GetIndexInCast(Tag);
+		return ThisNarrative.AllIndicesOfCharactersInUse.IsValidIndex(IndexInCast)
+			? ThisNarrative.AllIndicesOfCharactersInUse[IndexInCast] : INDEX_NONE;
+	};
+
+	const auto ApplyOutcomeOfThisEvent = [this, &FindCharacterInRole](FPGNEventId ThisEventId)
+	{
+		if (!EventLibrary->IsValidEventId(ThisEventId))
+		{
+			return;
+		}
+
+		const FPGNPackedEvent& ThisEvent = EventLibrary->GetEvent(ThisEventId);
+		const int IndexOfSubject = FindCharacterInRole(ThisEvent.GetSubject());
+		const int IndexOfObject = ThisEvent.bDoesEventHaveObject ? FindCharacterInRole(ThisEvent.GetObject()) : INDEX_NONE;
+
+		if (IndexOfSubject != INDEX_NONE)
+		{
+			ApplyOutcomeOfThisEventAction(ThisEvent.GetAction(), IndexOfSubject, IndexOfObject);
+		}
+	};
+
+	bIsApplyingOutcomesOfNarrative = true;
+	bHaveCharactersChangedWhileApplyingOutcomes = false;
+
+	for (const int ThisEventId : ThisNarrative.AllEventIds)
+	{
+		ApplyOutcomeOfThisEvent(ThisEventId);
+	}
+
+	ApplyOutcomeOfThisEvent(ThisNarrative.ConclusionEventId);
+
+	bIsApplyingOutcomesOfNarrative = false;
+
+	return bHaveCharactersChangedWhileApplyingOutcomes;
+}
+
+void APGNOverseer::OnCharactersChanged()
+{
+	if (bIsApplyingOutcomesOfNarrative)
+	{
+		bHaveCharactersChangedWhileApplyingOutcomes = true;
+		return;
+	}
+
+	// Every cached score includes how well the cast suits their events, which depends on their relationships.
+	if (NarrativeEvaluator.IsValid())
+	{
+		NarrativeEvaluator->EmptyCaches();
+	}
+
+	if (!bIsCommittingPrefetchedNarrative)
+	{
+		InvalidatePrefetchedNarratives();
+	}
+
+	// Readers should see who has arrived, left or died straight away, not only with the next narrative.
+	bIsPublishedWorldStateStale = true;
+	PublishNarrativeState();
+}
+
+#pragma endregion Population Changes
+
+bool APGNOverseer::GenerateNewNarrative(const FPGNNarrativeRequestConstraints* Constraints)
+{
+	PGN_LLM_SCOPE(Generation);
+
+	// We will check this before archiving anything, so that a request nothing can meet leaves the narrative as it is.
+	if (Constraints != nullptr && !Algo::AnyOf(GetAllConclusionEvents(),
+		[Constraints](const FPGNConclusionEvent& ThisConclusionEvent)
+		{
+			return Constraints->AllowsThisConclusionEvent(ThisConclusionEvent);
+		}))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("None of the conclusion events meet the constraints of this narrative request."));
+		return false;
+	}
+
+	UE_LOG(LogTemp, Error, TEXT("_____________________________________________________"));
+
+	ArchiveCurrentNarrative();
+
+	// Every transient container created while generating this narrative is released here in one go.
+	FPGNGenerationScratchScope ScratchScope;
+
+	FPGNGeneratedNarrative NewNarrative;
+	CastOfNarrativeBeingGenerated.Reset();
+
+#pragma region GenerateNarrative
+
+	// With cores to spare, we will build a candidate for each of the best conclusions and keep the best of them.
+	if (!NarrativeEvaluator.IsValid() || !BuildBestOfCandidateNarratives(NewNarrative, Constraints))
+	{
+		// The current narrative has been archived, but it stays current, so nothing refers to a missing conclusion.
+		UE_LOG(LogTemp, Warning, TEXT("No narrative could be built, since none of the candidates could be fully cast."));
+		return false;
+	}
+
+	// Assign this value so we can use it for recency checks later down the line.
+	CurrentConclusionEvent.AllNarrativesThisConclusionEventIsIn.Add(NarrativeHistory.Num());
+
+	UPGNUtilities::DEBUG_PrintOutThisConclusionEvent(CurrentConclusionEvent);
+
+#pragma endregion GenerateNarrative
+
+	TArray<FPGNEventId> AllEventIdsInOrder = NewNarrative.AllEventIds;
+	AllEventIdsInOrder.Add(NewNarrative.ConclusionEventId);
+
+	TArray<FPGNCastingCandidate> Cast;
+	GatherCastOfThisNarrative(NewNarrative, Cast);
+
+	FPGNNarrativeFitness Fitness;
+
+	if (NarrativeEvaluator->Evaluate(AllEventIdsInOrder, Cast, Fitness))
+	{
+		UE_LOG(LogTemp, Log, TEXT("Narrative fitness: %.3f (coherence %.3f, mood flow %.3f, tension %.3f, cast fit %.3f)"),
+			Fitness.Total, Fitness.Coherence, Fitness.MoodFlow, Fitness.DramaticTension, Fitness.CastFit);
+	}
+
+	CommitNewNarrative(NewNarrative, false);
+
+	UE_LOG(LogTemp, Error, TEXT("_____________________________________________________"));
+
+	return true;
+}
+
+bool APGNOverseer::BuildBestOfCandidateNarratives(FPGNGeneratedNarrative& Out_Narrative,
+	const FPGNNarrativeRequestConstraints* Constraints)
+{
+	PGN_LLM_SCOPE(Generation);
+
+	TArray<int> AllConclusionEventIds;
+	UPGNUtilities::FindBestConclusionEvents(AllConclusionEventIds, NumberOfCandidateNarratives, this, Constraints);
+
+	TArray<FPGNCastingCandidate> AllCastingCandidates;
+	GatherCastingCandidates(AllCastingCandidates);
+
+	const double StartTime = FPlatformTime::Seconds();
+	const double Deadline = StartTime + CandidateNarrativeDeadlineInMilliseconds / 1000.0;
+
+	// Relationships are only looked up while the candidates are built, which is safe from any thread.
+	const int32 IndexOfBestCandidate = FPGNCandidateNarrativeBuilder::BuildCandidates(AllConclusionEventIds,
+		GetAllConclusionEvents(), NumberOfEventsBeforeConclusion, NarrativeRandomStream.RandHelper(MAX_int32), AllCastingCandidates,
+		CastOfNarrativeBeingGenerated, [this](int32 IndexOfCharacterA, int32 IndexOfCharacterB, FPGNRelationship& Out_Relationship)
+		{
+			return FindRelationshipBetweenCharacters(IndexOfCharacterA, IndexOfCharacterB, Out_Relationship);
+		}, *NarrativeEvaluator, Deadline, AllCandidatesOfLastNarrative);
+
+	for (int Index_Candidate = 0; Index_Candidate < AllCandidatesOfLastNarrative.Num(); Index_Candidate++)
+	{
+		const FPGNCandidateNarrative& ThisCandidate = AllCandidatesOfLastNarrative[Index_Candidate];
+
+		UE_LOG(LogTemp, Log, TEXT("Candidate %d (conclusion %d): %s, %d events, fitness %.3f, built in %.3f ms, scored in %.3f ms"),
+			Index_Candidate, AllConclusionEventIds[Index_Candidate], ThisCandidate.bIsComplete ? TEXT("complete") : TEXT("skipped"),
+			ThisCandidate.Narrative.AllEventIds.Num(), ThisCandidate.Fitness.Total, ThisCandidate.BuildingTimeInSeconds * 1000.0, ThisCandidate.ScoringTimeInSeconds * 1000.0);
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Built %d candidate narratives in %.3f ms and kept candidate %d."),
+		AllCandidatesOfLastNarrative.Num(), (FPlatformTime::Seconds() - StartTime) * 1000.0, IndexOfBestCandidate);
+
+	if (IndexOfBestCandidate == INDEX_NONE)
+	{
+		return false;
+	}
+
+	FPGNCandidateNarrative& BestCandidate = AllCandidatesOfLastNarrative[IndexOfBestCandidate];
+	Out_Narrative = BestCandidate.Narrative;
+	CastOfNarrativeBeingGenerated = BestCandidate.Cast;
+
+	CurrentConclusionEvent = GetAllConclusionEvents()[Out_Narrative.ConclusionEventId];
+	CurrentConclusionEvent.AllNarrativesThisConclusionEventIsIn = AllConclusionEventUsage[Out_Narrative.ConclusionEventId];
+
+	return true;
+}
+
+void APGNOverseer::ArchiveCurrentNarrative()
+{
+	PGN_LLM_SCOPE(History);
+
+	if (CurrentNarrative.bIsNarrativeInitialized && !bIsCurrentNarrativeArchived)
+	{
+		NarrativeHistory.Append(CurrentNarrative);
+		bIsCurrentNarrativeArchived = true;
+	}
+}
+
+void APGNOverseer::CommitNewNarrative(FPGNGeneratedNarrative& NewNarrative, bool bWasPrefetched)
+{
+	PGN_LLM_SCOPE(History);
+
+	// Record the usage of the conclusion event so that we can use it for recency checks.
+	if (AllConclusionEventUsage.IsValidIndex(NewNarrative.ConclusionEventId))
+	{
+		AllConclusionEventUsage[NewNarrative.ConclusionEventId].Add(NarrativeHistory.Num());
+	}
+
+	// The cast will be looked up again and again while the narrative plays out, so we keep them in memory.
+	if (bUseVirtualPopulation)
+	{
+		VirtualPopulation.MaterializeCastAndTheirSocialPartners(NewNarrative.AllIndicesOfCharactersInUse);
+	}
+
+	// The index it will have once it is archived, like the usage above.
+	if (EventLibrary.IsValid())
+	{
+		CharacterTimeline.RecordNarrative(NarrativeHistory.Num(), NewNarrative, *EventLibrary);
+	}
+
+	NewNarrative.bIsNarrativeInitialized = true;
+	
+	CurrentNarrative = NewNarrative;
+	bHasMoodOfRemovedConclusionEvent = false;
+	bIsCurrentNarrativeArchived = false;
+
+	// Whoever died, left or divorced is gone from the town once the narrative is committed. Every cached score that
+	// counted on them is thrown away, and the narrative is published along with the change.
+	if (ApplyOutcomesOfThisNarrative(CurrentNarrative))
+	{
+		TGuardValue<bool> CommittingPrefetchedNarrativeGuard(bIsCommittingPrefetchedNarrative, bWasPrefetched);
+		OnCharactersChanged();
+	}
+	else
+	{
+		PublishNarrativeState();
+
+		// Anything else the producer built follows on from a narrative that was never delivered.
+		if (!bWasPrefetched)
+		{
+			InvalidatePrefetchedNarratives();
+		}
+	}
+
+	// Whatever happened to the cast was recorded in their flags above.
+	bHasCurrentNarrativeChangedSinceLastSave = true;
+
+	for (const int IndexOfCharacter : CurrentNarrative.AllIndicesOfCharactersInUse)
+	{
+		MarkCharacterAsChangedSinceLastSave(IndexOfCharacter);
+	}
+
+	SaveOverseerState();
+
+	EnforceMemoryBudgets();
+}
+
+bool APGNOverseer::TryConsumePrefetchedNarrative()
+{
+	if (!NarrativePrefetcher.IsValid())
+	{
+		return false;
+	}
+
+	FPGNGeneratedNarrative NewNarrative;
+	TArray<FPGNCastMember> CastOfNewNarrative;
+	if (!NarrativePrefetcher->TryDequeueNarrative(NewNarrative, CastOfNewNarrative)
+		|| !GetAllConclusionEvents().IsValidIndex(NewNarrative.ConclusionEventId))
+	{
+		return false;
+	}
+
+	// The producer already advanced its own copy of the world past this narrative, so committing it here keeps us
+	// in step with everything else it has queued.
+	ArchiveCurrentNarrative();
+
+	CastOfNarrativeBeingGenerated = MoveTemp(CastOfNewNarrative);
+
+	// This is what GenerateNewNarrative would have left, so that the narrative is published with its own conclusion.
+	CurrentConclusionEvent = GetAllConclusionEvents()[NewNarrative.ConclusionEventId];
+	CurrentConclusionEvent.AllNarrativesThisConclusionEventIsIn = AllConclusionEventUsage[NewNarrative.ConclusionEventId];
+	CurrentConclusionEvent.AllNarrativesThisConclusionEventIsIn.Add(NarrativeHistory.Num());
+	UPGNUtilities::DEBUG_PrintOutThisConclusionEvent(CurrentConclusionEvent);
+
+	CommitNewNarrative(NewNarrative, true);
+	
+	return true;
+}
+
+#pragma region Published State
+
+void APGNOverseer::PublishNarrativeState()
+{
+	const TSharedRef<FPGNNarrativeStateSnapshot, ESPMode::ThreadSafe> NewSnapshot =
+		MakeShared<FPGNNarrativeStateSnapshot, ESPMode::ThreadSafe>();
+
+	NewSnapshot->Narrative = CurrentNarrative;
+	NewSnapshot->ConclusionEvent = CurrentConclusionEvent;
+	NewSnapshot->EventLibrary = EventLibrary;
+	NewSnapshot->NumberOfArchivedNarratives = NarrativeHistory.Num();
+
+	NewSnapshot->AllCharactersInCast.SetNum(CurrentNarrative.AllIndicesOfCharactersInUse.Num());
+
+	for (int Index_Role = 0; Index_Role < CurrentNarrative.AllIndicesOfCharactersInUse.Num(); Index_Role++)
+	{
+		if (const FPGNCharacter* ThisCharacter = GetCharacter(CurrentNarrative.AllIndicesOfCharactersInUse[Index_Role]))
+		{
+			NewSnapshot->AllCharactersInCast[Index_Role] = *ThisCharacter;
+		}
+	}
+
+	if (bIsPublishedWorldStateStale)
+	{
+		PublishedWorldState = CreateWorldState();
+		bIsPublishedWorldStateStale = false;
+	}
+
+	// Only the cast can have changed attitude since the last snapshot, so only their chunks are copied.
+	for (const FPGNCastMember& ThisCastMember : CastOfNarrativeBeingGenerated)
+	{
+		const int32 IndexOfCharacter = ThisCastMember.Character.IndexOfCharacter;
+
+		if (PublishedWorldState.IsValidIndex(IndexOfCharacter))
+		{
+			FPGNCharacterState ThisState = PublishedWorldState.GetCharacterState(IndexOfCharacter);
+			ThisState.CurrentAttitude = ThisCastMember.CurrentAttitude;
+			PublishedWorldState.SetCharacterState(IndexOfCharacter, ThisState);
+		}
+	}
+
+	NewSnapshot->WorldState = PublishedWorldState;
+
+	NarrativeStatePublisher.Publish(NewSnapshot);
+}
+
+bool APGNOverseer::GetPublishedNarrative(FPGNGeneratedNarrative& Out_Narrative,
+	TArray<FPGNCharacter>& Out_AllCharactersInCast) const
+{
+	const FPGNNarrativeStateSnapshotPtr Snapshot = GetNarrativeStateSnapshot();
+
+	if (!Snapshot.IsValid())
+	{
+		return false;
+	}
+
+	Out_Narrative = Snapshot->Narrative;
+	Out_AllCharactersInCast = Snapshot->AllCharactersInCast;
+
+	return true;
+}
+
+FString APGNOverseer::GetPublishedNarrativeText() const
+{
+	const FPGNNarrativeStateSnapshotPtr Snapshot = GetNarrativeStateSnapshot();
+	return Snapshot.IsValid() ? FPGNNarrativeTextRealiser::Get().RealiseNarrative(*Snapshot) : FString();
+}
+
+#pragma endregion Published State
+
+#pragma region Saving
+
+bool APGNOverseer::LoadOverseerState()
+{
+	PGN_LLM_SCOPE(Characters);
+
+	if (!bSaveOverseerState || SaveFilename.IsEmpty())
+	{
+		return false;
+	}
+
+	if (bUseVirtualPopulation)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("A virtual population is generated from its seed, so the overseer state is not saved."));
+		return false;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	SaveJournal.SetFilename(FPaths::IsRelative(SaveFilename) ? FPaths::Combine(FPaths::ProjectSavedDir(), SaveFilename)
+		: SaveFilename);
+
+	TArray<uint8> CheckpointPayload;
+	TArray<TArray<uint8>> AllDeltaPayloads;
+
+	if (!SaveJournal.Load(CheckpointPayload, AllDeltaPayloads))
+	{
+		return false;
+	}
+
+	FPGNOverseerSaveState SavedState;
+
+	if (!SavedState.ApplyPayload(CheckpointPayload) || SavedState.AllCharacters.Num() == 0)
+	{
+		UE_LOG(LogTemp, Error, TEXT("Could not read the saved overseer state, so a new town will be built."));
+		return false;
+	}
+
+	int32 NumberOfDeltasApplied = 0;
+
+	for (const TArray<uint8>& ThisDeltaPayload : AllDeltaPayloads)
+	{
+		if (!SavedState.ApplyPayload(ThisDeltaPayload))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Could not read delta %d of the saved overseer state, so it and every delta after it are dropped."),
+				NumberOfDeltasApplied);
+			break;
+		}
+
+		NumberOfDeltasApplied++;
+	}
+
+	if (!bPersistNarrativeHistory)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("The narrative history is not persisted, so the loaded town starts with no history."));
+	}
+
+	AllCharacters = MoveTemp(SavedState.AllCharacters);
+	AllCharactersWaitingForMarriagePartners = MoveTemp(SavedState.AllCharactersWaitingForMarriagePartners);
+	ThresholdForSocialEdgeCreation = SavedState.ThresholdForSocialEdgeCreation;
+
+	// Everything else about the town is built from the spouses and the relationships, just as it was the first time.
+	GetMutableRelationshipOracle().Reset(AllCharacters.Num());
+
+	for (int Index_Character = 0; Index_Character < AllCharacters.Num(); Index_Character++)
+	{
+		FPGNCharacterRomanticData& ThisRomanticData = AllCharacters[Index_Character].MyRomanticData;
+		const int IndexOfSpouse = ThisRomanticData.IndexOfRomanticPartner;
+
+		if (!AllCharacters.IsValidIndex(IndexOfSpouse))
+		{
+			ThisRomanticData.IndexOfRomanticPartner = INDEX_NONE;
+			continue;
+		}
+
+		ThisRomanticData.NameOfRomanticPartner = AllCharacters[IndexOfSpouse].Name;
+
+		if (Index_Character < IndexOfSpouse)
+		{
+			GetMutableRelationshipOracle().SetAreSpouses(Index_Character, IndexOfSpouse, true);
+		}
+	}
+
+	CharacterGraph = NewObject<UCharacterGraph>(this);
+
+	for (int Index_Character = 0; Index_Character < AllCharacters.Num(); Index_Character++)
+	{
+		if (AllCharacters[Index_Character].bIsInTown)
+		{
+			CharacterGraph->AddVertex(Index_Character);
+		}
+	}
+
+	// In order, so that the same save always gives the same graph.
+	TArray<uint64> AllRelationships;
+	SavedState.DistanceOfRelationship.GenerateKeyArray(AllRelationships);
+	AllRelationships.Sort();
+
+	for (const uint64 ThisRelationship : AllRelationships)
+	{
+		int32 IndexOfCharacterA = INDEX_NONE;
+		int32 IndexOfCharacterB = INDEX_NONE;
+		FPGNOverseerSaveState::GetCharactersOfRelationship(ThisRelationship, IndexOfCharacterA, IndexOfCharacterB);
+
+		CharacterGraph->AddEdge(IndexOfCharacterA, IndexOfCharacterB, SavedState.DistanceOfRelationship[ThisRelationship]);
+	}
+
+	SocialDistanceService.Initialize(CharacterGraph, NumberOfSocialDistanceSourcesToCache);
+	SocialCommunityIndex.Initialize(CharacterGraph);
+
+	for (const FCharacterGraphEdge& ThisEdge : CharacterGraph->AllEdges)
+	{
+		AddSocialDataForThisEdge(ThisEdge);
+	}
+
+	TArray<int> AllDirtyVertices;
+	CharacterGraph->ConsumeDirtyVertices(AllDirtyVertices);
+
+	// The flags carry over, but the timeline of each character starts again from here.
+	CharacterTimeline.Reset();
+
+	for (int Index_Character = 0; Index_Character < AllCharacters.Num(); Index_Character++)
+	{
+		const EPGNCharacterStateFlags SavedFlags = SavedState.AllStateFlags[Index_Character];
+
+		CharacterTimeline.IntroduceCharacter(Index_Character, EnumHasAnyFlags(SavedFlags, EPGNCharacterStateFlags::KNOWN)
+			? SavedFlags : FPGNCharacterTimeline::GetInitialFlagsOfCharacter(AllCharacters[Index_Character]));
+	}
+
+	// The events may have been edited since the save was written, in which case the current narrative carries on
+	// without any that were removed, like it does after a hot reload.
+	CurrentNarrative = SavedState.CurrentNarrative;
+
+	if (EventLibrary.IsValid())
+	{
+		CurrentNarrative.AllEventIds.RemoveAll([this](int ThisEventId)
+		{
+			return !EventLibrary->IsValidEventId(ThisEventId);
+		});
+	}
+
+	if (CurrentNarrative.bIsNarrativeInitialized && GetAllConclusionEvents().IsValidIndex(CurrentNarrative.ConclusionEventId))
+	{
+		CurrentConclusionEvent = GetAllConclusionEvents()[CurrentNarrative.ConclusionEventId];
+		CurrentConclusionEvent.AllNarrativesThisConclusionEventIsIn = AllConclusionEventUsage[CurrentNarrative.ConclusionEventId];
+	}
+	else
+	{
+		CurrentNarrative = FPGNGeneratedNarrative();
+	}
+
+	// The current narrative is archived when the game ends, after it was saved.
+	bIsCurrentNarrativeArchived = CurrentNarrative.bIsNarrativeInitialized
+		&& NarrativeHistory.Num() > SavedState.NarrativeIndexOfCurrentNarrative;
+
+	ClearChangesSinceLastSave();
+
+	bIsPublishedWorldStateStale = true;
+	PublishNarrativeState();
+
+	// The deltas that could not be read would stop every later load in the same place, so we will start over.
+	if (NumberOfDeltasApplied < AllDeltaPayloads.Num())
+	{
+		WriteSave(true);
+	}
+
+	UE_LOG(LogTemp, Log, TEXT("Loaded %d characters and %d relationships from a checkpoint and %d deltas in %.2f ms."),
+		AllCharacters.Num(), CharacterGraph->AllEdges.Num(), NumberOfDeltasApplied,
+		(FPlatformTime::Seconds() - StartTime) * 1000.0);
+
+	return true;
+}
+
+bool APGNOverseer::SaveOverseerState()
+{
+	if (!bSaveOverseerState || bUseVirtualPopulation || !SaveJournal.HasFilename())
+	{
+		return false;
+	}
+
+	const bool bWriteCheckpoint = !SaveJournal.HasCheckpoint()
+		|| SaveJournal.GetNumberOfDeltasSinceCheckpoint() >= MaximumDeltasPerCheckpoint
+		|| SaveJournal.GetSizeOfDeltasSinceCheckpoint() >= MaximumKilobytesOfDeltasPerCheckpoint * 1024LL;
+
+	WriteSave(bWriteCheckpoint);
+
+	return true;
+}
+
+void APGNOverseer::WriteSave(bool bWriteCheckpoint)
+{
+	PGN_LLM_SCOPE(Save);
+
+	if (!bSaveOverseerState || bUseVirtualPopulation || !SaveJournal.HasFilename())
+	{
+		return;
+	}
+
+	if (!bWriteCheckpoint && AllCharactersChangedSinceLastSave.Num() == 0 && AllRelationshipsChangedSinceLastSave.Num() == 0
+		&& !bHasCurrentNarrativeChangedSinceLastSave)
+	{
+		return;
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	TArray<uint8> Payload;
+	FPGNOverseerSaveState::WriteNumberOfCharacters(Payload, AllCharacters.Num());
+
+	if (bWriteCheckpoint)
+	{
+		FPGNOverseerSaveState::WriteThresholdForSocialEdgeCreation(Payload, ThresholdForSocialEdgeCreation);
+
+		for (int Index_Character = 0; Index_Character < AllCharacters.Num(); Index_Character++)
+		{
+			FPGNOverseerSaveState::WriteCharacter(Payload, Index_Character, AllCharacters[Index_Character],
+				CharacterTimeline.GetFlags(Index_Character));
+		}
+
+		if (CharacterGraph != nullptr)
+		{
+			for (const FCharacterGraphEdge& ThisEdge : CharacterGraph->AllEdges)
+			{
+				FPGNOverseerSaveState::WriteRelationship(Payload, ThisEdge.VertexA.IndexInAllCharactersArray,
+					ThisEdge.VertexB.IndexInAllCharactersArray, ThisEdge.DistanceBetweenVertices);
+			}
+		}
+	}
+	else
+	{
+		for (const int32 IndexOfCharacter : AllCharactersChangedSinceLastSave)
+		{
+			if (AllCharacters.IsValidIndex(IndexOfCharacter))
+			{
+				FPGNOverseerSaveState::WriteCharacter(Payload, IndexOfCharacter, AllCharacters[IndexOfCharacter],
+					CharacterTimeline.GetFlags(IndexOfCharacter));
+			}
+		}
+
+		// Whatever the relationship is now is what is saved, including that it is gone.
+		for (const uint64 ThisRelationship : AllRelationshipsChangedSinceLastSave)
+		{
+			int32 IndexOfCharacterA = INDEX_NONE;
+			int32 IndexOfCharacterB = INDEX_NONE;
+			FPGNOverseerSaveState::GetCharactersOfRelationship(ThisRelationship, IndexOfCharacterA, IndexOfCharacterB);
+
+			const FCharacterGraphEdge* ThisEdge = CharacterGraph != nullptr
+				? CharacterGraph->FindEdge(IndexOfCharacterA, IndexOfCharacterB) : nullptr;
+
+			FPGNOverseerSaveState::WriteRelationship(Payload, IndexOfCharacterA, IndexOfCharacterB,
+				ThisEdge != nullptr ? ThisEdge->DistanceBetweenVertices : INDEX_NONE);
+		}
+	}
+
+	// The waiting list only changes along with the characters on it, and is small enough to write in full.
+	if (bWriteCheckpoint || AllCharactersChangedSinceLastSave.Num() > 0)
+	{
+		FPGNOverseerSaveState::WriteWaitingList(Payload, AllCharactersWaitingForMarriagePartners);
+	}
+
+	if (bWriteCheckpoint || bHasCurrentNarrativeChangedSinceLastSave)
+	{
+		FPGNOverseerSaveState::WriteCurrentNarrative(Payload, CurrentNarrative,
+			bIsCurrentNarrativeArchived ? NarrativeHistory.Num() - 1 : NarrativeHistory.Num());
+	}
+
+	const int32 SizeOfPayload = Payload.Num();
+
+	// Only the writing happens off the game thread; the payload is already complete.
+	if (bWriteCheckpoint)
+	{
+		SaveJournal.WriteCheckpoint(MoveTemp(Payload));
+	}
+	else
+	{
+		SaveJournal.AppendDelta(MoveTemp(Payload));
+	}
+
+	ClearChangesSinceLastSave();
+
+	UE_LOG(LogTemp, Log, TEXT("Saved a %s of %d bytes in %.3f ms."), bWriteCheckpoint ? TEXT("checkpoint") : TEXT("delta"),
+		SizeOfPayload, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+}
+
+void APGNOverseer::MarkCharacterAsChangedSinceLastSave(int IndexOfCharacter)
+{
+	if (bSaveOverseerState && IndexOfCharacter >= 0)
+	{
+		AllCharactersChangedSinceLastSave.Add(IndexOfCharacter);
+	}
+}
+
+void APGNOverseer::MarkRelationshipAsChangedSinceLastSave(int IndexOfCharacterA, int IndexOfCharacterB)
+{
+	if (bSaveOverseerState)
+	{
+		AllRelationshipsChangedSinceLastSave.Add(FPGNOverseerSaveState::GetKeyOfRelationship(IndexOfCharacterA,
+			IndexOfCharacterB));
+	}
+}
+
+void APGNOverseer::ClearChangesSinceLastSave()
+{
+	AllCharactersChangedSinceLastSave.Reset();
+	AllRelationshipsChangedSinceLastSave.Reset();
+	bHasCurrentNarrativeChangedSinceLastSave = false;
+}
+
+#pragma endregion Saving
+
+#pragma region Memory
+
+void APGNOverseer::GatherMemoryUsage(FPGNMemoryUsage& Out_MemoryUsage) const
+{
+	Out_MemoryUsage = FPGNMemoryUsage();
+
+	Out_MemoryUsage.Characters = AllCharacters.GetAllocatedSize() + AllCharactersWaitingForMarriagePartners.GetAllocatedSize()
+		+ VirtualPopulation.GetAllocatedSize();
+
+	for (const FPGNCharacter& ThisCharacter : AllCharacters)
+	{
+		Out_MemoryUsage.Characters += FPGNMemoryTracking::GetAllocatedSizeOfCharacter(ThisCharacter);
+	}
+
+	Out_MemoryUsage.Graphs = RelationshipOracle->GetAllocatedSize() + SocialCommunityIndex.GetAllocatedSize();
+
+	if (CharacterGraph != nullptr)
+	{
+		Out_MemoryUsage.Graphs += CharacterGraph->GetAllocatedSize();
+	}
+
+	if (WorldData.IsValid())
+	{
+		Out_MemoryUsage.Events += WorldData->GetAllocatedSize();
+	}
+
+	if (EventLibrary.IsValid())
+	{
+		Out_MemoryUsage.Events += EventLibrary->GetAllocatedSize();
+	}
+
+	Out_MemoryUsage.History = NarrativeHistory.GetAllocatedSize() + CharacterTimeline.GetAllocatedSize()
+		+ FPGNMemoryTracking::GetAllocatedSizeOfNarrative(CurrentNarrative) + AllConclusionEventUsage.GetAllocatedSize();
+
+	for (const TArray<int>& AllNarrativesOfConclusionEvent : AllConclusionEventUsage)
+	{
+		Out_MemoryUsage.History += AllNarrativesOfConclusionEvent.GetAllocatedSize();
+	}
+
+	Out_MemoryUsage.Caches = SocialDistanceService.GetAllocatedSize();
+
+	if (NarrativeEvaluator.IsValid())
+	{
+		Out_MemoryUsage.Caches += NarrativeEvaluator->GetAllocatedSizeOfCaches();
+	}
+}
+
+void APGNOverseer::GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize)
+{
+	Super::GetResourceSizeEx(CumulativeResourceSize);
+
+	FPGNMemoryUsage MemoryUsage;
+	GatherMemoryUsage(MemoryUsage);
+
+	SIZE_T SizeOwnedByOverseer = MemoryUsage.GetTotal() - MemoryUsage.Events;
+
+	if (CharacterGraph != nullptr)
+	{
+		SizeOwnedByOverseer -= CharacterGraph->GetAllocatedSize();
+	}
+
+	CumulativeResourceSize.AddDedicatedSystemMemoryBytes(SizeOwnedByOverseer);
+}
+
+void APGNOverseer::EnforceMemoryBudgets()
+{
+	if (HistoryMemoryBudgetInKilobytes <= 0 && CacheMemoryBudgetInKilobytes <= 0)
+	{
+		return;
+	}
+
+	FPGNMemoryUsage MemoryUsage;
+	GatherMemoryUsage(MemoryUsage);
+
+	const SIZE_T HistoryMemoryBudget = static_cast<SIZE_T>(HistoryMemoryBudgetInKilobytes) * 1024;
+
+	if (HistoryMemoryBudgetInKilobytes > 0 && MemoryUsage.History > HistoryMemoryBudget)
+	{
+		// The timeline and the usage of every conclusion event are still needed for casting and recency, so only the
+		// archive gives anything back.
+		const SIZE_T SizeOfEverythingButTheArchive = MemoryUsage.History - NarrativeHistory.GetAllocatedSize();
+
+		NarrativeHistory.TrimToSize(HistoryMemoryBudget > SizeOfEverythingButTheArchive
+			? HistoryMemoryBudget - SizeOfEverythingButTheArchive : 0);
+	}
+
+	const SIZE_T CacheMemoryBudget = static_cast<SIZE_T>(CacheMemoryBudgetInKilobytes) * 1024;
+
+	if (CacheMemoryBudgetInKilobytes > 0 && MemoryUsage.Caches > CacheMemoryBudget)
+	{
+		UE_LOG(LogTemp, Log, TEXT("%s is using %.1f KB for caches, over its budget of %d KB. Emptying them."), *GetName(),
+			MemoryUsage.Caches / 1024.f, CacheMemoryBudgetInKilobytes);
+
+		if (NarrativeEvaluator.IsValid())
+		{
+			NarrativeEvaluator->EmptyCaches();
+		}
+
+		SocialDistanceService.EmptyCaches();
+	}
+}
+
+#pragma endregion Memory
+
+void APGNOverseer::InvalidatePrefetchedNarratives()
+{
+	if (!NarrativePrefetcher.IsValid())
+	{
+		return;
+	}
+
+	FPGNNarrativeGenerationSnapshot NewSnapshot;
+	CreateNarrativeGenerationSnapshot(NewSnapshot);
+	
+	NarrativePrefetcher->ResetWorldState(MoveTemp(NewSnapshot));
+}
+
+void APGNOverseer::CreateNarrativeGenerationSnapshot(FPGNNarrativeGenerationSnapshot& Out_Snapshot)
+{
+	Out_Snapshot.EventLibrary = EventLibrary;
+	
+	Out_Snapshot.AllConclusionEventUsage = AllConclusionEventUsage;
+	
+	Out_Snapshot.RandomSeed = NarrativeRandomStream.RandHelper(MAX_int32);
+
+	Out_Snapshot.MoodDistanceTable = GetMoodDistanceTable();
+
+	// Virtual characters are materialized on the game thread as they are needed, so the producer cannot look their
+	// relationships up. Without an oracle it will not build anything.
+	if (!bUseVirtualPopulation)
+	{
+		// Every narrative is cast from scratch, as it is in GenerateNewNarrative, so the cast of the current one is
+		// left out of gathering the candidates.
+		TArray<FPGNCastMember> CastOfCurrentNarrative = MoveTemp(CastOfNarrativeBeingGenerated);
+		CastOfNarrativeBeingGenerated.Reset();
+		GatherCastingCandidates(Out_Snapshot.AllCastingCandidates);
+		CastOfNarrativeBeingGenerated = MoveTemp(CastOfCurrentNarrative);
+
+		Out_Snapshot.RelationshipOracle = RelationshipOracle;
+	}
+
+	Out_Snapshot.WorldData = WorldData;
+
+	Out_Snapshot.NumberOfCandidateNarratives = NumberOfCandidateNarratives;
+	Out_Snapshot.NumberOfEventsBeforeConclusion = NumberOfEventsBeforeConclusion;
+	Out_Snapshot.DesiredFinalDramaticTension = EventDataAsset != nullptr ? EventDataAsset->DesiredFinalDramaticTension : 0.f;
+	Out_Snapshot.NumberOfEvaluationsToCache = NumberOfEvaluationsToCache;
+
+	// The current narrative will be archived before the next one is committed, so it counts as a previous narrative.
+	Out_Snapshot.NumberOfPreviouslyGeneratedNarratives = NarrativeHistory.Num();
+	
+	if (CurrentNarrative.bIsNarrativeInitialized && !bIsCurrentNarrativeArchived)
+	{
+		Out_Snapshot.NumberOfPreviouslyGeneratedNarratives++;
+		Out_Snapshot.bHasLastConclusionEvent = true;
+		Out_Snapshot.LastConclusionMood = GetMoodOfThisEvent(CurrentNarrative.ConclusionEventId);
+	}
+	else if (NarrativeHistory.Num() > 0)
+	{
+		Out_Snapshot.bHasLastConclusionEvent = true;
+		Out_Snapshot.LastConclusionMood = GetMoodOfLastConclusionEvent();
+	}
+}
+
+#pragma region Narrative Requests
+
+TFuture<FPGNNarrativeRequestResult> APGNOverseer::RequestNarrative(const FPGNNarrativeRequestConstraints& Constraints,
+	FPGNNarrativeRequestId* Out_RequestId)
+{
+	TFuture<FPGNNarrativeRequestResult> Future;
+	const FPGNNarrativeRequestId RequestId = NarrativeRequests.Add(Constraints, FPlatformTime::Seconds(), nullptr,
+		&Future);
+
+	if (Out_RequestId != nullptr)
+	{
+		*Out_RequestId = RequestId;
+	}
+
+	if (!NarrativeRequestTickerHandle.IsValid())
+	{
+		NarrativeRequestTickerHandle = FPGNCoreTicker::GetCoreTicker().AddTicker(
+			FTickerDelegate::CreateUObject(this, &APGNOverseer::ServeNarrativeRequests));
+	}
+
+	return Future;
+}
+
+FPGNNarrativeRequestId APGNOverseer::RequestNarrativeWithCallback(const FPGNNarrativeRequestConstraints& Constraints,
+	TFunction<void(const FPGNNarrativeRequestResult&)> OnCompleted)
+{
+	const FPGNNarrativeRequestId RequestId = NarrativeRequests.Add(Constraints, FPlatformTime::Seconds(),
+		MoveTemp(OnCompleted), nullptr);
+
+	if (!NarrativeRequestTickerHandle.IsValid())
+	{
+		NarrativeRequestTickerHandle = FPGNCoreTicker::GetCoreTicker().AddTicker(
+			FTickerDelegate::CreateUObject(this, &APGNOverseer::ServeNarrativeRequests));
+	}
+
+	return RequestId;
+}
+
+bool APGNOverseer::CancelNarrativeRequest(FPGNNarrativeRequestId RequestId)
+{
+	// The ticker removes itself the next time it finds nothing waiting.
+	return NarrativeRequests.Cancel(RequestId);
+}
+
+bool APGNOverseer::ServeNarrativeRequests(float DeltaTime)
+{
+	const double CurrentTime = FPlatformTime::Seconds();
+
+	// We will time out anything that has waited too long before choosing what to serve, so that it is not served late.
+	NarrativeRequests.ExpireRequests(CurrentTime);
+
+	TArray<FPGNPendingNarrativeRequest> AllRequestsSharingThisNarrative;
+
+	for (int Index_Narrative = 0; Index_Narrative < MaximumNarrativesPerFrame; Index_Narrative++)
+	{
+		FPGNNarrativeRequestConstraints Constraints;
+		if (!NarrativeRequests.TakeMostUrgentRequests(CurrentTime, Constraints, AllRequestsSharingThisNarrative))
+		{
+			break;
+		}
+
+		FPGNNarrativeRequestResult Result;
+
+		if (ProduceNarrativeForTheseConstraints(Constraints))
+		{
+			Result.Status = EPGNNarrativeRequestStatus::FULFILLED;
+			Result.Narrative = CurrentNarrative;
+		}
+
+		// Whoever made these may ask for more straight away, which only adds to the queue.
+		for (FPGNPendingNarrativeRequest& ThisRequest : AllRequestsSharingThisNarrative)
+		{
+			FPGNNarrativeRequestQueue::Complete(ThisRequest, Result);
+		}
+	}
+
+	if (NarrativeRequests.IsEmpty())
+	{
+		NarrativeRequestTickerHandle.Reset();
+		return false;
+	}
+
+	return true;
+}
+
+bool APGNOverseer::ProduceNarrativeForTheseConstraints(const FPGNNarrativeRequestConstraints& Constraints)
+{
+	if (!WorldData.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("A narrative was requested before the overseer was initialized."));
+		return false;
+	}
+
+	// The producer does not know about constraints, so only requests that allow any conclusion can take what it made.
+	if (Constraints.AllowsAnyConclusionEvent())
+	{
+		// If the producer has not caught up yet, we will just generate this one ourselves.
+		return TryConsumePrefetchedNarrative() || GenerateNewNarrative();
+	}
+
+	return GenerateNewNarrative(&Constraints);
+}
+
+#pragma endregion Narrative Requests
+
+bool APGNOverseer::HasCurrentNarrativeReachedConvergence()
+{
+	// ToDo: This needs to be implemented.
+	return true;
+}
+
+// We use the mood graph to ensure that we do not jump from one tone to another too quickly.
+float APGNOverseer::EvaluateScoreFromMoodGraphForThisConclusionEvent(const FPGNConclusionEvent& ThisConclusionEvent) const
+{
+	return UPGNUtilities::EvaluateScoreFromMoodGraphDistance(FindMoodGraphDistanceFromLastConclusionEvent(
+		ThisConclusionEvent));
+}
+
+int APGNOverseer::FindMoodGraphDistanceFromLastConclusionEvent(const FPGNConclusionEvent& ThisConclusionEvent) const
+{
+	/* All Moods to Use (12):
+	 *
+	 * VERTICES:
+	 * 1. Joyful
+	 * 2. Optimistic
+	 * 3. Playful
+	 * 4. Empathetic
 	 * 5. Sentimental
 	 * 6. Serene
 	 * 7. Inquisitive
@@ -472,25 +2179,28 @@ int APGNOverseer::EvaluateScoreFromMoodGraphForThisConclusionEvent(FPGNConclusio
 	 * 12. Melancholy
 	 */
 
-	// Get the last conclusion event.
-	const FPGNConclusionEvent& LastConclusionEvent = AllPreviouslyGeneratedNarratives[
-		AllPreviouslyGeneratedNarratives.Num() - 1].ConclusionEvent;
-
-	// We will want to get the three closest conclusion events in absolute distance from the last conclusion event.
-	FMoodGraphVertex LastConclusionEventMoodVertex;
-	LastConclusionEventMoodVertex.Mood = LastConclusionEvent.Mood;
+	// The distances between every pair of moods were computed when the mood graph was initialized, so this is
+	// only a lookup instead of a search through the graph for every possible conclusion event.
+	const int IndexInDistanceTable = UMoodGraph::GetIndexInDistanceTable(GetMoodOfLastConclusionEvent(),
+		ThisConclusionEvent.Mood);
 	
-	TMap<FMoodGraphVertex, int> DistanceMapForLastConclusionEvent = MoodGraph->CreateDistanceMapUsingDijkstra(
-		LastConclusionEventMoodVertex);
+	const TArray<int>& MoodDistanceTable = GetMoodDistanceTable();
+	return MoodDistanceTable.IsValidIndex(IndexInDistanceTable) ? MoodDistanceTable[IndexInDistanceTable] : MAX_int32;
+}
 
-	// Now, we are going to get the distance from the last conclusion event to this potential new conclusion event.
-	FMoodGraphVertex ThisEventMoodVertex;
-	ThisEventMoodVertex.Mood = ThisConclusionEvent.Mood;
-	
-	int DistanceFromThisEventToLastConclusionEvent = DistanceMapForLastConclusionEvent[ThisEventMoodVertex];
-	
-	// By default, we will just try to minimize or incentivize distance.
-	DistanceFromThisEventToLastConclusionEvent /= static_cast<float>(IDEAL_MOOD_GRAPH_DISTANCE_FROM_LAST_CONCLUSION);
-	
-	return DistanceFromThisEventToLastConclusionEvent;
+EPGNMood APGNOverseer::GetMoodOfLastConclusionEvent() const
+{
+	return bHasMoodOfRemovedConclusionEvent ? MoodOfRemovedConclusionEvent
+		: GetMoodOfThisEvent(NarrativeHistory.GetLastConclusionEventId());
+}
+
+EPGNMood APGNOverseer::GetMoodOfThisEvent(int EventId) const
+{
+	if (!EventLibrary.IsValid() || !EventLibrary->IsValidEventId(EventId))
+	{
+		UE_LOG(LogTemp, Error, TEXT("The event %d is not in the event library."), EventId);
+		return EPGNMood::MOOD_Joyful;
+	}
+
+	return EventLibrary->GetEvent(EventId).GetMood();
 }
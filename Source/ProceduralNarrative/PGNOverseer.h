@@ -5,21 +5,66 @@
 #include "CoreMinimal.h"
 #include "Graph.h"
 #include "PGNUtilities.h"
+#include "Containers/Ticker.h"
 #include "GameFramework/Actor.h"
+#include "Runtime/Launch/Resources/Version.h"
+#include "Events/PGNEventLibrary.h"
+#include "Generation/PGNAliasTable.h"
+#include "Generation/PGNCandidateNarratives.h"
+#include "Generation/PGNNarrativePrefetcher.h"
+#include "Generation/PGNCastingSolver.h"
+#include "Generation/PGNNarrativeEvaluator.h"
+#include "Graphs/PGNSocialCommunityIndex.h"
+#include "Graphs/PGNSocialDistanceService.h"
+#include "History/PGNCharacterTimeline.h"
+#include "History/PGNNarrativeHistoryArchive.h"
+#include "Memory/PGNMemoryTracking.h"
+#include "Population/PGNRelationshipOracle.h"
+#include "Population/PGNVirtualPopulation.h"
+#include "Requests/PGNNarrativeRequest.h"
+#include "Save/PGNOverseerSaveState.h"
+#include "Save/PGNSaveJournal.h"
+#include "Text/PGNNarrativeTextRealiser.h"
+#include "World/PGNNarrativeStateSnapshot.h"
+#include "World/PGNWorldData.h"
+#include "World/PGNWorldState.h"
 #include "PGNOverseer.generated.h"
 
+class UCharacterGraph;
+struct FCharacterGraphEdge;
 class UMoodGraph;
 class UPGNCharacterDataAsset;
 class UPGNEventDataAsset;
 class UPGNMoodGraphDataAsset;
 
+// UE5 replaced the core ticker with the thread-safe FTSTicker, whose handles are no longer plain delegate handles.
+#if ENGINE_MAJOR_VERSION >= 5
+using FPGNCoreTicker = FTSTicker;
+using FPGNCoreTickerHandle = FTSTicker::FDelegateHandle;
+#else
+using FPGNCoreTicker = FTicker;
+using FPGNCoreTickerHandle = FDelegateHandle;
+#endif
+
+// How many times a character template has been used while populating the town. A heap of these always has the
+// least used template on top, with ties going to the template that comes first.
+struct FPGNTemplateAllocation
+{
+	int NumberOfTimesUsed = 0;
+	int IndexOfTemplate = INDEX_NONE;
+
+	bool operator<(const FPGNTemplateAllocation& Other) const
+	{
+		return NumberOfTimesUsed != Other.NumberOfTimesUsed ? NumberOfTimesUsed < Other.NumberOfTimesUsed
+			: IndexOfTemplate < Other.IndexOfTemplate;
+	}
+};
+
 UCLASS()
 class PROCEDURALNARRATIVE_API APGNOverseer : public AActor
 {
 	GENERATED_BODY()
 
-	static constexpr float HOW_LONG_BEFORE_GENERATING_NEW_NARRATIVES = 1.f;
-
 public:	
 	// Sets default values for this actor's properties
 	APGNOverseer();
@@ -30,6 +75,11 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite)
 	UPGNEventDataAsset* EventDataAsset;
 
+	// If this is set, the events are memory-mapped from this event library file instead of being read from the Event
+	// Data Asset. Relative paths start from the project's Content folder. See FPGNEventLibraryFile.
+	UPROPERTY(EditAnywhere, meta = (FilePathFilter = "pgnevents", RelativeToGameContentDir))
+	FFilePath EventLibraryFile;
+
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Characters")
 	UPGNCharacterDataAsset* CharacterDataAsset;
 
@@ -39,21 +89,185 @@ public:
 	UPROPERTY()
 	FPGNGeneratedNarrative CurrentNarrative;
 	
-	// We will use this to keep track of the previous narratives.
-	UPROPERTY()
-	TArray<FPGNGeneratedNarrative> AllPreviouslyGeneratedNarratives;
+#pragma region History
+
+	// We will use this to keep track of the previous narratives. Only the most recent ones are kept in memory.
+	FPGNNarrativeHistoryArchive NarrativeHistory;
+
+	// When this is enabled, the narrative history is kept in a file so that it carries on from one session to the next.
+	UPROPERTY(EditAnywhere, Category = "History")
+	bool bPersistNarrativeHistory = false;
+
+	// Relative paths start from the project's Saved folder.
+	UPROPERTY(EditAnywhere, Category = "History", meta = (EditCondition = "bPersistNarrativeHistory"))
+	FString NarrativeHistoryFilename = TEXT("ProceduralNarrative/NarrativeHistory.pgnhistory");
+
+#pragma endregion History
 
 #pragma region Characters
 
 	UPROPERTY(VisibleAnywhere, Category = "Characters")
 	TArray<FPGNCharacter> AllCharacters;
 
+	// The social relationships between everyone in town. It is built once and then changed one character at a time.
+	UPROPERTY()
+	UCharacterGraph* CharacterGraph;
+
+	// Finds a character by their index, whether the town is in AllCharacters or is a virtual population. The pointer
+	// is only valid until the next character is looked up.
+	const FPGNCharacter* GetCharacter(int IndexOfCharacter);
+	int GetNumberOfCharacters() const;
+
+	// How any two characters are related, in a single lookup. It is kept up to date with every relationship change.
+	// The prefetcher's snapshots share it, so it is copied before a change while any of them still hold it.
+	TSharedPtr<FPGNRelationshipOracle, ESPMode::ThreadSafe> RelationshipOracle;
+
+	FPGNRelationshipOracle& GetMutableRelationshipOracle();
+
+	// Returns false if the two characters are not related at all. This works for virtual populations too.
+	bool FindRelationshipBetweenCharacters(int IndexOfCharacterA, int IndexOfCharacterB,
+		FPGNRelationship& Out_Relationship) const;
+
+	// How far apart any two characters are through the people they know, for picking and scoring a cast. Results are
+	// cached per character and thrown away whenever the character graph changes.
+	FPGNSocialDistanceService SocialDistanceService;
+
+	UPROPERTY(EditAnywhere, Category = "Characters", meta = (ClampMin = "1"))
+	int NumberOfSocialDistanceSourcesToCache = 64;
+
+	// Who is connected to whom at all, and the tightly knit groups within that, for narrowing down who to cast.
+	FPGNSocialCommunityIndex SocialCommunityIndex;
+
+	// When this is enabled, roles are only cast from the people connected to whoever was cast first, or to someone at
+	// random for the first role.
+	UPROPERTY(EditAnywhere, Category = "Characters|Casting")
+	bool bOnlyCastCharactersWhoAreConnected = true;
+
+	// Narrows the cast down further, to the community within that group.
+	UPROPERTY(EditAnywhere, Category = "Characters|Casting", meta = (EditCondition = "bOnlyCastCharactersWhoAreConnected"))
+	bool bOnlyCastCharactersInTheSameCommunity = false;
+
+	// If a group is smaller than this, the next wider one is cast from instead, up to the whole town.
+	UPROPERTY(EditAnywhere, Category = "Characters|Casting", meta = (ClampMin = "1", EditCondition = "bOnlyCastCharactersWhoAreConnected"))
+	int MinimumNumberOfCastingCandidates = 8;
+
+	// When this is more than zero, the cast is narrowed down first to the people within this social distance of whoever
+	// the group is centred on, closest first.
+	UPROPERTY(EditAnywhere, Category = "Characters|Casting", meta = (ClampMin = "0", EditCondition = "bOnlyCastCharactersWhoAreConnected"))
+	int MaximumSocialDistanceOfCastingCandidates = 0;
+
+	// Everyone who could still be given a role in the narrative being generated.
+	void GatherCastingCandidates(TArray<FPGNCastingCandidate>& Out_AllCandidates);
+
+	// The attitude the last event this character took part in left them with, from their timeline.
+	EPGNCharacterAttitude FindCurrentAttitudeOfCharacter(int IndexOfCharacter) const;
+
+	// The people the cast could be drawn from, if casting is narrowed down to the people who are connected. It is left
+	// empty if the whole town should be cast from instead.
+	void GatherCharactersConnectedToTheCast(TArray<int32>& Out_AllIndicesOfCharacters);
+
+	// Who has been cast in the narrative being generated so far, and the attitude each of them was last left in.
+	TArray<FPGNCastMember> CastOfNarrativeBeingGenerated;
+
+	// What has become of everyone, so that nobody who was killed, left town or is not married is cast as if they were
+	// not. Every committed narrative is recorded in it.
+	FPGNCharacterTimeline CharacterTimeline;
+
+	// The state of everyone in town, for searches to branch from. Branches share everything they do not change, so
+	// this is the only time the whole town is copied.
+	FPGNWorldState CreateWorldState() const;
+
 #pragma endregion Characters
 
+#pragma region Virtual Population
+
+	/*
+	 * When this is enabled, the town is a virtual population instead of AllCharacters. Its characters are generated
+	 * from the seed whenever they are needed, so the town can be as large as a city while only the cast of the
+	 * current narrative, and the people they know, are kept in memory. See FPGNVirtualPopulation.
+	 *
+	 * AllCharacters and the character graph stay empty in this mode, so the population changes below do not apply.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Characters|Virtual Population")
+	bool bUseVirtualPopulation = false;
+
+	UPROPERTY(EditAnywhere, Category = "Characters|Virtual Population", meta = (ClampMin = "1", EditCondition = "bUseVirtualPopulation"))
+	int NumberOfVirtualCharacters = 1000000;
+
+	// The same seed always gives the same town.
+	UPROPERTY(EditAnywhere, Category = "Characters|Virtual Population", meta = (EditCondition = "bUseVirtualPopulation"))
+	int VirtualPopulationSeed = 0;
+
+	UPROPERTY(EditAnywhere, Category = "Characters|Virtual Population", meta = (ClampMin = "0.0", EditCondition = "bUseVirtualPopulation"))
+	float AverageNumberOfSocialPartnersInVirtualPopulation = 8.f;
+
+	UPROPERTY(EditAnywhere, Category = "Characters|Virtual Population", meta = (ClampMin = "1", EditCondition = "bUseVirtualPopulation"))
+	int NumberOfVirtualCharactersToCache = 4096;
+
+	// A virtual population is too large to cast from in full, so roles are cast from this many neighbours of the
+	// cast so far, or of someone at random for the first role.
+	UPROPERTY(EditAnywhere, Category = "Characters|Virtual Population", meta = (ClampMin = "1", EditCondition = "bUseVirtualPopulation"))
+	int NumberOfVirtualCastingCandidates = 256;
+
+	FPGNVirtualPopulation VirtualPopulation;
+
+#pragma endregion Virtual Population
+
+#pragma region Population Changes
+
+	/*
+	 * Characters arrive, die, leave town and divorce as narratives play out. Each of these only touches the characters
+	 * involved and their neighbours in the character graph, instead of rebuilding the relationships of the whole town.
+	 */
+
+	// Creates a new character from this template and wires them into the town. Returns their index in AllCharacters.
+	int AddCharacterToTown(const FPGNCharacterTemplate& ThisCharacterTemplate);
+
+	// The character keeps their place in AllCharacters, but loses every relationship they had.
+	void RemoveCharacterFromTown(int IndexOfCharacter, bool bDidCharacterDie);
+
+	// Both characters end up divorced, and whatever social relationship they had ends with the marriage. The former
+	// spouse is whoever the character is married to, unless they are given.
+	void DivorceThisCharacter(int IndexOfCharacter, int IndexOfFormerSpouse = INDEX_NONE);
+	bool FindNewSpouseForThisCharacter(int IndexOfCharacter);
+
+	bool AddSocialRelationship(int IndexOfCharacterA, int IndexOfCharacterB, int DistanceBetweenCharacters);
+	bool RemoveSocialRelationship(int IndexOfCharacterA, int IndexOfCharacterB);
+	bool SetSocialRelationshipDistance(int IndexOfCharacterA, int IndexOfCharacterB, int NewDistanceBetweenCharacters);
+
+	// Applies what this action does to the town, such as a character leaving it. Actions that do not change the
+	// population or its relationships are ignored.
+	void ApplyOutcomeOfThisEventAction(EPGNEventAction Action, int IndexOfSubject, int IndexOfObject = INDEX_NONE);
+
+	bool IsCharacterInTown(int IndexOfCharacter) const;
+
+#pragma endregion Population Changes
+
 #pragma region Conclusions
 	
-	UPROPERTY()
-	TArray<FPGNConclusionEvent> CONCLUSION_AllEvents;
+	// The conclusion events themselves are shared with every other overseer in the process that uses the same assets.
+	const TArray<FPGNConclusionEvent>& GetAllConclusionEvents() const;
+
+	// Which narratives each conclusion event has been used in, indexed by conclusion event ID. This is the only part
+	// of the conclusion events that belongs to this overseer.
+	TArray<TArray<int>> AllConclusionEventUsage;
+
+	// The compiled form of every event in the Event Data Asset. Narratives refer to events by their ID in here. It
+	// never changes after it is built, so it can be handed to other threads as is.
+	TSharedPtr<const FPGNEventLibrary, ESPMode::ThreadSafe> EventLibrary;
+
+	// The events, mood distances and character samplers, which are shared with every overseer using the same assets.
+	FPGNWorldDataPtr WorldData;
+
+	EPGNMood GetMoodOfThisEvent(int EventId) const;
+
+	// The mood of the conclusion of the last narrative in the history, even if its event has since been reloaded away.
+	EPGNMood GetMoodOfLastConclusionEvent() const;
+
+	// Set when a reload of the events removed the conclusion event the next narrative should carry on from, until
+	// the next narrative is committed.
+	bool bHasMoodOfRemovedConclusionEvent = false;
+	EPGNMood MoodOfRemovedConclusionEvent = EPGNMood::MOOD_Joyful;
 	
 	UPROPERTY()
 	FPGNConclusionEvent CurrentConclusionEvent;
@@ -73,40 +287,255 @@ public:
 
 	static constexpr int IDEAL_MOOD_GRAPH_DISTANCE_FROM_LAST_CONCLUSION = 3;
 
+	// The distance between every pair of moods, indexed with UMoodGraph::GetIndexInDistanceTable.
+	const TArray<int>& GetMoodDistanceTable() const;
+
+	// This is only built the first time it is asked for, since generating narratives only needs the distance table.
+	UMoodGraph* GetMoodGraph();
+
 	// We use the mood graph to ensure that we do not jump from one tone to another too quickly.
-	int EvaluateScoreFromMoodGraphForThisConclusionEvent(FPGNConclusionEvent& ThisConclusionEvent);
+	float EvaluateScoreFromMoodGraphForThisConclusionEvent(const FPGNConclusionEvent& ThisConclusionEvent) const;
+	// MAX_int32 if either mood is not in the mood graph or one cannot be reached from the other.
+	int FindMoodGraphDistanceFromLastConclusionEvent(const FPGNConclusionEvent& ThisConclusionEvent) const;
 
 #pragma endregion MoodGraph
 
+#pragma region Hot Reload
+
+	/*
+	 * Picks up edits to the event and mood graph data assets while the game is running, without touching the
+	 * characters or the history. Events that were kept, moved or edited keep their usage and their place in the
+	 * current narrative. In the editor this is called whenever either asset changes.
+	 */
+	void ReloadWorldData();
+
+#pragma endregion Hot Reload
+
+#pragma region Evaluation
+
+	// Scores narratives for the searches over events and casts, remembering what it has scored before. It is built
+	// once the world data and characters are ready.
+	TUniquePtr<FPGNNarrativeEvaluator> NarrativeEvaluator;
+
+	UPROPERTY(EditAnywhere, Category = "Evaluation", meta = (ClampMin = "16"))
+	int NumberOfEvaluationsToCache = 65536;
+
+	// The cast of this narrative in the form the evaluator and the casting solver take, indexed by role.
+	void GatherCastOfThisNarrative(const FPGNGeneratedNarrative& ThisNarrative, TArray<FPGNCastingCandidate>& Out_Cast);
+
+#pragma endregion Evaluation
+
+#pragma region Candidate Narratives
+
+	// Every narrative is the best of this many candidates, built side by side from the best conclusion events on
+	// spare cores and scored by the narrative evaluator.
+	UPROPERTY(EditAnywhere, Category = "Evaluation", meta = (ClampMin = "1", ClampMax = "64"))
+	int NumberOfCandidateNarratives = 1;
+
+	// How many events lead up to the conclusion of each narrative, if there are enough that suit its cast.
+	UPROPERTY(EditAnywhere, Category = "Evaluation", meta = (ClampMin = "0", ClampMax = "16"))
+	int NumberOfEventsBeforeConclusion = 3;
+
+	// Candidates that have not been started by then are skipped. The first one is always built.
+	UPROPERTY(EditAnywhere, Category = "Evaluation", meta = (ClampMin = "0.0", EditCondition = "NumberOfCandidateNarratives > 1"))
+	float CandidateNarrativeDeadlineInMilliseconds = 8.f;
+
+	// What each candidate for the last narrative cost and how it scored, for tuning the two settings above.
+	TArray<FPGNCandidateNarrative> AllCandidatesOfLastNarrative;
+
+	// The same seed, town and history always give the same narratives.
+	UPROPERTY(EditAnywhere, Category = "Evaluation")
+	int NarrativeGenerationSeed = 0;
+
+	// Every random choice made while generating narratives is drawn from this, from conclusions to casting anchors
+	// and the seeds of the candidates and the prefetcher.
+	FRandomStream NarrativeRandomStream;
+
+#pragma endregion Candidate Narratives
+
+#pragma region Prefetching
+
+	// When this is enabled, a background producer keeps narratives ready so that delivering one is only a dequeue.
+	// It builds them from a snapshot of the relationships, so it does nothing for a virtual population.
+	UPROPERTY(EditAnywhere, Category = "Prefetching")
+	bool bPrefetchNarratives = false;
+
+	UPROPERTY(EditAnywhere, Category = "Prefetching", meta = (ClampMin = "1", ClampMax = "64", EditCondition = "bPrefetchNarratives"))
+	int NumberOfNarrativesToPrefetch = 4;
+
+	// Delivers a prefetched narrative as the new current narrative. Returns false if none are ready yet.
+	bool TryConsumePrefetchedNarrative();
+
+	// This must be called whenever the characters, events or mood graph change outside of narrative generation.
+	void InvalidatePrefetchedNarratives();
+
+	void CreateNarrativeGenerationSnapshot(FPGNNarrativeGenerationSnapshot& Out_Snapshot);
+
+#pragma endregion Prefetching
+
+#pragma region Narrative Requests
+
+	/*
+	 * Narratives are only generated when something asks for one. Requests are served on the game thread by a ticker
+	 * that only runs while any of them are waiting, the most urgent first, and requests with the same constraints that
+	 * are waiting at the same time all share one narrative. The request ID can be used to cancel it.
+	 */
+	TFuture<FPGNNarrativeRequestResult> RequestNarrative(const FPGNNarrativeRequestConstraints& Constraints,
+		FPGNNarrativeRequestId* Out_RequestId = nullptr);
+
+	// The same, but OnCompleted is called on the game thread instead, which is what Blueprints need.
+	FPGNNarrativeRequestId RequestNarrativeWithCallback(const FPGNNarrativeRequestConstraints& Constraints,
+		TFunction<void(const FPGNNarrativeRequestResult&)> OnCompleted);
+
+	// Returns false if the request has already been completed.
+	bool CancelNarrativeRequest(FPGNNarrativeRequestId RequestId);
+
+	int32 GetNumberOfWaitingNarrativeRequests() const { return NarrativeRequests.Num(); }
+
+	// Anything still waiting after this many narratives waits for the next frame, so that a burst of requests does not
+	// cause a hitch.
+	UPROPERTY(EditAnywhere, Category = "Narrative Requests", meta = (ClampMin = "1"))
+	int MaximumNarrativesPerFrame = 1;
+
+#pragma endregion Narrative Requests
+
+#pragma region Published State
+
+	/*
+	 * Anything that only reads the narrative, such as UI, quests and Blueprints, should read it from here instead of
+	 * from CurrentNarrative and AllCharacters. This is safe from any thread and never blocks, and the snapshot never
+	 * changes under whoever holds it. A new one is published whenever the narrative or the characters change.
+	 */
+	FPGNNarrativeStateSnapshotPtr GetNarrativeStateSnapshot() const { return NarrativeStatePublisher.Acquire(); }
+
+	// The same for Blueprints. Returns false if nothing has been published yet.
+	UFUNCTION(BlueprintCallable, Category = "Procedural Narrative")
+	bool GetPublishedNarrative(FPGNGeneratedNarrative& Out_Narrative, TArray<FPGNCharacter>& Out_AllCharactersInCast) const;
+
+	// The published narrative written out as prose, for dialogue and journals. See FPGNNarrativeTextRealiser.
+	UFUNCTION(BlueprintCallable, Category = "Procedural Narrative")
+	FString GetPublishedNarrativeText() const;
+
+#pragma endregion Published State
+
+#pragma region Saving
+
+	/*
+	 * When this is enabled, the town, its relationships and the current narrative are saved as a checkpoint followed
+	 * by a journal of what has changed since, and are loaded again instead of building a new town. Each save after a
+	 * narrative only writes what that narrative changed, and the writing happens off the game thread. See
+	 * FPGNSaveJournal. The narrative history has its own file, so bPersistNarrativeHistory should be enabled as well.
+	 *
+	 * A virtual population is generated from its seed, so it is never saved.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Saving")
+	bool bSaveOverseerState = false;
+
+	// Relative paths start from the project's Saved folder. The extensions are added to this.
+	UPROPERTY(EditAnywhere, Category = "Saving", meta = (EditCondition = "bSaveOverseerState"))
+	FString SaveFilename = TEXT("ProceduralNarrative/Overseer");
+
+	// A new checkpoint is written once the journal has this many deltas, so that loading never has far to replay.
+	UPROPERTY(EditAnywhere, Category = "Saving", meta = (ClampMin = "1", EditCondition = "bSaveOverseerState"))
+	int MaximumDeltasPerCheckpoint = 64;
+
+	// Or once the deltas add up to this much.
+	UPROPERTY(EditAnywhere, Category = "Saving", meta = (ClampMin = "1", EditCondition = "bSaveOverseerState"))
+	int MaximumKilobytesOfDeltasPerCheckpoint = 256;
+
+	// This is called after every narrative, but can be called at any other time as well. Returns false if saving is
+	// disabled. Nothing is written if nothing has changed.
+	UFUNCTION(BlueprintCallable, Category = "Procedural Narrative")
+	bool SaveOverseerState();
+
+#pragma endregion Saving
+
+#pragma region Memory
+
+	/*
+	 * Soft limits, checked after every narrative. A history over its budget encodes its pending narratives, and if it
+	 * is not kept in a file, forgets its oldest narratives. Caches over their budget are thrown away, and fill up again
+	 * as they are needed. 0 means there is no limit. "pgn.mem" lists what every overseer is using.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Memory", meta = (ClampMin = "0"))
+	int HistoryMemoryBudgetInKilobytes = 0;
+
+	UPROPERTY(EditAnywhere, Category = "Memory", meta = (ClampMin = "0"))
+	int CacheMemoryBudgetInKilobytes = 0;
+
+	void GatherMemoryUsage(FPGNMemoryUsage& Out_MemoryUsage) const;
+
+	// Only what the overseer owns. The character graph reports its own, and the world data is shared.
+	virtual void GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize) override;
+
+#pragma endregion Memory
+
 protected:
 	
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 #pragma region Initialization
 	
 	void InitializeOverseer();
+
+	// Finds or builds the read-only data for our assets in the shared FPGNWorldDataCache.
+	bool InitializeWorldData();
 	bool InitializeAllEvents();
+	void InitializeNarrativeEvaluator();
+
+	// Moves everything we keep by event ID over to the IDs in the event library of the new world data.
+	void ApplyEventLibraryChanges(const FPGNEventLibrary& PreviousEventLibrary);
+
+#if WITH_EDITOR
+	void OnObjectPropertyChanged(UObject* ChangedObject, FPropertyChangedEvent& PropertyChangedEvent);
+	FDelegateHandle ObjectPropertyChangedHandle;
+#endif
 
 #pragma region Characters
 
 	void InitializeAllCharacters();
 
-	void InitializeAllCharacterPopulationIntervalsFromDataAsset() const;
-	
 	void InitializeThisIndividualCharacter(FPGNCharacterTemplate& ThisCharacterTemplate, FPGNCharacter& Out_ThisCharacter);
 	void InitializeThisCharacterGender(FPGNCharacter& Out_ThisCharacter) const;
 	void InitializeThisCharacterAge(FPGNCharacter& Out_ThisCharacter) const;
 	void InitializeThisCharacterName(FPGNCharacter& Out_ThisCharacter) const;
 
 	void InitializeAllCharacterRelationships();
+	void InitializeCharacterTimeline();
 	
 	void InitializeAllCharactersRomanticRelationships();
 	EPGNCharacterRomanticRelationship DetermineRelationshipFromRandomPercentage(float GeneratedChance);
-	bool FindPotentialRomanticSpouseForThisCharacter(FPGNCharacter& ThisCharacter);
+	bool FindPotentialRomanticSpouseForThisCharacter(int IndexOfCharacter);
 
 	void InitializeAllCharactersSocialRelationships();
 
+	// The Erdos-Renyi threshold the town was built with. New arrivals are connected with the same one.
+	float ThresholdForSocialEdgeCreation = 0.f;
+
+	void AddSocialDataForThisEdge(const FCharacterGraphEdge& ThisEdge);
+	void RemoveSocialDataBetweenTheseCharacters(int IndexOfCharacterA, int IndexOfCharacterB);
+
+	// Ends this character's marriage, if they have one, and leaves their spouse with this relationship.
+	void EndMarriageOfThisCharacter(int IndexOfCharacter, EPGNCharacterRomanticRelationship RelationshipForSpouse);
+
+	// Everything derived from the characters, such as queued narratives, has to be rebuilt after they change.
+	void OnCharactersChanged();
+
+	// While this is set, OnCharactersChanged only notes that something changed, so that a narrative that changes the
+	// town several times only rebuilds everything once.
+	bool bIsApplyingOutcomesOfNarrative = false;
+	bool bHaveCharactersChangedWhileApplyingOutcomes = false;
+
+	// While this is set, OnCharactersChanged keeps the prefetched narratives, since the producer already built them
+	// after the narrative being committed, outcomes and all.
+	bool bIsCommittingPrefetchedNarrative = false;
+
+	// Applies what every event of this narrative does to the town, in the order they happen. Returns true if the
+	// characters changed.
+	bool ApplyOutcomesOfThisNarrative(const FPGNGeneratedNarrative& ThisNarrative);
+
 	EPGNCharacterSocialRelationship DetermineSocialRelationshipFromRandomPercentage(float GeneratedChance);
 
 	UPROPERTY(VisibleAnywhere, Category = "Characters")
@@ -114,16 +543,65 @@ protected:
 
 #pragma endregion Characters
 
-	void InitializeMoodGraph();
+	// Opens the narrative history file and restores the usage of every conclusion event from it.
+	void InitializeNarrativeHistory();
+
+	// Returns false if there is no save to load, in which case the town has to be built from scratch.
+	bool LoadOverseerState();
 
 #pragma endregion Initialization
 
+	TUniquePtr<FPGNNarrativePrefetcher> NarrativePrefetcher;
+
+	FPGNNarrativeRequestQueue NarrativeRequests;
+	FPGNCoreTickerHandle NarrativeRequestTickerHandle;
+
+	// Generates a narrative for the most urgent requests, up to MaximumNarrativesPerFrame of them. The ticker is
+	// removed once nothing is waiting.
+	bool ServeNarrativeRequests(float DeltaTime);
+
+	// Returns false if no narrative could be made to meet the constraints, in which case nothing has changed.
+	bool ProduceNarrativeForTheseConstraints(const FPGNNarrativeRequestConstraints& Constraints);
+
+	// Builds the candidate narratives and keeps the best in Out_Narrative. Returns false if none of them could be built.
+	bool BuildBestOfCandidateNarratives(FPGNGeneratedNarrative& Out_Narrative,
+		const FPGNNarrativeRequestConstraints* Constraints);
+
+	FPGNNarrativeStatePublisher NarrativeStatePublisher;
+
+	// Carried from one snapshot to the next, so that each snapshot only copies the characters that changed. It is
+	// built again from the town whenever the characters change.
+	FPGNWorldState PublishedWorldState;
+	bool bIsPublishedWorldStateStale = true;
+
+	void PublishNarrativeState();
+
+	FPGNSaveJournal SaveJournal;
+
+	// What has changed since the last save, so that a delta only holds that.
+	TSet<int32> AllCharactersChangedSinceLastSave;
+	TSet<uint64> AllRelationshipsChangedSinceLastSave;
+	bool bHasCurrentNarrativeChangedSinceLastSave = false;
+
+	void MarkCharacterAsChangedSinceLastSave(int IndexOfCharacter);
+	void MarkRelationshipAsChangedSinceLastSave(int IndexOfCharacterA, int IndexOfCharacterB);
+	void ClearChangesSinceLastSave();
+
+	void WriteSave(bool bWriteCheckpoint);
+
+	// The current narrative may already be in the history, if it was archived when the game last ended.
+	bool bIsCurrentNarrativeArchived = false;
+
+	// Moves the current narrative into the history before a new one replaces it.
+	void ArchiveCurrentNarrative();
+	// Throws the prefetched narratives away unless this is one of them, in which case the rest still follow on from it.
+	void CommitNewNarrative(FPGNGeneratedNarrative& NewNarrative, bool bWasPrefetched);
+
+	void EnforceMemoryBudgets();
+
 public:
 	
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
-	float TimerSinceLastNarrativeGeneration = 0.f;
-	
-	void GenerateNewNarrative();
+	// Returns false without touching the current narrative if none of the conclusion events meet the constraints.
+	bool GenerateNewNarrative(const FPGNNarrativeRequestConstraints* Constraints = nullptr);
 	bool HasCurrentNarrativeReachedConvergence();
 };
@@ -2,38 +2,72 @@
 
 #include "PGNUtilities.h"
 #include "PGNOverseer.h"
+#include "Requests/PGNNarrativeRequest.h"
+#include "Text/PGNNarrativeTextRealiser.h"
 
-void UPGNUtilities::FindBestConclusionEvent(FPGNConclusionEvent& Out_ConclusionEvent, APGNOverseer* ThisOverseer)
+void UPGNUtilities::FindBestConclusionEvents(TArray<int>& Out_AllConclusionEventIds, int NumberToFind,
+	APGNOverseer* ThisOverseer, const FPGNNarrativeRequestConstraints* Constraints)
 {
-	TArray<FPGNConclusionEvent> AllPossibleConclusionEvents = ThisOverseer->CONCLUSION_AllEvents;
+	const TArray<FPGNConclusionEvent>& AllPossibleConclusionEvents = ThisOverseer->GetAllConclusionEvents();
+	const TArray<TArray<int>>& AllConclusionEventUsage = ThisOverseer->AllConclusionEventUsage;
+	const bool bHasPreviousNarratives = ThisOverseer->NarrativeHistory.Num() > 0;
 
-	// If we have no previous narratives, then we will just return the a random conclusion event.
-	if (ThisOverseer->AllPreviouslyGeneratedNarratives.Num() == 0)
-	{
-		Out_ConclusionEvent = AllPossibleConclusionEvents[FMath::RandRange(0,
-			AllPossibleConclusionEvents.Num() - 1)];
-		return;
-	}
-	
-	for (FPGNConclusionEvent& ThisConclusionEvent : AllPossibleConclusionEvents)
+	TArray<TPair<float, int>> AllScoredConclusionEvents;
+	AllScoredConclusionEvents.Reserve(AllPossibleConclusionEvents.Num());
+
+	for (int Index_ConclusionEvent = 0; Index_ConclusionEvent < AllPossibleConclusionEvents.Num(); Index_ConclusionEvent++)
 	{
-		UE_LOG(LogTemp, Warning, TEXT("***********************************"));
-		ThisConclusionEvent.EvaluatedScore = EvaluateThisPossibleConclusionEvent(ThisConclusionEvent, ThisOverseer);
-		UE_LOG(LogTemp, Warning, TEXT("Evaluated Score: %f FOR THE SUBJECT TAG %s"), ThisConclusionEvent.EvaluatedScore,
-			*UEnum::GetValueAsString(ThisConclusionEvent.Action));
+		const FPGNConclusionEvent& ThisConclusionEvent = AllPossibleConclusionEvents[Index_ConclusionEvent];
+
+		if (Constraints != nullptr && !Constraints->AllowsThisConclusionEvent(ThisConclusionEvent))
+		{
+			continue;
+		}
+
+		// If we have no previous narratives, then a random score gives us a random selection.
+		float EvaluatedScore = ThisOverseer->NarrativeRandomStream.FRand();
+
+		if (bHasPreviousNarratives)
+		{
+			float RecencySubScore = 0.f;
+			float MoodGraphSubScore = 0.f;
+			EvaluatedScore = EvaluateThisPossibleConclusionEvent(AllConclusionEventUsage[Index_ConclusionEvent],
+				ThisOverseer->FindMoodGraphDistanceFromLastConclusionEvent(ThisConclusionEvent), RecencySubScore,
+				MoodGraphSubScore);
+		}
+
+		AllScoredConclusionEvents.Emplace(EvaluatedScore, Index_ConclusionEvent);
 	}
 
-	// Determine the best conclusion event
-	AllPossibleConclusionEvents.Sort([](const FPGNConclusionEvent& A, const FPGNConclusionEvent& B)
+	// Ties go to the conclusion event that comes first.
+	AllScoredConclusionEvents.Sort([](const TPair<float, int>& A, const TPair<float, int>& B)
 	{
-		return A.EvaluatedScore > B.EvaluatedScore;
+		return A.Key != B.Key ? A.Key > B.Key : A.Value < B.Value;
 	});
 
-	// Return that event then
-	Out_ConclusionEvent = AllPossibleConclusionEvents[0];
+	Out_AllConclusionEventIds.Reset();
+
+	for (int Index_Best = 0; Index_Best < FMath::Min(NumberToFind, AllScoredConclusionEvents.Num()); Index_Best++)
+	{
+		Out_AllConclusionEventIds.Add(AllScoredConclusionEvents[Index_Best].Value);
+	}
 }
 
 float UPGNUtilities::EvaluateThisPossibleConclusionEvent(FPGNConclusionEvent& ThisConclusionEvent, APGNOverseer* ThisOverseer)
+{
+	return EvaluateThisPossibleConclusionEvent(ThisConclusionEvent,
+		ThisOverseer->FindMoodGraphDistanceFromLastConclusionEvent(ThisConclusionEvent));
+}
+
+float UPGNUtilities::EvaluateThisPossibleConclusionEvent(FPGNConclusionEvent& ThisConclusionEvent,
+	int MoodGraphDistanceFromLastConclusion)
+{
+	return EvaluateThisPossibleConclusionEvent(ThisConclusionEvent.AllNarrativesThisConclusionEventIsIn,
+		MoodGraphDistanceFromLastConclusion, ThisConclusionEvent.RecencySubScore, ThisConclusionEvent.MoodGraphSubScore);
+}
+
+float UPGNUtilities::EvaluateThisPossibleConclusionEvent(const TArray<int>& AllNarrativesThisConclusionEventIsIn,
+	int MoodGraphDistanceFromLastConclusion, float& Out_RecencySubScore, float& Out_MoodGraphSubScore)
 {
 	/* What we will do is evaluate every possible conclusion event based on three main figures:
 	 *
@@ -46,11 +80,11 @@ float UPGNUtilities::EvaluateThisPossibleConclusionEvent(FPGNConclusionEvent& Th
 	 */
 
 	/// EVALUATING RECENCY
-	if (ThisConclusionEvent.AllNarrativesThisConclusionEventIsIn.Num() > 0)
+	if (AllNarrativesThisConclusionEventIsIn.Num() > 0)
 	{
-		const float TotalAppearancesOfEvent = static_cast<float>(ThisConclusionEvent.AllNarrativesThisConclusionEventIsIn.Num());
-		const int LastUsageOfThisEvent = ThisConclusionEvent.AllNarrativesThisConclusionEventIsIn[
-			ThisConclusionEvent.AllNarrativesThisConclusionEventIsIn.Num() - 1];
+		const float TotalAppearancesOfEvent = static_cast<float>(AllNarrativesThisConclusionEventIsIn.Num());
+		const int LastUsageOfThisEvent = AllNarrativesThisConclusionEventIsIn[
+			AllNarrativesThisConclusionEventIsIn.Num() - 1];
 
 		constexpr float WeightingForDensity = 0.67f;
 		constexpr float WeightingForLastUsage = 0.5f;
@@ -61,39 +95,71 @@ float UPGNUtilities::EvaluateThisPossibleConclusionEvent(FPGNConclusionEvent& Th
 		constexpr float WEIGHTING_FOR_RECENCY = 2.f;
 		RecencySubScore *= WEIGHTING_FOR_RECENCY;
 
-		ThisConclusionEvent.RecencySubScore = RecencySubScore;
+		Out_RecencySubScore = RecencySubScore;
 	}
 	else
 	{
-		ThisConclusionEvent.RecencySubScore = 0;
+		Out_RecencySubScore = 0;
 	}
 
-	ThisConclusionEvent.RecencySubScore = 0;
+	Out_RecencySubScore = 0;
 	
 	/// EVALUATING MOODS
-	int MoodGraphSubScore = ThisOverseer->EvaluateScoreFromMoodGraphForThisConclusionEvent(ThisConclusionEvent)
-		* ThisOverseer->WEIGHTING_FOR_MOOD_GRAPH_IN_GENERATING_CONCLUSIONS;
-
-	ThisConclusionEvent.MoodGraphSubScore = MoodGraphSubScore;
-	UE_LOG(LogTemp, Log, TEXT("HEY CHARLIE! THE MOOD GRAPH SUB SCORE IS %f"), ThisConclusionEvent.MoodGraphSubScore);
+	Out_MoodGraphSubScore = EvaluateScoreFromMoodGraphDistance(MoodGraphDistanceFromLastConclusion)
+		* APGNOverseer::WEIGHTING_FOR_MOOD_GRAPH_IN_GENERATING_CONCLUSIONS;
 	
 	// The maximum possible score is 100, and the lowest is 0.
-	return ThisConclusionEvent.RecencySubScore + ThisConclusionEvent.MoodGraphSubScore;
+	return Out_RecencySubScore + Out_MoodGraphSubScore;
 }
 
-void UPGNUtilities::DEBUG_PrintOutThisConclusionEvent(FPGNConclusionEvent& In_ConclusionEvent)
+float UPGNUtilities::EvaluateScoreFromMoodGraphDistance(int MoodGraphDistanceFromLastConclusion)
 {
-	UE_LOG(LogTemp, Log, TEXT("THIS CONCLUSION EVENT HAD THIS SUBJECT %s %s"), *UEnum::GetValueAsString(
-		In_ConclusionEvent.Subject), *UEnum::GetValueAsString(In_ConclusionEvent.Action));
+	// A mood we cannot reach from the last one, or do not know at all, is the worst choice there is.
+	if (MoodGraphDistanceFromLastConclusion < 0 || MoodGraphDistanceFromLastConclusion == MAX_int32)
+	{
+		return 0.f;
+	}
+
+	// By default, we will just try to incentivize distance, up to the ideal distance.
+	const float ScoreFromDistance = MoodGraphDistanceFromLastConclusion
+		/ static_cast<float>(APGNOverseer::IDEAL_MOOD_GRAPH_DISTANCE_FROM_LAST_CONCLUSION);
+
+	return FMath::Clamp(ScoreFromDistance, 0.f, 1.f) * MAXIMUM_MOOD_GRAPH_SCORE;
 }
 
-void UPGNUtilities::FindBestNextEvent(FPGNEvent& Out_NextEvent, APGNOverseer* ThisOverseer)
+void UPGNUtilities::DEBUG_PrintOutThisConclusionEvent(FPGNConclusionEvent& In_ConclusionEvent)
 {
-	// ToDo: Implement using genetic algorithms.
+	const FStringView SubjectPhrase = FPGNNarrativeTextRealiser::GetTagPhrase(In_ConclusionEvent.Subject);
+	const FStringView ActionPhrase = FPGNNarrativeTextRealiser::GetActionPhrase(In_ConclusionEvent.Action);
+
+	UE_LOG(LogTemp, Log, TEXT("THIS CONCLUSION EVENT HAD THIS SUBJECT %.*s %.*s"), SubjectPhrase.Len(),
+		SubjectPhrase.GetData(), ActionPhrase.Len(), ActionPhrase.GetData());
 }
 
-void UPGNUtilities::GeneratePossibleCastOfCharactersForThisEvent(FPGNGeneratedNarrative& Out_GeneratedNarrative,
-	FPGNEvent& Out_ThisEvent, APGNOverseer* ThisOverseer)
+void UPGNUtilities::RecordCastOfThisEvent(FPGNGeneratedNarrative& Out_GeneratedNarrative, const FPGNEvent& ThisEvent,
+	TArray<FPGNCastMember>& InOut_Cast)
 {
-	// ToDo: Implement using the already existing cast of characters.
+	for (FPGNCastMember& ThisCastMember : InOut_Cast)
+	{
+		const int IndexInCast = FPGNCastingSolver::GetIndexInCast(ThisCastMember.Tag);
+
+		while (Out_GeneratedNarrative.AllIndicesOfCharactersInUse.Num() <= IndexInCast)
+		{
+			Out_GeneratedNarrative.AllIndicesOfCharactersInUse.Add(INDEX_NONE);
+			Out_GeneratedNarrative.AllCharactersInUse.AddDefaulted();
+		}
+
+		Out_GeneratedNarrative.AllIndicesOfCharactersInUse[IndexInCast] = ThisCastMember.Character.IndexOfCharacter;
+		Out_GeneratedNarrative.AllCharactersInUse[IndexInCast] = ThisCastMember.Character.Template;
+
+		// The next event this character is in should pick up from where this one leaves them.
+		if (ThisCastMember.Tag == ThisEvent.Subject)
+		{
+			ThisCastMember.CurrentAttitude = ThisEvent.SubjectFinalAttitude;
+		}
+		else if (ThisEvent.bDoesEventHaveObject && ThisCastMember.Tag == ThisEvent.Object)
+		{
+			ThisCastMember.CurrentAttitude = ThisEvent.ObjectFinalAttitude;
+		}
+	}
 }
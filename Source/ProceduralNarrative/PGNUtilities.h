@@ -7,6 +7,8 @@
 #include "PGNUtilities.generated.h"
 
 class APGNOverseer;
+struct FPGNCastMember;
+struct FPGNNarrativeRequestConstraints;
 
 //// ALL ENUMS //////////////////////////////
 // We will divide up all sectors into five different areas for better sorting and dramatic tension evaluation.
@@ -237,7 +239,9 @@ struct FPGNCharacterRomanticData
 	UPROPERTY()
 	FString NameOfRomanticPartner = "INVALID";
 
-	// ToDo: We really need some kind of ID system.
+	// Characters never move in APGNOverseer::AllCharacters, so their index there is used as their ID.
+	UPROPERTY()
+	int IndexOfRomanticPartner = INDEX_NONE;
 };
 
 USTRUCT()
@@ -250,6 +254,9 @@ struct FPGNCharacterSocialData
 
 	UPROPERTY()
 	FString NameOfSocialPartner = "INVALID";
+
+	UPROPERTY()
+	int IndexOfSocialPartner = INDEX_NONE;
 };
 
 // These are instances created from the Character Templates.
@@ -279,6 +286,10 @@ struct FPGNCharacter
 	UPROPERTY(VisibleAnywhere)
 	bool bIsMale = true;
 
+	// Characters who die or leave town keep their place in AllCharacters so that nobody else's index changes.
+	UPROPERTY(VisibleAnywhere)
+	bool bIsInTown = true;
+
 	UPROPERTY(VisibleAnywhere)
 	FPGNCharacterTemplate MyCharacterTemplate;
 };
@@ -436,11 +447,19 @@ struct FPGNGeneratedNarrative
 	UPROPERTY(VisibleAnywhere)
 	bool bIsNarrativeInitialized = false;
 
+	// Events are stored by their ID in the overseer's FPGNEventLibrary rather than as copies. The ID of a conclusion
+	// event is also its index in APGNOverseer::GetAllConclusionEvents().
 	UPROPERTY(VisibleAnywhere)
-	FPGNConclusionEvent ConclusionEvent;
+	int ConclusionEventId = INDEX_NONE;
 
 	UPROPERTY(VisibleAnywhere)
-	TArray<FPGNEvent> AllEvents;
+	TArray<int> AllEventIds;
+
+	// The cast is indexed by role: TAG_PROTAGONIST is at 0, TAG_CHARACTER_1 at 1, and so on. Each index is into
+	// APGNOverseer::AllCharacters, or INDEX_NONE if nobody plays that role. AllCharactersInUse has the template of the
+	// character at the same place.
+	UPROPERTY(VisibleAnywhere)
+	TArray<int> AllIndicesOfCharactersInUse;
 
 	UPROPERTY(VisibleAnywhere)
 	TArray<FPGNCharacterTemplate> AllCharactersInUse;
@@ -456,13 +475,27 @@ class PROCEDURALNARRATIVE_API UPGNUtilities : public UBlueprintFunctionLibrary
 
 public:
 
-	static void FindBestConclusionEvent(FPGNConclusionEvent& Out_ConclusionEvent, APGNOverseer* ThisOverseer);
+	// Scores every conclusion event that meets the constraints, if there are any, and keeps the best NumberToFind of
+	// them, best first, for building candidate narratives side by side. With no previous narratives, they are chosen
+	// at random.
+	static void FindBestConclusionEvents(TArray<int>& Out_AllConclusionEventIds, int NumberToFind,
+		APGNOverseer* ThisOverseer, const FPGNNarrativeRequestConstraints* Constraints = nullptr);
 	static float EvaluateThisPossibleConclusionEvent(FPGNConclusionEvent& ThisConclusionEvent, APGNOverseer* ThisOverseer);
 
-	static void DEBUG_PrintOutThisConclusionEvent(FPGNConclusionEvent& In_ConclusionEvent);
+	// The same evaluation, but with the mood graph distance from the last conclusion already known. This does not
+	// touch the overseer, so it is safe to call from the narrative prefetcher.
+	static float EvaluateThisPossibleConclusionEvent(FPGNConclusionEvent& ThisConclusionEvent,
+		int MoodGraphDistanceFromLastConclusion);
+	static float EvaluateThisPossibleConclusionEvent(const TArray<int>& AllNarrativesThisConclusionEventIsIn,
+		int MoodGraphDistanceFromLastConclusion, float& Out_RecencySubScore, float& Out_MoodGraphSubScore);
 
-	static void FindBestNextEvent(FPGNEvent& Out_NextEvent, APGNOverseer* ThisOverseer);
+	// From 0 to MAXIMUM_MOOD_GRAPH_SCORE. Unreachable moods score 0.
+	static constexpr float MAXIMUM_MOOD_GRAPH_SCORE = 100.f;
+	static float EvaluateScoreFromMoodGraphDistance(int MoodGraphDistanceFromLastConclusion);
+
+	static void DEBUG_PrintOutThisConclusionEvent(FPGNConclusionEvent& In_ConclusionEvent);
 
-	static void GeneratePossibleCastOfCharactersForThisEvent(FPGNGeneratedNarrative& Out_GeneratedNarrative,
-		FPGNEvent& Out_ThisEvent, APGNOverseer* ThisOverseer);
+	// Writes the cast into the narrative by role, and leaves everyone in this event with the attitude it ends them in.
+	static void RecordCastOfThisEvent(FPGNGeneratedNarrative& Out_GeneratedNarrative, const FPGNEvent& ThisEvent,
+		TArray<FPGNCastMember>& InOut_Cast);
 };
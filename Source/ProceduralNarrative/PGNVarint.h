@@ -0,0 +1,134 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+// The encoding shared by the narrative history and the overseer's save.
+namespace PGNVarint
+{
+	// Small numbers take a single byte. Seven bits go in each byte, and the top bit says whether another byte follows.
+	FORCEINLINE void WriteVarint(TArray<uint8>& Out_Payload, uint32 Value)
+	{
+		while (Value >= 0x80)
+		{
+			Out_Payload.Add(static_cast<uint8>(Value | 0x80));
+			Value >>= 7;
+		}
+
+		Out_Payload.Add(static_cast<uint8>(Value));
+	}
+
+	// Maps signed numbers onto unsigned ones so that small negative deltas stay small: 0, -1, 1, -2, 2...
+	FORCEINLINE uint32 EncodeZigZag(int32 Value)
+	{
+		return (static_cast<uint32>(Value) << 1) ^ static_cast<uint32>(Value >> 31);
+	}
+
+	FORCEINLINE int32 DecodeZigZag(uint32 Value)
+	{
+		return static_cast<int32>(Value >> 1) ^ -static_cast<int32>(Value & 1);
+	}
+
+	FORCEINLINE void WriteFloat(TArray<uint8>& Out_Payload, float Value)
+	{
+		Out_Payload.Append(reinterpret_cast<const uint8*>(&Value), sizeof(float));
+	}
+
+	inline void WriteString(TArray<uint8>& Out_Payload, const FString& Value)
+	{
+		const FTCHARToUTF8 ValueAsUTF8(*Value);
+		WriteVarint(Out_Payload, ValueAsUTF8.Length());
+		Out_Payload.Append(reinterpret_cast<const uint8*>(ValueAsUTF8.Get()), ValueAsUTF8.Length());
+	}
+
+	// Reads everything above back out of a payload. Once anything reads past the end, every read after it fails too.
+	struct FReader
+	{
+		const TArray<uint8>& Payload;
+		int32 Offset = 0;
+		bool bIsValid = true;
+
+		explicit FReader(const TArray<uint8>& InPayload)
+			: Payload(InPayload)
+		{
+		}
+
+		bool IsAtEnd() const { return Offset >= Payload.Num(); }
+
+		uint32 ReadVarint()
+		{
+			uint32 Value = 0;
+
+			for (int32 Shift = 0; Shift < 35; Shift += 7)
+			{
+				if (!bIsValid || !Payload.IsValidIndex(Offset))
+				{
+					bIsValid = false;
+					return 0;
+				}
+
+				const uint8 ThisByte = Payload[Offset++];
+				Value |= static_cast<uint32>(ThisByte & 0x7F) << Shift;
+
+				if ((ThisByte & 0x80) == 0)
+				{
+					return Value;
+				}
+			}
+
+			bIsValid = false;
+			return 0;
+		}
+
+		int32 ReadZigZag() { return DecodeZigZag(ReadVarint()); }
+
+		// Counts are bounded by what is left of the payload, so a damaged one cannot ask for billions of anything.
+		int32 ReadCount() { return static_cast<int32>(FMath::Min<uint32>(ReadVarint(), Payload.Num() - Offset)); }
+
+		// Indices are stored plus one, so that INDEX_NONE is zero.
+		int32 ReadIndex() { return static_cast<int32>(ReadVarint()) - 1; }
+
+		uint8 ReadByte()
+		{
+			uint8 Value = 0;
+			ReadBytes(&Value, sizeof(Value));
+			return Value;
+		}
+
+		float ReadFloat()
+		{
+			float Value = 0.f;
+			ReadBytes(&Value, sizeof(Value));
+			return Value;
+		}
+
+		void ReadBytes(void* Out_Data, int32 NumberOfBytes)
+		{
+			if (!bIsValid || Offset + NumberOfBytes > Payload.Num())
+			{
+				bIsValid = false;
+				FMemory::Memzero(Out_Data, NumberOfBytes);
+				return;
+			}
+
+			FMemory::Memcpy(Out_Data, Payload.GetData() + Offset, NumberOfBytes);
+			Offset += NumberOfBytes;
+		}
+
+		FString ReadString()
+		{
+			const int32 Length = ReadCount();
+
+			if (!bIsValid || Length == 0)
+			{
+				return FString();
+			}
+
+			const FUTF8ToTCHAR ValueAsTCHAR(reinterpret_cast<const ANSICHAR*>(Payload.GetData() + Offset), Length);
+			Offset += Length;
+
+			return FString(ValueAsTCHAR.Length(), ValueAsTCHAR.Get());
+		}
+	};
+}
@@ -0,0 +1,191 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/Population/PGNRelationshipOracle.h"
+
+void FPGNPackedRelationship::Unpack(FPGNRelationship& Out_Relationship) const
+{
+	Out_Relationship.bHasSocialRelationship = bHasSocialRelationship;
+	Out_Relationship.SocialRelationship = static_cast<EPGNCharacterSocialRelationship>(SocialRelationship);
+	Out_Relationship.DistanceBetweenCharacters = DistanceBetweenCharacters;
+	Out_Relationship.bAreSpouses = bAreSpouses;
+}
+
+void FPGNRelationshipOracle::Reset(int32 InNumberOfCharacters)
+{
+	NumberOfCharacters = 0;
+	bIsDense = true;
+
+	DenseMatrix.Empty();
+	HashedPairs.Empty();
+
+	SetNumberOfCharacters(InNumberOfCharacters);
+}
+
+void FPGNRelationshipOracle::SetNumberOfCharacters(int32 InNumberOfCharacters)
+{
+	if (InNumberOfCharacters <= NumberOfCharacters)
+	{
+		return;
+	}
+
+	NumberOfCharacters = InNumberOfCharacters;
+
+	if (bIsDense && NumberOfCharacters > MAXIMUM_CHARACTERS_IN_DENSE_MATRIX)
+	{
+		MoveToHashedPairs();
+	}
+
+	if (bIsDense)
+	{
+		// The new rows start out as empty records, which means unrelated.
+		DenseMatrix.SetNumZeroed(static_cast<int32>(GetIndexInDenseMatrix(0, NumberOfCharacters)));
+	}
+}
+
+bool FPGNRelationshipOracle::FindRelationship(int32 IndexOfCharacterA, int32 IndexOfCharacterB,
+	FPGNRelationship& Out_Relationship) const
+{
+	Out_Relationship = FPGNRelationship();
+
+	if (!IsValidPair(IndexOfCharacterA, IndexOfCharacterB))
+	{
+		return false;
+	}
+
+	const FPGNPackedRelationship PackedRelationship = GetPackedRelationship(IndexOfCharacterA, IndexOfCharacterB);
+	PackedRelationship.Unpack(Out_Relationship);
+
+	return !PackedRelationship.IsEmpty();
+}
+
+void FPGNRelationshipOracle::SetSocialRelationship(int32 IndexOfCharacterA, int32 IndexOfCharacterB,
+	EPGNCharacterSocialRelationship SocialRelationship, int DistanceBetweenCharacters)
+{
+	if (!IsValidPair(IndexOfCharacterA, IndexOfCharacterB))
+	{
+		return;
+	}
+
+	FPGNPackedRelationship PackedRelationship = GetPackedRelationship(IndexOfCharacterA, IndexOfCharacterB);
+	PackedRelationship.bHasSocialRelationship = true;
+	PackedRelationship.SocialRelationship = static_cast<uint16>(SocialRelationship);
+	PackedRelationship.DistanceBetweenCharacters = FMath::Clamp(DistanceBetweenCharacters, 0, MAXIMUM_STORED_DISTANCE);
+
+	SetPackedRelationship(IndexOfCharacterA, IndexOfCharacterB, PackedRelationship);
+}
+
+void FPGNRelationshipOracle::RemoveSocialRelationship(int32 IndexOfCharacterA, int32 IndexOfCharacterB)
+{
+	if (!IsValidPair(IndexOfCharacterA, IndexOfCharacterB))
+	{
+		return;
+	}
+
+	FPGNPackedRelationship PackedRelationship = GetPackedRelationship(IndexOfCharacterA, IndexOfCharacterB);
+	PackedRelationship.bHasSocialRelationship = false;
+	PackedRelationship.SocialRelationship = 0;
+	PackedRelationship.DistanceBetweenCharacters = 0;
+
+	SetPackedRelationship(IndexOfCharacterA, IndexOfCharacterB, PackedRelationship);
+}
+
+void FPGNRelationshipOracle::SetAreSpouses(int32 IndexOfCharacterA, int32 IndexOfCharacterB, bool bAreSpouses)
+{
+	if (!IsValidPair(IndexOfCharacterA, IndexOfCharacterB))
+	{
+		return;
+	}
+
+	FPGNPackedRelationship PackedRelationship = GetPackedRelationship(IndexOfCharacterA, IndexOfCharacterB);
+	PackedRelationship.bAreSpouses = bAreSpouses;
+
+	SetPackedRelationship(IndexOfCharacterA, IndexOfCharacterB, PackedRelationship);
+}
+
+SIZE_T FPGNRelationshipOracle::GetAllocatedSize() const
+{
+	return DenseMatrix.GetAllocatedSize() + HashedPairs.GetAllocatedSize();
+}
+
+bool FPGNRelationshipOracle::IsValidPair(int32 IndexOfCharacterA, int32 IndexOfCharacterB) const
+{
+	return IndexOfCharacterA != IndexOfCharacterB
+		&& IndexOfCharacterA >= 0 && IndexOfCharacterA < NumberOfCharacters
+		&& IndexOfCharacterB >= 0 && IndexOfCharacterB < NumberOfCharacters;
+}
+
+FPGNPackedRelationship FPGNRelationshipOracle::GetPackedRelationship(int32 IndexOfCharacterA,
+	int32 IndexOfCharacterB) const
+{
+	if (bIsDense)
+	{
+		return DenseMatrix[static_cast<int32>(GetIndexInDenseMatrix(IndexOfCharacterA, IndexOfCharacterB))];
+	}
+
+	const FPGNPackedRelationship* PackedRelationship = HashedPairs.Find(GetPairKey(IndexOfCharacterA, IndexOfCharacterB));
+	return PackedRelationship != nullptr ? *PackedRelationship : FPGNPackedRelationship();
+}
+
+void FPGNRelationshipOracle::SetPackedRelationship(int32 IndexOfCharacterA, int32 IndexOfCharacterB,
+	FPGNPackedRelationship Relationship)
+{
+	if (bIsDense)
+	{
+		DenseMatrix[static_cast<int32>(GetIndexInDenseMatrix(IndexOfCharacterA, IndexOfCharacterB))] = Relationship;
+		return;
+	}
+
+	// Only related pairs are kept, otherwise the set would slowly fill up with empty records.
+	if (Relationship.IsEmpty())
+	{
+		HashedPairs.Remove(GetPairKey(IndexOfCharacterA, IndexOfCharacterB));
+	}
+	else
+	{
+		HashedPairs.Add(GetPairKey(IndexOfCharacterA, IndexOfCharacterB), Relationship);
+	}
+}
+
+int64 FPGNRelationshipOracle::GetIndexInDenseMatrix(int32 IndexOfCharacterA, int32 IndexOfCharacterB)
+{
+	const int64 SmallerIndex = FMath::Min(IndexOfCharacterA, IndexOfCharacterB);
+	const int64 LargerIndex = FMath::Max(IndexOfCharacterA, IndexOfCharacterB);
+
+	return LargerIndex * (LargerIndex - 1) / 2 + SmallerIndex;
+}
+
+uint64 FPGNRelationshipOracle::GetPairKey(int32 IndexOfCharacterA, int32 IndexOfCharacterB)
+{
+	return static_cast<uint64>(FMath::Min(IndexOfCharacterA, IndexOfCharacterB)) << 32
+		| static_cast<uint32>(FMath::Max(IndexOfCharacterA, IndexOfCharacterB));
+}
+
+void FPGNRelationshipOracle::MoveToHashedPairs()
+{
+	// We can only walk the rows that the matrix already has; any new characters have no relationships yet.
+	const int32 NumberOfRows = FMath::Min(NumberOfCharacters, MAXIMUM_CHARACTERS_IN_DENSE_MATRIX);
+
+	for (int32 IndexOfLargerCharacter = 1; IndexOfLargerCharacter < NumberOfRows; IndexOfLargerCharacter++)
+	{
+		const int32 StartOfRow = static_cast<int32>(GetIndexInDenseMatrix(0, IndexOfLargerCharacter));
+
+		if (StartOfRow >= DenseMatrix.Num())
+		{
+			break;
+		}
+
+		for (int32 IndexOfSmallerCharacter = 0; IndexOfSmallerCharacter < IndexOfLargerCharacter; IndexOfSmallerCharacter++)
+		{
+			const FPGNPackedRelationship& ThisRelationship = DenseMatrix[StartOfRow + IndexOfSmallerCharacter];
+
+			if (!ThisRelationship.IsEmpty())
+			{
+				HashedPairs.Add(GetPairKey(IndexOfSmallerCharacter, IndexOfLargerCharacter), ThisRelationship);
+			}
+		}
+	}
+
+	DenseMatrix.Empty();
+	bIsDense = false;
+}
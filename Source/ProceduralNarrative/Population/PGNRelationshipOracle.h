@@ -0,0 +1,100 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralNarrative/PGNUtilities.h"
+
+// Everything two characters are to each other, as returned by a single lookup.
+struct FPGNRelationship
+{
+	bool bHasSocialRelationship = false;
+	EPGNCharacterSocialRelationship SocialRelationship = EPGNCharacterSocialRelationship::NEIGHBORS;
+	int DistanceBetweenCharacters = 0;
+
+	bool bAreSpouses = false;
+
+	bool AreRelated() const { return bHasSocialRelationship || bAreSpouses; }
+};
+
+// The form a relationship is stored in by FPGNRelationshipOracle. A zero record means the pair is not related.
+struct FPGNPackedRelationship
+{
+	uint16 bHasSocialRelationship : 1;
+	uint16 bAreSpouses : 1;
+	uint16 SocialRelationship : 3;
+	uint16 DistanceBetweenCharacters : 11;
+
+	FPGNPackedRelationship()
+		: bHasSocialRelationship(0), bAreSpouses(0), SocialRelationship(0), DistanceBetweenCharacters(0)
+	{
+	}
+
+	bool IsEmpty() const { return !bHasSocialRelationship && !bAreSpouses; }
+
+	void Unpack(FPGNRelationship& Out_Relationship) const;
+};
+
+static_assert(sizeof(FPGNPackedRelationship) == 2, "FPGNPackedRelationship should stay one 16-bit word.");
+static_assert(static_cast<uint32>(EPGNCharacterSocialRelationship::ENEMIES) < (1u << 3),
+	"EPGNCharacterSocialRelationship no longer fits.");
+
+/**
+ * Answers how any two characters are related with a single probe, instead of searching through their social data.
+ *
+ * Small towns are stored as a dense lower-triangular matrix with one 2-byte record per pair, so a lookup is a single
+ * indexed read. Once the town grows past MAXIMUM_CHARACTERS_IN_DENSE_MATRIX, that matrix would be mostly empty, so
+ * the oracle moves to a hashed set of only the related pairs, keyed by the packed (min, max) pair of indices. The
+ * switch happens automatically, and only ever in that direction.
+ *
+ * The oracle is not the source of truth. The overseer updates it whenever it changes a relationship.
+ */
+class PROCEDURALNARRATIVE_API FPGNRelationshipOracle
+{
+public:
+
+	// 1024 characters is half a million pairs, or 1 MB of records.
+	static constexpr int32 MAXIMUM_CHARACTERS_IN_DENSE_MATRIX = 1024;
+
+	static constexpr int MAXIMUM_STORED_DISTANCE = (1 << 11) - 1;
+
+	// Forgets every relationship.
+	void Reset(int32 InNumberOfCharacters);
+
+	// New characters start out unrelated to everyone. The number of characters can only grow, since characters never
+	// move or leave AllCharacters.
+	void SetNumberOfCharacters(int32 InNumberOfCharacters);
+
+	int32 GetNumberOfCharacters() const { return NumberOfCharacters; }
+	bool IsDense() const { return bIsDense; }
+
+	// Returns false, and leaves Out_Relationship empty, if the two characters are not related at all.
+	bool FindRelationship(int32 IndexOfCharacterA, int32 IndexOfCharacterB, FPGNRelationship& Out_Relationship) const;
+
+	void SetSocialRelationship(int32 IndexOfCharacterA, int32 IndexOfCharacterB,
+		EPGNCharacterSocialRelationship SocialRelationship, int DistanceBetweenCharacters);
+	void RemoveSocialRelationship(int32 IndexOfCharacterA, int32 IndexOfCharacterB);
+
+	void SetAreSpouses(int32 IndexOfCharacterA, int32 IndexOfCharacterB, bool bAreSpouses);
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+
+	bool IsValidPair(int32 IndexOfCharacterA, int32 IndexOfCharacterB) const;
+
+	FPGNPackedRelationship GetPackedRelationship(int32 IndexOfCharacterA, int32 IndexOfCharacterB) const;
+	void SetPackedRelationship(int32 IndexOfCharacterA, int32 IndexOfCharacterB, FPGNPackedRelationship Relationship);
+
+	// Row b of the triangle holds the pairs (0, b) to (b - 1, b), so adding a character only appends a row.
+	static int64 GetIndexInDenseMatrix(int32 IndexOfCharacterA, int32 IndexOfCharacterB);
+	static uint64 GetPairKey(int32 IndexOfCharacterA, int32 IndexOfCharacterB);
+
+	void MoveToHashedPairs();
+
+	int32 NumberOfCharacters = 0;
+	bool bIsDense = true;
+
+	TArray<FPGNPackedRelationship> DenseMatrix;
+	TMap<uint64, FPGNPackedRelationship> HashedPairs;
+};
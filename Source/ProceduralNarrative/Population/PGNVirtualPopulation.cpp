@@ -0,0 +1,364 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/Population/PGNVirtualPopulation.h"
+
+#include "ProceduralNarrative/DataAssets/PGNCharacterDataAsset.h"
+#include "ProceduralNarrative/Graphs/CharacterGraph.h"
+#include "ProceduralNarrative/Memory/PGNMemoryTracking.h"
+#include "ProceduralNarrative/PGNHash.h"
+
+FPGNVirtualPopulation::FPGNVirtualPopulation()
+{
+}
+
+bool FPGNVirtualPopulation::Initialize(const UPGNCharacterDataAsset* InCharacterDataAsset,
+	const FPGNAliasTable& InGenerationAliasTable, const TArray<int>& InTemplateAllocationOrder, int32 InWorldSeed,
+	int32 InNumberOfCharacters, float AverageNumberOfSocialPartners, int32 NumberOfCharactersToCache)
+{
+	Reset();
+
+	if (InCharacterDataAsset == nullptr || InCharacterDataAsset->AllCharacterTemplates.Num() == 0
+		|| InTemplateAllocationOrder.Num() == 0 || InGenerationAliasTable.IsEmpty())
+	{
+		UE_LOG(LogTemp, Error, TEXT("The virtual population needs a Character Data Asset with templates and demographics."));
+		return false;
+	}
+
+	CharacterDataAsset = InCharacterDataAsset;
+	GenerationAliasTable = InGenerationAliasTable;
+	TemplateAllocationOrder = InTemplateAllocationOrder;
+
+	WorldSeed = InWorldSeed;
+	NumberOfCharacters = FMath::Max(InNumberOfCharacters, 0);
+
+	// Every character has 2 * NEIGHBOURHOOD_RADIUS people around them who they could know.
+	ThresholdForSocialEdgeCreation = FMath::Clamp(AverageNumberOfSocialPartners / (2 * NEIGHBOURHOOD_RADIUS), 0.f, 1.f);
+
+	MaterializedCharacters.Empty(FMath::Max(NumberOfCharactersToCache, 1));
+
+	return true;
+}
+
+void FPGNVirtualPopulation::Reset()
+{
+	CharacterDataAsset = nullptr;
+	GenerationAliasTable = FPGNAliasTable();
+	TemplateAllocationOrder.Reset();
+
+	WorldSeed = 0;
+	NumberOfCharacters = 0;
+	ThresholdForSocialEdgeCreation = 0.f;
+
+	MaterializedCharacters.Empty();
+}
+
+void FPGNVirtualPopulation::EmptyCache()
+{
+	MaterializedCharacters.Empty(MaterializedCharacters.Max());
+}
+
+SIZE_T FPGNVirtualPopulation::GetAllocatedSize() const
+{
+	return GenerationAliasTable.Probabilities.GetAllocatedSize() + GenerationAliasTable.Aliases.GetAllocatedSize()
+		+ TemplateAllocationOrder.GetAllocatedSize()
+		+ FPGNMemoryTracking::GetAllocatedSizeOfLruCache(MaterializedCharacters, &FPGNMemoryTracking::GetAllocatedSizeOfCharacter);
+}
+
+const FPGNCharacter* FPGNVirtualPopulation::GetCharacter(int32 IndexOfCharacter)
+{
+	if (!IsInitialized() || !IsValidIndex(IndexOfCharacter))
+	{
+		return nullptr;
+	}
+
+	if (const FPGNCharacter* CachedCharacter = MaterializedCharacters.FindAndTouch(IndexOfCharacter))
+	{
+		return CachedCharacter;
+	}
+
+	FPGNCharacter NewCharacter;
+	MaterializeCharacter(IndexOfCharacter, NewCharacter);
+
+	// If the cache is full, this evicts whoever was used the longest time ago.
+	MaterializedCharacters.Add(IndexOfCharacter, NewCharacter);
+
+	return MaterializedCharacters.FindAndTouch(IndexOfCharacter);
+}
+
+void FPGNVirtualPopulation::MaterializeCastAndTheirSocialPartners(TArrayView<const int32> AllIndicesOfCast)
+{
+	TArray<int32> AllIndicesToMaterialize;
+
+	for (const int32 IndexOfCastMember : AllIndicesOfCast)
+	{
+		const FPGNCharacter* ThisCastMember = GetCharacter(IndexOfCastMember);
+
+		if (ThisCastMember == nullptr)
+		{
+			continue;
+		}
+
+		// We copy the indices out first, since materialising anyone else can evict this cast member.
+		if (ThisCastMember->MyRomanticData.IndexOfRomanticPartner != INDEX_NONE)
+		{
+			AllIndicesToMaterialize.Add(ThisCastMember->MyRomanticData.IndexOfRomanticPartner);
+		}
+
+		for (const FPGNCharacterSocialData& ThisSocialData : ThisCastMember->AllMySocialData)
+		{
+			AllIndicesToMaterialize.Add(ThisSocialData.IndexOfSocialPartner);
+		}
+	}
+
+	if (AllIndicesOfCast.Num() + AllIndicesToMaterialize.Num() > MaterializedCharacters.Max())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("The cast and their social partners (%d characters) do not fit in the cache of %d characters."),
+			AllIndicesOfCast.Num() + AllIndicesToMaterialize.Num(), MaterializedCharacters.Max());
+	}
+
+	for (const int32 IndexOfSocialPartner : AllIndicesToMaterialize)
+	{
+		GetCharacter(IndexOfSocialPartner);
+	}
+
+	// The cast is touched last, so they are the last ones to be evicted.
+	for (const int32 IndexOfCastMember : AllIndicesOfCast)
+	{
+		GetCharacter(IndexOfCastMember);
+	}
+}
+
+bool FPGNVirtualPopulation::MaterializeCharacter(int32 IndexOfCharacter, FPGNCharacter& Out_Character) const
+{
+	if (!IsInitialized() || !IsValidIndex(IndexOfCharacter))
+	{
+		return false;
+	}
+
+	MaterializeIdentity(IndexOfCharacter, Out_Character);
+
+	const int32 IndexOfSpouse = GetSpouseOfCharacter(IndexOfCharacter);
+
+	if (IndexOfSpouse != INDEX_NONE)
+	{
+		FPGNCharacter Spouse;
+		MaterializeIdentity(IndexOfSpouse, Spouse);
+
+		Out_Character.MyRomanticData.NameOfRomanticPartner = Spouse.Name;
+		Out_Character.MyRomanticData.IndexOfRomanticPartner = IndexOfSpouse;
+		Out_Character.bFoundValidMarriagePartner = true;
+	}
+
+	TArray<FPGNVirtualSocialEdge> AllSocialEdges;
+	GetSocialEdgesOfCharacter(IndexOfCharacter, AllSocialEdges);
+
+	Out_Character.AllMySocialData.Reserve(AllSocialEdges.Num());
+
+	for (const FPGNVirtualSocialEdge& ThisSocialEdge : AllSocialEdges)
+	{
+		FPGNCharacter SocialPartner;
+		MaterializeIdentity(ThisSocialEdge.IndexOfSocialPartner, SocialPartner);
+
+		// This is the same mapping from distance to relationship that the overseer uses for its character graph.
+		const float PercentageOfMaxDistance = static_cast<float>(ThisSocialEdge.DistanceBetweenCharacters) /
+			CharacterDataAsset->MaximumDistanceBetweenCharactersInSingleEdge;
+
+		FPGNCharacterSocialData NewSocialData;
+		NewSocialData.NameOfSocialPartner = SocialPartner.Name;
+		NewSocialData.IndexOfSocialPartner = ThisSocialEdge.IndexOfSocialPartner;
+		NewSocialData.SocialRelationship = CharacterDataAsset->DetermineSocialRelationshipFromPercentage(
+			PercentageOfMaxDistance);
+
+		Out_Character.AllMySocialData.Add(NewSocialData);
+	}
+
+	return true;
+}
+
+void FPGNVirtualPopulation::GetSocialEdgesOfCharacter(int32 IndexOfCharacter,
+	TArray<FPGNVirtualSocialEdge>& Out_AllSocialEdges) const
+{
+	Out_AllSocialEdges.Reset();
+
+	if (!IsInitialized() || !IsValidIndex(IndexOfCharacter))
+	{
+		return;
+	}
+
+	const int32 FirstIndexInNeighbourhood = FMath::Max(IndexOfCharacter - NEIGHBOURHOOD_RADIUS, 0);
+	const int32 LastIndexInNeighbourhood = FMath::Min(IndexOfCharacter + NEIGHBOURHOOD_RADIUS, NumberOfCharacters - 1);
+
+	for (int32 Index_Character = FirstIndexInNeighbourhood; Index_Character <= LastIndexInNeighbourhood; Index_Character++)
+	{
+		if (Index_Character == IndexOfCharacter)
+		{
+			continue;
+		}
+
+		const float ProbabilityOfEdgeCreation = GetRollForSocialEdge(IndexOfCharacter, Index_Character);
+
+		if (ProbabilityOfEdgeCreation >= ThresholdForSocialEdgeCreation)
+		{
+			continue;
+		}
+
+		FPGNVirtualSocialEdge NewSocialEdge;
+		NewSocialEdge.IndexOfSocialPartner = Index_Character;
+		NewSocialEdge.DistanceBetweenCharacters = UCharacterGraph::CalculateDistanceFromEdgeProbability(
+			ProbabilityOfEdgeCreation, ThresholdForSocialEdgeCreation,
+			CharacterDataAsset->MaximumDistanceBetweenCharactersInSingleEdge);
+
+		Out_AllSocialEdges.Add(NewSocialEdge);
+	}
+}
+
+int32 FPGNVirtualPopulation::GetSpouseOfCharacter(int32 IndexOfCharacter) const
+{
+	if (!IsInitialized() || !IsValidIndex(IndexOfCharacter) || !IsHouseholdMarried(IndexOfCharacter / 2))
+	{
+		return INDEX_NONE;
+	}
+
+	// The other member of the household.
+	return IndexOfCharacter ^ 1;
+}
+
+bool FPGNVirtualPopulation::FindRelationship(int32 IndexOfCharacterA, int32 IndexOfCharacterB,
+	FPGNRelationship& Out_Relationship) const
+{
+	Out_Relationship = FPGNRelationship();
+
+	if (!IsValidIndex(IndexOfCharacterA) || !IsValidIndex(IndexOfCharacterB) || IndexOfCharacterA == IndexOfCharacterB)
+	{
+		return false;
+	}
+
+	Out_Relationship.bAreSpouses = GetSpouseOfCharacter(IndexOfCharacterA) == IndexOfCharacterB;
+
+	if (FMath::Abs(IndexOfCharacterA - IndexOfCharacterB) <= NEIGHBOURHOOD_RADIUS)
+	{
+		const float ProbabilityOfEdgeCreation = GetRollForSocialEdge(IndexOfCharacterA, IndexOfCharacterB);
+
+		if (ProbabilityOfEdgeCreation < ThresholdForSocialEdgeCreation)
+		{
+			const int MaximumDistance = CharacterDataAsset->MaximumDistanceBetweenCharactersInSingleEdge;
+
+			Out_Relationship.bHasSocialRelationship = true;
+			Out_Relationship.DistanceBetweenCharacters = UCharacterGraph::CalculateDistanceFromEdgeProbability(
+				ProbabilityOfEdgeCreation, ThresholdForSocialEdgeCreation, MaximumDistance);
+			Out_Relationship.SocialRelationship = CharacterDataAsset->DetermineSocialRelationshipFromPercentage(
+				static_cast<float>(Out_Relationship.DistanceBetweenCharacters) / MaximumDistance);
+		}
+	}
+
+	return Out_Relationship.AreRelated();
+}
+
+FRandomStream FPGNVirtualPopulation::CreateRandomStream(uint64 Key, ERandomStreamPurpose Purpose) const
+{
+	// Neighbouring keys come out completely unrelated, which is what lets consecutive character indices seed
+	// independent random streams.
+	const uint64 SeedForPurpose = PGNHash::MixBits(static_cast<uint64>(static_cast<uint32>(WorldSeed))
+		| static_cast<uint64>(Purpose) << 32);
+	const uint64 Hash = PGNHash::MixBits(SeedForPurpose ^ Key);
+
+	return FRandomStream(static_cast<int32>(Hash ^ (Hash >> 32)));
+}
+
+float FPGNVirtualPopulation::GetRollForSocialEdge(int32 IndexOfCharacterA, int32 IndexOfCharacterB) const
+{
+	const uint64 KeyForPair = static_cast<uint64>(FMath::Min(IndexOfCharacterA, IndexOfCharacterB)) << 32
+		| static_cast<uint32>(FMath::Max(IndexOfCharacterA, IndexOfCharacterB));
+
+	return CreateRandomStream(KeyForPair, ERandomStreamPurpose::SocialEdge).GetFraction();
+}
+
+bool FPGNVirtualPopulation::IsHouseholdMarried(int32 IndexOfHousehold) const
+{
+	// The last character is on their own if the population is odd, so they cannot be married.
+	if (IndexOfHousehold * 2 + 1 >= NumberOfCharacters)
+	{
+		return false;
+	}
+
+	FRandomStream HouseholdStream = CreateRandomStream(IndexOfHousehold, ERandomStreamPurpose::Household);
+	return HouseholdStream.GetFraction() <= CharacterDataAsset->PercentageOfCharactersWhoAreMarried;
+}
+
+void FPGNVirtualPopulation::MaterializeIdentity(int32 IndexOfCharacter, FPGNCharacter& Out_Character) const
+{
+	FRandomStream CharacterStream = CreateRandomStream(IndexOfCharacter, ERandomStreamPurpose::Character);
+
+	// The templates are handed out in turn from least used to most used, which keeps them as evenly spread as the
+	// overseer's allocation heap does.
+	const int IndexOfTemplate = TemplateAllocationOrder[IndexOfCharacter % TemplateAllocationOrder.Num()];
+	Out_Character.MyCharacterTemplate = CharacterDataAsset->AllCharacterTemplates[IndexOfTemplate];
+
+	const float PercentageOfCharactersWhoAreMarried = CharacterDataAsset->PercentageOfCharactersWhoAreMarried;
+	int32 IndexOfDemographic;
+
+	if (IsHouseholdMarried(IndexOfCharacter / 2))
+	{
+		// The household decides the generation and who is the husband, so that both spouses agree on them. The first
+		// roll from its stream is the one that decided the marriage.
+		FRandomStream HouseholdStream = CreateRandomStream(IndexOfCharacter / 2, ERandomStreamPurpose::Household);
+		HouseholdStream.GetFraction();
+
+		IndexOfDemographic = SampleDemographic(HouseholdStream);
+
+		const bool bIsFirstMemberOfHouseholdMale = HouseholdStream.GetFraction() < CharacterDataAsset->PercentageOfMaleCharacters;
+		Out_Character.bIsMale = IndexOfCharacter % 2 == 0 ? bIsFirstMemberOfHouseholdMale : !bIsFirstMemberOfHouseholdMale;
+
+		Out_Character.MyRomanticData.RomanticRelationship = EPGNCharacterRomanticRelationship::MARRIED;
+	}
+	else
+	{
+		Out_Character.bIsMale = CharacterStream.GetFraction() < CharacterDataAsset->PercentageOfMaleCharacters;
+		IndexOfDemographic = SampleDemographic(CharacterStream);
+
+		// Marriage was already ruled out by the household, so we only roll across the rest of the interval.
+		const float GeneratedChance = PercentageOfCharactersWhoAreMarried
+			+ CharacterStream.GetFraction() * (1.f - PercentageOfCharactersWhoAreMarried);
+
+		const EPGNCharacterRomanticRelationship RomanticRelationship =
+			CharacterDataAsset->DetermineRomanticRelationshipFromPercentage(GeneratedChance);
+
+		Out_Character.MyRomanticData.RomanticRelationship = RomanticRelationship == EPGNCharacterRomanticRelationship::MARRIED
+			? EPGNCharacterRomanticRelationship::SINGLE : RomanticRelationship;
+	}
+
+	AssignAgeAndName(IndexOfDemographic, CharacterStream, Out_Character);
+}
+
+int32 FPGNVirtualPopulation::SampleDemographic(FRandomStream& RandomStream) const
+{
+	const float RandomColumn = RandomStream.GetFraction();
+	const float RandomCoinFlip = RandomStream.GetFraction();
+
+	return GenerationAliasTable.Sample(RandomColumn, RandomCoinFlip);
+}
+
+void FPGNVirtualPopulation::AssignAgeAndName(int32 IndexOfDemographic, FRandomStream& RandomStream,
+	FPGNCharacter& Out_Character) const
+{
+	if (!CharacterDataAsset->AllDemographicParameters.IsValidIndex(IndexOfDemographic))
+	{
+		Out_Character.Generation = EPGNCharacterGeneration::GENERATION_Z;
+		return;
+	}
+
+	const FPGNCharacterDemographicParameters& ThisDemographic = CharacterDataAsset->AllDemographicParameters[
+		IndexOfDemographic];
+
+	Out_Character.Generation = ThisDemographic.Generation;
+	Out_Character.Age = RandomStream.RandRange(ThisDemographic.MinimumAge, ThisDemographic.MaximumAge);
+
+	const TArray<FString>& PoolOfPossibleNames = Out_Character.bIsMale ? ThisDemographic.AllPossibleMaleNames
+		: ThisDemographic.AllPossibleFemaleNames;
+
+	if (PoolOfPossibleNames.Num() > 0)
+	{
+		Out_Character.Name = PoolOfPossibleNames[RandomStream.RandRange(0, PoolOfPossibleNames.Num() - 1)];
+	}
+}
@@ -0,0 +1,120 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/LruCache.h"
+#include "ProceduralNarrative/PGNUtilities.h"
+#include "ProceduralNarrative/Generation/PGNAliasTable.h"
+#include "ProceduralNarrative/Population/PGNRelationshipOracle.h"
+
+class UPGNCharacterDataAsset;
+
+// A social relationship in a virtual population, as seen from one of the two characters in it.
+struct FPGNVirtualSocialEdge
+{
+	int32 IndexOfSocialPartner = INDEX_NONE;
+	int DistanceBetweenCharacters = 0;
+};
+
+/**
+ * A town of any size whose characters are only created when something needs them.
+ *
+ * Everything about a character (gender, generation, age, template, name and relationships) comes from a hash of the
+ * world seed and the character's index, so the same index always gives the same character and nothing has to be
+ * stored for the characters that are not in use. The characters that are materialised are kept in a least recently
+ * used cache, so memory grows with the active cast instead of with the size of the town.
+ *
+ * Relationships are derived the same way:
+ *
+ *	Marriage		Characters 2k and 2k + 1 share a household. A household is married with the data asset's percentage
+ *					of married characters, in which case its two members share a generation and are of opposite genders.
+ *	Social edges	Characters only know people who live within NEIGHBOURHOOD_RADIUS indices of them, like the houses
+ *					along a street. Whether each of those pairs is connected is rolled from a hash of the pair, so both
+ *					characters always agree on it.
+ */
+class PROCEDURALNARRATIVE_API FPGNVirtualPopulation
+{
+public:
+
+	static constexpr int32 NEIGHBOURHOOD_RADIUS = 32;
+
+	FPGNVirtualPopulation();
+
+	FPGNVirtualPopulation(const FPGNVirtualPopulation&) = delete;
+	FPGNVirtualPopulation& operator=(const FPGNVirtualPopulation&) = delete;
+
+	/*
+	 * The data asset must outlive the population. AverageNumberOfSocialPartners is how many people each character
+	 * knows on average; it is capped at everyone in their neighbourhood.
+	 */
+	bool Initialize(const UPGNCharacterDataAsset* InCharacterDataAsset, const FPGNAliasTable& InGenerationAliasTable,
+		const TArray<int>& InTemplateAllocationOrder, int32 InWorldSeed, int32 InNumberOfCharacters,
+		float AverageNumberOfSocialPartners, int32 NumberOfCharactersToCache);
+
+	void Reset();
+
+	bool IsInitialized() const { return CharacterDataAsset != nullptr; }
+
+	int32 Num() const { return NumberOfCharacters; }
+	bool IsValidIndex(int32 IndexOfCharacter) const { return IndexOfCharacter >= 0 && IndexOfCharacter < NumberOfCharacters; }
+
+	int32 GetWorldSeed() const { return WorldSeed; }
+
+	// Returns the cached character, materialising it first if it is not cached. The pointer is only valid until the
+	// next character is materialised, since that can evict this one. Null if the index is not in the population.
+	const FPGNCharacter* GetCharacter(int32 IndexOfCharacter);
+
+	// Builds this character from scratch, including their relationships, without touching the cache.
+	bool MaterializeCharacter(int32 IndexOfCharacter, FPGNCharacter& Out_Character) const;
+
+	// Makes sure that this cast, and everyone they know, is in the cache before a narrative is generated with them.
+	void MaterializeCastAndTheirSocialPartners(TArrayView<const int32> AllIndicesOfCast);
+
+	// Every social relationship this character has, in order of the index of their partner.
+	void GetSocialEdgesOfCharacter(int32 IndexOfCharacter, TArray<FPGNVirtualSocialEdge>& Out_AllSocialEdges) const;
+
+	// INDEX_NONE if the character is not married.
+	int32 GetSpouseOfCharacter(int32 IndexOfCharacter) const;
+
+	// Works out how two characters are related from their hashes alone, without materialising either of them.
+	bool FindRelationship(int32 IndexOfCharacterA, int32 IndexOfCharacterB, FPGNRelationship& Out_Relationship) const;
+
+	int32 GetNumberOfCachedCharacters() const { return MaterializedCharacters.Num(); }
+	void EmptyCache();
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+
+	// Each of these draws from its own hash, so adding a roll to one never changes the results of another.
+	enum class ERandomStreamPurpose : uint32
+	{
+		Character,
+		Household,
+		SocialEdge
+	};
+
+	FRandomStream CreateRandomStream(uint64 Key, ERandomStreamPurpose Purpose) const;
+
+	// A number in [0, 1) that only depends on the world seed and the pair, whichever way round it is given.
+	float GetRollForSocialEdge(int32 IndexOfCharacterA, int32 IndexOfCharacterB) const;
+
+	bool IsHouseholdMarried(int32 IndexOfHousehold) const;
+
+	// Everything except the relationships, which need the names of the other characters.
+	void MaterializeIdentity(int32 IndexOfCharacter, FPGNCharacter& Out_Character) const;
+
+	int32 SampleDemographic(FRandomStream& RandomStream) const;
+	void AssignAgeAndName(int32 IndexOfDemographic, FRandomStream& RandomStream, FPGNCharacter& Out_Character) const;
+
+	const UPGNCharacterDataAsset* CharacterDataAsset = nullptr;
+	FPGNAliasTable GenerationAliasTable;
+	TArray<int> TemplateAllocationOrder;
+
+	int32 WorldSeed = 0;
+	int32 NumberOfCharacters = 0;
+	float ThresholdForSocialEdgeCreation = 0.f;
+
+	TLruCache<int32, FPGNCharacter> MaterializedCharacters;
+};
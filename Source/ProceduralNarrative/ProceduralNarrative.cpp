@@ -2,6 +2,17 @@
 
 #include "ProceduralNarrative.h"
 #include "Modules/ModuleManager.h"
+#include "Memory/PGNMemoryTracking.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, ProceduralNarrative, "ProceduralNarrative" );
- 
\ No newline at end of file
+class FProceduralNarrativeModule : public FDefaultGameModuleImpl
+{
+public:
+
+	virtual void StartupModule() override
+	{
+		// The tags have to be registered before anything is allocated under them.
+		FPGNMemoryTracking::RegisterLowLevelMemoryTags();
+	}
+};
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FProceduralNarrativeModule, ProceduralNarrative, "ProceduralNarrative" );
@@ -0,0 +1,146 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/Requests/PGNNarrativeRequest.h"
+
+FPGNNarrativeRequestId FPGNNarrativeRequestQueue::Add(const FPGNNarrativeRequestConstraints& Constraints,
+	double CurrentTime, TFunction<void(const FPGNNarrativeRequestResult&)> OnCompleted,
+	TFuture<FPGNNarrativeRequestResult>* Out_Future)
+{
+	FPGNPendingNarrativeRequest& NewRequest = AllPendingRequests.AddDefaulted_GetRef();
+	NewRequest.RequestId = NextRequestId;
+	NewRequest.Constraints = Constraints;
+	NewRequest.TimeRequested = CurrentTime;
+	NewRequest.OnCompleted = MoveTemp(OnCompleted);
+
+	if (Out_Future != nullptr)
+	{
+		NewRequest.Promise = MakeShared<TPromise<FPGNNarrativeRequestResult>>();
+		*Out_Future = NewRequest.Promise->GetFuture();
+	}
+
+	// Zero is never handed out, since it stands for "no request".
+	NextRequestId = NextRequestId == MAX_uint32 ? INVALID_PGN_NARRATIVE_REQUEST_ID + 1 : NextRequestId + 1;
+
+	return NewRequest.RequestId;
+}
+
+bool FPGNNarrativeRequestQueue::Cancel(FPGNNarrativeRequestId RequestId)
+{
+	const int32 IndexOfRequest = AllPendingRequests.IndexOfByPredicate([RequestId](const FPGNPendingNarrativeRequest& ThisRequest)
+	{
+		return ThisRequest.RequestId == RequestId;
+	});
+
+	if (IndexOfRequest == INDEX_NONE)
+	{
+		return false;
+	}
+
+	// The request is taken out first, in case whoever made it asks for another one straight away.
+	FPGNPendingNarrativeRequest CancelledRequest = MoveTemp(AllPendingRequests[IndexOfRequest]);
+	AllPendingRequests.RemoveAt(IndexOfRequest);
+
+	FPGNNarrativeRequestResult Result;
+	Result.Status = EPGNNarrativeRequestStatus::CANCELLED;
+	Complete(CancelledRequest, Result);
+
+	return true;
+}
+
+void FPGNNarrativeRequestQueue::CancelAll()
+{
+	TArray<FPGNPendingNarrativeRequest> AllCancelledRequests = MoveTemp(AllPendingRequests);
+	AllPendingRequests.Reset();
+
+	FPGNNarrativeRequestResult Result;
+	Result.Status = EPGNNarrativeRequestStatus::CANCELLED;
+
+	for (FPGNPendingNarrativeRequest& ThisRequest : AllCancelledRequests)
+	{
+		Complete(ThisRequest, Result);
+	}
+}
+
+void FPGNNarrativeRequestQueue::ExpireRequests(double CurrentTime)
+{
+	TArray<FPGNPendingNarrativeRequest> AllExpiredRequests;
+
+	for (int32 Index_Request = AllPendingRequests.Num() - 1; Index_Request >= 0; Index_Request--)
+	{
+		const FPGNPendingNarrativeRequest& ThisRequest = AllPendingRequests[Index_Request];
+
+		if (ThisRequest.Constraints.DeadlineInSeconds > 0.f
+			&& CurrentTime - ThisRequest.TimeRequested > ThisRequest.Constraints.DeadlineInSeconds)
+		{
+			AllExpiredRequests.Add(MoveTemp(AllPendingRequests[Index_Request]));
+			AllPendingRequests.RemoveAt(Index_Request);
+		}
+	}
+
+	FPGNNarrativeRequestResult Result;
+	Result.Status = EPGNNarrativeRequestStatus::TIMED_OUT;
+
+	for (FPGNPendingNarrativeRequest& ThisRequest : AllExpiredRequests)
+	{
+		Complete(ThisRequest, Result);
+	}
+}
+
+bool FPGNNarrativeRequestQueue::TakeMostUrgentRequests(double CurrentTime,
+	FPGNNarrativeRequestConstraints& Out_Constraints, TArray<FPGNPendingNarrativeRequest>& Out_AllRequests)
+{
+	Out_AllRequests.Reset();
+
+	if (AllPendingRequests.Num() == 0)
+	{
+		return false;
+	}
+
+	// Requests are in the order they came in, so only a strictly more urgent one can take the place of an older one.
+	int32 IndexOfMostUrgentRequest = INDEX_NONE;
+	double HighestUrgency = 0.0;
+
+	for (int32 Index_Request = 0; Index_Request < AllPendingRequests.Num(); Index_Request++)
+	{
+		const FPGNPendingNarrativeRequest& ThisRequest = AllPendingRequests[Index_Request];
+		const double Urgency = ThisRequest.Constraints.Priority
+			+ (CurrentTime - ThisRequest.TimeRequested) * PRIORITY_GAINED_PER_SECOND_WAITED;
+
+		if (IndexOfMostUrgentRequest == INDEX_NONE || Urgency > HighestUrgency)
+		{
+			IndexOfMostUrgentRequest = Index_Request;
+			HighestUrgency = Urgency;
+		}
+	}
+
+	Out_Constraints = AllPendingRequests[IndexOfMostUrgentRequest].Constraints;
+
+	for (int32 Index_Request = 0; Index_Request < AllPendingRequests.Num(); Index_Request++)
+	{
+		if (AllPendingRequests[Index_Request].Constraints.CanShareNarrativeWith(Out_Constraints))
+		{
+			Out_AllRequests.Add(MoveTemp(AllPendingRequests[Index_Request]));
+			AllPendingRequests.RemoveAt(Index_Request);
+			Index_Request--;
+		}
+	}
+
+	return true;
+}
+
+void FPGNNarrativeRequestQueue::Complete(FPGNPendingNarrativeRequest& ThisRequest,
+	const FPGNNarrativeRequestResult& Result)
+{
+	if (ThisRequest.Promise.IsValid())
+	{
+		ThisRequest.Promise->SetValue(Result);
+		ThisRequest.Promise.Reset();
+	}
+
+	if (ThisRequest.OnCompleted)
+	{
+		ThisRequest.OnCompleted(Result);
+		ThisRequest.OnCompleted = nullptr;
+	}
+}
@@ -0,0 +1,130 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "ProceduralNarrative/PGNUtilities.h"
+#include "PGNNarrativeRequest.generated.h"
+
+// What gameplay wants from the narrative it is asking for.
+USTRUCT(BlueprintType)
+struct FPGNNarrativeRequestConstraints
+{
+	GENERATED_BODY()
+
+	// An empty list allows anything.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Constraints")
+	TArray<EPGNMood> AllAllowedConclusionMoods;
+
+	// An empty list allows anything.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Constraints")
+	TArray<EPGNEventAction> AllAllowedConclusionActions;
+
+	// Higher priorities are served first. Waiting requests gain priority over time, so that none of them starve.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scheduling")
+	int32 Priority = 0;
+
+	// How long the request may wait before it times out. Zero or less waits for as long as it takes.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Scheduling")
+	float DeadlineInSeconds = 0.f;
+
+	bool AllowsAnyConclusionEvent() const
+	{
+		return AllAllowedConclusionMoods.Num() == 0 && AllAllowedConclusionActions.Num() == 0;
+	}
+
+	bool AllowsThisConclusionEvent(const FPGNEvent& ConclusionEvent) const
+	{
+		return (AllAllowedConclusionMoods.Num() == 0 || AllAllowedConclusionMoods.Contains(ConclusionEvent.Mood))
+			&& (AllAllowedConclusionActions.Num() == 0 || AllAllowedConclusionActions.Contains(ConclusionEvent.Action));
+	}
+
+	// Requests that would be happy with the same narrative can share it, whatever their scheduling.
+	bool CanShareNarrativeWith(const FPGNNarrativeRequestConstraints& Other) const
+	{
+		return AllAllowedConclusionMoods == Other.AllAllowedConclusionMoods
+			&& AllAllowedConclusionActions == Other.AllAllowedConclusionActions;
+	}
+};
+
+UENUM(BlueprintType)
+enum class EPGNNarrativeRequestStatus : uint8
+{
+	FULFILLED,
+	CANCELLED,
+	TIMED_OUT,
+	// No narrative could meet the constraints, or the overseer could not generate at all.
+	FAILED
+};
+
+USTRUCT(BlueprintType)
+struct FPGNNarrativeRequestResult
+{
+	GENERATED_BODY()
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Result")
+	EPGNNarrativeRequestStatus Status = EPGNNarrativeRequestStatus::FAILED;
+
+	// Only set if the request was fulfilled.
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Result")
+	FPGNGeneratedNarrative Narrative;
+};
+
+using FPGNNarrativeRequestId = uint32;
+
+static constexpr FPGNNarrativeRequestId INVALID_PGN_NARRATIVE_REQUEST_ID = 0;
+
+// A request that is waiting to be served. Whoever made it hears back through the promise, the callback, or both.
+struct FPGNPendingNarrativeRequest
+{
+	FPGNNarrativeRequestId RequestId = INVALID_PGN_NARRATIVE_REQUEST_ID;
+	FPGNNarrativeRequestConstraints Constraints;
+	double TimeRequested = 0.0;
+
+	TSharedPtr<TPromise<FPGNNarrativeRequestResult>> Promise;
+	TFunction<void(const FPGNNarrativeRequestResult&)> OnCompleted;
+};
+
+/**
+ * The narrative requests that are waiting to be served, in the order they should be.
+ *
+ * The most urgent request is the one with the highest priority once the time it has waited is added to it, at
+ * PRIORITY_GAINED_PER_SECOND_WAITED, with older requests winning ties. Whenever it is taken, every other waiting
+ * request that can share its narrative is taken with it, so that asking for the same story from several places at
+ * once only generates it once.
+ *
+ * This only schedules. It is up to the owner to generate a narrative for each group it takes and to complete them.
+ */
+class PROCEDURALNARRATIVE_API FPGNNarrativeRequestQueue
+{
+public:
+
+	static constexpr double PRIORITY_GAINED_PER_SECOND_WAITED = 1.0;
+
+	FPGNNarrativeRequestId Add(const FPGNNarrativeRequestConstraints& Constraints, double CurrentTime,
+		TFunction<void(const FPGNNarrativeRequestResult&)> OnCompleted, TFuture<FPGNNarrativeRequestResult>* Out_Future);
+
+	// Completes the request as cancelled. Returns false if it is not waiting any more.
+	bool Cancel(FPGNNarrativeRequestId RequestId);
+	void CancelAll();
+
+	// Completes every request whose deadline has passed as timed out.
+	void ExpireRequests(double CurrentTime);
+
+	// Takes the most urgent request and every request that can share a narrative with it. Returns false if nothing
+	// is waiting.
+	bool TakeMostUrgentRequests(double CurrentTime, FPGNNarrativeRequestConstraints& Out_Constraints,
+		TArray<FPGNPendingNarrativeRequest>& Out_AllRequests);
+
+	static void Complete(FPGNPendingNarrativeRequest& ThisRequest, const FPGNNarrativeRequestResult& Result);
+
+	int32 Num() const { return AllPendingRequests.Num(); }
+	bool IsEmpty() const { return AllPendingRequests.Num() == 0; }
+
+private:
+
+	// Requests are kept in the order they came in.
+	TArray<FPGNPendingNarrativeRequest> AllPendingRequests;
+	FPGNNarrativeRequestId NextRequestId = INVALID_PGN_NARRATIVE_REQUEST_ID + 1;
+};
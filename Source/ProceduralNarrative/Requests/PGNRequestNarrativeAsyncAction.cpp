@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/Requests/PGNRequestNarrativeAsyncAction.h"
+
+#include "ProceduralNarrative/PGNOverseer.h"
+
+UPGNRequestNarrativeAsyncAction* UPGNRequestNarrativeAsyncAction::RequestNarrative(APGNOverseer* Overseer,
+	const FPGNNarrativeRequestConstraints& Constraints)
+{
+	UPGNRequestNarrativeAsyncAction* NewAction = NewObject<UPGNRequestNarrativeAsyncAction>();
+	NewAction->Overseer = Overseer;
+	NewAction->Constraints = Constraints;
+
+	// This keeps the action alive until the request has been completed.
+	if (Overseer != nullptr)
+	{
+		NewAction->RegisterWithGameInstance(Overseer);
+	}
+
+	return NewAction;
+}
+
+void UPGNRequestNarrativeAsyncAction::Activate()
+{
+	if (!Overseer.IsValid())
+	{
+		UE_LOG(LogTemp, Error, TEXT("A narrative was requested without an overseer."));
+		OnRequestCompleted(FPGNNarrativeRequestResult());
+		return;
+	}
+
+	// The overseer may outlive this action, so the callback must not keep it alive or call into it once it is gone.
+	TWeakObjectPtr<UPGNRequestNarrativeAsyncAction> WeakThis(this);
+
+	RequestId = Overseer->RequestNarrativeWithCallback(Constraints,
+		[WeakThis](const FPGNNarrativeRequestResult& Result)
+		{
+			if (WeakThis.IsValid())
+			{
+				WeakThis->OnRequestCompleted(Result);
+			}
+		});
+}
+
+void UPGNRequestNarrativeAsyncAction::CancelRequest()
+{
+	if (Overseer.IsValid() && RequestId != INVALID_PGN_NARRATIVE_REQUEST_ID)
+	{
+		Overseer->CancelNarrativeRequest(RequestId);
+	}
+}
+
+void UPGNRequestNarrativeAsyncAction::OnRequestCompleted(const FPGNNarrativeRequestResult& Result)
+{
+	RequestId = INVALID_PGN_NARRATIVE_REQUEST_ID;
+
+	if (Result.Status == EPGNNarrativeRequestStatus::FULFILLED)
+	{
+		Fulfilled.Broadcast(Result);
+	}
+	else
+	{
+		Failed.Broadcast(Result);
+	}
+
+	SetReadyToDestroy();
+}
@@ -0,0 +1,48 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintAsyncActionBase.h"
+#include "ProceduralNarrative/Requests/PGNNarrativeRequest.h"
+#include "PGNRequestNarrativeAsyncAction.generated.h"
+
+class APGNOverseer;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FPGNNarrativeRequestCompletedPin, const FPGNNarrativeRequestResult&, Result);
+
+/**
+ * The Blueprint node for APGNOverseer::RequestNarrative. It carries on from Fulfilled once the narrative has been
+ * generated, or from Failed if the request was cancelled, timed out, or could not be met.
+ */
+UCLASS()
+class PROCEDURALNARRATIVE_API UPGNRequestNarrativeAsyncAction : public UBlueprintAsyncActionBase
+{
+	GENERATED_BODY()
+
+public:
+
+	UFUNCTION(BlueprintCallable, Category = "Procedural Narrative", meta = (BlueprintInternalUseOnly = "true"))
+	static UPGNRequestNarrativeAsyncAction* RequestNarrative(APGNOverseer* Overseer,
+		const FPGNNarrativeRequestConstraints& Constraints);
+
+	UPROPERTY(BlueprintAssignable)
+	FPGNNarrativeRequestCompletedPin Fulfilled;
+
+	UPROPERTY(BlueprintAssignable)
+	FPGNNarrativeRequestCompletedPin Failed;
+
+	virtual void Activate() override;
+
+	// Failed is called straight away if the request was still waiting.
+	UFUNCTION(BlueprintCallable, Category = "Procedural Narrative")
+	void CancelRequest();
+
+private:
+
+	void OnRequestCompleted(const FPGNNarrativeRequestResult& Result);
+
+	TWeakObjectPtr<APGNOverseer> Overseer;
+	FPGNNarrativeRequestConstraints Constraints;
+	FPGNNarrativeRequestId RequestId = INVALID_PGN_NARRATIVE_REQUEST_ID;
+};
@@ -0,0 +1,282 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/Save/PGNOverseerSaveState.h"
+
+#include "ProceduralNarrative/PGNVarint.h"
+
+namespace PGNOverseerSaveState
+{
+	enum class ERecordType : uint8
+	{
+		NUMBER_OF_CHARACTERS = 1,
+		CHARACTER,
+		RELATIONSHIP,
+		WAITING_LIST,
+		CURRENT_NARRATIVE,
+		THRESHOLD_FOR_SOCIAL_EDGE_CREATION
+	};
+
+#pragma region Templates
+
+	void WriteTemplate(TArray<uint8>& Out_Payload, const FPGNCharacterTemplate& ThisTemplate)
+	{
+		Out_Payload.Add(static_cast<uint8>(ThisTemplate.Occupation));
+		PGNVarint::WriteVarint(Out_Payload, PGNVarint::EncodeZigZag(ThisTemplate.OccupationSalary));
+		Out_Payload.Add(static_cast<uint8>(ThisTemplate.CharacterGreatestDesire));
+		PGNVarint::WriteFloat(Out_Payload, ThisTemplate.TendencyTowardsMoralDecisions);
+		PGNVarint::WriteFloat(Out_Payload, ThisTemplate.TendencyToPursueGreatestDesire);
+		PGNVarint::WriteVarint(Out_Payload, PGNVarint::EncodeZigZag(ThisTemplate.NumberOfTimesTemplateUsed));
+	}
+
+	void ReadTemplate(PGNVarint::FReader& Reader, FPGNCharacterTemplate& Out_Template)
+	{
+		Out_Template.Occupation = static_cast<EPGNCharacterOccupation>(Reader.ReadByte());
+		Out_Template.OccupationSalary = Reader.ReadZigZag();
+		Out_Template.CharacterGreatestDesire = static_cast<EPGNCharacterDesire>(Reader.ReadByte());
+		Out_Template.TendencyTowardsMoralDecisions = Reader.ReadFloat();
+		Out_Template.TendencyToPursueGreatestDesire = Reader.ReadFloat();
+		Out_Template.NumberOfTimesTemplateUsed = Reader.ReadZigZag();
+	}
+
+#pragma endregion Templates
+
+	// The flags that only have two values are packed into one byte.
+	constexpr uint8 IS_MALE = 1 << 0;
+	constexpr uint8 IS_IN_TOWN = 1 << 1;
+	constexpr uint8 FOUND_VALID_MARRIAGE_PARTNER = 1 << 2;
+}
+
+#pragma region Writing
+
+void FPGNOverseerSaveState::WriteNumberOfCharacters(TArray<uint8>& Out_Payload, int32 NumberOfCharacters)
+{
+	Out_Payload.Add(static_cast<uint8>(PGNOverseerSaveState::ERecordType::NUMBER_OF_CHARACTERS));
+	PGNVarint::WriteVarint(Out_Payload, NumberOfCharacters);
+}
+
+void FPGNOverseerSaveState::WriteCharacter(TArray<uint8>& Out_Payload, int32 IndexOfCharacter,
+	const FPGNCharacter& ThisCharacter, EPGNCharacterStateFlags StateFlags)
+{
+	Out_Payload.Add(static_cast<uint8>(PGNOverseerSaveState::ERecordType::CHARACTER));
+	PGNVarint::WriteVarint(Out_Payload, IndexOfCharacter);
+
+	PGNVarint::WriteString(Out_Payload, ThisCharacter.Name);
+	// A varint like every other number, so the format does not change if ages ever outgrow a byte.
+	PGNVarint::WriteVarint(Out_Payload, ThisCharacter.Age);
+	Out_Payload.Add(static_cast<uint8>(ThisCharacter.Generation));
+
+	Out_Payload.Add(static_cast<uint8>((ThisCharacter.bIsMale ? PGNOverseerSaveState::IS_MALE : 0)
+		| (ThisCharacter.bIsInTown ? PGNOverseerSaveState::IS_IN_TOWN : 0)
+		| (ThisCharacter.bFoundValidMarriagePartner ? PGNOverseerSaveState::FOUND_VALID_MARRIAGE_PARTNER : 0)));
+
+	Out_Payload.Add(static_cast<uint8>(ThisCharacter.MyRomanticData.RomanticRelationship));
+	PGNVarint::WriteVarint(Out_Payload,
+		static_cast<uint32>(ThisCharacter.MyRomanticData.IndexOfRomanticPartner + 1));
+
+	PGNOverseerSaveState::WriteTemplate(Out_Payload, ThisCharacter.MyCharacterTemplate);
+
+	PGNVarint::WriteVarint(Out_Payload, static_cast<uint16>(StateFlags));
+}
+
+void FPGNOverseerSaveState::WriteRelationship(TArray<uint8>& Out_Payload, int32 IndexOfCharacterA,
+	int32 IndexOfCharacterB, int32 DistanceBetweenCharacters)
+{
+	Out_Payload.Add(static_cast<uint8>(PGNOverseerSaveState::ERecordType::RELATIONSHIP));
+	PGNVarint::WriteVarint(Out_Payload, IndexOfCharacterA);
+	PGNVarint::WriteVarint(Out_Payload, IndexOfCharacterB);
+	PGNVarint::WriteVarint(Out_Payload, static_cast<uint32>(DistanceBetweenCharacters + 1));
+}
+
+void FPGNOverseerSaveState::WriteWaitingList(TArray<uint8>& Out_Payload,
+	const TArray<uint16>& AllCharactersWaitingForMarriagePartners)
+{
+	Out_Payload.Add(static_cast<uint8>(PGNOverseerSaveState::ERecordType::WAITING_LIST));
+	PGNVarint::WriteVarint(Out_Payload, AllCharactersWaitingForMarriagePartners.Num());
+
+	for (const uint16 IndexOfCharacter : AllCharactersWaitingForMarriagePartners)
+	{
+		PGNVarint::WriteVarint(Out_Payload, IndexOfCharacter);
+	}
+}
+
+void FPGNOverseerSaveState::WriteCurrentNarrative(TArray<uint8>& Out_Payload, const FPGNGeneratedNarrative& ThisNarrative,
+	int32 NarrativeIndex)
+{
+	Out_Payload.Add(static_cast<uint8>(PGNOverseerSaveState::ERecordType::CURRENT_NARRATIVE));
+	Out_Payload.Add(static_cast<uint8>(ThisNarrative.bIsNarrativeInitialized ? 1 : 0));
+	PGNVarint::WriteVarint(Out_Payload, static_cast<uint32>(NarrativeIndex + 1));
+	PGNVarint::WriteVarint(Out_Payload, static_cast<uint32>(ThisNarrative.ConclusionEventId + 1));
+
+	// Events in the same narrative tend to sit close together in the library, so the deltas are small.
+	PGNVarint::WriteVarint(Out_Payload, ThisNarrative.AllEventIds.Num());
+
+	int PreviousEventId = 0;
+
+	for (const int ThisEventId : ThisNarrative.AllEventIds)
+	{
+		PGNVarint::WriteVarint(Out_Payload, PGNVarint::EncodeZigZag(ThisEventId - PreviousEventId));
+		PreviousEventId = ThisEventId;
+	}
+
+	PGNVarint::WriteVarint(Out_Payload, ThisNarrative.AllCharactersInUse.Num());
+
+	for (int32 Index_Role = 0; Index_Role < ThisNarrative.AllCharactersInUse.Num(); Index_Role++)
+	{
+		const int IndexOfCharacter = ThisNarrative.AllIndicesOfCharactersInUse.IsValidIndex(Index_Role)
+			? ThisNarrative.AllIndicesOfCharactersInUse[Index_Role] : INDEX_NONE;
+
+		PGNVarint::WriteVarint(Out_Payload, static_cast<uint32>(IndexOfCharacter + 1));
+		PGNOverseerSaveState::WriteTemplate(Out_Payload, ThisNarrative.AllCharactersInUse[Index_Role]);
+	}
+}
+
+void FPGNOverseerSaveState::WriteThresholdForSocialEdgeCreation(TArray<uint8>& Out_Payload, float Threshold)
+{
+	Out_Payload.Add(static_cast<uint8>(PGNOverseerSaveState::ERecordType::THRESHOLD_FOR_SOCIAL_EDGE_CREATION));
+	PGNVarint::WriteFloat(Out_Payload, Threshold);
+}
+
+#pragma endregion Writing
+
+#pragma region Loading
+
+bool FPGNOverseerSaveState::ApplyPayload(const TArray<uint8>& Payload)
+{
+	PGNVarint::FReader Reader(Payload);
+
+	while (Reader.bIsValid && !Reader.IsAtEnd())
+	{
+		switch (static_cast<PGNOverseerSaveState::ERecordType>(Reader.ReadByte()))
+		{
+		case PGNOverseerSaveState::ERecordType::NUMBER_OF_CHARACTERS:
+		{
+			const int32 NumberOfCharacters = static_cast<int32>(Reader.ReadVarint());
+
+			if (NumberOfCharacters > MAXIMUM_NUMBER_OF_CHARACTERS)
+			{
+				return false;
+			}
+
+			// Nobody is ever removed from AllCharacters, so this only grows.
+			if (NumberOfCharacters > AllCharacters.Num())
+			{
+				AllCharacters.SetNum(NumberOfCharacters);
+				AllStateFlags.SetNum(NumberOfCharacters);
+			}
+
+			break;
+		}
+		case PGNOverseerSaveState::ERecordType::CHARACTER:
+		{
+			const int32 IndexOfCharacter = static_cast<int32>(Reader.ReadVarint());
+
+			if (!AllCharacters.IsValidIndex(IndexOfCharacter))
+			{
+				return false;
+			}
+
+			FPGNCharacter& ThisCharacter = AllCharacters[IndexOfCharacter];
+			ThisCharacter.Name = Reader.ReadString();
+
+			// Ages are written from a uint8, so anything larger can only come from a damaged save.
+			const uint32 Age = Reader.ReadVarint();
+
+			if (Age > MAX_uint8)
+			{
+				return false;
+			}
+
+			ThisCharacter.Age = static_cast<uint8>(Age);
+			ThisCharacter.Generation = static_cast<EPGNCharacterGeneration>(Reader.ReadByte());
+
+			const uint8 PackedFlags = Reader.ReadByte();
+			ThisCharacter.bIsMale = (PackedFlags & PGNOverseerSaveState::IS_MALE) != 0;
+			ThisCharacter.bIsInTown = (PackedFlags & PGNOverseerSaveState::IS_IN_TOWN) != 0;
+			ThisCharacter.bFoundValidMarriagePartner = (PackedFlags & PGNOverseerSaveState::FOUND_VALID_MARRIAGE_PARTNER) != 0;
+
+			ThisCharacter.MyRomanticData.RomanticRelationship = static_cast<EPGNCharacterRomanticRelationship>(
+				Reader.ReadByte());
+			ThisCharacter.MyRomanticData.IndexOfRomanticPartner = Reader.ReadIndex();
+
+			PGNOverseerSaveState::ReadTemplate(Reader, ThisCharacter.MyCharacterTemplate);
+
+			AllStateFlags[IndexOfCharacter] = static_cast<EPGNCharacterStateFlags>(Reader.ReadVarint());
+			break;
+		}
+		case PGNOverseerSaveState::ERecordType::RELATIONSHIP:
+		{
+			const int32 IndexOfCharacterA = static_cast<int32>(Reader.ReadVarint());
+			const int32 IndexOfCharacterB = static_cast<int32>(Reader.ReadVarint());
+			const int32 DistanceBetweenCharacters = Reader.ReadIndex();
+
+			if (!AllCharacters.IsValidIndex(IndexOfCharacterA) || !AllCharacters.IsValidIndex(IndexOfCharacterB))
+			{
+				return false;
+			}
+
+			const uint64 Key = GetKeyOfRelationship(IndexOfCharacterA, IndexOfCharacterB);
+
+			if (DistanceBetweenCharacters == INDEX_NONE)
+			{
+				DistanceOfRelationship.Remove(Key);
+			}
+			else
+			{
+				DistanceOfRelationship.Add(Key, DistanceBetweenCharacters);
+			}
+
+			break;
+		}
+		case PGNOverseerSaveState::ERecordType::WAITING_LIST:
+		{
+			AllCharactersWaitingForMarriagePartners.SetNum(Reader.ReadCount());
+
+			for (uint16& IndexOfCharacter : AllCharactersWaitingForMarriagePartners)
+			{
+				IndexOfCharacter = static_cast<uint16>(Reader.ReadVarint());
+			}
+
+			break;
+		}
+		case PGNOverseerSaveState::ERecordType::CURRENT_NARRATIVE:
+		{
+			CurrentNarrative = FPGNGeneratedNarrative();
+			CurrentNarrative.bIsNarrativeInitialized = Reader.ReadByte() != 0;
+			NarrativeIndexOfCurrentNarrative = Reader.ReadIndex();
+			CurrentNarrative.ConclusionEventId = Reader.ReadIndex();
+
+			CurrentNarrative.AllEventIds.SetNum(Reader.ReadCount());
+
+			int PreviousEventId = 0;
+
+			for (int& ThisEventId : CurrentNarrative.AllEventIds)
+			{
+				ThisEventId = PreviousEventId + Reader.ReadZigZag();
+				PreviousEventId = ThisEventId;
+			}
+
+			const int32 NumberOfRoles = Reader.ReadCount();
+			CurrentNarrative.AllIndicesOfCharactersInUse.SetNum(NumberOfRoles);
+			CurrentNarrative.AllCharactersInUse.SetNum(NumberOfRoles);
+
+			for (int32 Index_Role = 0; Index_Role < NumberOfRoles; Index_Role++)
+			{
+				CurrentNarrative.AllIndicesOfCharactersInUse[Index_Role] = Reader.ReadIndex();
+				PGNOverseerSaveState::ReadTemplate(Reader, CurrentNarrative.AllCharactersInUse[Index_Role]);
+			}
+
+			break;
+		}
+		case PGNOverseerSaveState::ERecordType::THRESHOLD_FOR_SOCIAL_EDGE_CREATION:
+			ThresholdForSocialEdgeCreation = Reader.ReadFloat();
+			break;
+		default:
+			return false;
+		}
+	}
+
+	return Reader.bIsValid;
+}
+
+#pragma endregion Loading
@@ -0,0 +1,84 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralNarrative/PGNUtilities.h"
+#include "ProceduralNarrative/History/PGNCharacterTimeline.h"
+
+/**
+ * The part of the overseer that is saved: the town, who is related to whom and how closely, the waiting list for
+ * spouses, the current narrative and what has become of everyone.
+ *
+ * A payload is a list of records, and each record replaces one piece of that state, such as one character or one
+ * relationship. A checkpoint holds a record for everything, and a delta only holds records for what has changed since
+ * the last save, so loading is just applying the checkpoint and then every delta in order. See FPGNSaveJournal.
+ *
+ * Social data, the relationship oracle and the character graph are not saved, since they are all built from the
+ * relationships and spouses again. Neither are the narrative history and the usage of each conclusion event, which
+ * are kept in their own file. See FPGNNarrativeHistoryArchive.
+ */
+class PROCEDURALNARRATIVE_API FPGNOverseerSaveState
+{
+public:
+
+	// The waiting list for spouses stores characters as uint16, so there are never more than this.
+	static constexpr int32 MAXIMUM_NUMBER_OF_CHARACTERS = MAX_uint16 + 1;
+
+#pragma region Writing
+
+	// Every payload should start with this, so that the characters after it have somewhere to go.
+	static void WriteNumberOfCharacters(TArray<uint8>& Out_Payload, int32 NumberOfCharacters);
+
+	// Everything about the character except their social data.
+	static void WriteCharacter(TArray<uint8>& Out_Payload, int32 IndexOfCharacter, const FPGNCharacter& ThisCharacter,
+		EPGNCharacterStateFlags StateFlags);
+
+	// A distance of INDEX_NONE means the two characters are no longer related.
+	static void WriteRelationship(TArray<uint8>& Out_Payload, int32 IndexOfCharacterA, int32 IndexOfCharacterB,
+		int32 DistanceBetweenCharacters);
+
+	static void WriteWaitingList(TArray<uint8>& Out_Payload, const TArray<uint16>& AllCharactersWaitingForMarriagePartners);
+
+	// NarrativeIndex is the index the narrative will have once it is archived.
+	static void WriteCurrentNarrative(TArray<uint8>& Out_Payload, const FPGNGeneratedNarrative& ThisNarrative,
+		int32 NarrativeIndex);
+
+	static void WriteThresholdForSocialEdgeCreation(TArray<uint8>& Out_Payload, float Threshold);
+
+#pragma endregion Writing
+
+#pragma region Loading
+
+	// Returns false if the payload cannot be read. Any records before the one that could not be read are kept.
+	bool ApplyPayload(const TArray<uint8>& Payload);
+
+	// Nobody has any social data, and the names of spouses are left for whoever loads the characters to fill in.
+	TArray<FPGNCharacter> AllCharacters;
+	TArray<EPGNCharacterStateFlags> AllStateFlags;
+
+	// The distance between every two characters who are related, by GetKeyOfRelationship.
+	TMap<uint64, int32> DistanceOfRelationship;
+
+	TArray<uint16> AllCharactersWaitingForMarriagePartners;
+
+	FPGNGeneratedNarrative CurrentNarrative;
+	int32 NarrativeIndexOfCurrentNarrative = INDEX_NONE;
+
+	float ThresholdForSocialEdgeCreation = 0.f;
+
+#pragma endregion Loading
+
+	// The same two characters in either order are the same relationship.
+	static uint64 GetKeyOfRelationship(int32 IndexOfCharacterA, int32 IndexOfCharacterB)
+	{
+		return static_cast<uint64>(FMath::Min(IndexOfCharacterA, IndexOfCharacterB)) << 32
+			| static_cast<uint32>(FMath::Max(IndexOfCharacterA, IndexOfCharacterB));
+	}
+
+	static void GetCharactersOfRelationship(uint64 Key, int32& Out_IndexOfCharacterA, int32& Out_IndexOfCharacterB)
+	{
+		Out_IndexOfCharacterA = static_cast<int32>(Key >> 32);
+		Out_IndexOfCharacterB = static_cast<int32>(Key & MAX_uint32);
+	}
+};
@@ -0,0 +1,329 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/Save/PGNSaveJournal.h"
+
+#include "Async/Async.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/Crc.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "ProceduralNarrative/Memory/PGNMemoryTracking.h"
+
+FPGNSaveJournal::~FPGNSaveJournal()
+{
+	WaitForPendingWrites();
+}
+
+void FPGNSaveJournal::SetFilename(const FString& InBaseFilename)
+{
+	WaitForPendingWrites();
+
+	BaseFilename = InBaseFilename;
+	CheckpointGeneration = 0;
+	NextDeltaSequence = 0;
+	NumberOfDeltasSinceCheckpoint = 0;
+	SizeOfDeltasSinceCheckpoint = 0;
+}
+
+#pragma region Loading
+
+bool FPGNSaveJournal::Load(TArray<uint8>& Out_CheckpointPayload, TArray<TArray<uint8>>& Out_AllDeltaPayloads)
+{
+	Out_CheckpointPayload.Reset();
+	Out_AllDeltaPayloads.Reset();
+
+	WaitForPendingWrites();
+
+	if (!HasFilename())
+	{
+		return false;
+	}
+
+	// A new checkpoint is written in full before the old one is deleted and the new one moved into its place. If we
+	// stopped in between, the new one is still waiting under its temporary name.
+	FString CheckpointFilename = GetCheckpointFilename();
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	if (!PlatformFile.FileExists(*CheckpointFilename) && PlatformFile.FileExists(*GetTemporaryCheckpointFilename()))
+	{
+		CheckpointFilename = GetTemporaryCheckpointFilename();
+	}
+
+	TArray<uint8> CheckpointFile;
+
+	if (!FFileHelper::LoadFileToArray(CheckpointFile, *CheckpointFilename, FILEREAD_Silent))
+	{
+		return false;
+	}
+
+	FCheckpointHeader CheckpointHeader;
+
+	if (CheckpointFile.Num() < static_cast<int32>(sizeof(CheckpointHeader)))
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s is too short to be a save."), *CheckpointFilename);
+		return false;
+	}
+
+	FMemory::Memcpy(&CheckpointHeader, CheckpointFile.GetData(), sizeof(CheckpointHeader));
+
+	const uint8* CheckpointPayload = CheckpointFile.GetData() + sizeof(CheckpointHeader);
+
+	if (CheckpointHeader.Magic != CHECKPOINT_MAGIC || CheckpointHeader.FormatVersion != FORMAT_VERSION
+		|| CheckpointHeader.Generation == 0
+		|| CheckpointHeader.SizeOfPayload != static_cast<uint32>(CheckpointFile.Num() - sizeof(CheckpointHeader))
+		|| FCrc::MemCrc32(CheckpointPayload, CheckpointHeader.SizeOfPayload) != CheckpointHeader.PayloadChecksum)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s is not a save that we can read."), *CheckpointFilename);
+		return false;
+	}
+
+	Out_CheckpointPayload.Append(CheckpointPayload, CheckpointHeader.SizeOfPayload);
+
+	if (CheckpointFilename != GetCheckpointFilename())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s was never moved into place, so it is moved now."), *CheckpointFilename);
+		PlatformFile.MoveFile(*GetCheckpointFilename(), *CheckpointFilename);
+	}
+
+	CheckpointGeneration = CheckpointHeader.Generation;
+	NextDeltaSequence = 0;
+	NumberOfDeltasSinceCheckpoint = 0;
+	SizeOfDeltasSinceCheckpoint = 0;
+
+	// The journal is only worth reading if it follows this very checkpoint. One from an earlier checkpoint means the
+	// game stopped between writing the checkpoint and starting the journal over, so everything in it is already saved.
+	TArray<uint8> JournalFile;
+	FJournalHeader JournalHeader;
+
+	// Either way, it is started over, or the deltas we append to it would be skipped on the next load as well.
+	if (!FFileHelper::LoadFileToArray(JournalFile, *GetJournalFilename(), FILEREAD_Silent)
+		|| JournalFile.Num() < static_cast<int32>(sizeof(JournalHeader)))
+	{
+		StartJournalOnDisk(CheckpointGeneration);
+		return true;
+	}
+
+	FMemory::Memcpy(&JournalHeader, JournalFile.GetData(), sizeof(JournalHeader));
+
+	if (JournalHeader.Magic != JOURNAL_MAGIC || JournalHeader.FormatVersion != FORMAT_VERSION
+		|| JournalHeader.Generation != CheckpointGeneration)
+	{
+		StartJournalOnDisk(CheckpointGeneration);
+		return true;
+	}
+
+	int64 OffsetOfDelta = sizeof(JournalHeader);
+
+	while (OffsetOfDelta + static_cast<int64>(sizeof(FDeltaHeader)) <= JournalFile.Num())
+	{
+		FDeltaHeader DeltaHeader;
+		FMemory::Memcpy(&DeltaHeader, JournalFile.GetData() + OffsetOfDelta, sizeof(DeltaHeader));
+
+		const int64 OffsetOfPayload = OffsetOfDelta + sizeof(FDeltaHeader);
+		const uint8* DeltaPayload = JournalFile.GetData() + OffsetOfPayload;
+
+		if (DeltaHeader.Magic != DELTA_MAGIC || DeltaHeader.Sequence != NextDeltaSequence
+			|| OffsetOfPayload + DeltaHeader.SizeOfPayload > JournalFile.Num()
+			|| FCrc::MemCrc32(DeltaPayload, DeltaHeader.SizeOfPayload) != DeltaHeader.PayloadChecksum)
+		{
+			break;
+		}
+
+		Out_AllDeltaPayloads.Emplace(DeltaPayload, DeltaHeader.SizeOfPayload);
+
+		NextDeltaSequence++;
+		NumberOfDeltasSinceCheckpoint++;
+		SizeOfDeltasSinceCheckpoint += DeltaHeader.SizeOfPayload;
+
+		OffsetOfDelta = OffsetOfPayload + DeltaHeader.SizeOfPayload;
+	}
+
+	// New deltas have to follow straight on from the last whole one, or the next load would stop at the damage.
+	if (OffsetOfDelta < JournalFile.Num())
+	{
+		UE_LOG(LogTemp, Warning, TEXT("%s ends with a damaged delta, which will be dropped."), *GetJournalFilename());
+
+		const TUniquePtr<IFileHandle> JournalHandle(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(
+			*GetJournalFilename(), true, true));
+
+		if (!JournalHandle.IsValid() || !JournalHandle->Truncate(OffsetOfDelta))
+		{
+			UE_LOG(LogTemp, Error, TEXT("Could not drop the damaged delta from %s."), *GetJournalFilename());
+		}
+	}
+
+	return true;
+}
+
+#pragma endregion Loading
+
+#pragma region Writing
+
+void FPGNSaveJournal::WriteCheckpoint(TArray<uint8>&& Payload)
+{
+	if (!HasFilename())
+	{
+		return;
+	}
+
+	FPendingWrite NewWrite;
+	NewWrite.bIsCheckpoint = true;
+	NewWrite.Generation = ++CheckpointGeneration;
+	NewWrite.Payload = MoveTemp(Payload);
+
+	NextDeltaSequence = 0;
+	NumberOfDeltasSinceCheckpoint = 0;
+	SizeOfDeltasSinceCheckpoint = 0;
+
+	EnqueueWrite(MoveTemp(NewWrite));
+}
+
+void FPGNSaveJournal::AppendDelta(TArray<uint8>&& Payload)
+{
+	if (!HasFilename())
+	{
+		return;
+	}
+
+	if (!HasCheckpoint())
+	{
+		UE_LOG(LogTemp, Error, TEXT("A delta cannot be saved to %s before a checkpoint."), *GetJournalFilename());
+		return;
+	}
+
+	FPendingWrite NewWrite;
+	NewWrite.Generation = CheckpointGeneration;
+	NewWrite.Sequence = NextDeltaSequence++;
+	NewWrite.Payload = MoveTemp(Payload);
+
+	NumberOfDeltasSinceCheckpoint++;
+	SizeOfDeltasSinceCheckpoint += NewWrite.Payload.Num();
+
+	EnqueueWrite(MoveTemp(NewWrite));
+}
+
+void FPGNSaveJournal::EnqueueWrite(FPendingWrite&& NewWrite)
+{
+	PendingWrites.Enqueue(MoveTemp(NewWrite));
+
+	// Whoever sets the flag is the only writer until they clear it again.
+	if (!bIsWriting.Exchange(true))
+	{
+		AllWriterTasks.RemoveAll([](const TFuture<void>& ThisTask) { return ThisTask.IsReady(); });
+		AllWriterTasks.Add(Async(EAsyncExecution::ThreadPool, [this]() { WritePendingWrites(); }));
+	}
+}
+
+void FPGNSaveJournal::WritePendingWrites()
+{
+	PGN_LLM_SCOPE(Save);
+
+	while (true)
+	{
+		FPendingWrite ThisWrite;
+
+		while (PendingWrites.Dequeue(ThisWrite))
+		{
+			const bool bWasWritten = ThisWrite.bIsCheckpoint ? WriteCheckpointToDisk(ThisWrite) : AppendDeltaToDisk(ThisWrite);
+
+			if (!bWasWritten)
+			{
+				UE_LOG(LogTemp, Error, TEXT("Could not write to the save %s."), *BaseFilename);
+			}
+		}
+
+		bIsWriting = false;
+
+		// Anything added after we ran dry but before we let go would otherwise wait for the next write. If someone else
+		// has taken over in the meantime, it is theirs.
+		if (PendingWrites.IsEmpty() || bIsWriting.Exchange(true))
+		{
+			return;
+		}
+	}
+}
+
+void FPGNSaveJournal::WaitForPendingWrites()
+{
+	for (TFuture<void>& ThisTask : AllWriterTasks)
+	{
+		ThisTask.Wait();
+	}
+
+	AllWriterTasks.Reset();
+}
+
+bool FPGNSaveJournal::WriteCheckpointToDisk(const FPendingWrite& ThisWrite) const
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*FPaths::GetPath(BaseFilename));
+
+	FCheckpointHeader CheckpointHeader;
+	CheckpointHeader.Magic = CHECKPOINT_MAGIC;
+	CheckpointHeader.FormatVersion = FORMAT_VERSION;
+	CheckpointHeader.Generation = ThisWrite.Generation;
+	CheckpointHeader.SizeOfPayload = ThisWrite.Payload.Num();
+	CheckpointHeader.PayloadChecksum = FCrc::MemCrc32(ThisWrite.Payload.GetData(), ThisWrite.Payload.Num());
+
+	const FString TemporaryFilename = GetTemporaryCheckpointFilename();
+
+	{
+		const TUniquePtr<IFileHandle> CheckpointHandle(PlatformFile.OpenWrite(*TemporaryFilename, false, false));
+
+		if (!CheckpointHandle.IsValid()
+			|| !CheckpointHandle->Write(reinterpret_cast<const uint8*>(&CheckpointHeader), sizeof(CheckpointHeader))
+			|| !CheckpointHandle->Write(ThisWrite.Payload.GetData(), ThisWrite.Payload.Num())
+			|| !CheckpointHandle->Flush())
+		{
+			return false;
+		}
+	}
+
+	// Moving does not replace on every platform, so the old checkpoint is deleted first. Load falls back to the
+	// temporary file if we are stopped in between.
+	PlatformFile.DeleteFile(*GetCheckpointFilename());
+
+	if (!PlatformFile.MoveFile(*GetCheckpointFilename(), *TemporaryFilename))
+	{
+		return false;
+	}
+
+	// Everything in the old journal is in the new checkpoint.
+	return StartJournalOnDisk(ThisWrite.Generation);
+}
+
+bool FPGNSaveJournal::AppendDeltaToDisk(const FPendingWrite& ThisWrite) const
+{
+	FDeltaHeader DeltaHeader;
+	DeltaHeader.Magic = DELTA_MAGIC;
+	DeltaHeader.Sequence = ThisWrite.Sequence;
+	DeltaHeader.SizeOfPayload = ThisWrite.Payload.Num();
+	DeltaHeader.PayloadChecksum = FCrc::MemCrc32(ThisWrite.Payload.GetData(), ThisWrite.Payload.Num());
+
+	const TUniquePtr<IFileHandle> JournalHandle(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(
+		*GetJournalFilename(), true, false));
+
+	return JournalHandle.IsValid()
+		&& JournalHandle->Write(reinterpret_cast<const uint8*>(&DeltaHeader), sizeof(DeltaHeader))
+		&& JournalHandle->Write(ThisWrite.Payload.GetData(), ThisWrite.Payload.Num())
+		&& JournalHandle->Flush();
+}
+
+bool FPGNSaveJournal::StartJournalOnDisk(uint32 Generation) const
+{
+	FJournalHeader JournalHeader;
+	JournalHeader.Magic = JOURNAL_MAGIC;
+	JournalHeader.FormatVersion = FORMAT_VERSION;
+	JournalHeader.Generation = Generation;
+
+	const TUniquePtr<IFileHandle> JournalHandle(FPlatformFileManager::Get().GetPlatformFile().OpenWrite(
+		*GetJournalFilename(), false, false));
+
+	return JournalHandle.IsValid()
+		&& JournalHandle->Write(reinterpret_cast<const uint8*>(&JournalHeader), sizeof(JournalHeader))
+		&& JournalHandle->Flush();
+}
+
+#pragma endregion Writing
@@ -0,0 +1,130 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "Containers/Queue.h"
+#include "Templates/Atomic.h"
+
+/**
+ * Keeps a save as a checkpoint plus a journal of deltas since that checkpoint, and writes both off the game thread.
+ *
+ *	<Name>.pgnsave		The last checkpoint: a header with its generation and checksum, then its payload. It is
+ *						written to a temporary file first and moved over the old one, so there is always a whole one.
+ *	<Name>.pgnjournal	A header with the generation of the checkpoint it follows, then one block per delta, each with
+ *						its own sequence number and checksum. It is started over with every checkpoint.
+ *
+ * What goes in a payload is up to whoever saves; see FPGNOverseerSaveState. Writes happen in the order they were
+ * asked for, on one pool thread at a time, so nothing the game thread does waits for the disk. Loading drops any
+ * block that is damaged or that follows another checkpoint, and every block after it, which is what a crash in the
+ * middle of a write leaves behind.
+ */
+class PROCEDURALNARRATIVE_API FPGNSaveJournal
+{
+public:
+
+	// 'PGNS'
+	static constexpr uint32 CHECKPOINT_MAGIC = 0x534E4750;
+	// 'PGNJ'
+	static constexpr uint32 JOURNAL_MAGIC = 0x4A4E4750;
+	// 'PGND'
+	static constexpr uint32 DELTA_MAGIC = 0x444E4750;
+
+	// Bump this whenever the layout of the files changes. Older saves will then be ignored.
+	static constexpr uint32 FORMAT_VERSION = 2;
+
+	FPGNSaveJournal() = default;
+	~FPGNSaveJournal();
+
+	FPGNSaveJournal(const FPGNSaveJournal&) = delete;
+	FPGNSaveJournal& operator=(const FPGNSaveJournal&) = delete;
+
+	// The extensions are added to this. Waits for anything still being written under the previous name.
+	void SetFilename(const FString& InBaseFilename);
+
+	bool HasFilename() const { return !BaseFilename.IsEmpty(); }
+
+	// Reads the checkpoint and every whole delta after it, in order. Returns false if there is no checkpoint that can
+	// be read. New deltas carry on from the last one that was read.
+	bool Load(TArray<uint8>& Out_CheckpointPayload, TArray<TArray<uint8>>& Out_AllDeltaPayloads);
+
+	// Replaces the checkpoint and starts the journal over.
+	void WriteCheckpoint(TArray<uint8>&& Payload);
+
+	void AppendDelta(TArray<uint8>&& Payload);
+
+	// How much has been journaled since the last checkpoint, for deciding when to write the next one.
+	int32 GetNumberOfDeltasSinceCheckpoint() const { return NumberOfDeltasSinceCheckpoint; }
+	int64 GetSizeOfDeltasSinceCheckpoint() const { return SizeOfDeltasSinceCheckpoint; }
+
+	bool HasCheckpoint() const { return CheckpointGeneration != 0; }
+
+	void WaitForPendingWrites();
+
+private:
+
+	struct FCheckpointHeader
+	{
+		uint32 Magic = 0;
+		uint32 FormatVersion = 0;
+		uint32 Generation = 0;
+		uint32 SizeOfPayload = 0;
+		uint32 PayloadChecksum = 0;
+		uint32 Reserved = 0;
+	};
+
+	struct FJournalHeader
+	{
+		uint32 Magic = 0;
+		uint32 FormatVersion = 0;
+		uint32 Generation = 0;
+		uint32 Reserved = 0;
+	};
+
+	// Written in front of every delta's payload.
+	struct FDeltaHeader
+	{
+		uint32 Magic = 0;
+		uint32 Sequence = 0;
+		uint32 SizeOfPayload = 0;
+		uint32 PayloadChecksum = 0;
+	};
+
+	struct FPendingWrite
+	{
+		bool bIsCheckpoint = false;
+		uint32 Generation = 0;
+		uint32 Sequence = 0;
+		TArray<uint8> Payload;
+	};
+
+	FString GetCheckpointFilename() const { return BaseFilename + TEXT(".pgnsave"); }
+	FString GetTemporaryCheckpointFilename() const { return GetCheckpointFilename() + TEXT(".tmp"); }
+	FString GetJournalFilename() const { return BaseFilename + TEXT(".pgnjournal"); }
+
+	void EnqueueWrite(FPendingWrite&& NewWrite);
+
+	// Runs on a pool thread until nothing is left to write.
+	void WritePendingWrites();
+
+	bool WriteCheckpointToDisk(const FPendingWrite& ThisWrite) const;
+	bool AppendDeltaToDisk(const FPendingWrite& ThisWrite) const;
+
+	// Replaces the journal with an empty one that follows the checkpoint of this generation.
+	bool StartJournalOnDisk(uint32 Generation) const;
+
+	FString BaseFilename;
+
+	// Zero until there is a checkpoint. Deltas are only valid after the checkpoint of the same generation.
+	uint32 CheckpointGeneration = 0;
+	uint32 NextDeltaSequence = 0;
+
+	int32 NumberOfDeltasSinceCheckpoint = 0;
+	int64 SizeOfDeltasSinceCheckpoint = 0;
+
+	// Only the game thread adds writes, and only one pool thread at a time takes them.
+	TQueue<FPendingWrite, EQueueMode::Spsc> PendingWrites;
+	TAtomic<bool> bIsWriting { false };
+	TArray<TFuture<void>> AllWriterTasks;
+};
@@ -0,0 +1,516 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/Text/PGNNarrativeTextRealiser.h"
+
+#include "ProceduralNarrative/Events/PGNEventLibrary.h"
+#include "ProceduralNarrative/Generation/PGNCastingSolver.h"
+#include "ProceduralNarrative/World/PGNNarrativeStateSnapshot.h"
+
+namespace PGNNarrativeTextRealiser
+{
+#pragma region Phrase Tables
+
+	// Every table is indexed by the value of its enum, so they have to be kept in the same order as the enums.
+
+	const FStringView TAG_PHRASES[] =
+	{
+		TEXTVIEW(""),
+		TEXTVIEW("the protagonist"),
+		TEXTVIEW("the first character"),
+		TEXTVIEW("the second character"),
+		TEXTVIEW("the third character"),
+		TEXTVIEW("the fourth character"),
+		TEXTVIEW("the fifth character"),
+		TEXTVIEW("the sixth character"),
+		TEXTVIEW("the seventh character"),
+		TEXTVIEW("the eighth character"),
+		TEXTVIEW("the ninth character"),
+		TEXTVIEW("the tenth character"),
+		TEXTVIEW("the eleventh character"),
+		TEXTVIEW("the twelfth character"),
+		TEXTVIEW("the thirteenth character"),
+		TEXTVIEW("the fourteenth character"),
+		TEXTVIEW("the fifteenth character")
+	};
+
+	const FStringView ATTITUDE_PHRASES[] =
+	{
+		TEXTVIEW(""),
+		TEXTVIEW("depressed"),
+		TEXTVIEW("joyful"),
+		TEXTVIEW("amazed"),
+		TEXTVIEW("bold"),
+		TEXTVIEW("comfortable"),
+		TEXTVIEW("optimistic"),
+		TEXTVIEW("proud"),
+		TEXTVIEW("aggravated"),
+		TEXTVIEW("pessimistic"),
+		TEXTVIEW("tense"),
+		TEXTVIEW("anxious"),
+		TEXTVIEW("tired"),
+		TEXTVIEW("disturbed"),
+		TEXTVIEW("curious"),
+		TEXTVIEW("shy"),
+		TEXTVIEW("sentimental")
+	};
+
+	const FStringView ACTION_PHRASES[] =
+	{
+		TEXTVIEW(""),
+		TEXTVIEW("is killed in a hit and run"),
+		TEXTVIEW("departs the town"),
+		TEXTVIEW("divorces"),
+		TEXTVIEW("is sentenced to prison"),
+		TEXTVIEW("promises to be better"),
+		TEXTVIEW("becomes a drunk"),
+		TEXTVIEW("loses their job"),
+		TEXTVIEW("is caught robbing"),
+		TEXTVIEW("wins a lawsuit against"),
+		TEXTVIEW("is revealed to be pregnant with the child of")
+	};
+
+	const FStringView TIME_OF_DAY_PHRASES[] =
+	{
+		TEXTVIEW(""),
+		TEXTVIEW("at dawn"),
+		TEXTVIEW("early in the morning"),
+		TEXTVIEW("late in the morning"),
+		TEXTVIEW("at noon"),
+		TEXTVIEW("early in the afternoon"),
+		TEXTVIEW("late in the afternoon"),
+		TEXTVIEW("in the evening"),
+		TEXTVIEW("late at night")
+	};
+
+	const FStringView SETTING_PHRASES[] =
+	{
+		TEXTVIEW("")
+	};
+
+	const FStringView MOOD_PHRASES[] =
+	{
+		TEXTVIEW("joyful"),
+		TEXTVIEW("optimistic"),
+		TEXTVIEW("playful"),
+		TEXTVIEW("empathetic"),
+		TEXTVIEW("sentimental"),
+		TEXTVIEW("serene"),
+		TEXTVIEW("inquisitive"),
+		TEXTVIEW("romantic"),
+		TEXTVIEW("exciting"),
+		TEXTVIEW("disturbing"),
+		TEXTVIEW("depressing"),
+		TEXTVIEW("melancholy")
+	};
+
+	// If any of these fail, an enum has gained a value that its table does not have a phrase for yet.
+	static_assert(UE_ARRAY_COUNT(TAG_PHRASES) == static_cast<int32>(EPGNCharacterTag::TAG_CHARACTER_15) + 1, "TAG_PHRASES is out of date.");
+	static_assert(UE_ARRAY_COUNT(ATTITUDE_PHRASES) == static_cast<int32>(EPGNCharacterAttitude::SENTIMENTAL) + 1, "ATTITUDE_PHRASES is out of date.");
+	static_assert(UE_ARRAY_COUNT(ACTION_PHRASES) == FPGNNarrativeTextRealiser::NUMBER_OF_ACTIONS, "ACTION_PHRASES is out of date.");
+	static_assert(UE_ARRAY_COUNT(TIME_OF_DAY_PHRASES) == static_cast<int32>(EPGNEventTime::LATE_NIGHT) + 1, "TIME_OF_DAY_PHRASES is out of date.");
+	static_assert(UE_ARRAY_COUNT(SETTING_PHRASES) == static_cast<int32>(EPGNEventSetting::SETTING_NONE) + 1, "SETTING_PHRASES is out of date.");
+	static_assert(UE_ARRAY_COUNT(MOOD_PHRASES) == static_cast<int32>(EPGNMood::MOOD_Melancholy) + 1, "MOOD_PHRASES is out of date.");
+
+	template <int32 NumberOfPhrases>
+	FStringView FindPhrase(const FStringView (&AllPhrases)[NumberOfPhrases], int32 Value)
+	{
+		return Value >= 0 && Value < NumberOfPhrases ? AllPhrases[Value] : FStringView();
+	}
+
+#pragma endregion Phrase Tables
+
+	// Indexed by action, like ACTION_PHRASES.
+	const TCHAR* const DEFAULT_TEMPLATES[] =
+	{
+		TEXT("{Subject} carried on as usual[ {TimeOfDay}]."),
+		TEXT("{Subject} was killed in a hit and run[ {TimeOfDay}][, leaving {Object} {ObjectAttitude}]."),
+		TEXT("{Subject} left town[ with {Object}][ {TimeOfDay}][, feeling {SubjectAttitude}]."),
+		TEXT("{Subject} divorced[ {Object}][ {TimeOfDay}][, feeling {SubjectAttitude}]."),
+		TEXT("{Subject} was sentenced to prison[ for what they did to {Object}][ {TimeOfDay}]."),
+		TEXT("{Subject} promised[ {Object}] to be better[ {TimeOfDay}][, feeling {SubjectAttitude}]."),
+		TEXT("{Subject} became a drunk[ {TimeOfDay}][, leaving {Object} {ObjectAttitude}]."),
+		TEXT("{Subject} lost their job[ {TimeOfDay}][, feeling {SubjectAttitude}]."),
+		TEXT("{Subject} was caught robbing[ {Object}][ {TimeOfDay}]."),
+		TEXT("{Subject} won a lawsuit[ against {Object}][ {TimeOfDay}][, feeling {SubjectAttitude}]."),
+		TEXT("{Subject} was revealed to be pregnant[ with the child of {Object}][ {TimeOfDay}].")
+	};
+
+	static_assert(UE_ARRAY_COUNT(DEFAULT_TEMPLATES) == FPGNNarrativeTextRealiser::NUMBER_OF_ACTIONS, "DEFAULT_TEMPLATES is out of date.");
+}
+
+FPGNNarrativeTextRealiser::FPGNNarrativeTextRealiser()
+{
+	AllTemplateSources.Reserve(NUMBER_OF_ACTIONS);
+
+	for (const TCHAR* ThisTemplate : PGNNarrativeTextRealiser::DEFAULT_TEMPLATES)
+	{
+		AllTemplateSources.Add(ThisTemplate);
+	}
+
+	const bool bDidDefaultTemplatesCompile = CompileAllTemplates();
+	check(bDidDefaultTemplatesCompile);
+}
+
+const FPGNNarrativeTextRealiser& FPGNNarrativeTextRealiser::Get()
+{
+	static const FPGNNarrativeTextRealiser DefaultRealiser;
+	return DefaultRealiser;
+}
+
+bool FPGNNarrativeTextRealiser::SetTemplateForAction(EPGNEventAction Action, const FString& Template)
+{
+	const int32 IndexOfAction = static_cast<int32>(Action);
+
+	if (!AllTemplateSources.IsValidIndex(IndexOfAction))
+	{
+		UE_LOG(LogTemp, Error, TEXT("There is no template for the action %d."), IndexOfAction);
+		return false;
+	}
+
+	const FString PreviousTemplate = AllTemplateSources[IndexOfAction];
+	AllTemplateSources[IndexOfAction] = Template;
+
+	if (!CompileAllTemplates())
+	{
+		AllTemplateSources[IndexOfAction] = PreviousTemplate;
+		return false;
+	}
+
+	return true;
+}
+
+#pragma region Rendering
+
+void FPGNNarrativeTextRealiser::RealiseEvent(const FPGNPackedEvent& ThisEvent,
+	TArrayView<const FPGNCharacter> AllCharactersInCast, FStringBuilderBase& Out_Text) const
+{
+	const int32 IndexOfAction = static_cast<int32>(ThisEvent.GetAction());
+
+	if (IndexOfAction >= NUMBER_OF_ACTIONS)
+	{
+		return;
+	}
+
+	const int32 IndexOfFirstToken = TokenOffsetOfAction[IndexOfAction];
+	const int32 IndexOfLastToken = TokenOffsetOfAction[IndexOfAction + 1];
+
+	for (int32 Index_Token = IndexOfFirstToken; Index_Token < IndexOfLastToken; Index_Token++)
+	{
+		const FToken& ThisToken = AllTokens[Index_Token];
+
+		switch (ThisToken.Type)
+		{
+		case ETokenType::LITERAL:
+			Out_Text << FStringView(&AllLiterals[ThisToken.Start], ThisToken.Length);
+			break;
+
+		case ETokenType::OPTIONAL_BEGIN:
+			// The whole group is left out if anything in it has nothing to say.
+			for (int32 Index_TokenInGroup = Index_Token + 1; Index_TokenInGroup < ThisToken.Start; Index_TokenInGroup++)
+			{
+				const ETokenType TypeInGroup = AllTokens[Index_TokenInGroup].Type;
+
+				if (TypeInGroup != ETokenType::LITERAL
+					&& ResolvePlaceholder(TypeInGroup, ThisEvent, AllCharactersInCast).IsEmpty())
+				{
+					Index_Token = ThisToken.Start;
+					break;
+				}
+			}
+			break;
+
+		case ETokenType::OPTIONAL_END:
+			break;
+
+		default:
+			{
+				const FStringView ThisText = ResolvePlaceholder(ThisToken.Type, ThisEvent, AllCharactersInCast);
+
+				// Anyone who was not cast is referred to by their role, which does not start with a capital.
+				if (Index_Token == IndexOfFirstToken && !ThisText.IsEmpty())
+				{
+					Out_Text << FChar::ToUpper(ThisText[0]) << ThisText.RightChop(1);
+				}
+				else
+				{
+					Out_Text << ThisText;
+				}
+			}
+			break;
+		}
+	}
+}
+
+void FPGNNarrativeTextRealiser::RealiseNarrative(const FPGNGeneratedNarrative& ThisNarrative,
+	const FPGNEventLibrary& EventLibrary, TArrayView<const FPGNCharacter> AllCharactersInCast,
+	FStringBuilderBase& Out_Text) const
+{
+	auto RealiseThisEvent = [&](FPGNEventId EventId)
+	{
+		if (!EventLibrary.IsValidEventId(EventId))
+		{
+			return;
+		}
+
+		if (Out_Text.Len() > 0)
+		{
+			Out_Text << TEXT(' ');
+		}
+
+		RealiseEvent(EventLibrary.GetEvent(EventId), AllCharactersInCast, Out_Text);
+	};
+
+	for (const int ThisEventId : ThisNarrative.AllEventIds)
+	{
+		RealiseThisEvent(ThisEventId);
+	}
+
+	RealiseThisEvent(ThisNarrative.ConclusionEventId);
+}
+
+FString FPGNNarrativeTextRealiser::RealiseNarrative(const FPGNGeneratedNarrative& ThisNarrative,
+	const FPGNEventLibrary& EventLibrary, TArrayView<const FPGNCharacter> AllCharactersInCast) const
+{
+	// The text is built on the stack, so the string we return is the only allocation.
+	TStringBuilder<INLINE_CHARACTERS_PER_NARRATIVE> Text;
+	RealiseNarrative(ThisNarrative, EventLibrary, AllCharactersInCast, Text);
+
+	return FString(Text.Len(), Text.GetData());
+}
+
+FString FPGNNarrativeTextRealiser::RealiseNarrative(const FPGNNarrativeStateSnapshot& Snapshot) const
+{
+	if (!Snapshot.EventLibrary.IsValid())
+	{
+		return FString();
+	}
+
+	return RealiseNarrative(Snapshot.Narrative, *Snapshot.EventLibrary, Snapshot.AllCharactersInCast);
+}
+
+FStringView FPGNNarrativeTextRealiser::ResolvePlaceholder(ETokenType Type, const FPGNPackedEvent& ThisEvent,
+	TArrayView<const FPGNCharacter> AllCharactersInCast)
+{
+	switch (Type)
+	{
+	case ETokenType::SUBJECT:
+		return ResolveCharacter(ThisEvent.GetSubject(), AllCharactersInCast);
+	case ETokenType::OBJECT:
+		return ThisEvent.bDoesEventHaveObject ? ResolveCharacter(ThisEvent.GetObject(), AllCharactersInCast) : FStringView();
+	case ETokenType::ACTION:
+		return GetActionPhrase(ThisEvent.GetAction());
+	case ETokenType::SUBJECT_ATTITUDE:
+		return GetAttitudePhrase(ThisEvent.GetSubjectFinalAttitude());
+	case ETokenType::OBJECT_ATTITUDE:
+		return ThisEvent.bDoesEventHaveObject ? GetAttitudePhrase(ThisEvent.GetObjectFinalAttitude()) : FStringView();
+	case ETokenType::TIME_OF_DAY:
+		return ThisEvent.bDoesEventOverrideTimeOfDay ? GetTimeOfDayPhrase(ThisEvent.GetTimeOfDay()) : FStringView();
+	case ETokenType::SETTING:
+		return ThisEvent.bDoesEventOverrideSetting ? GetSettingPhrase(ThisEvent.GetSetting()) : FStringView();
+	case ETokenType::MOOD:
+		return GetMoodPhrase(ThisEvent.GetMood());
+	default:
+		return FStringView();
+	}
+}
+
+FStringView FPGNNarrativeTextRealiser::ResolveCharacter(EPGNCharacterTag Tag,
+	TArrayView<const FPGNCharacter> AllCharactersInCast)
+{
+	const int32 IndexInCast = FPGNCastingSolver::GetIndexInCast(Tag);
+
+	// Roles nobody was cast in still have a default character in the snapshot, who has no real name.
+	if (AllCharactersInCast.IsValidIndex(IndexInCast))
+	{
+		const FString& Name = AllCharactersInCast[IndexInCast].Name;
+
+		if (!Name.IsEmpty() && Name != TEXT("NAME_UNKNOWN"))
+		{
+			return FStringView(*Name, Name.Len());
+		}
+	}
+
+	return GetTagPhrase(Tag);
+}
+
+#pragma endregion Rendering
+
+#pragma region Compiling
+
+bool FPGNNarrativeTextRealiser::CompileAllTemplates()
+{
+	TArray<FToken> NewTokens;
+	TArray<TCHAR> NewLiterals;
+	int32 NewTokenOffsetOfAction[NUMBER_OF_ACTIONS + 1];
+
+	for (int32 Index_Action = 0; Index_Action < NUMBER_OF_ACTIONS; Index_Action++)
+	{
+		NewTokenOffsetOfAction[Index_Action] = NewTokens.Num();
+
+		if (!CompileTemplate(AllTemplateSources[Index_Action], NewTokens, NewLiterals))
+		{
+			return false;
+		}
+	}
+
+	NewTokenOffsetOfAction[NUMBER_OF_ACTIONS] = NewTokens.Num();
+
+	AllTokens = MoveTemp(NewTokens);
+	AllLiterals = MoveTemp(NewLiterals);
+	FMemory::Memcpy(TokenOffsetOfAction, NewTokenOffsetOfAction, sizeof(TokenOffsetOfAction));
+
+	return true;
+}
+
+bool FPGNNarrativeTextRealiser::CompileTemplate(const FString& Template, TArray<FToken>& InOut_AllTokens,
+	TArray<TCHAR>& InOut_AllLiterals)
+{
+	struct FPlaceholder
+	{
+		FStringView Name;
+		ETokenType Type;
+	};
+
+	static const FPlaceholder ALL_PLACEHOLDERS[] =
+	{
+		{ TEXTVIEW("Subject"), ETokenType::SUBJECT },
+		{ TEXTVIEW("Object"), ETokenType::OBJECT },
+		{ TEXTVIEW("Action"), ETokenType::ACTION },
+		{ TEXTVIEW("SubjectAttitude"), ETokenType::SUBJECT_ATTITUDE },
+		{ TEXTVIEW("ObjectAttitude"), ETokenType::OBJECT_ATTITUDE },
+		{ TEXTVIEW("TimeOfDay"), ETokenType::TIME_OF_DAY },
+		{ TEXTVIEW("Setting"), ETokenType::SETTING },
+		{ TEXTVIEW("Mood"), ETokenType::MOOD }
+	};
+
+	int32 IndexOfOpenGroup = INDEX_NONE;
+	int32 StartOfLiteral = INDEX_NONE;
+
+	auto EndLiteral = [&]()
+	{
+		if (StartOfLiteral != INDEX_NONE)
+		{
+			InOut_AllTokens.Add({ ETokenType::LITERAL, StartOfLiteral, InOut_AllLiterals.Num() - StartOfLiteral });
+			StartOfLiteral = INDEX_NONE;
+		}
+	};
+
+	for (int32 Index_Character = 0; Index_Character < Template.Len(); Index_Character++)
+	{
+		const TCHAR ThisCharacter = Template[Index_Character];
+
+		if (ThisCharacter == TEXT('{'))
+		{
+			const int32 IndexOfClosingBrace = Template.Find(TEXT("}"), ESearchCase::CaseSensitive, ESearchDir::FromStart,
+				Index_Character);
+
+			if (IndexOfClosingBrace == INDEX_NONE)
+			{
+				UE_LOG(LogTemp, Error, TEXT("The template \"%s\" has a placeholder that is never closed."), *Template);
+				return false;
+			}
+
+			const FStringView Name(*Template + Index_Character + 1, IndexOfClosingBrace - Index_Character - 1);
+			const FPlaceholder* ThisPlaceholder = nullptr;
+
+			for (const FPlaceholder& ThisPossiblePlaceholder : ALL_PLACEHOLDERS)
+			{
+				if (ThisPossiblePlaceholder.Name.Equals(Name, ESearchCase::CaseSensitive))
+				{
+					ThisPlaceholder = &ThisPossiblePlaceholder;
+					break;
+				}
+			}
+
+			if (ThisPlaceholder == nullptr)
+			{
+				UE_LOG(LogTemp, Error, TEXT("The template \"%s\" has the unknown placeholder {%s}."), *Template,
+					*FString(Name.Len(), Name.GetData()));
+				return false;
+			}
+
+			EndLiteral();
+			InOut_AllTokens.Add({ ThisPlaceholder->Type });
+			Index_Character = IndexOfClosingBrace;
+		}
+		else if (ThisCharacter == TEXT('['))
+		{
+			if (IndexOfOpenGroup != INDEX_NONE)
+			{
+				UE_LOG(LogTemp, Error, TEXT("The template \"%s\" has an optional group inside another."), *Template);
+				return false;
+			}
+
+			EndLiteral();
+			IndexOfOpenGroup = InOut_AllTokens.Add({ ETokenType::OPTIONAL_BEGIN });
+		}
+		else if (ThisCharacter == TEXT(']'))
+		{
+			if (IndexOfOpenGroup == INDEX_NONE)
+			{
+				UE_LOG(LogTemp, Error, TEXT("The template \"%s\" closes an optional group it never opened."), *Template);
+				return false;
+			}
+
+			EndLiteral();
+			InOut_AllTokens[IndexOfOpenGroup].Start = InOut_AllTokens.Add({ ETokenType::OPTIONAL_END });
+			IndexOfOpenGroup = INDEX_NONE;
+		}
+		else
+		{
+			if (StartOfLiteral == INDEX_NONE)
+			{
+				StartOfLiteral = InOut_AllLiterals.Num();
+			}
+
+			InOut_AllLiterals.Add(ThisCharacter);
+		}
+	}
+
+	if (IndexOfOpenGroup != INDEX_NONE)
+	{
+		UE_LOG(LogTemp, Error, TEXT("The template \"%s\" has an optional group that is never closed."), *Template);
+		return false;
+	}
+
+	EndLiteral();
+
+	return true;
+}
+
+#pragma endregion Compiling
+
+#pragma region Phrases
+
+FStringView FPGNNarrativeTextRealiser::GetTagPhrase(EPGNCharacterTag Tag)
+{
+	return PGNNarrativeTextRealiser::FindPhrase(PGNNarrativeTextRealiser::TAG_PHRASES, static_cast<int32>(Tag));
+}
+
+FStringView FPGNNarrativeTextRealiser::GetAttitudePhrase(EPGNCharacterAttitude Attitude)
+{
+	return PGNNarrativeTextRealiser::FindPhrase(PGNNarrativeTextRealiser::ATTITUDE_PHRASES, static_cast<int32>(Attitude));
+}
+
+FStringView FPGNNarrativeTextRealiser::GetActionPhrase(EPGNEventAction Action)
+{
+	return PGNNarrativeTextRealiser::FindPhrase(PGNNarrativeTextRealiser::ACTION_PHRASES, static_cast<int32>(Action));
+}
+
+FStringView FPGNNarrativeTextRealiser::GetTimeOfDayPhrase(EPGNEventTime TimeOfDay)
+{
+	return PGNNarrativeTextRealiser::FindPhrase(PGNNarrativeTextRealiser::TIME_OF_DAY_PHRASES, static_cast<int32>(TimeOfDay));
+}
+
+FStringView FPGNNarrativeTextRealiser::GetSettingPhrase(EPGNEventSetting Setting)
+{
+	return PGNNarrativeTextRealiser::FindPhrase(PGNNarrativeTextRealiser::SETTING_PHRASES, static_cast<int32>(Setting));
+}
+
+FStringView FPGNNarrativeTextRealiser::GetMoodPhrase(EPGNMood Mood)
+{
+	return PGNNarrativeTextRealiser::FindPhrase(PGNNarrativeTextRealiser::MOOD_PHRASES, static_cast<int32>(Mood));
+}
+
+#pragma endregion Phrases
@@ -0,0 +1,124 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/StringView.h"
+#include "Misc/StringBuilder.h"
+#include "ProceduralNarrative/PGNUtilities.h"
+#include "ProceduralNarrative/Events/PGNPackedEvent.h"
+
+class FPGNEventLibrary;
+struct FPGNNarrativeStateSnapshot;
+
+/**
+ * Turns narratives into prose, fast enough to do for every conversation an NPC has about them.
+ *
+ * Every action has a template, such as "{Subject} divorced[ {Object}][ {TimeOfDay}].", which is compiled once into a
+ * stream of tokens: literal text, placeholders, and optional groups in square brackets, which are left out whenever
+ * any placeholder in them has nothing to say. Rendering only walks the tokens and appends views of text that already
+ * exists, from the compiled literals, the phrase tables below and the characters' names, so it never goes through
+ * reflection and never allocates anything but the string it returns.
+ *
+ *	Placeholders	{Subject}, {Object}, {Action}, {SubjectAttitude}, {ObjectAttitude}, {TimeOfDay}, {Setting}, {Mood}
+ *
+ * Once its templates are set, a realiser is only read, so the one from Get() can be used from any thread.
+ */
+class PROCEDURALNARRATIVE_API FPGNNarrativeTextRealiser
+{
+public:
+
+	static constexpr int32 NUMBER_OF_ACTIONS = static_cast<int32>(EPGNEventAction::REVEALED_PREGNANT_WITH_CHILD_OF) + 1;
+
+	// Enough for every narrative we generate today, so that rendering one does not have to grow the builder.
+	static constexpr int32 INLINE_CHARACTERS_PER_NARRATIVE = 1024;
+
+	// Compiles the default template of every action.
+	FPGNNarrativeTextRealiser();
+
+	// The realiser with the default templates, shared by everyone who does not need their own.
+	static const FPGNNarrativeTextRealiser& Get();
+
+	// Returns false and keeps the previous template if this one does not compile.
+	bool SetTemplateForAction(EPGNEventAction Action, const FString& Template);
+
+#pragma region Rendering
+
+	// The cast is indexed by role, like FPGNNarrativeStateSnapshot::AllCharactersInCast. Roles nobody was cast in are
+	// referred to by their role instead.
+	void RealiseEvent(const FPGNPackedEvent& ThisEvent, TArrayView<const FPGNCharacter> AllCharactersInCast,
+		FStringBuilderBase& Out_Text) const;
+
+	// Every event of the narrative in order, ending with its conclusion, separated by spaces.
+	void RealiseNarrative(const FPGNGeneratedNarrative& ThisNarrative, const FPGNEventLibrary& EventLibrary,
+		TArrayView<const FPGNCharacter> AllCharactersInCast, FStringBuilderBase& Out_Text) const;
+
+	FString RealiseNarrative(const FPGNGeneratedNarrative& ThisNarrative, const FPGNEventLibrary& EventLibrary,
+		TArrayView<const FPGNCharacter> AllCharactersInCast) const;
+
+	// Empty if the snapshot has no event library to look its events up in.
+	FString RealiseNarrative(const FPGNNarrativeStateSnapshot& Snapshot) const;
+
+#pragma endregion Rendering
+
+#pragma region Phrases
+
+	// These are tables built at compile time, so they are safe to use anywhere text is needed in place of
+	// UEnum::GetValueAsString. Values past the end of a table give an empty view.
+	static FStringView GetTagPhrase(EPGNCharacterTag Tag);
+	static FStringView GetAttitudePhrase(EPGNCharacterAttitude Attitude);
+	static FStringView GetActionPhrase(EPGNEventAction Action);
+	static FStringView GetTimeOfDayPhrase(EPGNEventTime TimeOfDay);
+	static FStringView GetSettingPhrase(EPGNEventSetting Setting);
+	static FStringView GetMoodPhrase(EPGNMood Mood);
+
+#pragma endregion Phrases
+
+private:
+
+	enum class ETokenType : uint8
+	{
+		LITERAL,
+		SUBJECT,
+		OBJECT,
+		ACTION,
+		SUBJECT_ATTITUDE,
+		OBJECT_ATTITUDE,
+		TIME_OF_DAY,
+		SETTING,
+		MOOD,
+		OPTIONAL_BEGIN,
+		OPTIONAL_END
+	};
+
+	struct FToken
+	{
+		ETokenType Type = ETokenType::LITERAL;
+
+		// For literals, where their text starts in AllLiterals and how long it is. For the start of an optional group,
+		// the index of the token that ends it.
+		int32 Start = 0;
+		int32 Length = 0;
+	};
+
+	// Rebuilds every token stream and the literals from the template sources. Returns false if any of them does not
+	// compile, in which case nothing is changed.
+	bool CompileAllTemplates();
+
+	static bool CompileTemplate(const FString& Template, TArray<FToken>& InOut_AllTokens, TArray<TCHAR>& InOut_AllLiterals);
+
+	// An empty view means the placeholder has nothing to say about this event.
+	static FStringView ResolvePlaceholder(ETokenType Type, const FPGNPackedEvent& ThisEvent,
+		TArrayView<const FPGNCharacter> AllCharactersInCast);
+
+	static FStringView ResolveCharacter(EPGNCharacterTag Tag, TArrayView<const FPGNCharacter> AllCharactersInCast);
+
+	TArray<FString> AllTemplateSources;
+
+	// The tokens of the template of each action start at TokenOffsetOfAction[Action] and end just before
+	// TokenOffsetOfAction[Action + 1].
+	TArray<FToken> AllTokens;
+	int32 TokenOffsetOfAction[NUMBER_OF_ACTIONS + 1];
+
+	TArray<TCHAR> AllLiterals;
+};
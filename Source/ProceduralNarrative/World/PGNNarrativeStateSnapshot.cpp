@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/World/PGNNarrativeStateSnapshot.h"
+
+void FPGNNarrativeStatePublisher::Publish(const TSharedRef<FPGNNarrativeStateSnapshot, ESPMode::ThreadSafe>& NewSnapshot)
+{
+	NewSnapshot->Version = NextVersion++;
+
+	FPGNNarrativeStateSnapshotPtr ReplacedSnapshot = MoveTemp(LastPublishedSnapshot);
+	LastPublishedSnapshot = NewSnapshot;
+
+	// Everything in the snapshot has been written by now, and the swap is sequentially consistent, so no reader can
+	// see the pointer before the contents.
+	CurrentSnapshot = &NewSnapshot.Get();
+
+	// Only counters seen after the swap say anything about who might still be loading the old pointer, so it joins
+	// the list here.
+	if (ReplacedSnapshot.IsValid())
+	{
+		AllReplacedSnapshots.Add({ MoveTemp(ReplacedSnapshot) });
+	}
+
+	RetireSnapshots();
+}
+
+FPGNNarrativeStateSnapshotPtr FPGNNarrativeStatePublisher::Acquire() const
+{
+	TAtomic<int32>& ThisNumberOfActiveReaders = NumberOfActiveReaders[ReaderEpoch.Load() & 1];
+	++ThisNumberOfActiveReaders;
+
+	FPGNNarrativeStateSnapshotPtr AcquiredSnapshot;
+
+	if (const FPGNNarrativeStateSnapshot* Snapshot = CurrentSnapshot.Load())
+	{
+		AcquiredSnapshot = Snapshot->AsShared();
+	}
+
+	--ThisNumberOfActiveReaders;
+
+	return AcquiredSnapshot;
+}
+
+void FPGNNarrativeStatePublisher::RetireSnapshots()
+{
+	if (AllReplacedSnapshots.Num() == 0)
+	{
+		return;
+	}
+
+	const uint32 Epoch = ReaderEpoch.Load();
+	const uint32 ParityOfNewReaders = Epoch & 1;
+	const uint32 ParityOfOldReaders = ParityOfNewReaders ^ 1;
+
+	const bool bHasNoOldReaders = NumberOfActiveReaders[ParityOfOldReaders].Load() == 0;
+	const bool bHasNoNewReaders = NumberOfActiveReaders[ParityOfNewReaders].Load() == 0;
+
+	for (FReplacedSnapshot& ThisReplacedSnapshot : AllReplacedSnapshots)
+	{
+		ThisReplacedSnapshot.bHasSeenNoReaders[ParityOfOldReaders] |= bHasNoOldReaders;
+		ThisReplacedSnapshot.bHasSeenNoReaders[ParityOfNewReaders] |= bHasNoNewReaders;
+	}
+
+	// Once the old counter has drained, new readers are moved over to it, so the one they were using drains next.
+	if (bHasNoOldReaders && !bHasNoNewReaders)
+	{
+		ReaderEpoch = Epoch + 1;
+	}
+
+	// Both counters have been seen at zero since the oldest ones were replaced, so they always go first.
+	int32 NumberOfRetiredSnapshots = 0;
+
+	while (NumberOfRetiredSnapshots < AllReplacedSnapshots.Num()
+		&& AllReplacedSnapshots[NumberOfRetiredSnapshots].bHasSeenNoReaders[0]
+		&& AllReplacedSnapshots[NumberOfRetiredSnapshots].bHasSeenNoReaders[1])
+	{
+		NumberOfRetiredSnapshots++;
+	}
+
+	AllReplacedSnapshots.RemoveAt(0, NumberOfRetiredSnapshots, false);
+}
@@ -0,0 +1,101 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/Atomic.h"
+#include "ProceduralNarrative/PGNUtilities.h"
+#include "ProceduralNarrative/Events/PGNEventLibrary.h"
+#include "ProceduralNarrative/World/PGNWorldState.h"
+
+// Everything readers outside of generation need to know about the narrative that is playing out. It is never
+// changed once it has been published, so it can be read from any thread for as long as it is held.
+struct FPGNNarrativeStateSnapshot : public TSharedFromThis<FPGNNarrativeStateSnapshot, ESPMode::ThreadSafe>
+{
+	// Goes up by one with every snapshot that is published.
+	uint64 Version = 0;
+
+	FPGNGeneratedNarrative Narrative;
+	FPGNConclusionEvent ConclusionEvent;
+
+	// The library the narrative's event IDs refer to. A reload builds a new one, so the snapshot keeps its own.
+	FPGNEventLibraryPtr EventLibrary;
+
+	// Indexed by role, like FPGNGeneratedNarrative::AllIndicesOfCharactersInUse. Roles nobody was cast in are left
+	// as a default character.
+	TArray<FPGNCharacter> AllCharactersInCast;
+
+	// The attitude of everyone in town, and whether they are still in it. This shares everything that did not
+	// change with the snapshots before it.
+	FPGNWorldState WorldState;
+
+	int32 NumberOfArchivedNarratives = 0;
+};
+
+using FPGNNarrativeStateSnapshotPtr = TSharedPtr<const FPGNNarrativeStateSnapshot, ESPMode::ThreadSafe>;
+
+/**
+ * Publishes narrative state snapshots to readers on any thread, read-copy-update style.
+ *
+ * Whoever generates narratives builds a new snapshot and publishes it by swapping a single pointer. Readers load the
+ * pointer and take a reference to the snapshot, without ever taking a lock, and see either the whole of the old
+ * snapshot or the whole of the new one.
+ *
+ * The only danger is a reader who has loaded the old pointer but not yet taken their reference when the publisher
+ * lets go of it. Readers therefore count themselves in one of two counters for those two steps, picked by the parity
+ * of ReaderEpoch. A replaced snapshot is kept until each counter has been seen at zero since the swap: any reader who
+ * could have loaded the old pointer was counted in one of them from before the swap, and anyone who starts reading
+ * after it can only load the new pointer.
+ *
+ * Under a steady stream of readers, neither counter might ever reach zero on its own. So once the counter that new
+ * readers no longer use has drained, the publisher flips the epoch, and the other one starts draining in its turn.
+ * Every replaced snapshot is let go of within a couple of publishes, however busy the readers are.
+ *
+ * Only one thread may publish, and only the publisher ever touches the replaced snapshots. Any number may acquire.
+ */
+class PROCEDURALNARRATIVE_API FPGNNarrativeStatePublisher
+{
+public:
+
+	FPGNNarrativeStatePublisher() = default;
+
+	FPGNNarrativeStatePublisher(const FPGNNarrativeStatePublisher&) = delete;
+	FPGNNarrativeStatePublisher& operator=(const FPGNNarrativeStatePublisher&) = delete;
+
+	// Stamps the snapshot with the next version and makes it the one every new reader gets.
+	void Publish(const TSharedRef<FPGNNarrativeStateSnapshot, ESPMode::ThreadSafe>& NewSnapshot);
+
+	// Null until something has been published. Safe to call from any thread. It never blocks and never fails.
+	FPGNNarrativeStateSnapshotPtr Acquire() const;
+
+	// Publisher only. Lets go of every replaced snapshot that no reader can still be about to acquire. Publishing
+	// does this too.
+	void RetireSnapshots();
+
+	// Publisher only.
+	const FPGNNarrativeStateSnapshotPtr& GetLastPublishedSnapshot() const { return LastPublishedSnapshot; }
+
+	int32 GetNumberOfSnapshotsWaitingToRetire() const { return AllReplacedSnapshots.Num(); }
+
+private:
+
+	struct FReplacedSnapshot
+	{
+		FPGNNarrativeStateSnapshotPtr Snapshot;
+
+		// Whether each of the two reader counters has been seen at zero since this snapshot was replaced.
+		bool bHasSeenNoReaders[2] = { false, false };
+	};
+
+	TAtomic<const FPGNNarrativeStateSnapshot*> CurrentSnapshot { nullptr };
+
+	// New readers count themselves in NumberOfActiveReaders[ReaderEpoch & 1].
+	TAtomic<uint32> ReaderEpoch { 0 };
+	mutable TAtomic<int32> NumberOfActiveReaders[2] { 0, 0 };
+
+	// The publisher's own reference to the current snapshot, which keeps it alive while it is current.
+	FPGNNarrativeStateSnapshotPtr LastPublishedSnapshot;
+
+	TArray<FReplacedSnapshot> AllReplacedSnapshots;
+	uint64 NextVersion = 1;
+};
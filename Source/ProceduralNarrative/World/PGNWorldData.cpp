@@ -0,0 +1,259 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/World/PGNWorldData.h"
+
+#include "HAL/FileManager.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+#include "ProceduralNarrative/DataAssets/PGNCharacterDataAsset.h"
+#include "ProceduralNarrative/DataAssets/PGNEventDataAsset.h"
+#include "ProceduralNarrative/DataAssets/PGNMoodGraphDataAsset.h"
+#include "ProceduralNarrative/Events/PGNEventLibraryFile.h"
+#include "ProceduralNarrative/Graphs/MoodGraph.h"
+
+SIZE_T FPGNWorldData::GetAllocatedSize() const
+{
+	// The event library is not counted here, since it may be shared with a data asset or be memory-mapped.
+	return AllConclusionEvents.GetAllocatedSize() + MoodDistanceTable.GetAllocatedSize()
+		+ GenerationAliasTable.Probabilities.GetAllocatedSize() + GenerationAliasTable.Aliases.GetAllocatedSize()
+		+ TemplateAllocationOrder.GetAllocatedSize();
+}
+
+FPGNWorldDataCache& FPGNWorldDataCache::Get()
+{
+	static FPGNWorldDataCache WorldDataCache;
+	return WorldDataCache;
+}
+
+FPGNWorldDataPtr FPGNWorldDataCache::FindOrCreate(const UPGNEventDataAsset* EventDataAsset,
+	const FString& EventLibraryFilename, const UPGNMoodGraphDataAsset* MoodGraphDataAsset,
+	const UPGNCharacterDataAsset* CharacterDataAsset)
+{
+	const FPGNWorldDataKey Key = CreateKey(EventDataAsset, EventLibraryFilename, MoodGraphDataAsset, CharacterDataAsset);
+
+	// The lock is held while building, so that two sessions starting at once do not both build the same data.
+	FScopeLock Lock(&CriticalSection);
+
+	if (const TWeakPtr<const FPGNWorldData, ESPMode::ThreadSafe>* ExistingWorld = AllWorlds.Find(Key))
+	{
+		if (FPGNWorldDataPtr ExistingWorldData = ExistingWorld->Pin())
+		{
+			return ExistingWorldData;
+		}
+	}
+
+	// Nobody is using the worlds that have expired, so this is a good time to forget them. The rest are kept alive
+	// until the build is done, so that it can share their parts.
+	TArray<FPGNWorldDataPtr> AllLiveWorlds;
+
+	for (auto It = AllWorlds.CreateIterator(); It; ++It)
+	{
+		if (FPGNWorldDataPtr ThisWorldData = It.Value().Pin())
+		{
+			AllLiveWorlds.Add(MoveTemp(ThisWorldData));
+		}
+		else
+		{
+			It.RemoveCurrent();
+		}
+	}
+
+	FPGNWorldDataPtr NewWorldData = Build(Key, EventDataAsset, EventLibraryFilename, MoodGraphDataAsset,
+		CharacterDataAsset, AllLiveWorlds);
+
+	if (NewWorldData.IsValid())
+	{
+		AllWorlds.Add(Key, NewWorldData);
+	}
+
+	return NewWorldData;
+}
+
+int32 FPGNWorldDataCache::GetNumberOfLiveWorlds() const
+{
+	FScopeLock Lock(&CriticalSection);
+
+	int32 NumberOfLiveWorlds = 0;
+
+	for (const TPair<FPGNWorldDataKey, TWeakPtr<const FPGNWorldData, ESPMode::ThreadSafe>>& ThisWorld : AllWorlds)
+	{
+		NumberOfLiveWorlds += ThisWorld.Value.IsValid() ? 1 : 0;
+	}
+
+	return NumberOfLiveWorlds;
+}
+
+FPGNWorldDataKey FPGNWorldDataCache::CreateKey(const UPGNEventDataAsset* EventDataAsset,
+	const FString& EventLibraryFilename, const UPGNMoodGraphDataAsset* MoodGraphDataAsset,
+	const UPGNCharacterDataAsset* CharacterDataAsset)
+{
+	FPGNWorldDataKey Key;
+	Key.MoodGraphDataAsset = FObjectKey(MoodGraphDataAsset);
+	Key.CharacterDataAsset = FObjectKey(CharacterDataAsset);
+
+	// We use the baked hashes where we can, since they are already known and are checked against the authored data
+	// in the editor anyway.
+	if (MoodGraphDataAsset != nullptr)
+	{
+		Key.MoodGraphSourceHash = MoodGraphDataAsset->HasValidBakedData()
+			? MoodGraphDataAsset->GetBakedSourceHash() : MoodGraphDataAsset->CalculateSourceHash();
+	}
+
+	if (CharacterDataAsset != nullptr)
+	{
+		Key.CharacterSourceHash = CharacterDataAsset->HasValidBakedData()
+			? CharacterDataAsset->GetBakedSourceHash() : CharacterDataAsset->CalculateSourceHash();
+	}
+
+	if (!EventLibraryFilename.IsEmpty())
+	{
+		// A file that is imported again gets a new timestamp, which is enough to tell the versions apart.
+		Key.EventLibraryFilename = FPaths::ConvertRelativePathToFull(EventLibraryFilename);
+		Key.EventLibraryFileTimestamp = IFileManager::Get().GetTimeStamp(*Key.EventLibraryFilename);
+	}
+	else if (EventDataAsset != nullptr)
+	{
+		Key.EventDataAsset = FObjectKey(EventDataAsset);
+		Key.EventSourceHash = EventDataAsset->HasValidBakedData()
+			? EventDataAsset->GetBakedSourceHash() : EventDataAsset->CalculateSourceHash();
+	}
+
+	return Key;
+}
+
+FPGNWorldDataPtr FPGNWorldDataCache::Build(const FPGNWorldDataKey& Key, const UPGNEventDataAsset* EventDataAsset,
+	const FString& EventLibraryFilename, const UPGNMoodGraphDataAsset* MoodGraphDataAsset,
+	const UPGNCharacterDataAsset* CharacterDataAsset, const TArray<FPGNWorldDataPtr>& AllLiveWorlds)
+{
+	const TSharedRef<FPGNWorldData, ESPMode::ThreadSafe> NewWorldData = MakeShared<FPGNWorldData, ESPMode::ThreadSafe>();
+	NewWorldData->Key = Key;
+
+	const auto FindLiveWorldWithSamePart = [&AllLiveWorlds](TFunctionRef<bool(const FPGNWorldDataKey&)> HasSamePart)
+		-> const FPGNWorldData*
+	{
+		const FPGNWorldDataPtr* LiveWorld = AllLiveWorlds.FindByPredicate([&HasSamePart](const FPGNWorldDataPtr& ThisWorldData)
+		{
+			return HasSamePart(ThisWorldData->Key);
+		});
+
+		return LiveWorld != nullptr ? LiveWorld->Get() : nullptr;
+	};
+
+	// The event library is never changed after it is built, so it can be shared as is.
+	if (const FPGNWorldData* WorldWithSameEvents = FindLiveWorldWithSamePart([&Key](const FPGNWorldDataKey& OtherKey)
+	{
+		return Key.HasSameEventsAs(OtherKey);
+	}))
+	{
+		NewWorldData->EventLibrary = WorldWithSameEvents->EventLibrary;
+		NewWorldData->AllConclusionEvents = WorldWithSameEvents->AllConclusionEvents;
+	}
+	else if (!BuildEvents(EventDataAsset, EventLibraryFilename, *NewWorldData))
+	{
+		return nullptr;
+	}
+
+	// The distance between every pair of moods is normally baked into the data asset when it is saved.
+	if (const FPGNWorldData* WorldWithSameMoodGraph = FindLiveWorldWithSamePart([&Key](const FPGNWorldDataKey& OtherKey)
+	{
+		return Key.HasSameMoodGraphAs(OtherKey);
+	}))
+	{
+		NewWorldData->MoodDistanceTable = WorldWithSameMoodGraph->MoodDistanceTable;
+	}
+	else if (MoodGraphDataAsset != nullptr)
+	{
+		if (MoodGraphDataAsset->HasValidBakedData())
+		{
+			NewWorldData->MoodDistanceTable = MoodGraphDataAsset->GetBakedMoodDistanceTable();
+		}
+		else
+		{
+			UMoodGraph::CreateAllPairsDistanceTable(MoodGraphDataAsset->AllVertices, MoodGraphDataAsset->AllEdges,
+				NewWorldData->MoodDistanceTable);
+		}
+	}
+
+	// Generations are sampled through an alias table, and templates are handed out from least used to most used.
+	// Both are normally baked into the data asset too.
+	if (const FPGNWorldData* WorldWithSameCharacters = FindLiveWorldWithSamePart([&Key](const FPGNWorldDataKey& OtherKey)
+	{
+		return Key.HasSameCharactersAs(OtherKey);
+	}))
+	{
+		NewWorldData->GenerationAliasTable = WorldWithSameCharacters->GenerationAliasTable;
+		NewWorldData->TemplateAllocationOrder = WorldWithSameCharacters->TemplateAllocationOrder;
+	}
+	else if (CharacterDataAsset != nullptr)
+	{
+		if (CharacterDataAsset->HasValidBakedData())
+		{
+			NewWorldData->GenerationAliasTable = CharacterDataAsset->GetBakedGenerationAliasTable();
+			NewWorldData->TemplateAllocationOrder = CharacterDataAsset->GetBakedTemplateAllocationOrder();
+		}
+		else
+		{
+			UPGNCharacterDataAsset::CreateGenerationAliasTable(CharacterDataAsset->AllDemographicParameters,
+				NewWorldData->GenerationAliasTable);
+			UPGNCharacterDataAsset::CreateTemplateAllocationOrder(CharacterDataAsset->AllCharacterTemplates,
+				NewWorldData->TemplateAllocationOrder);
+		}
+	}
+
+	return NewWorldData;
+}
+
+bool FPGNWorldDataCache::BuildEvents(const UPGNEventDataAsset* EventDataAsset, const FString& EventLibraryFilename,
+	FPGNWorldData& Out_WorldData)
+{
+	if (!EventLibraryFilename.IsEmpty())
+	{
+		// We will map the event library file, so only the pages that are actually used are ever read from disk.
+		Out_WorldData.EventLibrary = FPGNEventLibraryFile::LoadMemoryMapped(EventLibraryFilename);
+
+		if (!Out_WorldData.EventLibrary.IsValid())
+		{
+			UE_LOG(LogTemp, Error, TEXT("Could not load the event library file %s."), *EventLibraryFilename);
+			return false;
+		}
+
+		// The conclusion events are the only ones that are kept unpacked, since their usage is tracked.
+		Out_WorldData.AllConclusionEvents.SetNum(Out_WorldData.EventLibrary->GetNumberOfConclusionEvents());
+
+		for (FPGNEventId ThisEventId = 0; ThisEventId < Out_WorldData.AllConclusionEvents.Num(); ThisEventId++)
+		{
+			Out_WorldData.EventLibrary->UnpackEvent(ThisEventId, Out_WorldData.AllConclusionEvents[ThisEventId]);
+		}
+	}
+	else if (EventDataAsset != nullptr)
+	{
+		Out_WorldData.AllConclusionEvents = EventDataAsset->AllConclusionEvents;
+
+		// Usage belongs to each session, so none of it is shared, even if the data asset happens to have some.
+		for (FPGNConclusionEvent& ThisConclusionEvent : Out_WorldData.AllConclusionEvents)
+		{
+			ThisConclusionEvent.AllNarrativesThisConclusionEventIsIn.Empty();
+		}
+
+		// Then get every event in the packed form that the generator works with. This is normally baked into the data
+		// asset when it is saved, so we only compile it here if that data is missing or out of date.
+		if (EventDataAsset->HasValidBakedData())
+		{
+			Out_WorldData.EventLibrary = EventDataAsset->GetBakedEventLibrary();
+		}
+		else
+		{
+			const TSharedRef<FPGNEventLibrary, ESPMode::ThreadSafe> CompiledEventLibrary = MakeShared<FPGNEventLibrary, ESPMode::ThreadSafe>();
+			CompiledEventLibrary->BuildFromDataAsset(EventDataAsset);
+			Out_WorldData.EventLibrary = CompiledEventLibrary;
+		}
+	}
+	else
+	{
+		UE_LOG(LogTemp, Error, TEXT("There is no Event Data Asset or event library file. Please set one and try again."));
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,129 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/CriticalSection.h"
+#include "UObject/ObjectKey.h"
+#include "ProceduralNarrative/PGNUtilities.h"
+#include "ProceduralNarrative/Events/PGNEventLibrary.h"
+#include "ProceduralNarrative/Generation/PGNAliasTable.h"
+
+class UPGNCharacterDataAsset;
+class UPGNEventDataAsset;
+class UPGNMoodGraphDataAsset;
+
+// Which assets, and which version of each, a set of world data was built from.
+struct FPGNWorldDataKey
+{
+	FObjectKey EventDataAsset;
+	FString EventLibraryFilename;
+	FDateTime EventLibraryFileTimestamp;
+
+	uint32 EventSourceHash = 0;
+
+	FObjectKey MoodGraphDataAsset;
+	uint32 MoodGraphSourceHash = 0;
+
+	FObjectKey CharacterDataAsset;
+	uint32 CharacterSourceHash = 0;
+
+	// Each part of the world data only depends on one of the assets, so a part can be reused by any other world data
+	// built from the same version of that asset.
+	bool HasSameEventsAs(const FPGNWorldDataKey& Other) const
+	{
+		return EventDataAsset == Other.EventDataAsset && EventLibraryFilename == Other.EventLibraryFilename
+			&& EventLibraryFileTimestamp == Other.EventLibraryFileTimestamp && EventSourceHash == Other.EventSourceHash;
+	}
+
+	bool HasSameMoodGraphAs(const FPGNWorldDataKey& Other) const
+	{
+		return MoodGraphDataAsset == Other.MoodGraphDataAsset && MoodGraphSourceHash == Other.MoodGraphSourceHash;
+	}
+
+	bool HasSameCharactersAs(const FPGNWorldDataKey& Other) const
+	{
+		return CharacterDataAsset == Other.CharacterDataAsset && CharacterSourceHash == Other.CharacterSourceHash;
+	}
+
+	bool operator==(const FPGNWorldDataKey& Other) const
+	{
+		return HasSameEventsAs(Other) && HasSameMoodGraphAs(Other) && HasSameCharactersAs(Other);
+	}
+
+	friend uint32 GetTypeHash(const FPGNWorldDataKey& Key)
+	{
+		uint32 Hash = HashCombine(GetTypeHash(Key.EventDataAsset), GetTypeHash(Key.EventLibraryFilename));
+		Hash = HashCombine(Hash, Key.EventSourceHash);
+		Hash = HashCombine(Hash, HashCombine(GetTypeHash(Key.MoodGraphDataAsset), Key.MoodGraphSourceHash));
+		return HashCombine(Hash, HashCombine(GetTypeHash(Key.CharacterDataAsset), Key.CharacterSourceHash));
+	}
+};
+
+/**
+ * Everything an overseer reads but never changes: the event library and its indices, the conclusion events, the
+ * mood distance table and the character samplers.
+ *
+ * It is built once per set of assets and then shared, through FPGNWorldDataCache, by every overseer in the process
+ * that uses those assets. Nothing in here may be changed after it is built, so it can be read from any thread.
+ */
+struct PROCEDURALNARRATIVE_API FPGNWorldData
+{
+	FPGNWorldDataKey Key;
+
+	FPGNEventLibraryPtr EventLibrary;
+
+	// The ID of a conclusion event is its index in here. How often each one has been used is kept by each overseer.
+	TArray<FPGNConclusionEvent> AllConclusionEvents;
+
+	// All-pairs distances of the mood graph, indexed with UMoodGraph::GetIndexInDistanceTable.
+	TArray<int> MoodDistanceTable;
+
+	// Picks an index into the character data asset's AllDemographicParameters.
+	FPGNAliasTable GenerationAliasTable;
+
+	// Indices into the character data asset's AllCharacterTemplates, from least used to most used.
+	TArray<int> TemplateAllocationOrder;
+
+	SIZE_T GetAllocatedSize() const;
+};
+
+using FPGNWorldDataPtr = TSharedPtr<const FPGNWorldData, ESPMode::ThreadSafe>;
+
+/**
+ * Hands out the world data for a set of assets, building it only if no one in the process is using it already.
+ *
+ * The cache only holds weak references, so the world data is freed as soon as the last overseer using it lets go of
+ * it. Editing any of the assets changes their source hash, so the next overseer that asks gets freshly built data
+ * while everyone else keeps the version they started with. Only the parts built from the edited asset are built
+ * again; the rest are shared with the world data that is still alive, which is what keeps reloading an edited asset
+ * cheap.
+ */
+class PROCEDURALNARRATIVE_API FPGNWorldDataCache
+{
+public:
+
+	static FPGNWorldDataCache& Get();
+
+	// Returns null if there are no events to build from. EventLibraryFilename takes the place of the event data asset
+	// if it is not empty.
+	FPGNWorldDataPtr FindOrCreate(const UPGNEventDataAsset* EventDataAsset, const FString& EventLibraryFilename,
+		const UPGNMoodGraphDataAsset* MoodGraphDataAsset, const UPGNCharacterDataAsset* CharacterDataAsset);
+
+	int32 GetNumberOfLiveWorlds() const;
+
+private:
+
+	static FPGNWorldDataKey CreateKey(const UPGNEventDataAsset* EventDataAsset, const FString& EventLibraryFilename,
+		const UPGNMoodGraphDataAsset* MoodGraphDataAsset, const UPGNCharacterDataAsset* CharacterDataAsset);
+
+	static FPGNWorldDataPtr Build(const FPGNWorldDataKey& Key, const UPGNEventDataAsset* EventDataAsset,
+		const FString& EventLibraryFilename, const UPGNMoodGraphDataAsset* MoodGraphDataAsset,
+		const UPGNCharacterDataAsset* CharacterDataAsset, const TArray<FPGNWorldDataPtr>& AllLiveWorlds);
+
+	static bool BuildEvents(const UPGNEventDataAsset* EventDataAsset, const FString& EventLibraryFilename,
+		FPGNWorldData& Out_WorldData);
+
+	mutable FCriticalSection CriticalSection;
+	TMap<FPGNWorldDataKey, TWeakPtr<const FPGNWorldData, ESPMode::ThreadSafe>> AllWorlds;
+};
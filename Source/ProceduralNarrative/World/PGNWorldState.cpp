@@ -0,0 +1,187 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProceduralNarrative/World/PGNWorldState.h"
+
+#include "ProceduralNarrative/PGNHash.h"
+
+FPGNWorldState::FPGNWorldState(int32 InNumberOfCharacters)
+	: NumberOfCharacters(FMath::Max(InNumberOfCharacters, 0))
+{
+	constexpr int32 CHARACTERS_PER_PAGE = CHARACTERS_PER_CHUNK * CHUNKS_PER_PAGE;
+	const int32 NumberOfPages = FMath::DivideAndRoundUp(NumberOfCharacters, CHARACTERS_PER_PAGE);
+
+	// Every character starts the same, so every page starts as the same page of the same chunk. The first change to
+	// any of them gives it its own copy.
+	const FChunkPtr DefaultChunk = MakeShared<FChunk, ESPMode::ThreadSafe>();
+	const FPagePtr DefaultPage = MakeShared<FPage, ESPMode::ThreadSafe>();
+
+	for (FChunkPtr& ThisChunk : DefaultPage->AllChunks)
+	{
+		ThisChunk = DefaultChunk;
+	}
+
+	PageTable = MakeShared<FPageTable, ESPMode::ThreadSafe>();
+	PageTable->Init(DefaultPage, NumberOfPages);
+
+	const FPGNCharacterState DefaultState;
+
+	for (int32 Index_Character = 0; Index_Character < NumberOfCharacters; Index_Character++)
+	{
+		Hash += HashCharacterState(Index_Character, DefaultState);
+	}
+}
+
+FPGNWorldState FPGNWorldState::CreateFromCharacters(const TArray<FPGNCharacter>& AllCharacters)
+{
+	FPGNWorldState NewWorldState(AllCharacters.Num());
+
+	for (int32 Index_Character = 0; Index_Character < AllCharacters.Num(); Index_Character++)
+	{
+		if (!AllCharacters[Index_Character].bIsInTown)
+		{
+			FPGNCharacterState ThisState;
+			ThisState.bIsInTown = false;
+			NewWorldState.SetCharacterState(Index_Character, ThisState);
+		}
+	}
+
+	return NewWorldState;
+}
+
+const FPGNCharacterState& FPGNWorldState::GetCharacterState(int32 IndexOfCharacter) const
+{
+	check(IsValidIndex(IndexOfCharacter));
+
+	const int32 IndexOfChunk = IndexOfCharacter / CHARACTERS_PER_CHUNK;
+	const FPage& ThisPage = *(*PageTable)[IndexOfChunk / CHUNKS_PER_PAGE];
+
+	return ThisPage.AllChunks[IndexOfChunk % CHUNKS_PER_PAGE]->AllStates[IndexOfCharacter % CHARACTERS_PER_CHUNK];
+}
+
+void FPGNWorldState::SetCharacterState(int32 IndexOfCharacter, const FPGNCharacterState& NewState)
+{
+	if (!IsValidIndex(IndexOfCharacter))
+	{
+		UE_LOG(LogTemp, Error, TEXT("The character %d is not in this world state."), IndexOfCharacter);
+		return;
+	}
+
+	// Writing the same state again should not cost a copy.
+	const FPGNCharacterState& PreviousState = GetCharacterState(IndexOfCharacter);
+
+	if (PreviousState == NewState)
+	{
+		return;
+	}
+
+	Hash -= HashCharacterState(IndexOfCharacter, PreviousState);
+	Hash += HashCharacterState(IndexOfCharacter, NewState);
+
+	GetChunkForWriting(IndexOfCharacter).AllStates[IndexOfCharacter % CHARACTERS_PER_CHUNK] = NewState;
+}
+
+void FPGNWorldState::ApplyEvent(const FPGNEvent& ThisEvent, int32 IndexOfSubject, int32 IndexOfObject)
+{
+	if (IsValidIndex(IndexOfSubject))
+	{
+		FPGNCharacterState SubjectState = GetCharacterState(IndexOfSubject);
+		SubjectState.CurrentAttitude = ThisEvent.SubjectFinalAttitude;
+
+		if (ThisEvent.Action == EPGNEventAction::KILLED_IN_HIT_AND_RUN || ThisEvent.Action == EPGNEventAction::DEPARTS_THE_TOWN)
+		{
+			SubjectState.bIsInTown = false;
+		}
+
+		SetCharacterState(IndexOfSubject, SubjectState);
+	}
+
+	if (ThisEvent.bDoesEventHaveObject && IsValidIndex(IndexOfObject))
+	{
+		FPGNCharacterState ObjectState = GetCharacterState(IndexOfObject);
+		ObjectState.CurrentAttitude = ThisEvent.ObjectFinalAttitude;
+		SetCharacterState(IndexOfObject, ObjectState);
+	}
+}
+
+bool FPGNWorldState::operator==(const FPGNWorldState& Other) const
+{
+	if (NumberOfCharacters != Other.NumberOfCharacters || Hash != Other.Hash)
+	{
+		return false;
+	}
+
+	if (NumberOfCharacters == 0 || PageTable == Other.PageTable)
+	{
+		return true;
+	}
+
+	// Branches of the same search share most of their pages and chunks, and anything shared is the same.
+	for (int32 Index_Page = 0; Index_Page < PageTable->Num(); Index_Page++)
+	{
+		const FPagePtr& ThisPage = (*PageTable)[Index_Page];
+		const FPagePtr& OtherPage = (*Other.PageTable)[Index_Page];
+
+		if (ThisPage == OtherPage)
+		{
+			continue;
+		}
+
+		for (int32 Index_Chunk = 0; Index_Chunk < CHUNKS_PER_PAGE; Index_Chunk++)
+		{
+			const FChunkPtr& ThisChunk = ThisPage->AllChunks[Index_Chunk];
+			const FChunkPtr& OtherChunk = OtherPage->AllChunks[Index_Chunk];
+
+			if (ThisChunk == OtherChunk)
+			{
+				continue;
+			}
+
+			// Slots past the last character are never written, so they always match.
+			for (int32 Index_State = 0; Index_State < CHARACTERS_PER_CHUNK; Index_State++)
+			{
+				if (ThisChunk->AllStates[Index_State] != OtherChunk->AllStates[Index_State])
+				{
+					return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+uint64 FPGNWorldState::HashCharacterState(int32 IndexOfCharacter, const FPGNCharacterState& State)
+{
+	const uint64 PackedState = static_cast<uint64>(State.CurrentAttitude) << 1 | (State.bIsInTown ? 1ull : 0ull);
+
+	// Mixed, so that changing one character changes every bit of the hash.
+	return PGNHash::MixBits(static_cast<uint64>(static_cast<uint32>(IndexOfCharacter)) << 32 | PackedState);
+}
+
+FPGNWorldState::FChunk& FPGNWorldState::GetChunkForWriting(int32 IndexOfCharacter)
+{
+	const int32 IndexOfChunk = IndexOfCharacter / CHARACTERS_PER_CHUNK;
+
+	// Anything another world state can still see is copied before it is changed. Anything only we can see is ours.
+	if (!PageTable.IsUnique())
+	{
+		PageTable = MakeShared<FPageTable, ESPMode::ThreadSafe>(*PageTable);
+	}
+
+	FPagePtr& ThisPage = (*PageTable)[IndexOfChunk / CHUNKS_PER_PAGE];
+
+	if (!ThisPage.IsUnique())
+	{
+		ThisPage = MakeShared<FPage, ESPMode::ThreadSafe>(*ThisPage);
+	}
+
+	FChunkPtr& ThisChunk = ThisPage->AllChunks[IndexOfChunk % CHUNKS_PER_PAGE];
+
+	if (!ThisChunk.IsUnique())
+	{
+		ThisChunk = MakeShared<FChunk, ESPMode::ThreadSafe>(*ThisChunk);
+	}
+
+	return *ThisChunk;
+}
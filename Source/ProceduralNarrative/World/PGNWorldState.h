@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "ProceduralNarrative/PGNUtilities.h"
+
+// The part of a character that events change, as a search over event sequences sees it.
+struct FPGNCharacterState
+{
+	EPGNCharacterAttitude CurrentAttitude = EPGNCharacterAttitude::ATTITUDE_NONE;
+	bool bIsInTown = true;
+
+	bool operator==(const FPGNCharacterState& Other) const
+	{
+		return CurrentAttitude == Other.CurrentAttitude && bIsInTown == Other.bIsInTown;
+	}
+
+	bool operator!=(const FPGNCharacterState& Other) const { return !(*this == Other); }
+};
+
+/**
+ * The state of every character in a hypothetical world, which a search can branch from and back out of for free.
+ *
+ * The states are kept in chunks of CHARACTERS_PER_CHUNK, and the chunks in pages of CHUNKS_PER_PAGE, and nothing that
+ * is shared is ever written to. Copying a world state therefore only copies one pointer, and changing a character
+ * only copies the page table, their page and their chunk, unless this world state is the only one using them, in
+ * which case they are changed in place. Thousands of branches of a search share everything they have not changed.
+ *
+ * The hash is kept up to date with every change, as a sum of one well mixed term per character, so it never has to
+ * walk the characters. Comparing two world states skips every page and chunk they share.
+ *
+ * A world state can be read from any number of threads at once, and each branch can be changed on its own thread, but
+ * a single world state must not be changed while anything else is using it.
+ */
+class PROCEDURALNARRATIVE_API FPGNWorldState
+{
+public:
+
+	static constexpr int32 CHARACTERS_PER_CHUNK = 64;
+	static constexpr int32 CHUNKS_PER_PAGE = 64;
+
+	FPGNWorldState() = default;
+
+	// Every character starts in town, with no attitude.
+	explicit FPGNWorldState(int32 InNumberOfCharacters);
+
+	static FPGNWorldState CreateFromCharacters(const TArray<FPGNCharacter>& AllCharacters);
+
+	int32 Num() const { return NumberOfCharacters; }
+	bool IsValidIndex(int32 IndexOfCharacter) const { return IndexOfCharacter >= 0 && IndexOfCharacter < NumberOfCharacters; }
+
+	const FPGNCharacterState& GetCharacterState(int32 IndexOfCharacter) const;
+	void SetCharacterState(int32 IndexOfCharacter, const FPGNCharacterState& NewState);
+
+	/*
+	 * Leaves the subject and the object in the attitudes this event ends them in, and takes anyone the action removes
+	 * out of town, as APGNOverseer::ApplyOutcomeOfThisEventAction would. IndexOfObject is ignored if the event has no
+	 * object.
+	 */
+	void ApplyEvent(const FPGNEvent& ThisEvent, int32 IndexOfSubject, int32 IndexOfObject = INDEX_NONE);
+
+	uint64 GetHash() const { return Hash; }
+
+	bool operator==(const FPGNWorldState& Other) const;
+	bool operator!=(const FPGNWorldState& Other) const { return !(*this == Other); }
+
+	friend uint32 GetTypeHash(const FPGNWorldState& WorldState) { return static_cast<uint32>(WorldState.Hash); }
+
+private:
+
+	struct FChunk
+	{
+		FPGNCharacterState AllStates[CHARACTERS_PER_CHUNK];
+	};
+
+	using FChunkPtr = TSharedPtr<FChunk, ESPMode::ThreadSafe>;
+
+	struct FPage
+	{
+		FChunkPtr AllChunks[CHUNKS_PER_PAGE];
+	};
+
+	using FPagePtr = TSharedPtr<FPage, ESPMode::ThreadSafe>;
+	using FPageTable = TArray<FPagePtr>;
+	using FPageTablePtr = TSharedPtr<FPageTable, ESPMode::ThreadSafe>;
+
+	static uint64 HashCharacterState(int32 IndexOfCharacter, const FPGNCharacterState& State);
+
+	// Makes sure the chunk this character is in belongs to this world state alone, and returns it.
+	FChunk& GetChunkForWriting(int32 IndexOfCharacter);
+
+	FPageTablePtr PageTable;
+	int32 NumberOfCharacters = 0;
+	uint64 Hash = 0;
+};